@@ -0,0 +1,384 @@
+#include "pch.h"
+#include "Actions/ActionCache.h"
+
+#include "Actions/WindowIndex.h"
+#include "Configuration/ConfigurationDiff.h"
+#include "Utils/ThreadQos.h"
+
+#include <userenv.h>
+
+#pragma comment(lib, "userenv.lib")
+
+namespace khm
+{
+    namespace
+    {
+        constexpr wchar_t AppPathsKey[] = L"Software\\Microsoft\\Windows\\CurrentVersion\\App Paths\\";
+
+        std::wstring Unquote(std::wstring value)
+        {
+            if (value.size() >= 2 && value.front() == L'"' && value.back() == L'"')
+            {
+                value = value.substr(1, value.size() - 2);
+            }
+            return value;
+        }
+
+        bool FileExists(std::wstring const& path) noexcept
+        {
+            DWORD const attributes = GetFileAttributesW(path.c_str());
+            return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+        }
+
+        // REG_EXPAND_SZ values come back expanded.
+        std::wstring ReadString(HKEY root, std::wstring const& subkey, wchar_t const* value)
+        {
+            DWORD bytes = 0;
+            if (RegGetValueW(root, subkey.c_str(), value, RRF_RT_REG_SZ, nullptr, nullptr, &bytes) != ERROR_SUCCESS || bytes < sizeof(wchar_t))
+            {
+                return {};
+            }
+            std::wstring text(bytes / sizeof(wchar_t), L'\0');
+            if (RegGetValueW(root, subkey.c_str(), value, RRF_RT_REG_SZ, nullptr, text.data(), &bytes) != ERROR_SUCCESS)
+            {
+                return {};
+            }
+            text.resize(wcsnlen(text.c_str(), text.size()));
+            return text;
+        }
+
+        std::wstring_view FindVariable(std::vector<wchar_t> const& block, std::wstring_view name) noexcept
+        {
+            for (wchar_t const* entry = block.data(); *entry != L'\0'; entry += wcslen(entry) + 1)
+            {
+                std::wstring_view const line{ entry };
+                if (line.size() > name.size() && line[name.size()] == L'='
+                    && CompareStringOrdinal(line.data(), static_cast<int>(name.size()), name.data(), static_cast<int>(name.size()), TRUE) == CSTR_EQUAL)
+                {
+                    return line.substr(name.size() + 1);
+                }
+            }
+            return {};
+        }
+
+        // First token of a command line (quotes stripped); the rest goes to `arguments`.
+        std::wstring_view SplitProgram(std::wstring_view commandLine, std::wstring_view& arguments) noexcept
+        {
+            size_t const start = commandLine.find_first_not_of(L" \t");
+            if (start == std::wstring_view::npos)
+            {
+                arguments = {};
+                return {};
+            }
+            commandLine.remove_prefix(start);
+
+            std::wstring_view program;
+            if (commandLine.front() == L'"')
+            {
+                size_t const close = commandLine.find(L'"', 1);
+                program = commandLine.substr(1, close == std::wstring_view::npos ? std::wstring_view::npos : close - 1);
+                commandLine.remove_prefix(close == std::wstring_view::npos ? commandLine.size() : close + 1);
+            }
+            else
+            {
+                size_t const end = commandLine.find_first_of(L" \t");
+                program = commandLine.substr(0, end);
+                commandLine.remove_prefix(end == std::wstring_view::npos ? commandLine.size() : end);
+            }
+
+            size_t const rest = commandLine.find_first_not_of(L" \t");
+            arguments = rest == std::wstring_view::npos ? std::wstring_view{} : commandLine.substr(rest);
+            return program;
+        }
+
+        // Copy of `block` with `prefix` put in front of PATH.
+        std::vector<wchar_t> PrependPath(std::vector<wchar_t> const& block, std::wstring_view prefix)
+        {
+            std::vector<wchar_t> result;
+            result.reserve(block.size() + prefix.size() + 8);
+            bool replaced = false;
+            for (wchar_t const* entry = block.data(); *entry != L'\0'; entry += wcslen(entry) + 1)
+            {
+                std::wstring_view line{ entry };
+                if (!replaced && line.size() > 4 && line[4] == L'=' && CompareStringOrdinal(line.data(), 4, L"Path", 4, TRUE) == CSTR_EQUAL)
+                {
+                    result.insert(result.end(), line.begin(), line.begin() + 5);
+                    result.insert(result.end(), prefix.begin(), prefix.end());
+                    result.push_back(L';');
+                    line.remove_prefix(5);
+                    replaced = true;
+                }
+                result.insert(result.end(), line.begin(), line.end());
+                result.push_back(L'\0');
+            }
+            if (!replaced)
+            {
+                constexpr std::wstring_view Name = L"Path=";
+                result.insert(result.end(), Name.begin(), Name.end());
+                result.insert(result.end(), prefix.begin(), prefix.end());
+                result.push_back(L'\0');
+            }
+            result.push_back(L'\0');
+            return result;
+        }
+    }
+
+    ActionCache::~ActionCache()
+    {
+        Stop();
+    }
+
+    void ActionCache::Start()
+    {
+        if (m_thread.joinable())
+        {
+            return;
+        }
+        m_stop = winrt::handle(winrt::check_pointer(CreateEventW(nullptr, TRUE, FALSE, nullptr)));
+        {
+            std::scoped_lock lock(m_requestLock);
+            m_wake = winrt::handle(winrt::check_pointer(CreateEventW(nullptr, FALSE, FALSE, nullptr)));
+            if (m_requested)
+            {
+                // Queued while stopped.
+                SetEvent(m_wake.get());
+            }
+        }
+        m_thread = std::thread([this] { Run(); });
+    }
+
+    void ActionCache::Stop() noexcept
+    {
+        if (m_thread.joinable())
+        {
+            SetEvent(m_stop.get());
+            m_thread.join();
+        }
+    }
+
+    void ActionCache::Prepare(ActionTable const& actions, uint64_t generation)
+    {
+        // Parsing is all this thread does; nothing here waits on the system.
+        Prepared prepared(actions.Size());
+        for (uint32_t i = 0; i < actions.Size(); ++i)
+        {
+            ActionRecord const& record = actions[i];
+            if (!IsTombstone(record))
+            {
+                prepared[i] = std::make_shared<PreparedAction>(PrepareAction(actions, record));
+            }
+        }
+
+        std::scoped_lock lock(m_requestLock);
+        m_request = std::move(prepared);
+        m_requestGeneration = generation;
+        m_requested = true;
+        if (m_wake)
+        {
+            SetEvent(m_wake.get());
+        }
+    }
+
+    void ActionCache::Run() noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), L"khm.action-cache");
+        ThreadQos::SetBackground(true);
+
+        HANDLE const events[] = { m_stop.get(), m_wake.get() };
+        while (WaitForMultipleObjects(ARRAYSIZE(events), events, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
+        {
+            Prepared prepared;
+            uint64_t generation = 0;
+            {
+                std::scoped_lock lock(m_requestLock);
+                if (!m_requested)
+                {
+                    continue;
+                }
+                prepared = std::move(m_request);
+                generation = m_requestGeneration;
+                m_request.clear();
+                m_requested = false;
+            }
+
+            try
+            {
+                Resolve(prepared, generation);
+            }
+            catch (std::exception const& e)
+            {
+                // Workers prepare what they run, without resolved launch targets.
+                Clear();
+                OutputDebugStringA("KeyboardHookManager: action preparation failed: ");
+                OutputDebugStringA(e.what());
+                OutputDebugStringA("\n");
+            }
+        }
+    }
+
+    void ActionCache::Resolve(Prepared& prepared, uint64_t generation)
+    {
+        // Built without either lock: registry and file system lookups.
+        RefreshEnvironment();
+        for (std::shared_ptr<PreparedAction> const& action : prepared)
+        {
+            if (auto* launch = action ? std::get_if<LaunchAppAction>(action.get()) : nullptr)
+            {
+                launch->target = Resolve(launch->target.commandLine);
+            }
+        }
+
+        {
+            // A newer snapshot is queued; this one would only be replaced.
+            std::scoped_lock lock(m_requestLock);
+            if (m_requested)
+            {
+                return;
+            }
+        }
+
+        std::scoped_lock lock(m_lock);
+        for (uint32_t i = 0; i < prepared.size() && i < m_actions.size(); ++i)
+        {
+            auto* next = prepared[i] ? std::get_if<LaunchAppAction>(prepared[i].get()) : nullptr;
+            auto const* previous = m_actions[i] ? std::get_if<LaunchAppAction>(m_actions[i].get()) : nullptr;
+            if (next && previous && !previous->target.appIdKey.empty() && previous->target.commandLine == next->target.commandLine)
+            {
+                next->target.appIdKey = previous->target.appIdKey;
+            }
+        }
+        m_actions.assign(prepared.begin(), prepared.end());
+        m_generation = generation;
+    }
+
+    std::shared_ptr<PreparedAction const> ActionCache::Find(uint32_t actionIndex, uint64_t generation) const noexcept
+    {
+        std::scoped_lock lock(m_lock);
+        return generation == m_generation && actionIndex < m_actions.size() ? m_actions[actionIndex] : nullptr;
+    }
+
+    void ActionCache::LearnAppId(uint32_t actionIndex, uint64_t generation, std::wstring appIdKey)
+    {
+        std::scoped_lock lock(m_lock);
+        auto const* const launch = generation == m_generation && actionIndex < m_actions.size() && m_actions[actionIndex]
+            ? std::get_if<LaunchAppAction>(m_actions[actionIndex].get()) : nullptr;
+        if (launch && launch->target.appIdKey.empty())
+        {
+            LaunchAppAction learned = *launch;
+            learned.target.appIdKey = std::move(appIdKey);
+            m_actions[actionIndex] = std::make_shared<PreparedAction const>(std::move(learned));
+        }
+    }
+
+    void ActionCache::Clear() noexcept
+    {
+        std::scoped_lock lock(m_lock);
+        m_actions.clear();
+        m_generation = 0;
+    }
+
+    void ActionCache::RefreshEnvironment()
+    {
+        m_environment.reset();
+        m_path.clear();
+
+        // Built from the registry rather than inherited, so variables changed
+        // since logon reach launched programs.
+        winrt::handle token;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY | TOKEN_DUPLICATE, token.put()))
+        {
+            return;
+        }
+        void* block = nullptr;
+        if (!CreateEnvironmentBlock(&block, token.get(), FALSE))
+        {
+            return;
+        }
+
+        wchar_t const* const begin = static_cast<wchar_t const*>(block);
+        wchar_t const* end = begin;
+        while (*end != L'\0')
+        {
+            end += wcslen(end) + 1;
+        }
+        auto environment = std::make_shared<std::vector<wchar_t>>(begin, end + 1);
+        DestroyEnvironmentBlock(block);
+
+        m_path = FindVariable(*environment, L"Path");
+        m_environment = std::move(environment);
+    }
+
+    LaunchTarget ActionCache::Resolve(std::wstring_view commandLine) const
+    {
+        LaunchTarget target;
+        target.commandLine = commandLine;
+        target.environment = m_environment;
+
+        std::wstring_view arguments;
+        std::wstring const program{ SplitProgram(commandLine, arguments) };
+        if (program.empty())
+        {
+            return target;
+        }
+
+        std::wstring image;
+        if (program.find_first_of(L"\\/") != std::wstring::npos)
+        {
+            wchar_t full[MAX_PATH];
+            DWORD const length = GetFullPathNameW(program.c_str(), ARRAYSIZE(full), full, nullptr);
+            if (length != 0 && length < ARRAYSIZE(full))
+            {
+                image = full;
+            }
+        }
+        else
+        {
+            // ShellExecute semantics: App Paths win over PATH.
+            std::wstring key = AppPathsKey + program;
+            if (program.find(L'.') == std::wstring::npos)
+            {
+                key += L".exe";
+            }
+            for (HKEY const root : { HKEY_CURRENT_USER, HKEY_LOCAL_MACHINE })
+            {
+                image = Unquote(ReadString(root, key, nullptr));
+                if (!image.empty())
+                {
+                    std::wstring const extraPath = ReadString(root, key, L"Path");
+                    if (!extraPath.empty() && m_environment)
+                    {
+                        target.environment = std::make_shared<std::vector<wchar_t> const>(PrependPath(*m_environment, extraPath));
+                    }
+                    break;
+                }
+            }
+            if (image.empty())
+            {
+                image = FindOnPath(program);
+            }
+        }
+
+        if (image.empty() || !FileExists(image))
+        {
+            target.environment = m_environment;
+            return target;
+        }
+
+        target.application = image;
+        target.imageKey = WindowIndex::Key(image);
+        target.commandLine = L"\"" + image + L"\"";
+        if (!arguments.empty())
+        {
+            target.commandLine += L' ';
+            target.commandLine += arguments;
+        }
+        return target;
+    }
+
+    std::wstring ActionCache::FindOnPath(std::wstring const& program) const
+    {
+        wchar_t found[MAX_PATH];
+        DWORD const length = SearchPathW(m_path.empty() ? nullptr : m_path.c_str(), program.c_str(), L".exe", ARRAYSIZE(found), found, nullptr);
+        return length != 0 && length < ARRAYSIZE(found) ? std::wstring{ found } : std::wstring{};
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Actions/PreparedAction.h"
+#include "Configuration/ActionTable.h"
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace khm
+{
+    // The prepared form of every action in one snapshot, built by
+    // PrepareAction() off the hotkey path. LaunchApp targets are then
+    // resolved through App Paths and SearchPath against a fresh user
+    // environment block, so a launch is a single CreateProcessW and picks up
+    // environment edits without restarting the process. That registry and
+    // file system work runs on the cache's own thread, and the result is
+    // swapped in whole, so neither the executor's dispatch thread nor the
+    // snapshot it reads waits on it. Lookups come from any pool worker.
+    // Published actions are immutable; LearnAppId() replaces its slot.
+    class ActionCache
+    {
+    public:
+        ActionCache() = default;
+        ~ActionCache();
+
+        ActionCache(ActionCache const&) = delete;
+        ActionCache& operator=(ActionCache const&) = delete;
+
+        void Start();
+        void Stop() noexcept;
+
+        // Parses every action of the snapshot whose actionsGeneration is
+        // `generation` on the calling thread, disabled ones too so that
+        // enabling one keeps the cache, and queues them for the cache's
+        // thread, which rebuilds the environment block and resolves the
+        // launch targets. A newer call supersedes one still queued.
+        // AppUserModelIDs learned for an unchanged command line are kept.
+        // Throws std::bad_alloc.
+        void Prepare(ActionTable const& actions, uint64_t generation);
+
+        // Null when the cache holds another generation, which includes one
+        // still being resolved, or the slot was not prepared; the caller then
+        // prepares the action itself.
+        std::shared_ptr<PreparedAction const> Find(uint32_t actionIndex, uint64_t generation) const noexcept;
+
+        // Ignored once the cache has moved on from `generation`.
+        void LearnAppId(uint32_t actionIndex, uint64_t generation, std::wstring appIdKey);
+
+        // Every action is prepared on demand until the next Prepare().
+        void Clear() noexcept;
+
+    private:
+        using Prepared = std::vector<std::shared_ptr<PreparedAction>>; // null for a tombstone
+
+        void Run() noexcept;
+        void Resolve(Prepared& prepared, uint64_t generation);
+        void RefreshEnvironment();
+        LaunchTarget Resolve(std::wstring_view commandLine) const;
+        std::wstring FindOnPath(std::wstring const& program) const;
+
+        std::thread m_thread;
+        winrt::handle m_stop;
+        winrt::handle m_wake; // auto-reset, set by Prepare()
+
+        std::mutex m_requestLock;
+        Prepared m_request;                 // guarded by m_requestLock
+        uint64_t m_requestGeneration = 0;   // guarded by m_requestLock
+        bool m_requested = false;           // guarded by m_requestLock
+
+        // Cache thread only.
+        std::shared_ptr<std::vector<wchar_t> const> m_environment;
+        std::wstring m_path;
+
+        mutable std::mutex m_lock;
+        std::vector<std::shared_ptr<PreparedAction const>> m_actions; // guarded by m_lock
+        uint64_t m_generation = 0;                                    // of m_actions, guarded by m_lock
+    };
+}
@@ -0,0 +1,337 @@
+#include "pch.h"
+#include "Actions/ActionExecutor.h"
+
+#include "Actions/ActionRunner.h"
+#include "Utils/Hash.h"
+#include "Utils/Instrumentation.h"
+#include "Utils/Logger.h"
+#include "Utils/ThreadQos.h"
+#include "Utils/WorkingSet.h"
+
+namespace khm
+{
+    namespace
+    {
+        constexpr LogFormat ActionFailed{ LogLevel::Warning, "action {} failed (error {})" };
+        constexpr LogFormat ActionSkipped{ LogLevel::Debug, "action {} skipped: {} runs in flight" };
+    }
+
+    ActionExecutor::ActionExecutor(HookEventRing& ring, DispatchSnapshotPointer& snapshots, WindowIndex& windows) :
+        m_ring(ring),
+        m_observed(std::make_unique<ObservedRing>(ring)),
+        m_external(std::make_unique<ExternalRing>()),
+        m_snapshots(snapshots.RegisterReader()),
+        m_windows(windows),
+        m_pool(WorkStealingPool::DefaultWorkerCount())
+    {
+        m_workers.reserve(m_pool.WorkerCount());
+        for (uint32_t i = 0; i < m_pool.WorkerCount(); ++i)
+        {
+            m_workers.push_back(WorkerState{ &snapshots.RegisterReader(), MacroPlayer{} });
+        }
+    }
+
+    ActionExecutor::~ActionExecutor()
+    {
+        Stop();
+    }
+
+    void ActionExecutor::Start()
+    {
+        if (!m_thread.joinable())
+        {
+            m_actions.Start();
+            m_pool.Start([this](uint32_t worker, HookEvent const& event) { Execute(worker, event); });
+            m_thread = std::jthread([this](std::stop_token stop) { Run(stop); });
+        }
+    }
+
+    void ActionExecutor::Stop() noexcept
+    {
+        if (m_thread.joinable())
+        {
+            m_thread.request_stop();
+            m_ring.Wake();
+            m_thread.join();
+            m_pool.Stop();
+            m_actions.Stop();
+            m_slots.clear();
+            m_completed.clear();
+            m_running = 0;
+        }
+    }
+
+    // From the executor waking up to an action reaching its worker; stays
+    // locked in memory while the process is trimmed (see WorkingSet).
+#pragma code_seg(push, ".text$khm_hot")
+
+    void ActionExecutor::Run(std::stop_token stop) noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), L"khm.executor");
+        ThreadQos::DisableThrottling();
+        WorkingSet::PinnedStack const stack;
+
+        HookEvent event;
+        for (;;)
+        {
+            uint32_t const ticket = m_ring.WaitTicket();
+            if (stop.stop_requested())
+            {
+                break;
+            }
+            PrepareActions();
+            DrainCompletions();
+            // Key presses first; the external queue fills the gaps.
+            while (m_ring.TryPop(event) || m_observed->TryPop(event) || m_external->TryPop(event))
+            {
+                Dispatch(event);
+            }
+            m_ring.Wait(ticket);
+        }
+    }
+
+    bool ActionExecutor::Trigger(uint32_t actionIndex) noexcept
+    {
+        if (!m_external->TryPush(HookEvent{ actionIndex, 0, 0, 0, Instrumentation::Now() }))
+        {
+            return false;
+        }
+        m_ring.Wake();
+        return true;
+    }
+
+    void ActionExecutor::ObservedRing::OnHotkey(uint32_t actionIndex, KBDLLHOOKSTRUCT const& event, uint8_t modifiers, int64_t timestamp) noexcept
+    {
+        if (!TryEnqueue(HookEvent{ actionIndex, modifiers, static_cast<uint8_t>(event.vkCode), 0, timestamp }))
+        {
+            return;
+        }
+        m_wake.Wake();
+        if (Instrumentation::Enabled())
+        {
+            Instrumentation::Record(LatencyStage::Handoff, Instrumentation::Now() - timestamp);
+        }
+    }
+
+    namespace
+    {
+        uint64_t IdHash(ActionTable const& actions, ActionRecord const& record) noexcept
+        {
+            return Fnv1a64(std::as_bytes(std::span(actions.String(record.id))));
+        }
+    }
+
+    void ActionExecutor::Dispatch(HookEvent const& event) noexcept
+    {
+        uint32_t maxInFlight = 1;
+        bool coalesce = true;
+        uint64_t id = 0;
+        {
+            // Slots are stable across reloads, so the index the hook resolved
+            // against an older snapshot still names the same action here.
+            RcuReadGuard<DispatchSnapshot> const snapshot(m_snapshots);
+            ActionTable const& actions = snapshot->configuration.actions;
+            if (event.actionIndex >= actions.Size() || IsTombstone(actions[event.actionIndex]))
+            {
+                m_failed.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            maxInFlight = actions[event.actionIndex].maxInFlight;
+            coalesce = actions[event.actionIndex].coalesce;
+            if (coalesce)
+            {
+                id = IdHash(actions, actions[event.actionIndex]);
+            }
+        }
+
+        try
+        {
+            if (event.actionIndex >= m_slots.size())
+            {
+                m_slots.resize(event.actionIndex + 1);
+            }
+            SlotState& slot = m_slots[event.actionIndex];
+            if (slot.inFlight >= maxInFlight)
+            {
+                // Holding a hotkey down auto-repeats; at most one more run
+                // is remembered, and it uses the latest press.
+                if (!coalesce || slot.pending)
+                {
+                    m_skipped.fetch_add(1, std::memory_order_relaxed);
+                    Log(ActionSkipped, event.actionIndex, slot.inFlight);
+                }
+                if (coalesce)
+                {
+                    slot.pending = true;
+                    slot.pendingEvent = event;
+                    slot.pendingId = id;
+                }
+                return;
+            }
+            {
+                // Room for every run's completion, so a worker reporting one
+                // never allocates and the slot is always released.
+                std::scoped_lock lock(m_completedLock);
+                m_completed.reserve(m_running + 1);
+                m_completedScratch.reserve(m_running + 1);
+            }
+            ++slot.inFlight;
+            ++m_running;
+            try
+            {
+                m_pool.Submit(event);
+            }
+            catch (...)
+            {
+                --slot.inFlight;
+                --m_running;
+                throw;
+            }
+        }
+        catch (...)
+        {
+            m_failed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void ActionExecutor::DrainCompletions() noexcept
+    {
+        {
+            std::scoped_lock lock(m_completedLock);
+            m_completedScratch.swap(m_completed);
+        }
+        // By index: a pending run dispatched from here may grow the scratch.
+        for (size_t i = 0; i < m_completedScratch.size(); ++i)
+        {
+            SlotState& slot = m_slots[m_completedScratch[i]];
+            --slot.inFlight;
+            --m_running;
+            if (slot.pending)
+            {
+                slot.pending = false;
+                DispatchPending(slot);
+            }
+        }
+        m_completedScratch.clear();
+    }
+
+#pragma code_seg(pop)
+
+    void ActionExecutor::DispatchPending(SlotState const& slot) noexcept
+    {
+        {
+            // A run can stay pending across several reloads, long enough for
+            // its slot to be tombstoned and then given to another action.
+            RcuReadGuard<DispatchSnapshot> const snapshot(m_snapshots);
+            ActionTable const& actions = snapshot->configuration.actions;
+            uint32_t const index = slot.pendingEvent.actionIndex;
+            if (index >= actions.Size() || IdHash(actions, actions[index]) != slot.pendingId)
+            {
+                m_skipped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        Dispatch(slot.pendingEvent);
+    }
+
+    void ActionExecutor::PrepareActions() noexcept
+    {
+        RcuReadGuard<DispatchSnapshot> const snapshot(m_snapshots);
+        bool const stale = m_preparedStale.exchange(false, std::memory_order_acq_rel);
+        if (!stale && snapshot->actionsGeneration == m_preparedGeneration)
+        {
+            return;
+        }
+
+        try
+        {
+            m_actions.Prepare(snapshot->configuration.actions, snapshot->actionsGeneration);
+            m_preparedGeneration = snapshot->actionsGeneration;
+        }
+        catch (std::exception const& e)
+        {
+            // Workers prepare what they run, without resolved launch targets.
+            m_actions.Clear();
+            OutputDebugStringA("KeyboardHookManager: action preparation failed: ");
+            OutputDebugStringA(e.what());
+            OutputDebugStringA("\n");
+        }
+    }
+
+    void ActionExecutor::Execute(uint32_t worker, HookEvent const& event) noexcept
+    {
+        WorkerState& state = m_workers[worker];
+        bool ok = false;
+
+        // Copied out of the snapshot, so the run does not hold a reader slot:
+        // Publish() waits out every reader, and CreateProcess, activating a
+        // window or playing a macro may take a while.
+        std::shared_ptr<PreparedAction const> prepared;
+        QosTier tier = QosTier::Normal;
+        uint64_t generation = 0;
+        bool found = false;
+        {
+            RcuReadGuard<DispatchSnapshot> const snapshot(*state.snapshots);
+            ActionTable const& actions = snapshot->configuration.actions;
+            if (event.actionIndex < actions.Size() && !IsTombstone(actions[event.actionIndex]))
+            {
+                found = true;
+                generation = snapshot->actionsGeneration;
+                // Unprepared until the dispatch thread catches up with a
+                // reload; such an action runs with its command line unresolved.
+                prepared = m_actions.Find(event.actionIndex, generation);
+                if (prepared == nullptr)
+                {
+                    try
+                    {
+                        prepared = std::make_shared<PreparedAction const>(PrepareAction(actions, actions[event.actionIndex]));
+                    }
+                    catch (...)
+                    {
+                        prepared = nullptr;
+                    }
+                }
+                tier = snapshot->configuration.settings.QosOf(prepared ? TypeOf(*prepared) : ActionType::Count);
+            }
+        }
+
+        if (found)
+        {
+            bool const instrumented = Instrumentation::Enabled();
+            int64_t const started = instrumented ? Instrumentation::Now() : 0;
+            if (instrumented)
+            {
+                Instrumentation::Record(LatencyStage::ActionStart, started - event.timestamp);
+            }
+
+            if (!state.tierSet || tier != state.tier)
+            {
+                ThreadQos::SetBackground(tier == QosTier::Background);
+                state.tier = tier;
+                state.tierSet = true;
+            }
+
+            ActionContext context{ m_actions, m_windows, state.macros, event.actionIndex, generation };
+            // Cleared first: not every failure passes through a Win32
+            // call, and a stale error from an earlier run would be logged.
+            SetLastError(ERROR_SUCCESS);
+            ok = prepared != nullptr && ActionRunner::Run(*prepared, context);
+            if (!ok)
+            {
+                Log(ActionFailed, event.actionIndex, prepared == nullptr ? ERROR_OUTOFMEMORY : GetLastError());
+            }
+
+            if (instrumented)
+            {
+                Instrumentation::Record(LatencyStage::ActionRun, Instrumentation::Now() - started);
+            }
+        }
+        (ok ? m_executed : m_failed).fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::scoped_lock lock(m_completedLock);
+            m_completed.push_back(event.actionIndex); // reserved by Dispatch()
+        }
+        m_ring.Wake();
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Actions/ActionCache.h"
+#include "Actions/MacroPlayer.h"
+#include "Actions/WindowIndex.h"
+#include "Actions/WorkStealingPool.h"
+#include "Core/DispatchSnapshot.h"
+#include "Core/HookEvent.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace khm
+{
+    // Drains the hook's event ring on its own dispatch thread and runs the
+    // actions on a small worker pool, so a slow CreateProcess never stalls
+    // keyboard input and a slow action never holds up the next hotkey.
+    // Each action's maxInFlight/coalesce limits are applied on dispatch; a
+    // worker switches to the QoS tier settings.actionQos gives the action's
+    // type before running it.
+    class ActionExecutor
+    {
+    public:
+        ActionExecutor(HookEventRing& ring, DispatchSnapshotPointer& snapshots, WindowIndex& windows);
+        ~ActionExecutor();
+
+        ActionExecutor(ActionExecutor const&) = delete;
+        ActionExecutor& operator=(ActionExecutor const&) = delete;
+
+        void Start();
+        void Stop() noexcept;
+
+        // Re-prepares the actions, LaunchApp targets and the environment
+        // block included, in the background; actions run in the meantime are
+        // prepared on demand. Any thread; called after a reload and when the
+        // user environment changes.
+        void RefreshActionCache() noexcept
+        {
+            m_preparedStale.store(true, std::memory_order_release);
+            m_ring.Wake();
+        }
+
+        // Queues an action from outside the hook, e.g. the control pipe,
+        // with the same limits as a key press. One producer thread; false
+        // when the queue is full.
+        bool Trigger(uint32_t actionIndex) noexcept;
+
+        // Handler for the Raw Input processor, the second key source; the
+        // hook's ring has room for one producer only.
+        IHotkeyHandler& ObservedKeys() noexcept { return *m_observed; }
+
+        uint64_t Executed() const noexcept { return m_executed.load(std::memory_order_relaxed); }
+        uint64_t Failed() const noexcept { return m_failed.load(std::memory_order_relaxed); }
+
+        // Presses dropped or folded into a pending run by an action's limits.
+        uint64_t Skipped() const noexcept { return m_skipped.load(std::memory_order_relaxed); }
+
+        // Events lost to a full hook ring, observed-key ring or external queue.
+        uint64_t Dropped() const noexcept { return m_ring.Dropped() + m_observed->Dropped() + m_external->Dropped(); }
+
+    private:
+        using ExternalRing = SpscRing<HookEvent, HookEventRingCapacity>;
+
+        // Pushes wake the dispatch thread, which only waits on the hook's ring.
+        class ObservedRing final : public IHotkeyHandler, public ExternalRing
+        {
+        public:
+            explicit ObservedRing(HookEventRing& wake) noexcept : m_wake(wake) {}
+
+            void OnHotkey(uint32_t actionIndex, KBDLLHOOKSTRUCT const& event, uint8_t modifiers, int64_t timestamp) noexcept override;
+
+        private:
+            HookEventRing& m_wake;
+        };
+
+        // Dispatch thread only, indexed by action slot.
+        struct SlotState
+        {
+            uint32_t inFlight = 0;
+            bool pending = false;
+            HookEvent pendingEvent{};
+            uint64_t pendingId = 0; // Fnv1a64 of the action id pendingEvent was meant for
+        };
+
+        struct WorkerState
+        {
+            DispatchSnapshotPointer::Reader* snapshots;
+            MacroPlayer macros;
+            QosTier tier = QosTier::Normal; // of the worker thread, once tierSet
+            bool tierSet = false;
+        };
+
+        void Run(std::stop_token stop) noexcept;
+        void Dispatch(HookEvent const& event) noexcept;
+        void DrainCompletions() noexcept;
+        void DispatchPending(SlotState const& slot) noexcept;
+        void Execute(uint32_t worker, HookEvent const& event) noexcept;
+        void PrepareActions() noexcept;
+
+        HookEventRing& m_ring;
+        std::unique_ptr<ObservedRing> m_observed;
+        std::unique_ptr<ExternalRing> m_external; // inline storage, too large for the stack
+        DispatchSnapshotPointer::Reader& m_snapshots;
+        WindowIndex& m_windows;
+        ActionCache m_actions;
+        uint64_t m_preparedGeneration = 0; // actionsGeneration, dispatch thread only
+        std::atomic<bool> m_preparedStale{ true };
+        std::atomic<uint64_t> m_executed{ 0 };
+        std::atomic<uint64_t> m_failed{ 0 };
+        std::atomic<uint64_t> m_skipped{ 0 };
+
+        WorkStealingPool m_pool;
+        std::vector<WorkerState> m_workers;
+        std::vector<SlotState> m_slots;
+
+        std::mutex m_completedLock;
+        std::vector<uint32_t> m_completed; // action slots whose run finished, guarded by m_completedLock
+        std::vector<uint32_t> m_completedScratch;
+        size_t m_running = 0; // runs submitted and not yet drained, dispatch thread only
+
+        std::jthread m_thread;
+    };
+}
@@ -0,0 +1,111 @@
+#include "pch.h"
+#include "Actions/ActionRunner.h"
+
+#include <appmodel.h>
+
+namespace khm
+{
+    namespace
+    {
+        // Shell_TrayWnd WM_COMMAND ids used by Explorer itself.
+        constexpr WPARAM TrayMinimizeAll = 419;
+        constexpr WPARAM TrayUndoMinimizeAll = 416;
+
+        bool SendTrayCommand(WPARAM command) noexcept
+        {
+            HWND const tray = FindWindowW(L"Shell_TrayWnd", nullptr);
+            if (tray == nullptr)
+            {
+                return false;
+            }
+            return PostMessageW(tray, WM_COMMAND, command, 0) != FALSE;
+        }
+    }
+
+    bool ActionRunner::Run(PreparedAction const& action, ActionContext& context) noexcept
+    {
+        return std::visit([&context](auto const& prepared) noexcept { return Run(prepared, context); }, action);
+    }
+
+    bool ActionRunner::Run(InvalidAction const&, ActionContext&) noexcept
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
+    bool ActionRunner::Run(LaunchAppAction const& action, ActionContext& context) noexcept
+    {
+        if (action.activateIfRunning && context.windows.Activate(action.target.appIdKey, action.target.imageKey))
+        {
+            return true;
+        }
+        return Launch(action.target, context, action.activateIfRunning);
+    }
+
+    bool ActionRunner::Run(WindowsCommandAction const& action, ActionContext&) noexcept
+    {
+        switch (action.command)
+        {
+        case WindowsCommand::MinimizeAll:
+            return SendTrayCommand(TrayMinimizeAll);
+        case WindowsCommand::RestoreAll:
+            return SendTrayCommand(TrayUndoMinimizeAll);
+        case WindowsCommand::LockWorkstation:
+            return LockWorkStation() != FALSE;
+        }
+        return false;
+    }
+
+    bool ActionRunner::Run(TypeTextAction const& action, ActionContext& context) noexcept
+    {
+        return context.macros.Play(action.inputs);
+    }
+
+    bool ActionRunner::Run(SendKeysAction const& action, ActionContext& context) noexcept
+    {
+        return context.macros.Play(action.inputs);
+    }
+
+    bool ActionRunner::Launch(LaunchTarget const& target, ActionContext& context, bool learnAppId) noexcept
+    {
+        STARTUPINFOW startup{ sizeof(startup) };
+        PROCESS_INFORMATION process{};
+        try
+        {
+            // Targets are shared between workers; CreateProcessW only writes
+            // into the command line, never into the environment block.
+            std::wstring commandLine = target.commandLine;
+            void* const environment = target.environment ? const_cast<wchar_t*>(target.environment->data()) : nullptr;
+            if (!CreateProcessW(target.application.empty() ? nullptr : target.application.c_str(), commandLine.data(),
+                    nullptr, nullptr, FALSE, CREATE_UNICODE_ENVIRONMENT, environment, nullptr, &startup, &process))
+            {
+                return false;
+            }
+        }
+        catch (...)
+        {
+            return false;
+        }
+
+        // Execution aliases (wt.exe, ...) start a differently named image
+        // inside the package; its AppUserModelID is what the windows carry.
+        if (learnAppId && target.appIdKey.empty())
+        {
+            wchar_t appId[APPLICATION_USER_MODEL_ID_MAX_LENGTH];
+            UINT32 length = ARRAYSIZE(appId);
+            if (GetApplicationUserModelId(process.hProcess, &length, appId) == ERROR_SUCCESS)
+            {
+                try
+                {
+                    context.actions.LearnAppId(context.actionIndex, context.generation, WindowIndex::Key(appId));
+                }
+                catch (...)
+                {
+                }
+            }
+        }
+        CloseHandle(process.hThread);
+        CloseHandle(process.hProcess);
+        return true;
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Actions/ActionCache.h"
+#include "Actions/MacroPlayer.h"
+#include "Actions/PreparedAction.h"
+#include "Actions/WindowIndex.h"
+
+#include <cstdint>
+
+namespace khm
+{
+    // State the actions draw on; the macro player belongs to the worker.
+    struct ActionContext
+    {
+        ActionCache& actions;
+        WindowIndex& windows;
+        MacroPlayer& macros;
+        uint32_t actionIndex; // slot of the action being run
+        uint64_t generation;  // actionsGeneration of the snapshot it was found in
+    };
+
+    // Performs a single prepared action. Runs on an executor pool worker,
+    // never on the hook thread.
+    class ActionRunner
+    {
+    public:
+        // Returns false for an InvalidAction (unknown type or unusable
+        // parameter, with ERROR_INVALID_PARAMETER as the last error) or when
+        // the underlying Win32 call failed.
+        static bool Run(PreparedAction const& action, ActionContext& context) noexcept;
+
+    private:
+        static bool Run(InvalidAction const& action, ActionContext& context) noexcept;
+        static bool Run(LaunchAppAction const& action, ActionContext& context) noexcept;
+        static bool Run(WindowsCommandAction const& action, ActionContext& context) noexcept;
+        static bool Run(TypeTextAction const& action, ActionContext& context) noexcept;
+        static bool Run(SendKeysAction const& action, ActionContext& context) noexcept;
+
+        static bool Launch(LaunchTarget const& target, ActionContext& context, bool learnAppId) noexcept;
+    };
+}
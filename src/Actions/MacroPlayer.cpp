@@ -0,0 +1,301 @@
+#include "pch.h"
+#include "Actions/MacroPlayer.h"
+
+#include "Core/HookProcessor.h"
+
+namespace khm
+{
+    namespace
+    {
+        struct KeyName
+        {
+            std::string_view name;
+            WORD vk;
+        };
+
+        constexpr KeyName KeyNames[] = {
+            { "Enter", VK_RETURN }, { "Return", VK_RETURN }, { "Tab", VK_TAB }, { "Esc", VK_ESCAPE },
+            { "Escape", VK_ESCAPE }, { "Space", VK_SPACE }, { "Backspace", VK_BACK }, { "Delete", VK_DELETE },
+            { "Del", VK_DELETE }, { "Insert", VK_INSERT }, { "Ins", VK_INSERT }, { "Home", VK_HOME },
+            { "End", VK_END }, { "PageUp", VK_PRIOR }, { "PageDown", VK_NEXT }, { "Left", VK_LEFT },
+            { "Right", VK_RIGHT }, { "Up", VK_UP }, { "Down", VK_DOWN }, { "Apps", VK_APPS },
+        };
+
+        constexpr WORD HeldModifiers[] = { VK_LCONTROL, VK_RCONTROL, VK_LSHIFT, VK_RSHIFT, VK_LMENU, VK_RMENU, VK_LWIN, VK_RWIN };
+
+        bool EqualsIgnoreCase(std::string_view a, std::string_view b) noexcept
+        {
+            if (a.size() != b.size())
+            {
+                return false;
+            }
+            for (size_t i = 0; i < a.size(); ++i)
+            {
+                auto lower = [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; };
+                if (lower(a[i]) != lower(b[i]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // 0 when `name` is not a key we know.
+        WORD VirtualKeyFromName(std::string_view name) noexcept
+        {
+            if (name.size() == 1)
+            {
+                char const c = name[0];
+                if (c >= 'a' && c <= 'z') return static_cast<WORD>(c - 'a' + 'A');
+                if ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) return static_cast<WORD>(c);
+                return 0;
+            }
+            if ((name[0] == 'F' || name[0] == 'f') && name.size() <= 3)
+            {
+                unsigned number = 0;
+                for (char c : name.substr(1))
+                {
+                    if (c < '0' || c > '9') return 0;
+                    number = number * 10 + (c - '0');
+                }
+                return number >= 1 && number <= 24 ? static_cast<WORD>(VK_F1 + number - 1) : 0;
+            }
+            if (name.size() == 4 && name[0] == '0' && (name[1] == 'x' || name[1] == 'X'))
+            {
+                WORD vk = 0;
+                for (char c : name.substr(2))
+                {
+                    vk <<= 4;
+                    if (c >= '0' && c <= '9') vk |= c - '0';
+                    else if (c >= 'a' && c <= 'f') vk |= c - 'a' + 10;
+                    else if (c >= 'A' && c <= 'F') vk |= c - 'A' + 10;
+                    else return 0;
+                }
+                return vk >= 1 && vk <= 254 ? vk : 0;
+            }
+            for (KeyName const& key : KeyNames)
+            {
+                if (EqualsIgnoreCase(name, key.name))
+                {
+                    return key.vk;
+                }
+            }
+            return 0;
+        }
+
+        WORD ModifierFromName(std::string_view name) noexcept
+        {
+            if (EqualsIgnoreCase(name, "Ctrl") || EqualsIgnoreCase(name, "Control")) return VK_LCONTROL;
+            if (EqualsIgnoreCase(name, "Shift")) return VK_LSHIFT;
+            if (EqualsIgnoreCase(name, "Alt")) return VK_LMENU;
+            if (EqualsIgnoreCase(name, "Win")) return VK_LWIN;
+            return 0;
+        }
+
+        // Keys whose scan code needs the E0 prefix; without it they arrive
+        // as their numeric keypad twins.
+        bool IsExtendedKey(WORD vk) noexcept
+        {
+            switch (vk)
+            {
+            case VK_INSERT: case VK_DELETE: case VK_HOME: case VK_END: case VK_PRIOR: case VK_NEXT:
+            case VK_LEFT: case VK_RIGHT: case VK_UP: case VK_DOWN:
+            case VK_RCONTROL: case VK_RMENU: case VK_LWIN: case VK_RWIN: case VK_APPS:
+                return true;
+            default:
+                return false;
+            }
+        }
+    }
+
+    MacroPlayer::MacroPlayer()
+    {
+        m_inputs.reserve(256);
+    }
+
+    bool MacroPlayer::CompileText(std::string_view utf8, std::vector<INPUT>& inputs)
+    {
+        inputs.clear();
+        int const length = utf8.empty() ? 0 : MultiByteToWideChar(CP_UTF8, 0, utf8.data(), static_cast<int>(utf8.size()), nullptr, 0);
+        if (length <= 0)
+        {
+            return false;
+        }
+        std::wstring text(static_cast<size_t>(length), L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, utf8.data(), static_cast<int>(utf8.size()), text.data(), length);
+
+        inputs.reserve(text.size() * 2);
+        for (wchar_t const unit : text)
+        {
+            switch (unit)
+            {
+            case L'\r':
+                break; // "\r\n" is one Enter
+            case L'\n':
+                AppendKey(inputs, VK_RETURN, false);
+                AppendKey(inputs, VK_RETURN, true);
+                break;
+            case L'\t':
+                AppendKey(inputs, VK_TAB, false);
+                AppendKey(inputs, VK_TAB, true);
+                break;
+            default:
+                AppendUnit(inputs, unit);
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool MacroPlayer::CompileKeys(std::string_view keys, std::vector<INPUT>& inputs)
+    {
+        inputs.clear();
+        while (!keys.empty())
+        {
+            size_t const start = keys.find_first_not_of(" \t,");
+            if (start == std::string_view::npos)
+            {
+                break;
+            }
+            keys.remove_prefix(start);
+            size_t const end = keys.find_first_of(" \t,");
+            if (!AppendChord(inputs, keys.substr(0, end)))
+            {
+                inputs.clear();
+                return false;
+            }
+            keys.remove_prefix(end == std::string_view::npos ? keys.size() : end);
+        }
+        return !inputs.empty();
+    }
+
+    bool MacroPlayer::Play(std::span<INPUT const> inputs) noexcept
+    {
+        try
+        {
+            m_inputs.clear();
+            ReleaseHeldModifiers();
+            m_inputs.insert(m_inputs.end(), inputs.begin(), inputs.end());
+            RestoreHeldModifiers();
+            return Flush();
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+
+    void MacroPlayer::ReleaseHeldModifiers()
+    {
+        // The user is usually still holding the hotkey's modifiers, which
+        // would otherwise turn typed text into shortcuts.
+        static_assert(ARRAYSIZE(HeldModifiers) <= ARRAYSIZE(m_released));
+        m_releasedCount = 0;
+        bool masked = false;
+        for (WORD const vk : HeldModifiers)
+        {
+            if (GetAsyncKeyState(vk) & 0x8000)
+            {
+                if (!masked)
+                {
+                    // Tapped first so the releases below read as "used in a
+                    // chord" and neither Start nor a menu bar opens.
+                    AppendKey(m_inputs, MenuMaskKey, false);
+                    AppendKey(m_inputs, MenuMaskKey, true);
+                    masked = true;
+                }
+                AppendKey(m_inputs, vk, true);
+                m_released[m_releasedCount++] = vk;
+            }
+        }
+    }
+
+    void MacroPlayer::RestoreHeldModifiers()
+    {
+        // Presses the released keys again in the same batch, so the logical
+        // state ends where the physical keys are: still holding Ctrl after a
+        // snippet keeps Ctrl+V working. SendInput is not interleaved with
+        // real input, so a key the user lets go of meanwhile sees its real
+        // key-up after these downs.
+        if (m_releasedCount == 0)
+        {
+            return;
+        }
+        for (size_t i = m_releasedCount; i-- > 0;)
+        {
+            AppendKey(m_inputs, m_released[i], false);
+        }
+        // Letting go of a re-pressed Win or Alt with nothing in between
+        // would otherwise open Start or the menu bar.
+        AppendKey(m_inputs, MenuMaskKey, false);
+        AppendKey(m_inputs, MenuMaskKey, true);
+    }
+
+    bool MacroPlayer::AppendChord(std::vector<INPUT>& inputs, std::string_view chord)
+    {
+        // "Ctrl+Shift+T": every part but the last is a modifier.
+        WORD modifiers[4];
+        size_t modifierCount = 0;
+        for (size_t plus = chord.find('+'); plus != std::string_view::npos && plus + 1 < chord.size(); plus = chord.find('+'))
+        {
+            WORD const modifier = ModifierFromName(chord.substr(0, plus));
+            if (modifier == 0 || modifierCount == ARRAYSIZE(modifiers))
+            {
+                return false;
+            }
+            modifiers[modifierCount++] = modifier;
+            chord.remove_prefix(plus + 1);
+        }
+
+        WORD const vk = VirtualKeyFromName(chord);
+        if (vk == 0)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < modifierCount; ++i)
+        {
+            AppendKey(inputs, modifiers[i], false);
+        }
+        AppendKey(inputs, vk, false);
+        AppendKey(inputs, vk, true);
+        for (size_t i = modifierCount; i > 0; --i)
+        {
+            AppendKey(inputs, modifiers[i - 1], true);
+        }
+        return true;
+    }
+
+    void MacroPlayer::AppendKey(std::vector<INPUT>& inputs, WORD vk, bool up)
+    {
+        INPUT& input = inputs.emplace_back();
+        input.type = INPUT_KEYBOARD;
+        input.ki.wVk = vk;
+        input.ki.wScan = static_cast<WORD>(MapVirtualKeyW(vk, MAPVK_VK_TO_VSC));
+        input.ki.dwFlags = (up ? KEYEVENTF_KEYUP : 0) | (IsExtendedKey(vk) ? KEYEVENTF_EXTENDEDKEY : 0);
+        input.ki.dwExtraInfo = InjectedEventTag;
+    }
+
+    void MacroPlayer::AppendUnit(std::vector<INPUT>& inputs, wchar_t unit)
+    {
+        // Surrogate pairs are sent as two units, which is what VK_PACKET expects.
+        for (DWORD const flags : { DWORD{ KEYEVENTF_UNICODE }, DWORD{ KEYEVENTF_UNICODE | KEYEVENTF_KEYUP } })
+        {
+            INPUT& input = inputs.emplace_back();
+            input.type = INPUT_KEYBOARD;
+            input.ki.wScan = unit;
+            input.ki.dwFlags = flags;
+            input.ki.dwExtraInfo = InjectedEventTag;
+        }
+    }
+
+    bool MacroPlayer::Flush() noexcept
+    {
+        if (m_inputs.empty())
+        {
+            return true;
+        }
+        // Fewer events than asked for means UIPI blocked the target window.
+        UINT const count = static_cast<UINT>(m_inputs.size());
+        return SendInput(count, m_inputs.data(), sizeof(INPUT)) == count;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <windows.h>
+
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace khm
+{
+    // Sends the whole input stream of a macro with a single SendInput call,
+    // so a long snippet cannot be interleaved with real typing. The streams
+    // are compiled once, when a snapshot's actions are prepared; a run only
+    // copies one into the player's reusable buffer between the release of
+    // whatever modifiers the user still holds and their re-press, so they
+    // are held again once the macro is done. Every event carries
+    // InjectedEventTag and is passed straight through by our own hook. One
+    // player per executor worker.
+    class MacroPlayer
+    {
+    public:
+        MacroPlayer();
+
+        // UTF-8 text as KEYEVENTF_UNICODE events; newlines and tabs become
+        // Enter and Tab. False for empty or invalid text.
+        static bool CompileText(std::string_view utf8, std::vector<INPUT>& inputs);
+
+        // Chords such as "Ctrl+C Tab Ctrl+V" (space or comma separated).
+        // False, with nothing usable in `inputs`, when any chord fails to
+        // parse or there is none.
+        static bool CompileKeys(std::string_view keys, std::vector<INPUT>& inputs);
+
+        bool Play(std::span<INPUT const> inputs) noexcept;
+
+    private:
+        void ReleaseHeldModifiers();
+        void RestoreHeldModifiers();
+        static bool AppendChord(std::vector<INPUT>& inputs, std::string_view chord);
+        static void AppendKey(std::vector<INPUT>& inputs, WORD vk, bool up);
+        static void AppendUnit(std::vector<INPUT>& inputs, wchar_t unit);
+        bool Flush() noexcept;
+
+        std::vector<INPUT> m_inputs;
+        WORD m_released[8] = {};
+        size_t m_releasedCount = 0;
+    };
+}
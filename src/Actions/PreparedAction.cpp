@@ -0,0 +1,89 @@
+#include "pch.h"
+#include "Actions/PreparedAction.h"
+
+#include "Actions/MacroPlayer.h"
+
+#include <array>
+
+namespace khm
+{
+    namespace
+    {
+        constexpr std::string_view WindowsCommandNames[] = { "MinimizeAll", "RestoreAll", "LockWorkstation" };
+
+        template <typename Action>
+        PreparedAction ParseAs(ActionRecord const& record, std::string_view parameter)
+        {
+            if (std::optional<Action> action = Action::Parse(record, parameter))
+            {
+                return PreparedAction{ std::in_place_type<Action>, std::move(*action) };
+            }
+            return InvalidAction{};
+        }
+
+        using Parser = PreparedAction (*)(ActionRecord const&, std::string_view);
+
+        template <size_t... Types>
+        constexpr std::array<Parser, sizeof...(Types)> MakeParsers(std::index_sequence<Types...>) noexcept
+        {
+            return { &ParseAs<std::variant_alternative_t<Types + 1, PreparedAction>>... };
+        }
+
+        // Indexed by ActionType.
+        constexpr std::array<Parser, ActionTypeCount> Parsers = MakeParsers(std::make_index_sequence<ActionTypeCount>{});
+    }
+
+    std::optional<LaunchAppAction> LaunchAppAction::Parse(ActionRecord const& record, std::string_view parameter)
+    {
+        if (parameter.empty())
+        {
+            return std::nullopt;
+        }
+        LaunchAppAction action;
+        action.target.commandLine = std::wstring{ winrt::to_hstring(parameter) };
+        action.activateIfRunning = record.activateIfRunning;
+        return action;
+    }
+
+    std::optional<WindowsCommandAction> WindowsCommandAction::Parse(ActionRecord const&, std::string_view parameter)
+    {
+        for (size_t i = 0; i < std::size(WindowsCommandNames); ++i)
+        {
+            if (WindowsCommandNames[i] == parameter)
+            {
+                return WindowsCommandAction{ static_cast<WindowsCommand>(i) };
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::optional<TypeTextAction> TypeTextAction::Parse(ActionRecord const&, std::string_view parameter)
+    {
+        TypeTextAction action;
+        if (!MacroPlayer::CompileText(parameter, action.inputs))
+        {
+            return std::nullopt;
+        }
+        return action;
+    }
+
+    std::optional<SendKeysAction> SendKeysAction::Parse(ActionRecord const&, std::string_view parameter)
+    {
+        SendKeysAction action;
+        if (!MacroPlayer::CompileKeys(parameter, action.inputs))
+        {
+            return std::nullopt;
+        }
+        return action;
+    }
+
+    PreparedAction PrepareAction(ActionTable const& table, ActionRecord const& record)
+    {
+        ActionType const type = ActionTypeOf(table.String(record.type));
+        if (type == ActionType::Count)
+        {
+            return InvalidAction{};
+        }
+        return Parsers[static_cast<size_t>(type)](record, table.String(record.parameter));
+    }
+}
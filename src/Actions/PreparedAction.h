@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Configuration/ActionTable.h"
+#include "Configuration/Configuration.h"
+
+#include <windows.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace khm
+{
+    // CreateProcessW arguments for one LaunchApp action, resolved ahead of
+    // the hotkey.
+    struct LaunchTarget
+    {
+        std::wstring application;                                 // full image path; empty leaves the search to CreateProcessW
+        std::wstring commandLine;                                 // copied per launch, CreateProcessW writes into it
+        std::shared_ptr<std::vector<wchar_t> const> environment;  // CREATE_UNICODE_ENVIRONMENT block; null inherits ours
+        std::wstring imageKey;                                    // WindowIndex keys for activateIfRunning
+        std::wstring appIdKey;                                    // learned from the first launch of a packaged app
+    };
+
+    // The form an action runs in. Every action type has its own parameter
+    // struct, parsed from the record's strings when a snapshot is prepared,
+    // so a trigger goes straight to the Win32 call: no type names compared,
+    // no text decoded or parsed.
+    //
+    // A type's Parse() returns nullopt for a parameter it cannot use; such an
+    // action prepares into InvalidAction, as does an unknown type.
+
+    struct InvalidAction
+    {
+    };
+
+    struct LaunchAppAction
+    {
+        static constexpr ActionType Type = ActionType::LaunchApp;
+
+        LaunchTarget target; // the bare command line until ActionCache resolves it
+        bool activateIfRunning = false;
+
+        static std::optional<LaunchAppAction> Parse(ActionRecord const& record, std::string_view parameter);
+    };
+
+    enum class WindowsCommand : uint8_t
+    {
+        MinimizeAll,
+        RestoreAll,
+        LockWorkstation,
+    };
+
+    struct WindowsCommandAction
+    {
+        static constexpr ActionType Type = ActionType::WindowsAction;
+
+        WindowsCommand command = WindowsCommand::MinimizeAll;
+
+        static std::optional<WindowsCommandAction> Parse(ActionRecord const& record, std::string_view parameter);
+    };
+
+    // TypeText and SendKeys keep the INPUT stream MacroPlayer compiled; the
+    // player only puts the release of held modifiers in front of it.
+    struct TypeTextAction
+    {
+        static constexpr ActionType Type = ActionType::TypeText;
+
+        std::vector<INPUT> inputs;
+
+        static std::optional<TypeTextAction> Parse(ActionRecord const& record, std::string_view parameter);
+    };
+
+    struct SendKeysAction
+    {
+        static constexpr ActionType Type = ActionType::SendKeys;
+
+        std::vector<INPUT> inputs;
+
+        static std::optional<SendKeysAction> Parse(ActionRecord const& record, std::string_view parameter);
+    };
+
+    // The action type registry: alternative i + 1 is ActionType i, checked
+    // below, so the parser table PrepareAction() picks from and the
+    // std::visit in ActionRunner are both generated from this list. A new
+    // type is an ActionType, its struct and its Run() overload.
+    using PreparedAction = std::variant<InvalidAction, LaunchAppAction, WindowsCommandAction, TypeTextAction, SendKeysAction>;
+
+    namespace detail
+    {
+        template <size_t... Types>
+        constexpr bool RegistryMatchesActionTypes(std::index_sequence<Types...>) noexcept
+        {
+            return ((std::variant_alternative_t<Types + 1, PreparedAction>::Type == static_cast<ActionType>(Types)) && ...);
+        }
+    }
+
+    inline constexpr size_t ActionTypeCount = static_cast<size_t>(ActionType::Count);
+    static_assert(std::variant_size_v<PreparedAction> == ActionTypeCount + 1, "one PreparedAction alternative per ActionType");
+    static_assert(detail::RegistryMatchesActionTypes(std::make_index_sequence<ActionTypeCount>{}), "PreparedAction alternatives out of ActionType order");
+
+    // ActionType::Count for InvalidAction.
+    constexpr ActionType TypeOf(PreparedAction const& action) noexcept
+    {
+        return action.index() == 0 ? ActionType::Count : static_cast<ActionType>(action.index() - 1);
+    }
+
+    // Parses one record through its type's Parse(). Throws std::bad_alloc.
+    PreparedAction PrepareAction(ActionTable const& table, ActionRecord const& record);
+}
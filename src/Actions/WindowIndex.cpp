@@ -0,0 +1,320 @@
+#include "pch.h"
+#include "Actions/WindowIndex.h"
+
+#include <appmodel.h>
+
+#include <algorithm>
+
+namespace khm
+{
+    namespace
+    {
+        bool IsTopLevel(HWND window) noexcept
+        {
+            return window != nullptr && GetAncestor(window, GA_ROOT) == window;
+        }
+
+        // What Alt+Tab would offer: visible, unowned and not a tool window.
+        bool CanActivate(HWND window) noexcept
+        {
+            return IsWindowVisible(window)
+                && GetWindow(window, GW_OWNER) == nullptr
+                && !(GetWindowLongPtrW(window, GWL_EXSTYLE) & WS_EX_TOOLWINDOW);
+        }
+
+        bool BringToFront(HWND window) noexcept
+        {
+            if (IsIconic(window))
+            {
+                ShowWindow(window, SW_RESTORE);
+            }
+            if (SetForegroundWindow(window))
+            {
+                return true;
+            }
+
+            // The foreground lock yields to a thread that shares input state
+            // with the current foreground thread.
+            DWORD const self = GetCurrentThreadId();
+            DWORD const foreground = GetWindowThreadProcessId(GetForegroundWindow(), nullptr);
+            if (foreground == 0 || foreground == self || !AttachThreadInput(self, foreground, TRUE))
+            {
+                return false;
+            }
+            BOOL const moved = SetForegroundWindow(window);
+            AttachThreadInput(self, foreground, FALSE);
+            return moved != FALSE;
+        }
+    }
+
+    WindowIndex::~WindowIndex()
+    {
+        Stop();
+    }
+
+    void WindowIndex::Start()
+    {
+        if (m_thread.joinable())
+        {
+            return;
+        }
+        m_ready = winrt::handle(winrt::check_pointer(CreateEventW(nullptr, TRUE, FALSE, nullptr)));
+        m_thread = std::thread([this] { Run(); });
+
+        // Stop() posts WM_QUIT, so the thread must own a queue first.
+        WaitForSingleObject(m_ready.get(), INFINITE);
+    }
+
+    void WindowIndex::Stop() noexcept
+    {
+        if (!m_thread.joinable())
+        {
+            return;
+        }
+        PostThreadMessageW(m_threadId, WM_QUIT, 0, 0);
+        m_thread.join();
+
+        std::scoped_lock lock(m_lock);
+        m_windows.clear();
+        m_byImage.clear();
+        m_byAppId.clear();
+    }
+
+    std::wstring WindowIndex::Key(std::wstring_view text)
+    {
+        std::wstring key{ text };
+        if (!key.empty())
+        {
+            CharUpperBuffW(key.data(), static_cast<DWORD>(key.size()));
+        }
+        return key;
+    }
+
+    bool WindowIndex::Activate(std::wstring_view appIdKey, std::wstring_view imageKey) noexcept
+    {
+        HWND window = nullptr;
+        {
+            std::scoped_lock lock(m_lock);
+            if (!appIdKey.empty())
+            {
+                window = Find(m_byAppId, appIdKey);
+            }
+            if (window == nullptr && !imageKey.empty())
+            {
+                window = Find(m_byImage, imageKey);
+            }
+        }
+        return window != nullptr && BringToFront(window);
+    }
+
+    HWND WindowIndex::Find(Buckets const& buckets, std::wstring_view key) const noexcept
+    {
+        auto const found = buckets.find(key);
+        if (found == buckets.end())
+        {
+            return nullptr;
+        }
+        for (auto it = found->second.rbegin(); it != found->second.rend(); ++it)
+        {
+            if (CanActivate(*it))
+            {
+                return *it;
+            }
+        }
+        return nullptr;
+    }
+
+    void WindowIndex::Run() noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), L"khm.window-index");
+
+        m_threadId = GetCurrentThreadId();
+        MSG msg;
+        PeekMessageW(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+        s_active = this;
+
+        // Out-of-context callbacks are delivered through this thread's queue.
+        constexpr DWORD Flags = WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS;
+        HWINEVENTHOOK const lifetime = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_DESTROY, nullptr, OnWinEvent, 0, 0, Flags);
+        HWINEVENTHOOK const foreground = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, nullptr, OnWinEvent, 0, 0, Flags);
+        SetEvent(m_ready.get());
+
+        if (lifetime != nullptr && foreground != nullptr)
+        {
+            // Seeded after the hooks so that no window created in between is missed.
+            EnumWindows(OnEnumWindow, reinterpret_cast<LPARAM>(this));
+            while (GetMessageW(&msg, nullptr, 0, 0) > 0)
+            {
+                DispatchMessageW(&msg);
+            }
+        }
+        else
+        {
+            OutputDebugStringA("KeyboardHookManager: window index hooks failed\n");
+        }
+
+        if (lifetime != nullptr)
+        {
+            UnhookWinEvent(lifetime);
+        }
+        if (foreground != nullptr)
+        {
+            UnhookWinEvent(foreground);
+        }
+        s_active = nullptr;
+    }
+
+    void CALLBACK WindowIndex::OnWinEvent(HWINEVENTHOOK, DWORD event, HWND window, LONG object, LONG child, DWORD, DWORD) noexcept
+    {
+        WindowIndex* const self = s_active;
+        if (self == nullptr || object != OBJID_WINDOW || child != CHILDID_SELF || window == nullptr)
+        {
+            return;
+        }
+        try
+        {
+            switch (event)
+            {
+            case EVENT_OBJECT_CREATE:
+                if (IsTopLevel(window))
+                {
+                    self->Add(window);
+                }
+                break;
+            case EVENT_OBJECT_DESTROY:
+                self->Remove(window);
+                break;
+            case EVENT_SYSTEM_FOREGROUND:
+                self->Touch(window);
+                break;
+            default:
+                break;
+            }
+        }
+        catch (...)
+        {
+            // An allocation failure only leaves this window unindexed.
+        }
+    }
+
+    BOOL CALLBACK WindowIndex::OnEnumWindow(HWND window, LPARAM context) noexcept
+    {
+        try
+        {
+            reinterpret_cast<WindowIndex*>(context)->Add(window);
+        }
+        catch (...)
+        {
+        }
+        return TRUE;
+    }
+
+    void WindowIndex::Add(HWND window)
+    {
+        {
+            std::scoped_lock lock(m_lock);
+            if (m_windows.contains(window))
+            {
+                return;
+            }
+        }
+
+        // The process is queried outside the lock; only this thread writes.
+        DWORD processId = 0;
+        GetWindowThreadProcessId(window, &processId);
+        winrt::handle const process{ OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId) };
+        if (!process)
+        {
+            return;
+        }
+
+        Entry entry;
+        wchar_t image[MAX_PATH * 2];
+        DWORD imageLength = ARRAYSIZE(image);
+        if (QueryFullProcessImageNameW(process.get(), 0, image, &imageLength))
+        {
+            entry.image = Key({ image, imageLength });
+        }
+        wchar_t appId[APPLICATION_USER_MODEL_ID_MAX_LENGTH];
+        UINT32 appIdLength = ARRAYSIZE(appId);
+        if (GetApplicationUserModelId(process.get(), &appIdLength, appId) == ERROR_SUCCESS)
+        {
+            entry.appId = Key(appId);
+        }
+        if (entry.image.empty() && entry.appId.empty())
+        {
+            return;
+        }
+
+        std::scoped_lock lock(m_lock);
+        if (!entry.image.empty())
+        {
+            m_byImage[entry.image].push_back(window);
+        }
+        if (!entry.appId.empty())
+        {
+            m_byAppId[entry.appId].push_back(window);
+        }
+        m_windows.emplace(window, std::move(entry));
+    }
+
+    void WindowIndex::Remove(HWND window) noexcept
+    {
+        std::scoped_lock lock(m_lock);
+        auto const found = m_windows.find(window);
+        if (found == m_windows.end())
+        {
+            return;
+        }
+        Erase(m_byImage, found->second.image, window);
+        Erase(m_byAppId, found->second.appId, window);
+        m_windows.erase(found);
+    }
+
+    void WindowIndex::Touch(HWND window)
+    {
+        window = GetAncestor(window, GA_ROOT);
+        if (window == nullptr)
+        {
+            return;
+        }
+        Add(window);
+
+        std::scoped_lock lock(m_lock);
+        auto const found = m_windows.find(window);
+        if (found != m_windows.end())
+        {
+            MoveToBack(m_byImage, found->second.image, window);
+            MoveToBack(m_byAppId, found->second.appId, window);
+        }
+    }
+
+    void WindowIndex::Erase(Buckets& buckets, std::wstring const& key, HWND window) noexcept
+    {
+        auto const found = buckets.find(key);
+        if (found == buckets.end())
+        {
+            return;
+        }
+        std::erase(found->second, window);
+        if (found->second.empty())
+        {
+            buckets.erase(found);
+        }
+    }
+
+    void WindowIndex::MoveToBack(Buckets& buckets, std::wstring const& key, HWND window) noexcept
+    {
+        auto const found = buckets.find(key);
+        if (found == buckets.end())
+        {
+            return;
+        }
+        auto& windows = found->second;
+        auto const position = std::find(windows.begin(), windows.end(), window);
+        if (position != windows.end())
+        {
+            std::rotate(position, position + 1, windows.end());
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace khm
+{
+    // Top-level windows grouped by process image and AppUserModelID, kept
+    // current from WinEvent hooks on its own thread so that "activate if
+    // running" is a hash lookup instead of an EnumWindows per key press.
+    class WindowIndex
+    {
+    public:
+        WindowIndex() = default;
+        ~WindowIndex();
+
+        WindowIndex(WindowIndex const&) = delete;
+        WindowIndex& operator=(WindowIndex const&) = delete;
+
+        // Both are idempotent. Only run while some action needs the index,
+        // since the create/destroy hook sees every window in the session.
+        void Start();
+        void Stop() noexcept;
+
+        // Case-folded form of an image path or AppUserModelID, as Activate
+        // expects it.
+        static std::wstring Key(std::wstring_view text);
+
+        // Brings the most recently active window of the app to the front.
+        // An empty key is not looked up; false when nothing is indexed.
+        bool Activate(std::wstring_view appIdKey, std::wstring_view imageKey) noexcept;
+
+    private:
+        struct KeyHash
+        {
+            using is_transparent = void;
+            size_t operator()(std::wstring_view key) const noexcept { return std::hash<std::wstring_view>{}(key); }
+        };
+
+        // Most recently active last.
+        using Buckets = std::unordered_map<std::wstring, std::vector<HWND>, KeyHash, std::equal_to<>>;
+
+        struct Entry
+        {
+            std::wstring image;
+            std::wstring appId;
+        };
+
+        static void CALLBACK OnWinEvent(HWINEVENTHOOK hook, DWORD event, HWND window, LONG object, LONG child, DWORD thread, DWORD time) noexcept;
+        static BOOL CALLBACK OnEnumWindow(HWND window, LPARAM context) noexcept;
+
+        void Run() noexcept;
+        void Add(HWND window);
+        void Remove(HWND window) noexcept;
+        void Touch(HWND window);
+        HWND Find(Buckets const& buckets, std::wstring_view key) const noexcept;
+        static void Erase(Buckets& buckets, std::wstring const& key, HWND window) noexcept;
+        static void MoveToBack(Buckets& buckets, std::wstring const& key, HWND window) noexcept;
+
+        static inline WindowIndex* s_active = nullptr; // set on the index thread
+
+        std::thread m_thread;
+        DWORD m_threadId = 0;
+        winrt::handle m_ready;
+
+        mutable std::mutex m_lock;
+        std::unordered_map<HWND, Entry> m_windows; // guarded by m_lock
+        Buckets m_byImage;                         // guarded by m_lock
+        Buckets m_byAppId;                         // guarded by m_lock
+    };
+}
@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "Actions/WorkStealingPool.h"
+
+#include <algorithm>
+#include <string>
+
+namespace khm
+{
+    uint32_t WorkStealingPool::DefaultWorkerCount() noexcept
+    {
+        return std::clamp(std::thread::hardware_concurrency() / 2, 2u, 4u);
+    }
+
+    WorkStealingPool::WorkStealingPool(uint32_t workerCount)
+    {
+        m_workers.reserve(workerCount);
+        for (uint32_t i = 0; i < workerCount; ++i)
+        {
+            m_workers.push_back(std::make_unique<Worker>());
+        }
+    }
+
+    WorkStealingPool::~WorkStealingPool()
+    {
+        Stop();
+    }
+
+    void WorkStealingPool::Start(Handler handler)
+    {
+        if (!m_workers.empty() && m_workers.front()->thread.joinable())
+        {
+            return;
+        }
+        m_handler = std::move(handler);
+        m_stopping.store(false, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < WorkerCount(); ++i)
+        {
+            m_workers[i]->thread = std::thread([this, i] { Run(i); });
+        }
+    }
+
+    void WorkStealingPool::Stop() noexcept
+    {
+        if (m_workers.empty() || !m_workers.front()->thread.joinable())
+        {
+            return;
+        }
+        m_stopping.store(true, std::memory_order_release);
+        m_queued.release(WorkerCount());
+        for (auto& worker : m_workers)
+        {
+            worker->thread.join();
+            std::scoped_lock lock(worker->lock);
+            worker->queue.clear();
+        }
+        // Drop the tokens of discarded events so a restart starts from zero.
+        while (m_queued.try_acquire())
+        {
+        }
+    }
+
+    void WorkStealingPool::Submit(HookEvent const& event)
+    {
+        Worker& worker = *m_workers[m_next];
+        m_next = (m_next + 1) % WorkerCount();
+        {
+            std::scoped_lock lock(worker.lock);
+            worker.queue.push_back(event);
+        }
+        m_queued.release();
+    }
+
+    void WorkStealingPool::Run(uint32_t self) noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), (L"khm.worker-" + std::to_wstring(self)).c_str());
+
+        HookEvent event;
+        for (;;)
+        {
+            m_queued.acquire();
+            if (m_stopping.load(std::memory_order_acquire))
+            {
+                break;
+            }
+            // A token guarantees an event for this worker, but a concurrent
+            // steal can take the one a scan was heading for; scan again.
+            while (!TryTake(self, event))
+            {
+                std::this_thread::yield();
+                if (m_stopping.load(std::memory_order_acquire))
+                {
+                    return;
+                }
+            }
+            m_handler(self, event);
+        }
+    }
+
+    bool WorkStealingPool::TryTake(uint32_t self, HookEvent& event) noexcept
+    {
+        {
+            Worker& own = *m_workers[self];
+            std::scoped_lock lock(own.lock);
+            if (!own.queue.empty())
+            {
+                event = own.queue.front();
+                own.queue.pop_front();
+                return true;
+            }
+        }
+        for (uint32_t offset = 1; offset < WorkerCount(); ++offset)
+        {
+            Worker& victim = *m_workers[(self + offset) % WorkerCount()];
+            std::scoped_lock lock(victim.lock);
+            if (!victim.queue.empty())
+            {
+                event = victim.queue.back();
+                victim.queue.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+}
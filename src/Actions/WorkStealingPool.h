@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Core/HookEvent.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+namespace khm
+{
+    // Small fixed pool the executor hands actions to. Every worker owns a
+    // queue and takes from its front; an idle worker steals from the back of
+    // the others, so one slow action only ever occupies a single thread.
+    // Events do not start in the order they were submitted: a steal can
+    // overtake the front of the same queue. The executor keeps one run of an
+    // action at a time unless its maxInFlight allows more, and those may then
+    // run in any order.
+    class WorkStealingPool
+    {
+    public:
+        using Handler = std::function<void(uint32_t worker, HookEvent const& event)>;
+
+        // Half the logical processors, between 2 and 4: actions mostly wait
+        // on other processes rather than compute.
+        static uint32_t DefaultWorkerCount() noexcept;
+
+        explicit WorkStealingPool(uint32_t workerCount);
+        ~WorkStealingPool();
+
+        WorkStealingPool(WorkStealingPool const&) = delete;
+        WorkStealingPool& operator=(WorkStealingPool const&) = delete;
+
+        uint32_t WorkerCount() const noexcept { return static_cast<uint32_t>(m_workers.size()); }
+
+        // `handler` runs on the worker threads and must not throw.
+        void Start(Handler handler);
+
+        // Queued events that have not started are discarded.
+        void Stop() noexcept;
+
+        // Single submitting thread (the executor's dispatcher).
+        void Submit(HookEvent const& event);
+
+    private:
+        struct Worker
+        {
+            std::mutex lock;
+            std::deque<HookEvent> queue; // guarded by lock
+            std::thread thread;
+        };
+
+        void Run(uint32_t self) noexcept;
+        bool TryTake(uint32_t self, HookEvent& event) noexcept;
+
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        Handler m_handler;
+        std::counting_semaphore<> m_queued{ 0 }; // one token per submitted event
+        std::atomic<bool> m_stopping{ false };
+        uint32_t m_next = 0; // round-robin cursor, submitting thread only
+    };
+}
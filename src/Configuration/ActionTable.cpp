@@ -0,0 +1,111 @@
+#include "pch.h"
+#include "Configuration/ActionTable.h"
+
+#include "Utils/Hash.h"
+
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <stdexcept>
+
+namespace khm
+{
+    namespace
+    {
+        // Ids are hashed to 32 bits, and m_idMask holds one less than this.
+        constexpr size_t MaxIdSlots = size_t{ 1 } << 32;
+
+        // At most half full, so a failed lookup stops after a few probes.
+        // In size_t: twice a count from a corrupt cache need not fit in 32 bits.
+        size_t IdSlotCount(uint32_t actionCount)
+        {
+            size_t const slots = std::bit_ceil(std::max<size_t>(2, size_t{ actionCount } * 2));
+            if (slots > MaxIdSlots)
+            {
+                throw std::length_error("too many actions");
+            }
+            return slots;
+        }
+
+        uint32_t IdHash(std::string_view id) noexcept
+        {
+            uint64_t const hash = Fnv1a64(std::as_bytes(std::span{ id }));
+            return static_cast<uint32_t>(hash ^ (hash >> 32));
+        }
+    }
+
+    ActionTable ActionTable::Allocate(uint32_t actionCount, uint32_t stringBytes)
+    {
+        size_t const recordBytes = size_t{ actionCount } * sizeof(ActionRecord);
+        size_t const idSlots = IdSlotCount(actionCount);
+        size_t const indexBytes = idSlots * sizeof(uint32_t);
+        static_assert(alignof(ActionRecord) >= alignof(uint32_t));
+
+        ActionTable table;
+        table.m_storage = std::make_unique_for_overwrite<std::byte[]>(recordBytes + indexBytes + stringBytes);
+        table.m_records = reinterpret_cast<ActionRecord*>(table.m_storage.get());
+        std::uninitialized_default_construct_n(table.m_records, actionCount);
+        table.m_idSlots = reinterpret_cast<uint32_t*>(table.m_storage.get() + recordBytes);
+        std::fill_n(table.m_idSlots, idSlots, NotFound);
+        table.m_idMask = static_cast<uint32_t>(idSlots - 1);
+        table.m_strings = reinterpret_cast<char*>(table.m_storage.get() + recordBytes + indexBytes);
+        table.m_count = actionCount;
+        table.m_stringBytes = stringBytes;
+        return table;
+    }
+
+    ActionTable ActionTable::Clone() const
+    {
+        if (m_storage == nullptr)
+        {
+            return {};
+        }
+        ActionTable copy = Allocate(m_count, m_stringBytes);
+        std::copy_n(m_records, m_count, copy.m_records);
+        std::copy_n(m_idSlots, size_t{ m_idMask } + 1, copy.m_idSlots);
+        std::copy_n(m_strings, m_stringBytes, copy.m_strings);
+        return copy;
+    }
+
+    uint32_t ActionTable::Find(std::string_view id) const noexcept
+    {
+        if (m_idSlots == nullptr || id.empty())
+        {
+            return NotFound;
+        }
+        for (uint32_t slot = IdHash(id) & m_idMask;; slot = (slot + 1) & m_idMask)
+        {
+            uint32_t const index = m_idSlots[slot];
+            if (index == NotFound || String(m_records[index].id) == id)
+            {
+                return index;
+            }
+        }
+    }
+
+    void ActionTable::IndexIds() noexcept
+    {
+        if (m_idSlots == nullptr)
+        {
+            return;
+        }
+        std::fill_n(m_idSlots, size_t{ m_idMask } + 1, NotFound);
+        for (uint32_t i = 0; i < m_count; ++i)
+        {
+            std::string_view const id = String(m_records[i].id);
+            if (id.empty())
+            {
+                continue;
+            }
+            uint32_t slot = IdHash(id) & m_idMask;
+            while (m_idSlots[slot] != NotFound && String(m_records[m_idSlots[slot]].id) != id)
+            {
+                slot = (slot + 1) & m_idMask;
+            }
+            if (m_idSlots[slot] == NotFound)
+            {
+                m_idSlots[slot] = i;
+            }
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Core/Hotkey.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace khm
+{
+    // Offset/length pair into an ActionTable's string arena.
+    struct StringRef
+    {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    inline constexpr uint32_t MaxActionInFlight = 16;
+
+    // The fields an action in a config file spelled out, so an override can
+    // change some and leave the base's others.
+    enum ActionField : uint16_t
+    {
+        NameField = 1 << 0,
+        EnabledField = 1 << 1,
+        TypeField = 1 << 2,
+        ParameterField = 1 << 3,
+        ProfileField = 1 << 4,
+        ActivateIfRunningField = 1 << 5,
+        MaxInFlightField = 1 << 6,
+        CoalesceField = 1 << 7,
+        PassThroughField = 1 << 8,
+        HotkeyField = 1 << 9, // with its keyName
+        SequenceField = 1 << 10,
+    };
+
+    struct ActionRecord
+    {
+        StringRef id;
+        StringRef name;
+        StringRef type;
+        StringRef parameter;
+        StringRef keyName;
+        StringRef sequence; // packed (modifiers, vk) byte pairs in the arena
+        StringRef profile;  // executable the hotkey is limited to; empty for everywhere
+        Hotkey hotkey;
+        bool enabled = true;
+        bool hasHotkey = false;
+        bool activateIfRunning = false; // LaunchApp: focus a running instance instead
+        uint8_t maxInFlight = 1;        // concurrent runs of this action, 1..MaxActionInFlight
+        bool coalesce = true;           // presses beyond maxInFlight fold into one more run instead of being dropped
+        bool passThrough = false;       // the hotkey is observed through Raw Input and still reaches the foreground app
+        uint16_t fields = 0;            // ActionField bits; set by the streaming loaders only
+    };
+
+    // Contiguous action array, an open-addressed index over the action ids
+    // and the UTF-8 arena the strings point into, all in a single allocation.
+    class ActionTable
+    {
+    public:
+        static constexpr uint32_t NotFound = UINT32_MAX;
+
+        ActionTable() = default;
+
+        static ActionTable Allocate(uint32_t actionCount, uint32_t stringBytes);
+
+        // Deep copy, for edits that do not come from the JSON.
+        ActionTable Clone() const;
+
+        uint32_t Size() const noexcept { return m_count; }
+        bool Empty() const noexcept { return m_count == 0; }
+
+        ActionRecord const& operator[](uint32_t index) const noexcept { return m_records[index]; }
+        std::span<ActionRecord const> Records() const noexcept { return { m_records, m_count }; }
+
+        std::string_view String(StringRef ref) const noexcept
+        {
+            return { m_strings + ref.offset, ref.length };
+        }
+
+        uint32_t SequenceLength(ActionRecord const& record) const noexcept { return record.sequence.length / 2; }
+
+        Hotkey SequenceStep(ActionRecord const& record, uint32_t step) const noexcept
+        {
+            char const* const pair = m_strings + record.sequence.offset + step * 2;
+            return Hotkey{ static_cast<uint8_t>(pair[0]), static_cast<uint8_t>(pair[1]) };
+        }
+
+        std::span<char const> StringData() const noexcept { return { m_strings, m_stringBytes }; }
+
+        // Index of the action with this id, or NotFound. Duplicate ids
+        // resolve to the first one; tombstones are never found.
+        uint32_t Find(std::string_view id) const noexcept;
+
+        // Builds the id index; the loader calls it once records and strings
+        // are written.
+        void IndexIds() noexcept;
+
+        // Writable views for the loader that fills the table.
+        ActionRecord* MutableRecords() noexcept { return m_records; }
+        char* MutableStrings() noexcept { return m_strings; }
+        uint32_t StringCapacity() const noexcept { return m_stringBytes; }
+
+    private:
+        std::unique_ptr<std::byte[]> m_storage;
+        ActionRecord* m_records = nullptr;
+        uint32_t* m_idSlots = nullptr; // action index per slot, NotFound when free
+        char* m_strings = nullptr;
+        uint32_t m_idMask = 0;
+        uint32_t m_count = 0;
+        uint32_t m_stringBytes = 0;
+    };
+}
@@ -0,0 +1,217 @@
+#include "pch.h"
+#include "Configuration/ConfigFieldSink.h"
+
+#include <cstring>
+
+namespace khm
+{
+    namespace
+    {
+        uint32_t HexValue(std::string_view digits) noexcept
+        {
+            uint32_t value = 0;
+            for (char c : digits)
+            {
+                value <<= 4;
+                if (c >= '0' && c <= '9') value |= c - '0';
+                else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+            }
+            return value;
+        }
+
+        size_t AppendUtf8(char* out, uint32_t codePoint) noexcept
+        {
+            char buffer[4];
+            size_t length;
+            if (codePoint < 0x80)
+            {
+                buffer[0] = static_cast<char>(codePoint);
+                length = 1;
+            }
+            else if (codePoint < 0x800)
+            {
+                buffer[0] = static_cast<char>(0xC0 | (codePoint >> 6));
+                buffer[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+                length = 2;
+            }
+            else if (codePoint < 0x10000)
+            {
+                buffer[0] = static_cast<char>(0xE0 | (codePoint >> 12));
+                buffer[1] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                buffer[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+                length = 3;
+            }
+            else
+            {
+                buffer[0] = static_cast<char>(0xF0 | (codePoint >> 18));
+                buffer[1] = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+                buffer[2] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                buffer[3] = static_cast<char>(0x80 | (codePoint & 0x3F));
+                length = 4;
+            }
+            if (out != nullptr)
+            {
+                std::memcpy(out, buffer, length);
+            }
+            return length;
+        }
+
+        // The tokenizer has already validated every escape sequence.
+        size_t DecodeJson(std::string_view source, char* out) noexcept
+        {
+            size_t length = 0;
+            auto put = [&](char c) {
+                if (out != nullptr) out[length] = c;
+                ++length;
+            };
+
+            for (size_t i = 0; i < source.size(); ++i)
+            {
+                char const c = source[i];
+                if (c != '\\')
+                {
+                    put(c);
+                    continue;
+                }
+                switch (source[++i])
+                {
+                case 'b': put('\b'); break;
+                case 'f': put('\f'); break;
+                case 'n': put('\n'); break;
+                case 'r': put('\r'); break;
+                case 't': put('\t'); break;
+                case 'u':
+                {
+                    uint32_t codePoint = HexValue(source.substr(i + 1, 4));
+                    i += 4;
+                    if (codePoint >= 0xD800 && codePoint <= 0xDBFF && i + 6 < source.size() && source[i + 1] == '\\' && source[i + 2] == 'u')
+                    {
+                        uint32_t const low = HexValue(source.substr(i + 3, 4));
+                        if (low >= 0xDC00 && low <= 0xDFFF)
+                        {
+                            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                            i += 6;
+                        }
+                    }
+                    if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+                    {
+                        codePoint = 0xFFFD;
+                    }
+                    length += AppendUtf8(out != nullptr ? out + length : nullptr, codePoint);
+                    break;
+                }
+                default: put(source[i]); break; // '"', '\\', '/'
+                }
+            }
+            return length;
+        }
+
+        // A superset of the JSON escapes; again validated by the tokenizer.
+        size_t DecodeYamlDoubleQuoted(std::string_view source, char* out) noexcept
+        {
+            size_t length = 0;
+            auto put = [&](char c) {
+                if (out != nullptr) out[length] = c;
+                ++length;
+            };
+            auto putCodePoint = [&](uint32_t codePoint) {
+                if ((codePoint >= 0xD800 && codePoint <= 0xDFFF) || codePoint > 0x10FFFF)
+                {
+                    codePoint = 0xFFFD;
+                }
+                length += AppendUtf8(out != nullptr ? out + length : nullptr, codePoint);
+            };
+
+            for (size_t i = 0; i < source.size(); ++i)
+            {
+                char const c = source[i];
+                if (c != '\\')
+                {
+                    put(c);
+                    continue;
+                }
+                switch (source[++i])
+                {
+                case '0': put('\0'); break;
+                case 'a': put('\a'); break;
+                case 'b': put('\b'); break;
+                case 't': put('\t'); break;
+                case 'n': put('\n'); break;
+                case 'v': put('\v'); break;
+                case 'f': put('\f'); break;
+                case 'r': put('\r'); break;
+                case 'e': put('\x1B'); break;
+                case 'N': putCodePoint(0x85); break;
+                case '_': putCodePoint(0xA0); break;
+                case 'L': putCodePoint(0x2028); break;
+                case 'P': putCodePoint(0x2029); break;
+                case 'x':
+                    putCodePoint(HexValue(source.substr(i + 1, 2)));
+                    i += 2;
+                    break;
+                case 'u':
+                {
+                    uint32_t codePoint = HexValue(source.substr(i + 1, 4));
+                    i += 4;
+                    if (codePoint >= 0xD800 && codePoint <= 0xDBFF && i + 6 < source.size() && source[i + 1] == '\\' && source[i + 2] == 'u')
+                    {
+                        uint32_t const low = HexValue(source.substr(i + 3, 4));
+                        if (low >= 0xDC00 && low <= 0xDFFF)
+                        {
+                            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                            i += 6;
+                        }
+                    }
+                    putCodePoint(codePoint);
+                    break;
+                }
+                case 'U':
+                    putCodePoint(HexValue(source.substr(i + 1, 8)));
+                    i += 8;
+                    break;
+                default: put(source[i]); break; // '"', '\\', '/', ' ', tab
+                }
+            }
+            return length;
+        }
+
+        size_t DecodeYamlSingleQuoted(std::string_view source, char* out) noexcept
+        {
+            size_t length = 0;
+            for (size_t i = 0; i < source.size(); ++i)
+            {
+                if (out != nullptr)
+                {
+                    out[length] = source[i];
+                }
+                ++length;
+                if (source[i] == '\'')
+                {
+                    ++i; // the second quote of ''
+                }
+            }
+            return length;
+        }
+    }
+
+    size_t ScalarText::Decode(char* out) const noexcept
+    {
+        switch (encoding)
+        {
+        case ScalarEncoding::JsonEscaped:
+            return DecodeJson(source, out);
+        case ScalarEncoding::YamlDoubleQuoted:
+            return DecodeYamlDoubleQuoted(source, out);
+        case ScalarEncoding::YamlSingleQuoted:
+            return DecodeYamlSingleQuoted(source, out);
+        case ScalarEncoding::Raw:
+        default:
+            if (out != nullptr)
+            {
+                std::memcpy(out, source.data(), source.size());
+            }
+            return source.size();
+        }
+    }
+}
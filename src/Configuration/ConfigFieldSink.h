@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Configuration/ConfigKeys.h"
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace khm
+{
+    // Where in the schema a field was found.
+    enum class ConfigScope : uint8_t
+    {
+        Root,
+        Settings,
+        Action,
+        Hotkey,
+        SequenceStep, // one entry of an action's "sequence" array
+        ActionQos,    // settings.actionQos
+    };
+
+    enum class ScalarEncoding : uint8_t
+    {
+        Raw,         // bytes are the value
+        JsonEscaped, // JSON string body containing backslash escapes
+        YamlDoubleQuoted, // YAML "..." body containing backslash escapes
+        YamlSingleQuoted, // YAML '...' body containing '' for a quote
+    };
+
+    // A string value still pointing into the source buffer. Decoding is
+    // deferred so that a sink can size its storage before copying.
+    struct ScalarText
+    {
+        std::string_view source;
+        ScalarEncoding encoding = ScalarEncoding::Raw;
+
+        // Writes the UTF-8 value to `out` (when non-null) and returns its length.
+        size_t Decode(char* out) const noexcept;
+
+        size_t DecodedLength() const noexcept
+        {
+            return encoding == ScalarEncoding::Raw ? source.size() : Decode(nullptr);
+        }
+    };
+
+    // Receiver for the field-level events produced by the streaming config
+    // parsers. Values arrive already type-checked against the schema.
+    template <typename T>
+    concept ConfigFieldSink = requires(T& sink, ConfigScope scope, ConfigKey key, ScalarText const& text, bool flag, uint32_t number) {
+        sink.BeginAction();
+        sink.EndAction();
+        sink.BeginHotkey();
+        sink.BeginSequence();
+        sink.BeginStep();
+        sink.EndStep();
+        sink.OnString(scope, key, text);
+        sink.OnBool(scope, key, flag);
+        sink.OnUInt(scope, key, number);
+    };
+}
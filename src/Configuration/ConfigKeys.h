@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace khm
+{
+    // Every key the configuration schema knows about. Anything else is skipped.
+    enum class ConfigKey : uint8_t
+    {
+        Unknown,
+        Version,
+        Settings,
+        StartWithWindows,
+        ShowTrayIcon,
+        EnableLogging,
+        LogLevel,
+        SequenceTimeoutMs,
+        HookPriority,
+        ActionQos,
+        LaunchApp,     // the action types, as settings.actionQos keys
+        WindowsAction,
+        TypeText,
+        SendKeys,
+        Actions,
+        Id,
+        Name,
+        Enabled,
+        Type,
+        Parameter,
+        ActivateIfRunning,
+        MaxInFlight,
+        Coalesce,
+        PassThrough,
+        Profile,
+        Hotkey,
+        Sequence,
+        Win,
+        Ctrl,
+        Shift,
+        Alt,
+        Key,
+        KeyName,
+    };
+
+    namespace detail
+    {
+        struct ConfigKeyName
+        {
+            std::string_view text;
+            ConfigKey key;
+        };
+
+        inline constexpr ConfigKeyName ConfigKeyNames[] = {
+            { "version", ConfigKey::Version },
+            { "settings", ConfigKey::Settings },
+            { "startWithWindows", ConfigKey::StartWithWindows },
+            { "showTrayIcon", ConfigKey::ShowTrayIcon },
+            { "enableLogging", ConfigKey::EnableLogging },
+            { "logLevel", ConfigKey::LogLevel },
+            { "sequenceTimeoutMs", ConfigKey::SequenceTimeoutMs },
+            { "hookPriority", ConfigKey::HookPriority },
+            { "actionQos", ConfigKey::ActionQos },
+            { "LaunchApp", ConfigKey::LaunchApp },
+            { "WindowsAction", ConfigKey::WindowsAction },
+            { "TypeText", ConfigKey::TypeText },
+            { "SendKeys", ConfigKey::SendKeys },
+            { "actions", ConfigKey::Actions },
+            { "id", ConfigKey::Id },
+            { "name", ConfigKey::Name },
+            { "enabled", ConfigKey::Enabled },
+            { "type", ConfigKey::Type },
+            { "parameter", ConfigKey::Parameter },
+            { "activateIfRunning", ConfigKey::ActivateIfRunning },
+            { "maxInFlight", ConfigKey::MaxInFlight },
+            { "coalesce", ConfigKey::Coalesce },
+            { "passThrough", ConfigKey::PassThrough },
+            { "profile", ConfigKey::Profile },
+            { "hotkey", ConfigKey::Hotkey },
+            { "sequence", ConfigKey::Sequence },
+            { "win", ConfigKey::Win },
+            { "ctrl", ConfigKey::Ctrl },
+            { "shift", ConfigKey::Shift },
+            { "alt", ConfigKey::Alt },
+            { "key", ConfigKey::Key },
+            { "keyName", ConfigKey::KeyName },
+        };
+
+        // Twice the keys or more, so a perfect seed turns up within a few tries.
+        inline constexpr uint32_t ConfigKeySlotBits = 7;
+        inline constexpr uint32_t ConfigKeySlotCount = 1u << ConfigKeySlotBits;
+
+        constexpr uint32_t HashKey(std::string_view text, uint32_t seed) noexcept
+        {
+            uint32_t hash = 2166136261u ^ seed;
+            for (char c : text)
+            {
+                hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+            }
+            return hash >> (32 - ConfigKeySlotBits);
+        }
+
+        // Smallest seed for which every known key lands in its own slot.
+        consteval uint32_t FindPerfectSeed()
+        {
+            for (uint32_t seed = 0;; ++seed)
+            {
+                std::array<bool, ConfigKeySlotCount> used{};
+                bool collision = false;
+                for (ConfigKeyName const& name : ConfigKeyNames)
+                {
+                    uint32_t const slot = HashKey(name.text, seed);
+                    collision |= used[slot];
+                    used[slot] = true;
+                }
+                if (!collision)
+                {
+                    return seed;
+                }
+            }
+        }
+
+        inline constexpr uint32_t ConfigKeySeed = FindPerfectSeed();
+
+        consteval std::array<ConfigKeyName, ConfigKeySlotCount> BuildConfigKeySlots()
+        {
+            std::array<ConfigKeyName, ConfigKeySlotCount> slots{};
+            for (ConfigKeyName const& name : ConfigKeyNames)
+            {
+                slots[HashKey(name.text, ConfigKeySeed)] = name;
+            }
+            return slots;
+        }
+
+        inline constexpr auto ConfigKeySlots = BuildConfigKeySlots();
+    }
+
+    // One hash and one string compare, with no runtime table construction.
+    constexpr ConfigKey LookupConfigKey(std::string_view text) noexcept
+    {
+        detail::ConfigKeyName const& slot = detail::ConfigKeySlots[detail::HashKey(text, detail::ConfigKeySeed)];
+        return slot.text == text ? slot.key : ConfigKey::Unknown;
+    }
+
+    static_assert(LookupConfigKey("hotkey") == ConfigKey::Hotkey);
+    static_assert(LookupConfigKey("keyName") == ConfigKey::KeyName);
+    static_assert(LookupConfigKey("hotkeys") == ConfigKey::Unknown);
+}
@@ -0,0 +1,283 @@
+#pragma once
+
+#include "Configuration/ConfigFieldSink.h"
+#include "Configuration/JsonReader.h"
+#include "Configuration/YamlReader.h"
+#include "Core/Hotkey.h"
+
+#include <charconv>
+
+namespace khm
+{
+    // Walks the config schema over a token reader (JsonReader, YamlReader)
+    // and reports typed fields to a ConfigFieldSink, so every format fills a
+    // sink the same way. Unknown keys are skipped; type mismatches throw.
+    template <typename Reader, ConfigFieldSink Sink>
+    class ConfigParser
+    {
+    public:
+        ConfigParser(std::string_view text, Sink& sink) noexcept :
+            m_reader(text),
+            m_sink(sink)
+        {
+        }
+
+        void Parse()
+        {
+            if (m_reader.Next() != JsonToken::BeginObject)
+            {
+                m_reader.Fail("configuration root must be an object");
+            }
+            Object(ConfigScope::Root);
+            m_reader.Next();
+        }
+
+    private:
+        enum class Kind : uint8_t { Skip, String, Bool, UInt, Object, Array };
+
+        static constexpr Kind ExpectedKind(ConfigScope scope, ConfigKey key) noexcept
+        {
+            switch (scope)
+            {
+            case ConfigScope::Root:
+                switch (key)
+                {
+                case ConfigKey::Version: return Kind::String;
+                case ConfigKey::Settings: return Kind::Object;
+                case ConfigKey::Actions: return Kind::Array;
+                default: return Kind::Skip;
+                }
+            case ConfigScope::Settings:
+                switch (key)
+                {
+                case ConfigKey::StartWithWindows:
+                case ConfigKey::ShowTrayIcon:
+                case ConfigKey::EnableLogging:
+                    return Kind::Bool;
+                case ConfigKey::SequenceTimeoutMs: return Kind::UInt;
+                case ConfigKey::HookPriority:
+                case ConfigKey::LogLevel:
+                    return Kind::String;
+                case ConfigKey::ActionQos: return Kind::Object;
+                default: return Kind::Skip;
+                }
+            case ConfigScope::ActionQos:
+                switch (key)
+                {
+                case ConfigKey::LaunchApp:
+                case ConfigKey::WindowsAction:
+                case ConfigKey::TypeText:
+                case ConfigKey::SendKeys:
+                    return Kind::String;
+                default: return Kind::Skip;
+                }
+            case ConfigScope::Action:
+                switch (key)
+                {
+                case ConfigKey::Id:
+                case ConfigKey::Name:
+                case ConfigKey::Type:
+                case ConfigKey::Parameter:
+                case ConfigKey::Profile:
+                    return Kind::String;
+                case ConfigKey::Enabled:
+                case ConfigKey::ActivateIfRunning:
+                case ConfigKey::Coalesce:
+                case ConfigKey::PassThrough:
+                    return Kind::Bool;
+                case ConfigKey::MaxInFlight: return Kind::UInt;
+                case ConfigKey::Hotkey: return Kind::Object;
+                case ConfigKey::Sequence: return Kind::Array;
+                default: return Kind::Skip;
+                }
+            case ConfigScope::SequenceStep:
+                switch (key)
+                {
+                case ConfigKey::Win:
+                case ConfigKey::Ctrl:
+                case ConfigKey::Shift:
+                case ConfigKey::Alt:
+                    return Kind::Bool;
+                case ConfigKey::Key: return Kind::UInt;
+                case ConfigKey::KeyName: return Kind::String;
+                default: return Kind::Skip;
+                }
+            case ConfigScope::Hotkey:
+                switch (key)
+                {
+                case ConfigKey::Win:
+                case ConfigKey::Ctrl:
+                case ConfigKey::Shift:
+                case ConfigKey::Alt:
+                    return Kind::Bool;
+                case ConfigKey::Key: return Kind::UInt;
+                case ConfigKey::KeyName: return Kind::String;
+                default: return Kind::Skip;
+                }
+            }
+            return Kind::Skip;
+        }
+
+        ConfigKey CurrentKey() const noexcept
+        {
+            ScalarText const& text = m_reader.Text();
+            if (text.encoding == ScalarEncoding::Raw)
+            {
+                return LookupConfigKey(text.source);
+            }
+            char buffer[32];
+            if (text.DecodedLength() > sizeof(buffer))
+            {
+                return ConfigKey::Unknown;
+            }
+            return LookupConfigKey(std::string_view(buffer, text.Decode(buffer)));
+        }
+
+        void Object(ConfigScope scope)
+        {
+            for (JsonToken token = m_reader.Next(); token != JsonToken::EndObject; token = m_reader.Next())
+            {
+                ConfigKey const key = CurrentKey();
+                Field(scope, key, m_reader.Next());
+            }
+        }
+
+        void Field(ConfigScope scope, ConfigKey key, JsonToken value)
+        {
+            Kind const kind = ExpectedKind(scope, key);
+            if (kind == Kind::Skip || value == JsonToken::Null)
+            {
+                m_reader.SkipValue(value);
+                return;
+            }
+
+            switch (kind)
+            {
+            case Kind::String:
+                Expect(value == JsonToken::String || (Reader::ScalarsAreStrings && IsScalar(value)), "expected a string");
+                m_sink.OnString(scope, key, m_reader.Text());
+                break;
+            case Kind::Bool:
+                Expect(value == JsonToken::True || value == JsonToken::False, "expected true or false");
+                m_sink.OnBool(scope, key, value == JsonToken::True);
+                break;
+            case Kind::UInt:
+                Expect(value == JsonToken::Number, "expected a number");
+                m_sink.OnUInt(scope, key, Unsigned(key));
+                break;
+            case Kind::Object:
+                Expect(value == JsonToken::BeginObject, "expected an object");
+                if (key == ConfigKey::Hotkey)
+                {
+                    m_sink.BeginHotkey();
+                    Object(ConfigScope::Hotkey);
+                }
+                else if (key == ConfigKey::ActionQos)
+                {
+                    Object(ConfigScope::ActionQos);
+                }
+                else
+                {
+                    Object(ConfigScope::Settings);
+                }
+                break;
+            case Kind::Array:
+                Expect(value == JsonToken::BeginArray, "expected an array");
+                if (key == ConfigKey::Sequence)
+                {
+                    Sequence();
+                }
+                else
+                {
+                    Actions();
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        void Actions()
+        {
+            for (JsonToken token = m_reader.Next(); token != JsonToken::EndArray; token = m_reader.Next())
+            {
+                Expect(token == JsonToken::BeginObject, "actions[] entries must be objects");
+                m_sink.BeginAction();
+                Object(ConfigScope::Action);
+                m_sink.EndAction();
+            }
+        }
+
+        void Sequence()
+        {
+            m_sink.BeginSequence();
+            for (JsonToken token = m_reader.Next(); token != JsonToken::EndArray; token = m_reader.Next())
+            {
+                Expect(token == JsonToken::BeginObject, "sequence[] entries must be objects");
+                m_sink.BeginStep();
+                Object(ConfigScope::SequenceStep);
+                m_sink.EndStep();
+            }
+        }
+
+        static bool IsScalar(JsonToken token) noexcept
+        {
+            return token == JsonToken::String || token == JsonToken::Number || token == JsonToken::True || token == JsonToken::False;
+        }
+
+        uint32_t Unsigned(ConfigKey key) const
+        {
+            switch (key)
+            {
+            case ConfigKey::SequenceTimeoutMs: return Ranged(MinSequenceTimeoutMs, MaxSequenceTimeoutMs, "settings.sequenceTimeoutMs must be in 100..10000");
+            case ConfigKey::MaxInFlight: return Ranged(1, MaxActionInFlight, "maxInFlight must be in 1..16");
+            default: return VirtualKey();
+            }
+        }
+
+        uint32_t Ranged(uint32_t min, uint32_t max, std::string_view message) const
+        {
+            std::string_view const text = m_reader.NumberText();
+            uint32_t value = 0;
+            auto const [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (error != std::errc{} || end != text.data() + text.size() || value < min || value > max)
+            {
+                m_reader.Fail(message);
+            }
+            return value;
+        }
+
+        uint32_t VirtualKey() const
+        {
+            uint32_t const value = Ranged(1, 254, "hotkey.key must be a virtual key code in 1..254");
+            if (IsModifierKey(static_cast<uint8_t>(value)))
+            {
+                m_reader.Fail("hotkey.key cannot be a modifier key");
+            }
+            return value;
+        }
+
+        void Expect(bool condition, std::string_view message) const
+        {
+            if (!condition)
+            {
+                m_reader.Fail(message);
+            }
+        }
+
+        Reader m_reader;
+        Sink& m_sink;
+    };
+
+    template <ConfigFieldSink Sink>
+    void ParseConfigJson(std::string_view text, Sink& sink)
+    {
+        ConfigParser<JsonReader, Sink>(text, sink).Parse();
+    }
+
+    template <ConfigFieldSink Sink>
+    void ParseConfigYaml(std::string_view text, Sink& sink)
+    {
+        ConfigParser<YamlReader, Sink>(text, sink).Parse();
+    }
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "Configuration/ActionTable.h"
+#include "Core/Hotkey.h"
+#include "Utils/Logger.h"
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace khm
+{
+    // In-memory form of config/example-config.json.
+
+    struct HotkeyDefinition
+    {
+        bool win = false;
+        bool ctrl = false;
+        bool shift = false;
+        bool alt = false;
+        uint32_t key = 0;
+        std::wstring keyName;
+
+        Hotkey ToHotkey() const noexcept
+        {
+            uint8_t modifiers = ModNone;
+            if (win) modifiers |= ModWin;
+            if (ctrl) modifiers |= ModCtrl;
+            if (shift) modifiers |= ModShift;
+            if (alt) modifiers |= ModAlt;
+            return Hotkey{ modifiers, static_cast<uint8_t>(key) };
+        }
+    };
+
+    struct ActionDefinition
+    {
+        std::wstring id;
+        std::wstring name;
+        bool enabled = true;
+        std::wstring type;
+        std::wstring parameter;
+        std::wstring profile;
+        bool activateIfRunning = false;
+        uint32_t maxInFlight = 1;
+        bool coalesce = true;
+        bool passThrough = false;
+        std::optional<HotkeyDefinition> hotkey;
+        std::vector<HotkeyDefinition> sequence;
+    };
+
+    // settings.hookPriority: scheduling priority of the hook thread.
+    enum class HookPriority : uint8_t
+    {
+        TimeCritical,
+        Highest,
+        AboveNormal,
+        Normal,
+    };
+
+    // settings.actionQos: how the executor's workers run an action type.
+    // Background runs at low CPU, I/O and memory priority and may be put on
+    // efficiency cores; Normal is never throttled.
+    enum class QosTier : uint8_t
+    {
+        Normal,
+        Background,
+    };
+
+    // The action types settings.actionQos can name.
+    enum class ActionType : uint8_t
+    {
+        LaunchApp,
+        WindowsAction,
+        TypeText,
+        SendKeys,
+        Count
+    };
+
+    // Config spellings, indexed by the enum values.
+    inline constexpr std::string_view HookPriorityNames[] = { "timeCritical", "highest", "aboveNormal", "normal" };
+    inline constexpr std::string_view QosTierNames[] = { "normal", "background" };
+    inline constexpr std::string_view LogLevelNames[] = { "debug", "info", "warning", "error", "off" };
+    inline constexpr std::string_view ActionTypeNames[] = { "LaunchApp", "WindowsAction", "TypeText", "SendKeys" };
+    static_assert(std::size(ActionTypeNames) == static_cast<size_t>(ActionType::Count));
+
+    // ActionType::Count for a type settings.actionQos cannot name.
+    constexpr ActionType ActionTypeOf(std::string_view type) noexcept
+    {
+        for (size_t i = 0; i < std::size(ActionTypeNames); ++i)
+        {
+            if (ActionTypeNames[i] == type)
+            {
+                return static_cast<ActionType>(i);
+            }
+        }
+        return ActionType::Count;
+    }
+
+    struct Settings
+    {
+        bool startWithWindows = false;
+        bool showTrayIcon = true;
+        bool enableLogging = false;
+        LogLevel logLevel = LogLevel::Info; // of the log file, while enableLogging is set
+        uint32_t sequenceTimeoutMs = DefaultSequenceTimeoutMs;
+        HookPriority hookPriority = HookPriority::TimeCritical;
+        std::array<QosTier, static_cast<size_t>(ActionType::Count)> actionQos{}; // by ActionType
+
+        QosTier QosOf(ActionType type) const noexcept
+        {
+            return type == ActionType::Count ? QosTier::Normal : actionQos[static_cast<size_t>(type)];
+        }
+
+        QosTier QosOf(std::string_view type) const noexcept { return QosOf(ActionTypeOf(type)); }
+    };
+
+    struct Configuration
+    {
+        std::wstring version;
+        Settings settings;
+        std::vector<ActionDefinition> actions;
+    };
+
+    // Result of the streaming loader: actions live in a single arena-backed table.
+    struct LoadedConfiguration
+    {
+        std::string version;
+        Settings settings;
+        ActionTable actions;
+        uint64_t sourceHash = 0; // Fnv1a64 of the JSON text
+    };
+
+    // One action as ConfigurationLoader::StreamActions reports it. Strings
+    // are UTF-8; the object is reused for the next action, so copy whatever
+    // has to outlive the callback.
+    struct StreamedAction
+    {
+        std::string id;
+        std::string name;
+        bool enabled = true;
+        std::string type;
+        std::string parameter;
+        std::string profile;
+        bool activateIfRunning = false;
+        uint32_t maxInFlight = 1;
+        bool coalesce = true;
+        bool passThrough = false;
+        bool hasHotkey = false;
+        Hotkey hotkey;
+        std::string keyName;
+        std::vector<Hotkey> sequence; // empty: none
+        std::vector<std::string> sequenceKeyNames; // one per step, empty when unnamed
+
+        // Back to the defaults, keeping the buffers.
+        void Reset() noexcept
+        {
+            id.clear();
+            name.clear();
+            enabled = true;
+            type.clear();
+            parameter.clear();
+            profile.clear();
+            activateIfRunning = false;
+            maxInFlight = 1;
+            coalesce = true;
+            passThrough = false;
+            hasHotkey = false;
+            hotkey = {};
+            keyName.clear();
+            sequence.clear();
+            sequenceKeyNames.clear();
+        }
+    };
+
+    // What StreamActions knows once the file has been read.
+    struct StreamedConfiguration
+    {
+        std::string version;
+        Settings settings;
+        bool hasSettings = false; // the file set at least one setting
+        uint32_t actionCount = 0;
+    };
+}
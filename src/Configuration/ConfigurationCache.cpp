@@ -0,0 +1,334 @@
+#include "pch.h"
+#include "Configuration/ConfigurationCache.h"
+
+#include "Utils/MappedFile.h"
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace khm
+{
+    namespace
+    {
+        constexpr uint32_t CacheMagic = 0x434D484B; // "KHMC"
+        // Bump whenever ActionRecord, Settings or the image layout changes.
+        constexpr uint16_t CacheFormatVersion = 10;
+
+        enum SettingsBits : uint8_t
+        {
+            StartWithWindowsBit = 1,
+            ShowTrayIconBit = 2,
+            EnableLoggingBit = 4,
+            LogLevelShift = 3, // bits 3-5
+        };
+
+        // Image layout: header | dispatch slots | records | strings | version.
+        struct CacheHeader
+        {
+            uint32_t magic;
+            uint16_t formatVersion;
+            uint16_t recordSize;
+            uint64_t sourceHash;
+            uint64_t sourceSize;      // zero in the shared sections, which have no file
+            uint64_t sourceWriteTime; // FILETIME
+            uint32_t actionCount;
+            uint32_t stringBytes;
+            uint32_t versionLength;
+            uint8_t settings; // SettingsBits
+            uint8_t threading; // hook priority in bits 0-1, then one Background bit per ActionType
+            uint16_t sequenceTimeoutMs;
+        };
+
+        static_assert(sizeof(CacheHeader) == 48);
+        static_assert(static_cast<size_t>(ActionType::Count) <= 6, "one CacheHeader::threading bit per type");
+        static_assert(std::is_trivially_copyable_v<ActionRecord>);
+
+        // A bool holding anything but 0 or 1 is undefined behaviour, so these
+        // bytes are checked before a record is copied out of the image.
+        constexpr size_t FlagOffsets[] = {
+            offsetof(ActionRecord, enabled),
+            offsetof(ActionRecord, hasHotkey),
+            offsetof(ActionRecord, activateIfRunning),
+            offsetof(ActionRecord, coalesce),
+            offsetof(ActionRecord, passThrough),
+        };
+        static_assert(sizeof(bool) == 1);
+
+        constexpr size_t SlotBytes = HotkeyDispatchTable::SlotCount * sizeof(uint32_t);
+
+        struct SourceStamp
+        {
+            uint64_t size = 0;
+            uint64_t writeTime = 0;
+        };
+
+        // Zero when the source cannot be queried, which no stored image matches.
+        SourceStamp StampOf(std::filesystem::path const& source) noexcept
+        {
+            WIN32_FILE_ATTRIBUTE_DATA data;
+            if (!GetFileAttributesExW(source.c_str(), GetFileExInfoStandard, &data))
+            {
+                return {};
+            }
+            return { (uint64_t{ data.nFileSizeHigh } << 32) | data.nFileSizeLow,
+                (uint64_t{ data.ftLastWriteTime.dwHighDateTime } << 32) | data.ftLastWriteTime.dwLowDateTime };
+        }
+
+        bool HasValidFlags(std::byte const* record) noexcept
+        {
+            for (size_t offset : FlagOffsets)
+            {
+                uint8_t value;
+                std::memcpy(&value, record + offset, sizeof(value));
+                if (value > 1)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool InBounds(StringRef ref, uint32_t stringBytes) noexcept
+        {
+            return ref.offset <= stringBytes && ref.length <= stringBytes - ref.offset;
+        }
+
+        bool IsValid(ActionRecord const& record, uint32_t stringBytes) noexcept
+        {
+            return InBounds(record.id, stringBytes)
+                && InBounds(record.name, stringBytes)
+                && InBounds(record.type, stringBytes)
+                && InBounds(record.parameter, stringBytes)
+                && InBounds(record.keyName, stringBytes)
+                && InBounds(record.sequence, stringBytes)
+                && InBounds(record.profile, stringBytes)
+                && record.sequence.length % 2 == 0
+                && record.sequence.length <= MaxSequenceLength * 2
+                && record.maxInFlight >= 1
+                && record.maxInFlight <= MaxActionInFlight;
+        }
+
+        uint8_t PackSettings(Settings const& settings) noexcept
+        {
+            return (settings.startWithWindows ? StartWithWindowsBit : 0)
+                | (settings.showTrayIcon ? ShowTrayIconBit : 0)
+                | (settings.enableLogging ? EnableLoggingBit : 0)
+                | static_cast<uint8_t>(static_cast<uint8_t>(settings.logLevel) << LogLevelShift);
+        }
+
+        uint8_t PackThreading(Settings const& settings) noexcept
+        {
+            uint8_t bits = static_cast<uint8_t>(settings.hookPriority);
+            for (size_t type = 0; type < settings.actionQos.size(); ++type)
+            {
+                bits |= settings.actionQos[type] == QosTier::Background ? static_cast<uint8_t>(4u << type) : 0;
+            }
+            return bits;
+        }
+
+        Settings UnpackSettings(uint8_t bits, uint8_t threading, uint16_t sequenceTimeoutMs) noexcept
+        {
+            Settings settings;
+            settings.sequenceTimeoutMs = sequenceTimeoutMs;
+            settings.startWithWindows = (bits & StartWithWindowsBit) != 0;
+            settings.showTrayIcon = (bits & ShowTrayIconBit) != 0;
+            settings.enableLogging = (bits & EnableLoggingBit) != 0;
+            settings.logLevel = static_cast<LogLevel>(bits >> LogLevelShift);
+            settings.hookPriority = static_cast<HookPriority>(threading & 3);
+            for (size_t type = 0; type < settings.actionQos.size(); ++type)
+            {
+                settings.actionQos[type] = (threading & (4u << type)) != 0 ? QosTier::Background : QosTier::Normal;
+            }
+            return settings;
+        }
+
+        std::vector<std::byte> SerializeImage(LoadedConfiguration const& configuration, HotkeyDispatchTable const& table, SourceStamp stamp)
+        {
+            ActionTable const& actions = configuration.actions;
+            std::span<ActionRecord const> const records = actions.Records();
+            std::span<char const> const strings = actions.StringData();
+
+            CacheHeader header{};
+            header.magic = CacheMagic;
+            header.formatVersion = CacheFormatVersion;
+            header.recordSize = sizeof(ActionRecord);
+            header.sourceHash = configuration.sourceHash;
+            header.sourceSize = stamp.size;
+            header.sourceWriteTime = stamp.writeTime;
+            header.actionCount = actions.Size();
+            header.stringBytes = static_cast<uint32_t>(strings.size());
+            header.versionLength = static_cast<uint32_t>(configuration.version.size());
+            header.settings = PackSettings(configuration.settings);
+            header.threading = PackThreading(configuration.settings);
+            header.sequenceTimeoutMs = static_cast<uint16_t>(configuration.settings.sequenceTimeoutMs);
+
+            std::vector<std::byte> image(sizeof(header) + SlotBytes + records.size_bytes() + strings.size() + configuration.version.size());
+            std::byte* cursor = image.data();
+            auto append = [&](void const* data, size_t size) {
+                if (size != 0)
+                {
+                    std::memcpy(cursor, data, size);
+                    cursor += size;
+                }
+            };
+            append(&header, sizeof(header));
+            append(table.Slots().data(), SlotBytes);
+            append(records.data(), records.size_bytes());
+            append(strings.data(), strings.size());
+            append(configuration.version.data(), configuration.version.size());
+            return image;
+        }
+    }
+
+    std::filesystem::path ConfigurationCache::PathFor(std::filesystem::path const& source)
+    {
+        std::filesystem::path path = source;
+        path += L".cache";
+        return path;
+    }
+
+    std::optional<CachedConfiguration> ConfigurationCache::Load(std::filesystem::path const& source) noexcept
+    {
+        try
+        {
+            SourceStamp const stamp = StampOf(source);
+            if (stamp.writeTime == 0)
+            {
+                return std::nullopt;
+            }
+
+            // Parse() copies everything out, so the mapping closes and
+            // Store() can replace the file.
+            MappedFile const file(PathFor(source));
+            std::span<std::byte const> const bytes = file.Bytes();
+            CacheHeader header;
+            if (bytes.size() < sizeof(header))
+            {
+                return std::nullopt;
+            }
+            std::memcpy(&header, bytes.data(), sizeof(header));
+            if (header.sourceSize != stamp.size || header.sourceWriteTime != stamp.writeTime)
+            {
+                return std::nullopt;
+            }
+            return Parse(bytes);
+        }
+        catch (...)
+        {
+            return std::nullopt;
+        }
+    }
+
+    std::optional<CachedConfiguration> ConfigurationCache::Parse(std::span<std::byte const> bytes) noexcept
+    {
+        try
+        {
+            if (bytes.size() < sizeof(CacheHeader))
+            {
+                return std::nullopt;
+            }
+
+            CacheHeader header;
+            std::memcpy(&header, bytes.data(), sizeof(header));
+            if (header.magic != CacheMagic || header.formatVersion != CacheFormatVersion || header.recordSize != sizeof(ActionRecord)
+                || header.sequenceTimeoutMs < MinSequenceTimeoutMs || header.sequenceTimeoutMs > MaxSequenceTimeoutMs
+                || (header.settings >> LogLevelShift) > static_cast<uint8_t>(LogLevel::Off))
+            {
+                return std::nullopt;
+            }
+
+            size_t const recordBytes = size_t{ header.actionCount } * sizeof(ActionRecord);
+            if (bytes.size() != sizeof(CacheHeader) + SlotBytes + recordBytes + header.stringBytes + header.versionLength)
+            {
+                return std::nullopt;
+            }
+
+            // Views are page aligned and the header keeps the slots 4-byte aligned.
+            std::byte const* cursor = bytes.data() + sizeof(CacheHeader);
+            std::span<uint32_t const, HotkeyDispatchTable::SlotCount> const slots{ reinterpret_cast<uint32_t const*>(cursor), HotkeyDispatchTable::SlotCount };
+            cursor += SlotBytes;
+
+            CachedConfiguration cached;
+            cached.table = HotkeyDispatchTable::FromSlots(slots, header.actionCount);
+            if (!cached.table)
+            {
+                return std::nullopt;
+            }
+
+            for (size_t offset = 0; offset < recordBytes; offset += sizeof(ActionRecord))
+            {
+                if (!HasValidFlags(cursor + offset))
+                {
+                    return std::nullopt;
+                }
+            }
+
+            LoadedConfiguration& config = cached.configuration;
+            config.actions = ActionTable::Allocate(header.actionCount, header.stringBytes);
+            std::memcpy(config.actions.MutableRecords(), cursor, recordBytes);
+            cursor += recordBytes;
+            std::memcpy(config.actions.MutableStrings(), cursor, header.stringBytes);
+            cursor += header.stringBytes;
+            config.version.assign(reinterpret_cast<char const*>(cursor), header.versionLength);
+            config.settings = UnpackSettings(header.settings, header.threading, header.sequenceTimeoutMs);
+            config.sourceHash = header.sourceHash;
+
+            for (ActionRecord const& record : config.actions.Records())
+            {
+                if (!IsValid(record, header.stringBytes))
+                {
+                    return std::nullopt;
+                }
+            }
+            config.actions.IndexIds();
+            return cached;
+        }
+        catch (...)
+        {
+            return std::nullopt;
+        }
+    }
+
+    std::vector<std::byte> ConfigurationCache::Serialize(LoadedConfiguration const& configuration, HotkeyDispatchTable const& table)
+    {
+        return SerializeImage(configuration, table, {});
+    }
+
+    bool ConfigurationCache::Store(std::filesystem::path const& source, LoadedConfiguration const& configuration, HotkeyDispatchTable const& table) noexcept
+    {
+        try
+        {
+            // Stamped after the load: a write in between is stamped with the
+            // old content, but it also wakes the watcher, whose reload stores
+            // again.
+            std::vector<std::byte> const image = SerializeImage(configuration, table, StampOf(source));
+
+            std::filesystem::path const cachePath = PathFor(source);
+            std::filesystem::path temporary = cachePath;
+            temporary += L".tmp";
+
+            bool written;
+            {
+                winrt::file_handle file{ CreateFileW(temporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) };
+                if (!file)
+                {
+                    return false;
+                }
+                DWORD done = 0;
+                written = image.size() <= MAXDWORD && WriteFile(file.get(), image.data(), static_cast<DWORD>(image.size()), &done, nullptr) && done == image.size();
+            }
+
+            if (!written || !MoveFileExW(temporary.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+            {
+                DeleteFileW(temporary.c_str());
+                return false;
+            }
+            return true;
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+}
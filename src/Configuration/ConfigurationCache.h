@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Configuration/Configuration.h"
+#include "Core/HotkeyDispatchTable.h"
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace khm
+{
+    struct CachedConfiguration
+    {
+        LoadedConfiguration configuration;
+        std::unique_ptr<HotkeyDispatchTable> table;
+    };
+
+    // Precompiled image of a loaded configuration (records, string arena and
+    // dispatch table) stored next to the JSON, so a logon start maps one small
+    // file instead of parsing. The image records the source's size and last
+    // write time, which Load() checks, and its Fnv1a64; the caller checks the
+    // JSON against that off the startup path.
+    class ConfigurationCache
+    {
+    public:
+        static std::filesystem::path PathFor(std::filesystem::path const& source);
+
+        // The cache of `source`. nullopt when it is missing, truncated,
+        // inconsistent, was written by a build with a different layout, or
+        // `source` has been written since.
+        static std::optional<CachedConfiguration> Load(std::filesystem::path const& source) noexcept;
+
+        // The same image in memory, for the shared configuration sections:
+        // Parse() validates like Load() and copies out of `bytes`.
+        static std::optional<CachedConfiguration> Parse(std::span<std::byte const> bytes) noexcept;
+        static std::vector<std::byte> Serialize(LoadedConfiguration const& configuration, HotkeyDispatchTable const& table);
+
+        // Best effort: writes a temporary file and renames it over the cache
+        // of `source`, so a reader never sees a partial image.
+        static bool Store(std::filesystem::path const& source, LoadedConfiguration const& configuration, HotkeyDispatchTable const& table) noexcept;
+    };
+}
@@ -0,0 +1,112 @@
+#include "pch.h"
+#include "Configuration/ConfigurationDiff.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace khm
+{
+    namespace
+    {
+        constexpr uint32_t NoSource = UINT32_MAX;
+
+        bool SameAction(ActionTable const& a, ActionRecord const& x, ActionTable const& b, ActionRecord const& y) noexcept
+        {
+            return x.enabled == y.enabled
+                && x.hasHotkey == y.hasHotkey
+                && x.activateIfRunning == y.activateIfRunning
+                && x.maxInFlight == y.maxInFlight
+                && x.coalesce == y.coalesce
+                && x.passThrough == y.passThrough
+                && x.hotkey == y.hotkey
+                && a.String(x.type) == b.String(y.type)
+                && a.String(x.parameter) == b.String(y.parameter)
+                && a.String(x.name) == b.String(y.name)
+                && a.String(x.keyName) == b.String(y.keyName)
+                && a.String(x.sequence) == b.String(y.sequence)
+                && a.String(x.profile) == b.String(y.profile);
+        }
+    }
+
+    bool IsTombstone(ActionRecord const& record) noexcept
+    {
+        return record.id.length == 0;
+    }
+
+    ActionTable AlignToSlots(ActionTable const& current, ActionTable const& next, ConfigurationDiff& diff)
+    {
+        diff = {};
+
+        std::vector<uint32_t> order(current.Size(), NoSource);
+        std::vector<uint32_t> pending;
+        for (uint32_t i = 0; i < next.Size(); ++i)
+        {
+            // A table cloned from a published one carries its tombstones;
+            // their slots come out empty again below, and are not additions.
+            if (IsTombstone(next[i]))
+            {
+                continue;
+            }
+            uint32_t const slot = current.Find(next.String(next[i].id));
+            if (slot == ActionTable::NotFound || order[slot] != NoSource)
+            {
+                pending.push_back(i);
+                continue;
+            }
+            order[slot] = i;
+            ++(SameAction(current, current[slot], next, next[i]) ? diff.unchanged : diff.changed);
+        }
+
+        for (uint32_t slot = 0; slot < current.Size(); ++slot)
+        {
+            if (order[slot] == NoSource && !IsTombstone(current[slot]))
+            {
+                ++diff.removed;
+            }
+        }
+
+        // Only slots that were already tombstones take additions: a slot
+        // removed by this reload may still be named by an event in the hook's
+        // ring or a run pending in the executor, so it stays empty for a
+        // generation.
+        auto const reusable = [&current](size_t slot) { return slot < current.Size() && IsTombstone(current[slot]); };
+
+        diff.added = static_cast<uint32_t>(pending.size());
+        auto nextPending = pending.begin();
+        for (uint32_t slot = 0; slot < order.size() && nextPending != pending.end(); ++slot)
+        {
+            if (order[slot] == NoSource && reusable(slot))
+            {
+                order[slot] = *nextPending++;
+            }
+        }
+        order.insert(order.end(), nextPending, pending.end());
+
+        // Keep trailing tombstones from growing the table forever; the ones
+        // this reload created go on the next.
+        while (!order.empty() && order.back() == NoSource && reusable(order.size() - 1))
+        {
+            order.pop_back();
+        }
+
+        std::span<char const> const strings = next.StringData();
+        ActionTable aligned = ActionTable::Allocate(static_cast<uint32_t>(order.size()), static_cast<uint32_t>(strings.size()));
+        std::memcpy(aligned.MutableStrings(), strings.data(), strings.size());
+
+        ActionRecord* const records = aligned.MutableRecords();
+        for (size_t slot = 0; slot < order.size(); ++slot)
+        {
+            if (order[slot] == NoSource)
+            {
+                records[slot] = ActionRecord{};
+                records[slot].enabled = false;
+            }
+            else
+            {
+                records[slot] = next[order[slot]];
+            }
+        }
+        aligned.IndexIds();
+        return aligned;
+    }
+}
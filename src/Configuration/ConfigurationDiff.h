@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Configuration/ActionTable.h"
+
+#include <cstdint>
+
+namespace khm
+{
+    struct ConfigurationDiff
+    {
+        uint32_t added = 0;
+        uint32_t removed = 0;
+        uint32_t changed = 0;
+        uint32_t unchanged = 0;
+
+        bool Empty() const noexcept { return added == 0 && removed == 0 && changed == 0; }
+    };
+
+    // Reorders a freshly loaded table so that every id keeps the slot it had
+    // in `current`. Removed ids leave a disabled tombstone in their slot,
+    // which only the additions of a later reload may reuse, so an action
+    // index captured by the hook before a reload still names the same
+    // action, or none, after it.
+    ActionTable AlignToSlots(ActionTable const& current, ActionTable const& next, ConfigurationDiff& diff);
+
+    bool IsTombstone(ActionRecord const& record) noexcept;
+}
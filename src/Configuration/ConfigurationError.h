@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdexcept>
+
+namespace khm
+{
+    class ConfigurationError : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+}
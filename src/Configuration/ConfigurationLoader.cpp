@@ -0,0 +1,802 @@
+#include "pch.h"
+#include "Configuration/ConfigurationLoader.h"
+
+#include "Configuration/ConfigParser.h"
+#include "Utils/Hash.h"
+#include "Utils/MappedFile.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace winrt::Windows::Data::Json;
+
+namespace khm
+{
+    namespace
+    {
+        std::string Narrow(winrt::hstring const& text)
+        {
+            return winrt::to_string(text);
+        }
+
+        [[noreturn]] void Fail(std::string const& message)
+        {
+            throw ConfigurationError(message);
+        }
+
+        MappedFile MapConfiguration(std::filesystem::path const& path)
+        {
+            try
+            {
+                return MappedFile(path);
+            }
+            catch (winrt::hresult_error const& e)
+            {
+                Fail("cannot open configuration file '" + path.string() + "': " + Narrow(e.message()));
+            }
+        }
+
+        template <ConfigFieldSink Sink>
+        void ParseConfig(std::string_view text, ConfigFormat format, Sink& sink)
+        {
+            if (format == ConfigFormat::Yaml)
+            {
+                ParseConfigYaml(text, sink);
+            }
+            else
+            {
+                ParseConfigJson(text, sink);
+            }
+        }
+
+        constexpr char HookPriorityError[] = "settings.hookPriority must be timeCritical, highest, aboveNormal or normal";
+        constexpr char LogLevelError[] = "settings.logLevel must be debug, info, warning, error or off";
+        constexpr char ActionQosError[] = "settings.actionQos values must be normal or background";
+
+        // Index of `value` in `names`, the config spellings of an enum.
+        template <size_t N>
+        uint8_t EnumValue(std::string_view value, std::string_view const (&names)[N], char const* message)
+        {
+            for (size_t i = 0; i < N; ++i)
+            {
+                if (names[i] == value)
+                {
+                    return static_cast<uint8_t>(i);
+                }
+            }
+            Fail(message);
+        }
+
+        bool GetBool(JsonObject const& object, wchar_t const* name, bool fallback)
+        {
+            return object.HasKey(name) ? object.GetNamedBoolean(name) : fallback;
+        }
+
+        std::wstring GetString(JsonObject const& object, wchar_t const* name)
+        {
+            return object.HasKey(name) ? std::wstring{ object.GetNamedString(name) } : std::wstring{};
+        }
+
+        HotkeyDefinition ParseHotkey(JsonObject const& object, std::wstring const& actionId)
+        {
+            HotkeyDefinition hotkey;
+            hotkey.win = GetBool(object, L"win", false);
+            hotkey.ctrl = GetBool(object, L"ctrl", false);
+            hotkey.shift = GetBool(object, L"shift", false);
+            hotkey.alt = GetBool(object, L"alt", false);
+            hotkey.keyName = GetString(object, L"keyName");
+
+            double const key = object.GetNamedNumber(L"key", 0.0);
+            if (key < 1.0 || key > 254.0 || key != static_cast<double>(static_cast<uint32_t>(key)))
+            {
+                Fail("action '" + Narrow(winrt::hstring{ actionId }) + "': hotkey.key must be a virtual key code in 1..254");
+            }
+            hotkey.key = static_cast<uint32_t>(key);
+
+            if (IsModifierKey(static_cast<uint8_t>(hotkey.key)))
+            {
+                Fail("action '" + Narrow(winrt::hstring{ actionId }) + "': hotkey.key cannot be a modifier key");
+            }
+            return hotkey;
+        }
+
+        ActionDefinition ParseAction(JsonObject const& object)
+        {
+            ActionDefinition action;
+            action.id = GetString(object, L"id");
+            if (action.id.empty())
+            {
+                Fail("action is missing an 'id'");
+            }
+            action.name = GetString(object, L"name");
+            action.enabled = GetBool(object, L"enabled", true);
+            action.type = GetString(object, L"type");
+            action.parameter = GetString(object, L"parameter");
+            action.profile = GetString(object, L"profile");
+            action.activateIfRunning = GetBool(object, L"activateIfRunning", false);
+            action.coalesce = GetBool(object, L"coalesce", true);
+            action.passThrough = GetBool(object, L"passThrough", false);
+            double const maxInFlight = object.GetNamedNumber(L"maxInFlight", 1.0);
+            if (maxInFlight < 1.0 || maxInFlight > MaxActionInFlight || maxInFlight != static_cast<double>(static_cast<uint32_t>(maxInFlight)))
+            {
+                Fail("action '" + Narrow(winrt::hstring{ action.id }) + "': maxInFlight must be in 1..16");
+            }
+            action.maxInFlight = static_cast<uint32_t>(maxInFlight);
+            if (object.HasKey(L"hotkey"))
+            {
+                action.hotkey = ParseHotkey(object.GetNamedObject(L"hotkey"), action.id);
+            }
+            if (object.HasKey(L"sequence"))
+            {
+                for (IJsonValue const& step : object.GetNamedArray(L"sequence"))
+                {
+                    action.sequence.push_back(ParseHotkey(step.GetObject(), action.id));
+                }
+                if (action.sequence.size() < MinSequenceLength || action.sequence.size() > MaxSequenceLength)
+                {
+                    Fail("action '" + Narrow(winrt::hstring{ action.id }) + "': sequence must have 2..8 steps");
+                }
+                if (!action.profile.empty())
+                {
+                    Fail("action '" + Narrow(winrt::hstring{ action.id }) + "': a 'profile' only applies to a hotkey, not a sequence");
+                }
+            }
+            return action;
+        }
+
+        // The per-action checks of the streaming loaders: what the schema
+        // cannot express (required fields, step counts) is checked when an
+        // action ends. Actions are numbered from 1 in error messages.
+        class ActionChecks
+        {
+        public:
+            uint32_t actionCount = 0;
+
+            void BeginAction() noexcept
+            {
+                ++actionCount;
+                m_sawId = false;
+                m_hotkeyWithoutKey = false;
+                m_sequenceSteps = -1;
+                m_sawProfile = false;
+            }
+
+            void EndAction()
+            {
+                if (!m_sawId)
+                {
+                    Fail("action #" + std::to_string(actionCount) + " is missing an 'id'");
+                }
+                if (m_hotkeyWithoutKey)
+                {
+                    Fail("action #" + std::to_string(actionCount) + ": hotkey is missing 'key'");
+                }
+                if (m_sequenceSteps >= 0 && (m_sequenceSteps < static_cast<int>(MinSequenceLength) || m_sequenceSteps > static_cast<int>(MaxSequenceLength)))
+                {
+                    Fail("action #" + std::to_string(actionCount) + ": sequence must have 2..8 steps");
+                }
+                if (m_sequenceSteps >= 0 && m_sawProfile)
+                {
+                    Fail("action #" + std::to_string(actionCount) + ": a 'profile' only applies to a hotkey, not a sequence");
+                }
+            }
+
+            void BeginHotkey() noexcept
+            {
+                m_hotkeyWithoutKey = true;
+            }
+
+            void BeginSequence() noexcept
+            {
+                m_sequenceSteps = 0;
+            }
+
+            void BeginStep() noexcept
+            {
+                ++m_sequenceSteps;
+                m_stepWithoutKey = true;
+            }
+
+            void EndStep()
+            {
+                if (m_stepWithoutKey)
+                {
+                    Fail("action #" + std::to_string(actionCount) + ": sequence step is missing 'key'");
+                }
+            }
+
+            // Action-scope strings only.
+            void OnString(ConfigKey key, size_t length) noexcept
+            {
+                if (key == ConfigKey::Id)
+                {
+                    m_sawId = length != 0;
+                }
+                else if (key == ConfigKey::Profile)
+                {
+                    m_sawProfile = length != 0;
+                }
+            }
+
+            void OnUInt(ConfigScope scope, ConfigKey key) noexcept
+            {
+                if (scope == ConfigScope::Hotkey && key == ConfigKey::Key)
+                {
+                    m_hotkeyWithoutKey = false;
+                }
+                else if (scope == ConfigScope::SequenceStep && key == ConfigKey::Key)
+                {
+                    m_stepWithoutKey = false;
+                }
+            }
+
+        private:
+            bool m_sawId = false;
+            bool m_hotkeyWithoutKey = false;
+            bool m_stepWithoutKey = false;
+            int m_sequenceSteps = -1; // -1: no "sequence" in this action
+            bool m_sawProfile = false;
+        };
+
+        // Settings fields are the same for every streaming sink. Returns
+        // false for fields outside the settings object.
+        bool ApplySetting(Settings& settings, ConfigKey key, bool value) noexcept
+        {
+            switch (key)
+            {
+            case ConfigKey::StartWithWindows: settings.startWithWindows = value; return true;
+            case ConfigKey::ShowTrayIcon: settings.showTrayIcon = value; return true;
+            case ConfigKey::EnableLogging: settings.enableLogging = value; return true;
+            default: return false;
+            }
+        }
+
+        bool ApplySetting(Settings& settings, ConfigScope scope, ConfigKey key, ScalarText const& text)
+        {
+            if (scope != ConfigScope::Settings && scope != ConfigScope::ActionQos)
+            {
+                return false;
+            }
+            // Every valid value is a short word.
+            char buffer[16];
+            std::string_view const value = text.DecodedLength() <= sizeof(buffer) ? std::string_view(buffer, text.Decode(buffer)) : std::string_view{};
+            if (scope == ConfigScope::Settings && key == ConfigKey::LogLevel)
+            {
+                settings.logLevel = static_cast<LogLevel>(EnumValue(value, LogLevelNames, LogLevelError));
+                return true;
+            }
+            if (scope == ConfigScope::Settings)
+            {
+                settings.hookPriority = static_cast<HookPriority>(EnumValue(value, HookPriorityNames, HookPriorityError));
+                return true;
+            }
+            ActionType const type = key == ConfigKey::LaunchApp ? ActionType::LaunchApp
+                : key == ConfigKey::WindowsAction ? ActionType::WindowsAction
+                : key == ConfigKey::TypeText ? ActionType::TypeText
+                : ActionType::SendKeys;
+            settings.actionQos[static_cast<size_t>(type)] = static_cast<QosTier>(EnumValue(value, QosTierNames, ActionQosError));
+            return true;
+        }
+
+        // Streaming pass 1: validates, captures settings and sizes the table.
+        class MeasuringSink
+        {
+        public:
+            explicit MeasuringSink(LoadedConfiguration& target) noexcept :
+                config(target)
+            {
+            }
+
+            LoadedConfiguration& config;
+            ActionChecks checks;
+            uint64_t stringBytes = 0;
+
+            void BeginAction() noexcept { checks.BeginAction(); }
+            void EndAction() { checks.EndAction(); }
+            void BeginHotkey() noexcept { checks.BeginHotkey(); }
+            void BeginSequence() noexcept { checks.BeginSequence(); }
+            void EndStep() { checks.EndStep(); }
+
+            void BeginStep() noexcept
+            {
+                checks.BeginStep();
+                stringBytes += 2;
+            }
+
+            void OnString(ConfigScope scope, ConfigKey key, ScalarText const& text)
+            {
+                size_t const length = text.DecodedLength();
+                if (scope == ConfigScope::Root)
+                {
+                    config.version.resize(length);
+                    text.Decode(config.version.data());
+                    return;
+                }
+                // The table keeps no step names; only StreamActions reads them.
+                if (ApplySetting(config.settings, scope, key, text) || scope == ConfigScope::SequenceStep)
+                {
+                    return;
+                }
+                if (scope == ConfigScope::Action)
+                {
+                    checks.OnString(key, length);
+                }
+                stringBytes += length;
+            }
+
+            void OnBool(ConfigScope scope, ConfigKey key, bool value) noexcept
+            {
+                if (scope == ConfigScope::Settings)
+                {
+                    ApplySetting(config.settings, key, value);
+                }
+            }
+
+            void OnUInt(ConfigScope scope, ConfigKey key, uint32_t value) noexcept
+            {
+                checks.OnUInt(scope, key);
+                if (scope == ConfigScope::Settings && key == ConfigKey::SequenceTimeoutMs)
+                {
+                    config.settings.sequenceTimeoutMs = value;
+                }
+            }
+        };
+
+        // Hands each action to a callback as soon as it ends, reusing one
+        // StreamedAction, so nothing grows with the number of actions.
+        class StreamingSink
+        {
+        public:
+            StreamingSink(StreamedConfiguration& header, ConfigurationLoader::ActionCallback const& onAction) noexcept :
+                m_header(header),
+                m_onAction(onAction)
+            {
+            }
+
+            void BeginAction() noexcept
+            {
+                m_checks.BeginAction();
+                m_action.Reset();
+            }
+
+            void EndAction()
+            {
+                m_checks.EndAction();
+                ++m_header.actionCount;
+                m_onAction(m_action);
+            }
+
+            void BeginHotkey() noexcept
+            {
+                m_checks.BeginHotkey();
+                m_action.hasHotkey = true;
+            }
+
+            void BeginSequence() noexcept { m_checks.BeginSequence(); }
+            void EndStep() { m_checks.EndStep(); }
+
+            void BeginStep()
+            {
+                m_checks.BeginStep();
+                m_action.sequence.push_back({});
+                m_action.sequenceKeyNames.emplace_back();
+            }
+
+            void OnString(ConfigScope scope, ConfigKey key, ScalarText const& text)
+            {
+                if (ApplySetting(m_header.settings, scope, key, text))
+                {
+                    m_header.hasSettings = true;
+                    return;
+                }
+                std::string* const target = scope == ConfigScope::Root ? &m_header.version
+                    : key == ConfigKey::Id ? &m_action.id
+                    : key == ConfigKey::Name ? &m_action.name
+                    : key == ConfigKey::Type ? &m_action.type
+                    : key == ConfigKey::Parameter ? &m_action.parameter
+                    : key == ConfigKey::Profile ? &m_action.profile
+                    : key != ConfigKey::KeyName ? nullptr
+                    : scope == ConfigScope::SequenceStep ? &m_action.sequenceKeyNames.back()
+                    : &m_action.keyName;
+                if (target == nullptr)
+                {
+                    return;
+                }
+                target->resize(text.DecodedLength());
+                text.Decode(target->data());
+                if (scope == ConfigScope::Action)
+                {
+                    m_checks.OnString(key, target->size());
+                }
+            }
+
+            void OnBool(ConfigScope scope, ConfigKey key, bool value) noexcept
+            {
+                if (scope == ConfigScope::Settings)
+                {
+                    m_header.hasSettings |= ApplySetting(m_header.settings, key, value);
+                }
+                else if (scope == ConfigScope::Action)
+                {
+                    switch (key)
+                    {
+                    case ConfigKey::Enabled: m_action.enabled = value; break;
+                    case ConfigKey::ActivateIfRunning: m_action.activateIfRunning = value; break;
+                    case ConfigKey::Coalesce: m_action.coalesce = value; break;
+                    case ConfigKey::PassThrough: m_action.passThrough = value; break;
+                    default: break;
+                    }
+                }
+                else
+                {
+                    uint8_t const bit = key == ConfigKey::Win ? ModWin
+                        : key == ConfigKey::Ctrl ? ModCtrl
+                        : key == ConfigKey::Shift ? ModShift
+                        : key == ConfigKey::Alt ? ModAlt
+                        : ModNone;
+                    uint8_t& modifiers = scope == ConfigScope::Hotkey ? m_action.hotkey.modifiers : m_action.sequence.back().modifiers;
+                    modifiers = value ? (modifiers | bit) : (modifiers & ~bit);
+                }
+            }
+
+            void OnUInt(ConfigScope scope, ConfigKey key, uint32_t value) noexcept
+            {
+                m_checks.OnUInt(scope, key);
+                if (scope == ConfigScope::Hotkey && key == ConfigKey::Key)
+                {
+                    m_action.hotkey.key = static_cast<uint8_t>(value);
+                }
+                else if (scope == ConfigScope::SequenceStep && key == ConfigKey::Key)
+                {
+                    m_action.sequence.back().key = static_cast<uint8_t>(value);
+                }
+                else if (scope == ConfigScope::Action && key == ConfigKey::MaxInFlight)
+                {
+                    m_action.maxInFlight = value;
+                }
+                else if (scope == ConfigScope::Settings && key == ConfigKey::SequenceTimeoutMs)
+                {
+                    m_header.settings.sequenceTimeoutMs = value;
+                    m_header.hasSettings = true;
+                }
+            }
+
+        private:
+            StreamedConfiguration& m_header;
+            ConfigurationLoader::ActionCallback const& m_onAction;
+            ActionChecks m_checks;
+            StreamedAction m_action;
+        };
+
+        // Streaming pass 2: writes records and strings into the table. Short
+        // repeated values (type, keyName, ...) are stored once. The table is
+        // sized by pass 1; a mapped file is shared for writing and may have
+        // grown since, so every write is checked against that size.
+        class ArenaSink
+        {
+        public:
+            explicit ArenaSink(ActionTable& table) noexcept :
+                m_table(table)
+            {
+            }
+
+            void BeginAction()
+            {
+                if (m_next == m_table.Size())
+                {
+                    Changed();
+                }
+                m_current = &m_table.MutableRecords()[m_next++];
+            }
+
+            // After the pass: a file that shrank leaves records unwritten.
+            void Finish() const
+            {
+                if (m_next != m_table.Size())
+                {
+                    Changed();
+                }
+            }
+
+            void EndAction() noexcept {}
+
+            void BeginHotkey() noexcept
+            {
+                m_current->hasHotkey = true;
+                m_current->fields |= HotkeyField;
+            }
+
+            // Steps only carry bools and numbers, so nothing is interned
+            // between them and the pairs stay contiguous.
+            void BeginSequence() noexcept
+            {
+                m_current->sequence = StringRef{ m_used, 0 };
+                m_current->fields |= SequenceField;
+            }
+
+            void BeginStep()
+            {
+                Reserve(2);
+                char* const pair = m_table.MutableStrings() + m_used;
+                pair[0] = pair[1] = 0;
+                m_used += 2;
+                m_current->sequence.length += 2;
+            }
+
+            void EndStep() noexcept {}
+
+            void OnString(ConfigScope scope, ConfigKey key, ScalarText const& text)
+            {
+                // Pass 1 took the version and settings, and sized the arena without them.
+                if (scope != ConfigScope::Action && scope != ConfigScope::Hotkey)
+                {
+                    return;
+                }
+                StringRef const ref = Intern(text);
+                switch (key)
+                {
+                case ConfigKey::Id: m_current->id = ref; break;
+                case ConfigKey::Name: m_current->name = ref; m_current->fields |= NameField; break;
+                case ConfigKey::Type: m_current->type = ref; m_current->fields |= TypeField; break;
+                case ConfigKey::Parameter: m_current->parameter = ref; m_current->fields |= ParameterField; break;
+                case ConfigKey::KeyName: m_current->keyName = ref; break;
+                case ConfigKey::Profile: m_current->profile = ref; m_current->fields |= ProfileField; break;
+                default: break;
+                }
+            }
+
+            void OnBool(ConfigScope scope, ConfigKey key, bool value) noexcept
+            {
+                if (scope == ConfigScope::Action && key == ConfigKey::Enabled)
+                {
+                    m_current->enabled = value;
+                    m_current->fields |= EnabledField;
+                }
+                else if (scope == ConfigScope::Action && key == ConfigKey::ActivateIfRunning)
+                {
+                    m_current->activateIfRunning = value;
+                    m_current->fields |= ActivateIfRunningField;
+                }
+                else if (scope == ConfigScope::Action && key == ConfigKey::Coalesce)
+                {
+                    m_current->coalesce = value;
+                    m_current->fields |= CoalesceField;
+                }
+                else if (scope == ConfigScope::Action && key == ConfigKey::PassThrough)
+                {
+                    m_current->passThrough = value;
+                    m_current->fields |= PassThroughField;
+                }
+                else if (scope == ConfigScope::Hotkey || scope == ConfigScope::SequenceStep)
+                {
+                    uint8_t const bit = key == ConfigKey::Win ? ModWin
+                        : key == ConfigKey::Ctrl ? ModCtrl
+                        : key == ConfigKey::Shift ? ModShift
+                        : key == ConfigKey::Alt ? ModAlt
+                        : ModNone;
+                    uint8_t& modifiers = scope == ConfigScope::Hotkey ? m_current->hotkey.modifiers : StepBytes()[0];
+                    modifiers = value ? (modifiers | bit) : (modifiers & ~bit);
+                }
+            }
+
+            void OnUInt(ConfigScope scope, ConfigKey key, uint32_t value) noexcept
+            {
+                if (scope == ConfigScope::Hotkey && key == ConfigKey::Key)
+                {
+                    m_current->hotkey.key = static_cast<uint8_t>(value);
+                }
+                else if (scope == ConfigScope::SequenceStep && key == ConfigKey::Key)
+                {
+                    StepBytes()[1] = static_cast<uint8_t>(value);
+                }
+                else if (scope == ConfigScope::Action && key == ConfigKey::MaxInFlight)
+                {
+                    m_current->maxInFlight = static_cast<uint8_t>(value);
+                    m_current->fields |= MaxInFlightField;
+                }
+            }
+
+        private:
+            static constexpr uint32_t DedupSlots = 4096;
+            static constexpr size_t DedupMaxLength = 64;
+
+            [[noreturn]] static void Changed()
+            {
+                Fail("configuration file changed while it was being read");
+            }
+
+            void Reserve(size_t bytes) const
+            {
+                if (bytes > m_table.StringCapacity() - m_used)
+                {
+                    Changed();
+                }
+            }
+
+            // (modifiers, vk) of the step being parsed.
+            uint8_t* StepBytes() noexcept
+            {
+                return reinterpret_cast<uint8_t*>(m_table.MutableStrings() + m_used - 2);
+            }
+
+            StringRef Intern(ScalarText const& text)
+            {
+                Reserve(text.DecodedLength());
+                char* const arena = m_table.MutableStrings();
+                StringRef ref{ m_used, static_cast<uint32_t>(text.Decode(arena + m_used)) };
+                if (ref.length == 0 || ref.length > DedupMaxLength)
+                {
+                    m_used += ref.length;
+                    return ref;
+                }
+
+                std::string_view const value(arena + ref.offset, ref.length);
+                uint32_t hash = 2166136261u;
+                for (char c : value)
+                {
+                    hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+                }
+                for (uint32_t probe = 0; probe < 8; ++probe)
+                {
+                    StringRef& slot = m_dedup[(hash + probe) & (DedupSlots - 1)];
+                    if (slot.length == 0)
+                    {
+                        slot = ref;
+                        break;
+                    }
+                    if (m_table.String(slot) == value)
+                    {
+                        return slot; // drop the copy we just decoded
+                    }
+                }
+                m_used += ref.length;
+                return ref;
+            }
+
+            ActionTable& m_table;
+            ActionRecord* m_current = nullptr;
+            uint32_t m_next = 0;
+            uint32_t m_used = 0;
+            std::array<StringRef, DedupSlots> m_dedup{};
+        };
+    }
+
+    Configuration ConfigurationLoader::LoadFromFile(std::filesystem::path const& path)
+    {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream)
+        {
+            Fail("cannot open configuration file '" + path.string() + "'");
+        }
+        std::ostringstream buffer;
+        buffer << stream.rdbuf();
+        return Parse(winrt::to_hstring(buffer.str()));
+    }
+
+    Configuration ConfigurationLoader::Parse(std::wstring_view json)
+    {
+        JsonObject root{ nullptr };
+        if (!JsonObject::TryParse(winrt::hstring{ json }, root))
+        {
+            Fail("configuration is not valid JSON");
+        }
+
+        Configuration config;
+        try
+        {
+            config.version = GetString(root, L"version");
+
+            if (root.HasKey(L"settings"))
+            {
+                JsonObject const settings = root.GetNamedObject(L"settings");
+                config.settings.startWithWindows = GetBool(settings, L"startWithWindows", config.settings.startWithWindows);
+                config.settings.showTrayIcon = GetBool(settings, L"showTrayIcon", config.settings.showTrayIcon);
+                config.settings.enableLogging = GetBool(settings, L"enableLogging", config.settings.enableLogging);
+                double const timeout = settings.GetNamedNumber(L"sequenceTimeoutMs", config.settings.sequenceTimeoutMs);
+                // Whole milliseconds only, as the streaming loaders accept.
+                if (timeout < MinSequenceTimeoutMs || timeout > MaxSequenceTimeoutMs || timeout != static_cast<double>(static_cast<uint32_t>(timeout)))
+                {
+                    Fail("settings.sequenceTimeoutMs must be in 100..10000");
+                }
+                config.settings.sequenceTimeoutMs = static_cast<uint32_t>(timeout);
+                if (settings.HasKey(L"hookPriority"))
+                {
+                    config.settings.hookPriority = static_cast<HookPriority>(EnumValue(Narrow(settings.GetNamedString(L"hookPriority")), HookPriorityNames, HookPriorityError));
+                }
+                if (settings.HasKey(L"logLevel"))
+                {
+                    config.settings.logLevel = static_cast<LogLevel>(EnumValue(Narrow(settings.GetNamedString(L"logLevel")), LogLevelNames, LogLevelError));
+                }
+                if (settings.HasKey(L"actionQos"))
+                {
+                    JsonObject const qos = settings.GetNamedObject(L"actionQos");
+                    for (size_t type = 0; type < std::size(ActionTypeNames); ++type)
+                    {
+                        winrt::hstring const name = winrt::to_hstring(ActionTypeNames[type]);
+                        if (qos.HasKey(name))
+                        {
+                            config.settings.actionQos[type] = static_cast<QosTier>(EnumValue(Narrow(qos.GetNamedString(name)), QosTierNames, ActionQosError));
+                        }
+                    }
+                }
+            }
+
+            if (root.HasKey(L"actions"))
+            {
+                JsonArray const actions = root.GetNamedArray(L"actions");
+                config.actions.reserve(actions.Size());
+                for (IJsonValue const& value : actions)
+                {
+                    config.actions.push_back(ParseAction(value.GetObject()));
+                }
+            }
+        }
+        catch (winrt::hresult_error const& e)
+        {
+            // Type mismatches (e.g. "key": "N") surface as hresult errors.
+            Fail("configuration schema error: " + Narrow(e.message()));
+        }
+        return config;
+    }
+
+    LoadedConfiguration ConfigurationLoader::LoadStreaming(std::filesystem::path const& path)
+    {
+        MappedFile const file = MapConfiguration(path);
+        return ParseStreaming(file.Text(), FormatOf(path));
+    }
+
+    std::optional<LoadedConfiguration> ConfigurationLoader::LoadIfChanged(std::filesystem::path const& path, uint64_t knownHash)
+    {
+        MappedFile const file = MapConfiguration(path);
+        if (Fnv1a64(file.Bytes()) == knownHash)
+        {
+            return std::nullopt;
+        }
+        return ParseStreaming(file.Text(), FormatOf(path));
+    }
+
+    StreamedConfiguration ConfigurationLoader::StreamActions(std::filesystem::path const& path, ActionCallback const& onAction)
+    {
+        MappedFile const file = MapConfiguration(path);
+        return StreamActions(file.Text(), onAction, FormatOf(path));
+    }
+
+    StreamedConfiguration ConfigurationLoader::StreamActions(std::string_view utf8, ActionCallback const& onAction, ConfigFormat format)
+    {
+        StreamedConfiguration header;
+        StreamingSink sink{ header, onAction };
+        ParseConfig(utf8, format, sink);
+        return header;
+    }
+
+    ConfigFormat ConfigurationLoader::FormatOf(std::filesystem::path const& path) noexcept
+    {
+        std::wstring const name = path.wstring();
+        auto endsWith = [&name](std::wstring_view extension) {
+            return name.size() >= extension.size()
+                && CompareStringOrdinal(name.data() + name.size() - extension.size(), static_cast<int>(extension.size()),
+                       extension.data(), static_cast<int>(extension.size()), TRUE) == CSTR_EQUAL;
+        };
+        return endsWith(L".yaml") || endsWith(L".yml") ? ConfigFormat::Yaml : ConfigFormat::Json;
+    }
+
+    LoadedConfiguration ConfigurationLoader::ParseStreaming(std::string_view utf8, ConfigFormat format)
+    {
+        LoadedConfiguration config;
+
+        MeasuringSink measure{ config };
+        ParseConfig(utf8, format, measure);
+        if (measure.stringBytes > UINT32_MAX)
+        {
+            Fail("configuration strings exceed 4 GB");
+        }
+
+        config.actions = ActionTable::Allocate(measure.checks.actionCount, static_cast<uint32_t>(measure.stringBytes));
+        ArenaSink write{ config.actions };
+        ParseConfig(utf8, format, write);
+        write.Finish();
+        config.actions.IndexIds();
+        config.sourceHash = Fnv1a64(std::as_bytes(std::span{ utf8 }));
+        return config;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Configuration/Configuration.h"
+#include "Configuration/ConfigurationError.h"
+
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string_view>
+
+namespace khm
+{
+    enum class ConfigFormat : uint8_t
+    {
+        Json,
+        Yaml,
+    };
+
+    // Loads and validates the configuration. Throws ConfigurationError for
+    // missing files, malformed JSON or YAML and invalid hotkeys.
+    class ConfigurationLoader
+    {
+    public:
+        // DOM mode; JSON only.
+        static Configuration LoadFromFile(std::filesystem::path const& path);
+        static Configuration Parse(std::wstring_view json);
+
+        // Streaming (SAX) mode for large generated configs: the file is
+        // memory-mapped and parsed twice without building a DOM, once to size
+        // the table and once to fill it, so each load makes one allocation.
+        // Both formats feed the same sinks; strings stay views into the
+        // mapping until they are copied into the table. The path overloads
+        // pick the format with FormatOf().
+        static LoadedConfiguration LoadStreaming(std::filesystem::path const& path);
+        static LoadedConfiguration ParseStreaming(std::string_view utf8, ConfigFormat format = ConfigFormat::Json);
+
+        // Hashes the file first and only parses it when the hash differs from
+        // `knownHash`; returns nullopt for an unchanged file.
+        static std::optional<LoadedConfiguration> LoadIfChanged(std::filesystem::path const& path, uint64_t knownHash);
+
+        // Single-pass mode for tools that only look at each action once
+        // (import/merge/export): actions are validated like LoadStreaming and
+        // handed to `onAction` as they end, so memory does not grow with the
+        // size of the file. Exceptions from `onAction` abort the parse.
+        using ActionCallback = std::function<void(StreamedAction const&)>;
+        static StreamedConfiguration StreamActions(std::filesystem::path const& path, ActionCallback const& onAction);
+        static StreamedConfiguration StreamActions(std::string_view utf8, ActionCallback const& onAction, ConfigFormat format = ConfigFormat::Json);
+
+        // YAML for ".yaml" and ".yml", JSON otherwise.
+        static ConfigFormat FormatOf(std::filesystem::path const& path) noexcept;
+    };
+}
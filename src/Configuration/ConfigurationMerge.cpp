@@ -0,0 +1,195 @@
+#include "pch.h"
+#include "Configuration/ConfigurationMerge.h"
+
+#include "Configuration/ConfigurationLoader.h"
+#include "Configuration/ConfigurationWriter.h"
+#include "Core/DispatchSnapshot.h"
+
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_set>
+
+namespace khm
+{
+    namespace
+    {
+        // Hash-set keys for triggers: a tag, then for chords the scope, then
+        // the (modifiers, vk) byte pair of every step.
+        enum TriggerTag : char
+        {
+            ChordTag = 'C',
+            SequenceTag = 'S',
+            PrefixTag = 'P', // every proper prefix of a bound sequence
+        };
+
+        class TriggerSet
+        {
+        public:
+            // Binds the action's triggers, a hotkey and a sequence can both be
+            // set, unless either collides; true when bound. Nothing is bound
+            // for an action that collides.
+            bool Bind(StreamedAction const& action)
+            {
+                std::string const scope = action.hasHotkey ? Scope(action.profile) : std::string{};
+                if (action.hasHotkey && !CanBindChord(scope, action.hotkey))
+                {
+                    return false;
+                }
+                if (!action.sequence.empty())
+                {
+                    // Its own hotkey counts: the dispatcher would have the
+                    // chord and the sequence's first step collide as well.
+                    if (!CanBindSequence(action.sequence)
+                        || (action.hasHotkey && scope.empty() && action.hotkey.Index() == action.sequence.front().Index()))
+                    {
+                        return false;
+                    }
+                    BindSequence(action.sequence);
+                }
+                if (action.hasHotkey)
+                {
+                    m_bound.insert(ChordKey(scope, action.hotkey));
+                }
+                return true;
+            }
+
+        private:
+            // Folded the way DispatchSnapshot matches profiles.
+            static std::string Scope(std::string const& profile)
+            {
+                return profile.empty() ? std::string{} : winrt::to_string(DispatchSnapshot::ProfileKey(winrt::to_hstring(profile)));
+            }
+
+            bool CanBindChord(std::string const& scope, Hotkey hotkey) const
+            {
+                if (m_bound.contains(ChordKey(scope, hotkey)))
+                {
+                    return false;
+                }
+                return !scope.empty() || !m_bound.contains(StepsKey(PrefixTag, { &hotkey, 1 })); // the first step of a sequence
+            }
+
+            bool CanBindSequence(std::span<Hotkey const> steps) const
+            {
+                if (m_bound.contains(StepsKey(SequenceTag, steps))
+                    || m_bound.contains(StepsKey(PrefixTag, steps))
+                    || m_bound.contains(ChordKey({}, steps.front())))
+                {
+                    return false;
+                }
+                for (size_t length = 1; length < steps.size(); ++length)
+                {
+                    if (m_bound.contains(StepsKey(SequenceTag, steps.first(length))))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            void BindSequence(std::span<Hotkey const> steps)
+            {
+                m_bound.insert(StepsKey(SequenceTag, steps));
+                for (size_t length = 1; length < steps.size(); ++length)
+                {
+                    m_bound.insert(StepsKey(PrefixTag, steps.first(length)));
+                }
+            }
+
+            static void AppendStep(std::string& key, Hotkey step)
+            {
+                key += static_cast<char>(step.modifiers & 0x0F);
+                key += static_cast<char>(step.key);
+            }
+
+            static std::string ChordKey(std::string_view scope, Hotkey hotkey)
+            {
+                std::string key(1, ChordTag);
+                key += scope;
+                key += '\0';
+                AppendStep(key, hotkey);
+                return key;
+            }
+
+            static std::string StepsKey(TriggerTag tag, std::span<Hotkey const> steps)
+            {
+                std::string key(1, tag);
+                for (Hotkey step : steps)
+                {
+                    AppendStep(key, step);
+                }
+                return key;
+            }
+
+            std::unordered_set<std::string> m_bound;
+        };
+    }
+
+    MergeReport ConfigurationMerge::Merge(std::span<std::filesystem::path const> inputs, std::filesystem::path const& output,
+        MergeCollisions collisions)
+    {
+        try
+        {
+            return MergeInto(inputs, output, collisions);
+        }
+        catch (winrt::hresult_error const& e)
+        {
+            throw ConfigurationError("cannot write configuration file '" + output.string() + "': " + winrt::to_string(e.message()));
+        }
+    }
+
+    MergeReport ConfigurationMerge::MergeInto(std::span<std::filesystem::path const> inputs, std::filesystem::path const& output,
+        MergeCollisions collisions)
+    {
+        MergeReport report;
+        ConfigurationWriter writer(output);
+        std::unordered_set<std::string> ids;
+        TriggerSet triggers;
+        std::optional<std::string> version;
+        std::optional<Settings> settings;
+
+        for (std::filesystem::path const& input : inputs)
+        {
+            StreamedConfiguration header;
+            try
+            {
+                header = ConfigurationLoader::StreamActions(input, [&](StreamedAction const& action) {
+                    ++report.read;
+                    if (!ids.insert(action.id).second)
+                    {
+                        ++report.duplicates;
+                        return;
+                    }
+                    bool enabled = action.enabled;
+                    if (enabled && !triggers.Bind(action))
+                    {
+                        ++report.collisions;
+                        if (collisions == MergeCollisions::Drop)
+                        {
+                            return;
+                        }
+                        enabled = false;
+                    }
+                    writer.Write(action, enabled);
+                });
+            }
+            catch (ConfigurationError const& e)
+            {
+                throw ConfigurationError("'" + input.string() + "': " + e.what());
+            }
+            if (!version && !header.version.empty())
+            {
+                version = header.version;
+            }
+            if (!settings && header.hasSettings)
+            {
+                settings = header.settings;
+            }
+        }
+
+        writer.Commit(version.value_or("1.0"), settings ? &*settings : nullptr);
+        report.written = writer.Written();
+        return report;
+    }
+}
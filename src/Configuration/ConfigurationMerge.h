@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+namespace khm
+{
+    // What happens to an enabled action whose trigger is already taken by
+    // an earlier one.
+    enum class MergeCollisions : uint8_t
+    {
+        Disable, // kept, written with "enabled": false
+        Drop,    // left out of the output
+    };
+
+    struct MergeReport
+    {
+        uint32_t read = 0;
+        uint32_t written = 0;
+        uint32_t duplicates = 0; // ids seen in an earlier input
+        uint32_t collisions = 0;
+    };
+
+    // Bulk import/export: streams the inputs in order into one output file
+    // without holding more than one action at a time, so merging configs
+    // with tens of thousands of actions costs two hash sets, not two DOMs.
+    // The first input wins everything: an action whose id was already
+    // written is skipped, an enabled trigger that an earlier enabled action
+    // already binds is resolved by `collisions`, and version and settings
+    // come from the first input that has them. Exporting is a merge of one.
+    //
+    // Collisions are the ones the dispatcher cannot resolve: the same chord
+    // in the same scope (global or one profile), the same sequence, one
+    // sequence a prefix of another, and a global chord that is the first
+    // step of a sequence. An action with both a hotkey and a sequence
+    // collides when either does. Inputs may be JSON or YAML (by extension);
+    // the output is always JSON, which a YAML loader reads as well. Throws
+    // ConfigurationError for an unreadable or invalid input and for an
+    // unwritable output; `output` is unchanged then, and may be one of the
+    // inputs.
+    class ConfigurationMerge
+    {
+    public:
+        static MergeReport Merge(std::span<std::filesystem::path const> inputs, std::filesystem::path const& output,
+            MergeCollisions collisions = MergeCollisions::Disable);
+
+    private:
+        static MergeReport MergeInto(std::span<std::filesystem::path const> inputs, std::filesystem::path const& output,
+            MergeCollisions collisions);
+    };
+}
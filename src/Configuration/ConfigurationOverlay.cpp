@@ -0,0 +1,121 @@
+#include "pch.h"
+#include "Configuration/ConfigurationOverlay.h"
+
+#include "Configuration/ConfigurationDiff.h"
+#include "Utils/Hash.h"
+
+#include <cstring>
+#include <vector>
+
+namespace khm
+{
+    namespace
+    {
+        // Points an override's strings into the second half of the arena.
+        ActionRecord RebasedOverride(ActionRecord record, uint32_t offset) noexcept
+        {
+            for (StringRef* ref : { &record.id, &record.name, &record.type, &record.parameter, &record.keyName, &record.sequence, &record.profile })
+            {
+                ref->offset += offset;
+            }
+            return record;
+        }
+
+        // The base action with the fields the override spelled out.
+        ActionRecord Merged(ActionRecord record, ActionRecord const& change) noexcept
+        {
+            uint16_t const fields = change.fields;
+            if (fields & NameField) record.name = change.name;
+            if (fields & EnabledField) record.enabled = change.enabled;
+            if (fields & TypeField) record.type = change.type;
+            if (fields & ParameterField) record.parameter = change.parameter;
+            if (fields & ProfileField) record.profile = change.profile;
+            if (fields & ActivateIfRunningField) record.activateIfRunning = change.activateIfRunning;
+            if (fields & MaxInFlightField) record.maxInFlight = change.maxInFlight;
+            if (fields & CoalesceField) record.coalesce = change.coalesce;
+            if (fields & PassThroughField) record.passThrough = change.passThrough;
+            if (fields & HotkeyField)
+            {
+                record.hasHotkey = change.hasHotkey;
+                record.hotkey = change.hotkey;
+                record.keyName = change.keyName;
+            }
+            if (fields & SequenceField) record.sequence = change.sequence;
+            record.fields |= fields;
+            return record;
+        }
+    }
+
+    LoadedConfiguration ConfigurationOverlay::Apply(LoadedConfiguration const& base, LoadedConfiguration const& overrides)
+    {
+        ActionTable const& shared = base.actions;
+        ActionTable const& user = overrides.actions;
+
+        // A repeated override id only counts the first time, as in Find().
+        std::vector<bool> used(user.Size(), false);
+        std::vector<uint32_t> replacement(shared.Size(), ActionTable::NotFound);
+        for (uint32_t i = 0; i < shared.Size(); ++i)
+        {
+            if (!IsTombstone(shared[i]))
+            {
+                uint32_t const match = user.Find(shared.String(shared[i].id));
+                if (match != ActionTable::NotFound)
+                {
+                    replacement[i] = match;
+                    used[match] = true;
+                }
+            }
+        }
+        std::vector<uint32_t> added;
+        for (uint32_t i = 0; i < user.Size(); ++i)
+        {
+            if (!used[i] && !IsTombstone(user[i]) && user.Find(user.String(user[i].id)) == i)
+            {
+                added.push_back(i);
+            }
+        }
+
+        std::span<char const> const sharedStrings = shared.StringData();
+        std::span<char const> const userStrings = user.StringData();
+        uint32_t const offset = static_cast<uint32_t>(sharedStrings.size());
+
+        LoadedConfiguration effective;
+        effective.version = base.version;
+        effective.settings = base.settings;
+        uint64_t const userHash = overrides.sourceHash;
+        effective.sourceHash = Fnv1a64(std::as_bytes(std::span{ &userHash, 1 }), base.sourceHash);
+        effective.actions = ActionTable::Allocate(shared.Size() + static_cast<uint32_t>(added.size()), offset + static_cast<uint32_t>(userStrings.size()));
+
+        char* const strings = effective.actions.MutableStrings();
+        if (!sharedStrings.empty())
+        {
+            std::memcpy(strings, sharedStrings.data(), sharedStrings.size());
+        }
+        if (!userStrings.empty())
+        {
+            std::memcpy(strings + offset, userStrings.data(), userStrings.size());
+        }
+
+        ActionRecord* const records = effective.actions.MutableRecords();
+        for (uint32_t i = 0; i < shared.Size(); ++i)
+        {
+            records[i] = replacement[i] == ActionTable::NotFound ? shared[i] : Merged(shared[i], RebasedOverride(user[replacement[i]], offset));
+        }
+        for (size_t i = 0; i < added.size(); ++i)
+        {
+            records[shared.Size() + i] = RebasedOverride(user[added[i]], offset);
+        }
+        effective.actions.IndexIds();
+        return effective;
+    }
+
+    LoadedConfiguration ConfigurationOverlay::Copy(LoadedConfiguration const& base)
+    {
+        LoadedConfiguration copy;
+        copy.version = base.version;
+        copy.settings = base.settings;
+        copy.actions = base.actions.Clone();
+        copy.sourceHash = base.sourceHash;
+        return copy;
+    }
+}
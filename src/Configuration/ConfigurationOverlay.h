@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Configuration/Configuration.h"
+
+namespace khm
+{
+    // Per-user overrides on top of a shared configuration (--agent). The
+    // overrides are an ordinary config file, usually a handful of actions,
+    // matched to the base by id: one with a base id changes only the fields
+    // it spells out (so { "id": ..., "enabled": false } turns it off), one
+    // with a new id is added after the base actions. Version and settings
+    // stay the base's.
+    class ConfigurationOverlay
+    {
+    public:
+        // The effective table is the base's records with the overridden
+        // fields swapped in, over one arena holding both string sets. Its
+        // sourceHash covers both inputs, so a reload notices either change.
+        static LoadedConfiguration Apply(LoadedConfiguration const& base, LoadedConfiguration const& overrides);
+
+        // A copy of `base` for when the user has no overrides.
+        static LoadedConfiguration Copy(LoadedConfiguration const& base);
+    };
+}
@@ -0,0 +1,153 @@
+#include "pch.h"
+#include "Configuration/ConfigurationWatcher.h"
+
+namespace khm
+{
+    namespace
+    {
+        constexpr DWORD NotifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+    }
+
+    ConfigurationWatcher::ConfigurationWatcher(std::filesystem::path file, std::chrono::milliseconds debounce, Callback onChanged) :
+        m_file(std::move(file)),
+        m_fileName(m_file.filename().wstring()),
+        m_debounce(debounce),
+        m_onChanged(std::move(onChanged))
+    {
+    }
+
+    ConfigurationWatcher::~ConfigurationWatcher()
+    {
+        Stop();
+    }
+
+    void ConfigurationWatcher::Start()
+    {
+        if (m_thread.joinable())
+        {
+            return;
+        }
+
+        m_directory.attach(CreateFileW(m_file.parent_path().c_str(), FILE_LIST_DIRECTORY,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+            FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr));
+        if (!m_directory)
+        {
+            winrt::throw_last_error();
+        }
+        m_stopEvent.attach(winrt::check_pointer(CreateEventW(nullptr, TRUE, FALSE, nullptr)));
+        m_triggerEvent.attach(winrt::check_pointer(CreateEventW(nullptr, FALSE, FALSE, nullptr)));
+        m_thread = std::thread([this] { Run(); });
+    }
+
+    void ConfigurationWatcher::Stop() noexcept
+    {
+        if (m_thread.joinable())
+        {
+            SetEvent(m_stopEvent.get());
+            m_thread.join();
+        }
+        m_directory.close();
+        m_stopEvent.close();
+        m_triggerEvent.close();
+    }
+
+    void ConfigurationWatcher::Trigger() noexcept
+    {
+        if (m_triggerEvent)
+        {
+            SetEvent(m_triggerEvent.get());
+        }
+    }
+
+    bool ConfigurationWatcher::Matches(FILE_NOTIFY_INFORMATION const& info) const noexcept
+    {
+        std::wstring_view const name{ info.FileName, info.FileNameLength / sizeof(wchar_t) };
+        return CompareStringOrdinal(name.data(), static_cast<int>(name.size()), m_fileName.data(), static_cast<int>(m_fileName.size()), TRUE) == CSTR_EQUAL;
+    }
+
+    void ConfigurationWatcher::Run() noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), L"khm.config-watcher");
+
+        winrt::handle ioEvent{ CreateEventW(nullptr, TRUE, FALSE, nullptr) };
+        if (!ioEvent)
+        {
+            return;
+        }
+
+        alignas(DWORD) std::byte buffer[16 * 1024];
+        OVERLAPPED overlapped{};
+        overlapped.hEvent = ioEvent.get();
+
+        auto issueRead = [&] {
+            ResetEvent(ioEvent.get());
+            return ReadDirectoryChangesW(m_directory.get(), buffer, sizeof(buffer), FALSE, NotifyFilter, nullptr, &overlapped, nullptr) != FALSE;
+        };
+        if (!issueRead())
+        {
+            return;
+        }
+
+        HANDLE const waits[] = { m_stopEvent.get(), m_triggerEvent.get(), ioEvent.get() };
+        bool pending = false;
+        ULONGLONG deadline = 0;
+
+        for (;;)
+        {
+            DWORD timeout = INFINITE;
+            if (pending)
+            {
+                ULONGLONG const now = GetTickCount64();
+                timeout = now >= deadline ? 0 : static_cast<DWORD>(deadline - now);
+            }
+
+            DWORD const wait = WaitForMultipleObjects(ARRAYSIZE(waits), waits, FALSE, timeout);
+            if (wait == WAIT_OBJECT_0)
+            {
+                break;
+            }
+
+            if (wait == WAIT_TIMEOUT || wait == WAIT_OBJECT_0 + 1)
+            {
+                pending = false;
+                m_onChanged();
+                continue;
+            }
+
+            DWORD bytes = 0;
+            if (!GetOverlappedResult(m_directory.get(), &overlapped, &bytes, FALSE))
+            {
+                break;
+            }
+
+            // Zero bytes means the buffer overflowed and the details were lost.
+            bool touched = bytes == 0;
+            for (std::byte const* entry = buffer; !touched && bytes != 0;)
+            {
+                auto const& info = *reinterpret_cast<FILE_NOTIFY_INFORMATION const*>(entry);
+                touched = Matches(info);
+                if (info.NextEntryOffset == 0)
+                {
+                    break;
+                }
+                entry += info.NextEntryOffset;
+            }
+
+            if (touched)
+            {
+                pending = true;
+                deadline = GetTickCount64() + static_cast<ULONGLONG>(m_debounce.count());
+            }
+
+            if (!issueRead())
+            {
+                break;
+            }
+        }
+
+        CancelIoEx(m_directory.get(), &overlapped);
+        DWORD ignored = 0;
+        GetOverlappedResult(m_directory.get(), &overlapped, &ignored, TRUE);
+    }
+}
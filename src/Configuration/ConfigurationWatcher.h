@@ -0,0 +1,49 @@
+#pragma once
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace khm
+{
+    // Watches one file through ReadDirectoryChangesW on its directory and
+    // calls `onChanged` on the watcher thread once the file has been quiet
+    // for the debounce interval. Editors that save through a temp file and
+    // rename are covered as well as in-place writes.
+    class ConfigurationWatcher
+    {
+    public:
+        using Callback = std::function<void()>;
+
+        ConfigurationWatcher(std::filesystem::path file, std::chrono::milliseconds debounce, Callback onChanged);
+        ~ConfigurationWatcher();
+
+        ConfigurationWatcher(ConfigurationWatcher const&) = delete;
+        ConfigurationWatcher& operator=(ConfigurationWatcher const&) = delete;
+
+        void Start();
+        void Stop() noexcept;
+
+        // Runs the callback on the watcher thread as if the file had changed,
+        // keeping every reload on one thread.
+        void Trigger() noexcept;
+
+    private:
+        void Run() noexcept;
+        bool Matches(FILE_NOTIFY_INFORMATION const& info) const noexcept;
+
+        std::filesystem::path m_file;
+        std::wstring m_fileName;
+        std::chrono::milliseconds m_debounce;
+        Callback m_onChanged;
+        winrt::file_handle m_directory;
+        winrt::handle m_stopEvent;
+        winrt::handle m_triggerEvent;
+        std::thread m_thread;
+    };
+}
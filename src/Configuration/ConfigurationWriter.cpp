@@ -0,0 +1,236 @@
+#include "pch.h"
+#include "Configuration/ConfigurationWriter.h"
+
+#include <charconv>
+
+namespace khm
+{
+    ConfigurationWriter::ConfigurationWriter(std::filesystem::path path) :
+        m_path(std::move(path)),
+        m_temporary(m_path)
+    {
+        m_temporary += L".tmp";
+        m_file.attach(CreateFileW(m_temporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+        if (!m_file)
+        {
+            winrt::throw_last_error();
+        }
+        m_buffer.reserve(BufferBytes);
+        Append("{\n  \"actions\": [");
+    }
+
+    ConfigurationWriter::~ConfigurationWriter()
+    {
+        if (!m_committed)
+        {
+            m_file.close();
+            DeleteFileW(m_temporary.c_str());
+        }
+    }
+
+    void ConfigurationWriter::Write(StreamedAction const& action, bool enabled)
+    {
+        Append(m_written == 0 ? "\n    {\n      \"id\": " : ",\n    {\n      \"id\": ");
+        AppendString(action.id);
+        if (!action.name.empty())
+        {
+            Append(",\n      \"name\": ");
+            AppendString(action.name);
+        }
+        AppendBool("enabled", enabled);
+        Append(",\n      \"type\": ");
+        AppendString(action.type);
+        Append(",\n      \"parameter\": ");
+        AppendString(action.parameter);
+        if (!action.profile.empty())
+        {
+            Append(",\n      \"profile\": ");
+            AppendString(action.profile);
+        }
+        // Defaults are left out, as in hand-written configs.
+        if (action.activateIfRunning)
+        {
+            AppendBool("activateIfRunning", true);
+        }
+        if (action.maxInFlight != 1)
+        {
+            AppendUInt("maxInFlight", action.maxInFlight);
+        }
+        if (!action.coalesce)
+        {
+            AppendBool("coalesce", false);
+        }
+        if (action.passThrough)
+        {
+            AppendBool("passThrough", true);
+        }
+        if (action.hasHotkey)
+        {
+            Append(",\n      \"hotkey\": ");
+            AppendHotkey(action.hotkey, action.keyName);
+        }
+        if (!action.sequence.empty())
+        {
+            Append(",\n      \"sequence\": [");
+            for (size_t i = 0; i < action.sequence.size(); ++i)
+            {
+                Append(i == 0 ? " " : ", ");
+                AppendHotkey(action.sequence[i], i < action.sequenceKeyNames.size() ? std::string_view{ action.sequenceKeyNames[i] } : std::string_view{});
+            }
+            Append(" ]");
+        }
+        Append("\n    }");
+        ++m_written;
+    }
+
+    void ConfigurationWriter::Commit(std::string_view version, Settings const* settings)
+    {
+        Append(m_written == 0 ? "]" : "\n  ]");
+        Append(",\n  \"version\": ");
+        AppendString(version);
+        if (settings != nullptr)
+        {
+            Append(",\n  \"settings\": {");
+            Append("\n    \"startWithWindows\": ");
+            Append(settings->startWithWindows ? "true" : "false");
+            Append(",\n    \"showTrayIcon\": ");
+            Append(settings->showTrayIcon ? "true" : "false");
+            Append(",\n    \"enableLogging\": ");
+            Append(settings->enableLogging ? "true" : "false");
+            Append(",\n    \"logLevel\": ");
+            AppendString(LogLevelNames[static_cast<size_t>(settings->logLevel)]);
+            Append(",\n    \"sequenceTimeoutMs\": ");
+            char digits[16];
+            Append({ digits, static_cast<size_t>(std::to_chars(digits, digits + sizeof(digits), settings->sequenceTimeoutMs).ptr - digits) });
+            Append(",\n    \"hookPriority\": ");
+            AppendString(HookPriorityNames[static_cast<size_t>(settings->hookPriority)]);
+            // Like action fields, only the tiers that differ from the default.
+            bool first = true;
+            for (size_t type = 0; type < settings->actionQos.size(); ++type)
+            {
+                if (settings->actionQos[type] == QosTier::Normal)
+                {
+                    continue;
+                }
+                Append(first ? ",\n    \"actionQos\": { " : ", ");
+                AppendString(ActionTypeNames[type]);
+                Append(": ");
+                AppendString(QosTierNames[static_cast<size_t>(settings->actionQos[type])]);
+                first = false;
+            }
+            if (!first)
+            {
+                Append(" }");
+            }
+            Append("\n  }");
+        }
+        Append("\n}\n");
+        Flush();
+        m_file.close();
+
+        if (!MoveFileExW(m_temporary.c_str(), m_path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        {
+            winrt::throw_last_error();
+        }
+        m_committed = true;
+    }
+
+    void ConfigurationWriter::Append(std::string_view text)
+    {
+        if (m_buffer.size() + text.size() > BufferBytes)
+        {
+            Flush();
+        }
+        if (text.size() > BufferBytes)
+        {
+            // Parameters can be long; no point copying them through the buffer.
+            DWORD done = 0;
+            if (text.size() > MAXDWORD || !WriteFile(m_file.get(), text.data(), static_cast<DWORD>(text.size()), &done, nullptr) || done != text.size())
+            {
+                winrt::throw_last_error();
+            }
+            return;
+        }
+        m_buffer.insert(m_buffer.end(), text.begin(), text.end());
+    }
+
+    void ConfigurationWriter::AppendString(std::string_view value)
+    {
+        static constexpr char Hex[] = "0123456789abcdef";
+
+        Append("\"");
+        size_t run = 0; // start of the pending unescaped bytes
+        for (size_t i = 0; i < value.size(); ++i)
+        {
+            unsigned char const c = static_cast<unsigned char>(value[i]);
+            if (c >= 0x20 && c != '"' && c != '\\')
+            {
+                continue; // UTF-8 passes through
+            }
+            Append(value.substr(run, i - run));
+            run = i + 1;
+            switch (c)
+            {
+            case '"': Append("\\\""); break;
+            case '\\': Append("\\\\"); break;
+            case '\n': Append("\\n"); break;
+            case '\r': Append("\\r"); break;
+            case '\t': Append("\\t"); break;
+            default:
+            {
+                char const escape[] = { '\\', 'u', '0', '0', Hex[c >> 4], Hex[c & 0xF] };
+                Append({ escape, sizeof(escape) });
+                break;
+            }
+            }
+        }
+        Append(value.substr(run));
+        Append("\"");
+    }
+
+    void ConfigurationWriter::AppendBool(std::string_view name, bool value)
+    {
+        Append(",\n      \"");
+        Append(name);
+        Append(value ? "\": true" : "\": false");
+    }
+
+    void ConfigurationWriter::AppendUInt(std::string_view name, uint32_t value)
+    {
+        char digits[16];
+        Append(",\n      \"");
+        Append(name);
+        Append("\": ");
+        Append({ digits, static_cast<size_t>(std::to_chars(digits, digits + sizeof(digits), value).ptr - digits) });
+    }
+
+    void ConfigurationWriter::AppendHotkey(Hotkey hotkey, std::string_view keyName)
+    {
+        char digits[4];
+        Append("{ ");
+        if (hotkey.modifiers & ModWin) Append("\"win\": true, ");
+        if (hotkey.modifiers & ModCtrl) Append("\"ctrl\": true, ");
+        if (hotkey.modifiers & ModShift) Append("\"shift\": true, ");
+        if (hotkey.modifiers & ModAlt) Append("\"alt\": true, ");
+        Append("\"key\": ");
+        Append({ digits, static_cast<size_t>(std::to_chars(digits, digits + sizeof(digits), hotkey.key).ptr - digits) });
+        if (!keyName.empty())
+        {
+            Append(", \"keyName\": ");
+            AppendString(keyName);
+        }
+        Append(" }");
+    }
+
+    void ConfigurationWriter::Flush()
+    {
+        DWORD done = 0;
+        if (!m_buffer.empty()
+            && (!WriteFile(m_file.get(), m_buffer.data(), static_cast<DWORD>(m_buffer.size()), &done, nullptr) || done != m_buffer.size()))
+        {
+            winrt::throw_last_error();
+        }
+        m_buffer.clear();
+    }
+}
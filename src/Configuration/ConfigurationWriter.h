@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Configuration/Configuration.h"
+
+#include <winrt/base.h>
+
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+namespace khm
+{
+    // Writes a configuration file one action at a time through a fixed
+    // buffer, for exports too large to build in memory first. The output
+    // goes to "<path>.tmp" and only replaces `path` on Commit(), so a failed
+    // export never leaves a half-written config for the watcher to load.
+    // Throws winrt::hresult_error when the file cannot be written.
+    class ConfigurationWriter
+    {
+    public:
+        explicit ConfigurationWriter(std::filesystem::path path);
+        ~ConfigurationWriter();
+
+        ConfigurationWriter(ConfigurationWriter const&) = delete;
+        ConfigurationWriter& operator=(ConfigurationWriter const&) = delete;
+
+        // `enabled` overrides the action's own flag.
+        void Write(StreamedAction const& action, bool enabled);
+
+        // Closes the action list with the given header and moves the file
+        // into place. `settings` is written only when non-null.
+        void Commit(std::string_view version, Settings const* settings);
+
+        uint32_t Written() const noexcept { return m_written; }
+
+    private:
+        static constexpr size_t BufferBytes = 64 * 1024;
+
+        void Append(std::string_view text);
+        void AppendString(std::string_view value); // quoted and escaped
+        void AppendBool(std::string_view name, bool value);
+        void AppendUInt(std::string_view name, uint32_t value);
+        void AppendHotkey(Hotkey hotkey, std::string_view keyName);
+        void Flush();
+
+        std::filesystem::path m_path;
+        std::filesystem::path m_temporary;
+        winrt::file_handle m_file;
+        std::vector<char> m_buffer;
+        uint32_t m_written = 0;
+        bool m_committed = false;
+    };
+}
@@ -0,0 +1,300 @@
+#include "pch.h"
+#include "Configuration/JsonReader.h"
+
+#include "Configuration/ConfigurationError.h"
+
+#include <cctype>
+
+namespace khm
+{
+    JsonReader::JsonReader(std::string_view text) noexcept :
+        m_begin(text.data()),
+        m_pos(text.data()),
+        m_end(text.data() + text.size())
+    {
+        if (text.starts_with("\xEF\xBB\xBF"))
+        {
+            m_pos += 3;
+        }
+    }
+
+    void JsonReader::Fail(std::string_view message) const
+    {
+        uint32_t line = 1;
+        uint32_t column = 1;
+        for (char const* p = m_begin; p < m_pos; ++p)
+        {
+            if (*p == '\n')
+            {
+                ++line;
+                column = 1;
+            }
+            else
+            {
+                ++column;
+            }
+        }
+        throw ConfigurationError(std::to_string(line) + ":" + std::to_string(column) + ": " + std::string(message));
+    }
+
+    void JsonReader::SkipWhitespace() noexcept
+    {
+        while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+        {
+            ++m_pos;
+        }
+    }
+
+    JsonToken JsonReader::Next()
+    {
+        SkipWhitespace();
+        if (m_pos == m_end)
+        {
+            if (!m_done)
+            {
+                Fail("unexpected end of input");
+            }
+            return JsonToken::EndOfInput;
+        }
+        if (m_done)
+        {
+            Fail("unexpected data after the root value");
+        }
+
+        char c = *m_pos;
+        if (c == '}' || c == ']')
+        {
+            if (m_depth == 0 || m_afterComma || m_afterKey || !(m_justOpened || m_expectSeparator))
+            {
+                Fail("unexpected closing bracket");
+            }
+            return Close(c);
+        }
+
+        if (m_expectSeparator)
+        {
+            if (c != ',')
+            {
+                Fail("expected ','");
+            }
+            ++m_pos;
+            m_expectSeparator = false;
+            m_afterComma = true;
+            SkipWhitespace();
+            if (m_pos == m_end)
+            {
+                Fail("unexpected end of input");
+            }
+            c = *m_pos;
+            if (c == '}' || c == ']')
+            {
+                Fail("trailing comma");
+            }
+        }
+
+        m_justOpened = false;
+        m_afterComma = false;
+
+        if (m_depth > 0 && InObject() && !m_afterKey)
+        {
+            if (c != '"')
+            {
+                Fail("expected an object key");
+            }
+            ScanString();
+            SkipWhitespace();
+            if (m_pos == m_end || *m_pos != ':')
+            {
+                Fail("expected ':'");
+            }
+            ++m_pos;
+            m_afterKey = true;
+            return JsonToken::Key;
+        }
+        m_afterKey = false;
+
+        switch (c)
+        {
+        case '{':
+            return Open(true);
+        case '[':
+            return Open(false);
+        case '"':
+            ScanString();
+            ValueDone();
+            return JsonToken::String;
+        case 't':
+            ScanLiteral("true");
+            ValueDone();
+            return JsonToken::True;
+        case 'f':
+            ScanLiteral("false");
+            ValueDone();
+            return JsonToken::False;
+        case 'n':
+            ScanLiteral("null");
+            ValueDone();
+            return JsonToken::Null;
+        default:
+            ScanNumber();
+            ValueDone();
+            return JsonToken::Number;
+        }
+    }
+
+    void JsonReader::SkipValue(JsonToken first)
+    {
+        if (first != JsonToken::BeginObject && first != JsonToken::BeginArray)
+        {
+            return;
+        }
+        uint32_t const depth = m_depth - 1;
+        while (m_depth > depth)
+        {
+            Next();
+        }
+    }
+
+    JsonToken JsonReader::Open(bool object)
+    {
+        if (m_depth == MaxDepth)
+        {
+            Fail("nesting too deep");
+        }
+        uint64_t const bit = uint64_t{ 1 } << m_depth;
+        m_containers = object ? (m_containers | bit) : (m_containers & ~bit);
+        ++m_depth;
+        ++m_pos;
+        m_justOpened = true;
+        return object ? JsonToken::BeginObject : JsonToken::BeginArray;
+    }
+
+    JsonToken JsonReader::Close(char bracket)
+    {
+        bool const object = bracket == '}';
+        if (InObject() != object)
+        {
+            Fail("mismatched closing bracket");
+        }
+        --m_depth;
+        ++m_pos;
+        m_justOpened = false;
+        m_expectSeparator = false;
+        ValueDone();
+        return object ? JsonToken::EndObject : JsonToken::EndArray;
+    }
+
+    void JsonReader::ValueDone() noexcept
+    {
+        if (m_depth == 0)
+        {
+            m_done = true;
+        }
+        else
+        {
+            m_expectSeparator = true;
+        }
+    }
+
+    void JsonReader::ScanString()
+    {
+        char const* const start = ++m_pos;
+        bool escaped = false;
+        while (m_pos < m_end)
+        {
+            char const c = *m_pos;
+            if (c == '"')
+            {
+                m_text = ScalarText{ std::string_view(start, m_pos - start), escaped ? ScalarEncoding::JsonEscaped : ScalarEncoding::Raw };
+                ++m_pos;
+                return;
+            }
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                Fail("control character in string");
+            }
+            if (c == '\\')
+            {
+                escaped = true;
+                if (++m_pos == m_end)
+                {
+                    break;
+                }
+                switch (*m_pos)
+                {
+                case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                    break;
+                case 'u':
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        if (++m_pos == m_end || !std::isxdigit(static_cast<unsigned char>(*m_pos)))
+                        {
+                            Fail("invalid \\u escape");
+                        }
+                    }
+                    break;
+                default:
+                    Fail("invalid escape sequence");
+                }
+            }
+            ++m_pos;
+        }
+        Fail("unterminated string");
+    }
+
+    void JsonReader::ScanNumber()
+    {
+        char const* const start = m_pos;
+        auto digits = [this] {
+            char const* const first = m_pos;
+            while (m_pos < m_end && *m_pos >= '0' && *m_pos <= '9')
+            {
+                ++m_pos;
+            }
+            return m_pos != first;
+        };
+
+        if (m_pos < m_end && *m_pos == '-')
+        {
+            ++m_pos;
+        }
+        if (m_pos < m_end && *m_pos == '0')
+        {
+            ++m_pos;
+        }
+        else if (!digits())
+        {
+            Fail("unexpected character");
+        }
+        if (m_pos < m_end && *m_pos == '.')
+        {
+            ++m_pos;
+            if (!digits())
+            {
+                Fail("invalid number");
+            }
+        }
+        if (m_pos < m_end && (*m_pos == 'e' || *m_pos == 'E'))
+        {
+            ++m_pos;
+            if (m_pos < m_end && (*m_pos == '+' || *m_pos == '-'))
+            {
+                ++m_pos;
+            }
+            if (!digits())
+            {
+                Fail("invalid number");
+            }
+        }
+        m_number = std::string_view(start, m_pos - start);
+    }
+
+    void JsonReader::ScanLiteral(std::string_view literal)
+    {
+        if (static_cast<size_t>(m_end - m_pos) < literal.size() || std::string_view(m_pos, literal.size()) != literal)
+        {
+            Fail("unexpected character");
+        }
+        m_pos += literal.size();
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Configuration/ConfigFieldSink.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace khm
+{
+    enum class JsonToken : uint8_t
+    {
+        EndOfInput,
+        BeginObject,
+        EndObject,
+        BeginArray,
+        EndArray,
+        Key,
+        String,
+        Number,
+        True,
+        False,
+        Null,
+    };
+
+    // Validating pull tokenizer over a UTF-8 buffer. It never allocates:
+    // strings and numbers are handed out as views into the input. Malformed
+    // input throws ConfigurationError with a line:column position.
+    class JsonReader
+    {
+    public:
+        static constexpr uint32_t MaxDepth = 64;
+
+        // Strings are always quoted.
+        static constexpr bool ScalarsAreStrings = false;
+
+        explicit JsonReader(std::string_view text) noexcept;
+
+        JsonToken Next();
+
+        // Skips the value whose first token was just returned by Next().
+        void SkipValue(JsonToken first);
+
+        // Valid after Key and String tokens.
+        ScalarText const& Text() const noexcept { return m_text; }
+
+        // Valid after a Number token.
+        std::string_view NumberText() const noexcept { return m_number; }
+
+        [[noreturn]] void Fail(std::string_view message) const;
+
+    private:
+        void SkipWhitespace() noexcept;
+        void ScanString();
+        void ScanNumber();
+        void ScanLiteral(std::string_view literal);
+        JsonToken Open(bool object);
+        JsonToken Close(char bracket);
+        void ValueDone() noexcept;
+        bool InObject() const noexcept { return (m_containers >> (m_depth - 1)) & 1; }
+
+        char const* m_begin;
+        char const* m_pos;
+        char const* m_end;
+
+        ScalarText m_text;
+        std::string_view m_number;
+
+        uint64_t m_containers = 0; // bit n set: level n+1 is an object
+        uint32_t m_depth = 0;
+        bool m_justOpened = false;
+        bool m_afterComma = false;
+        bool m_afterKey = false;
+        bool m_expectSeparator = false;
+        bool m_done = false;
+    };
+}
@@ -0,0 +1,718 @@
+#include "pch.h"
+#include "Configuration/YamlReader.h"
+
+#include "Configuration/ConfigurationError.h"
+
+#include <cctype>
+
+namespace khm
+{
+    namespace
+    {
+        bool IsBlank(char c) noexcept
+        {
+            return c == ' ' || c == '\t';
+        }
+
+        bool IsBreak(char c) noexcept
+        {
+            return c == '\n' || c == '\r';
+        }
+
+        bool IsFlowIndicator(char c) noexcept
+        {
+            return c == ',' || c == '[' || c == ']' || c == '{' || c == '}';
+        }
+
+        // Core schema. Only decimal integers become numbers; the schema has
+        // no use for floats, and hex or octal keys would read as a typo.
+        JsonToken Resolve(std::string_view text) noexcept
+        {
+            if (text == "~" || text == "null" || text == "Null" || text == "NULL")
+            {
+                return JsonToken::Null;
+            }
+            if (text == "true" || text == "True" || text == "TRUE")
+            {
+                return JsonToken::True;
+            }
+            if (text == "false" || text == "False" || text == "FALSE")
+            {
+                return JsonToken::False;
+            }
+            size_t const sign = text.starts_with('-') ? 1 : 0;
+            if (text.size() > sign && text.find_first_not_of("0123456789", sign) == std::string_view::npos)
+            {
+                return JsonToken::Number;
+            }
+            return JsonToken::String;
+        }
+    }
+
+    YamlReader::YamlReader(std::string_view text) noexcept :
+        m_begin(text.data()),
+        m_pos(text.data()),
+        m_lineStart(text.data()),
+        m_end(text.data() + text.size()),
+        m_tokenAt(text.data())
+    {
+        if (text.starts_with("\xEF\xBB\xBF"))
+        {
+            m_pos += 3;
+            m_lineStart = m_pos;
+        }
+    }
+
+    void YamlReader::Fail(std::string_view message) const
+    {
+        FailAt(m_tokenAt, message);
+    }
+
+    void YamlReader::FailAt(char const* at, std::string_view message) const
+    {
+        uint32_t line = 1;
+        uint32_t column = 1;
+        for (char const* p = m_begin; p < at; ++p)
+        {
+            if (*p == '\n')
+            {
+                ++line;
+                column = 1;
+            }
+            else
+            {
+                ++column;
+            }
+        }
+        throw ConfigurationError(std::to_string(line) + ":" + std::to_string(column) + ": " + std::string(message));
+    }
+
+    JsonToken YamlReader::Next()
+    {
+        while (m_taken == m_queued)
+        {
+            if (m_ended)
+            {
+                return JsonToken::EndOfInput;
+            }
+            m_taken = m_queued = 0;
+            if (m_flowDepth > 0)
+            {
+                ScanFlow();
+            }
+            else
+            {
+                ScanLines();
+            }
+        }
+        Pending const& next = m_queue[m_taken++];
+        m_text = next.text;
+        m_tokenAt = next.at;
+        return next.token;
+    }
+
+    void YamlReader::SkipValue(JsonToken first)
+    {
+        if (first != JsonToken::BeginObject && first != JsonToken::BeginArray)
+        {
+            return;
+        }
+        for (uint32_t depth = 1; depth > 0;)
+        {
+            switch (Next())
+            {
+            case JsonToken::BeginObject:
+            case JsonToken::BeginArray:
+                ++depth;
+                break;
+            case JsonToken::EndObject:
+            case JsonToken::EndArray:
+                --depth;
+                break;
+            case JsonToken::EndOfInput:
+                Fail("unexpected end of input");
+            default:
+                break;
+            }
+        }
+    }
+
+    void YamlReader::ScanLines()
+    {
+        while (m_queued == 0)
+        {
+            if (m_pos == m_end)
+            {
+                EndDocument();
+                return;
+            }
+
+            m_lineStart = m_pos;
+            char const* content = m_pos;
+            while (content < m_end && *content == ' ')
+            {
+                ++content;
+            }
+            if (content < m_end && *content == '\t' && !AtLineEnd(SkipBlanks(content)))
+            {
+                FailAt(content, "tabs are not allowed in indentation");
+            }
+            if (AtLineEnd(SkipBlanks(content)))
+            {
+                m_pos = NextLine(content);
+                continue;
+            }
+
+            uint32_t const column = Column(content);
+            if (column == 0 && std::string_view(content, m_end - content).starts_with("---")
+                && (content + 3 == m_end || IsBlank(content[3]) || IsBreak(content[3])))
+            {
+                if (m_started)
+                {
+                    FailAt(content, "multiple documents are not supported");
+                }
+                char const* const rest = SkipBlanks(content + 3);
+                if (!AtLineEnd(rest))
+                {
+                    FailAt(rest, "content on the '---' line is not supported");
+                }
+                m_pos = NextLine(rest);
+                continue;
+            }
+            if (m_finished)
+            {
+                FailAt(content, "unexpected content after the document");
+            }
+
+            bool const dash = IsDash(content);
+            if (m_awaiting)
+            {
+                m_awaiting = false;
+                // "key:" may be followed by its sequence at the same indent.
+                if (column > m_awaitingIndent || (dash && column == m_awaitingIndent && m_awaitingInMapping))
+                {
+                    Node(content);
+                    continue;
+                }
+                Push(JsonToken::Null, content);
+            }
+            else if (!m_started)
+            {
+                m_started = true;
+                Node(content);
+                continue;
+            }
+
+            CloseBlocks(column, dash);
+            if (m_blockDepth == 0)
+            {
+                FailAt(content, "unexpected content after the document");
+            }
+            OpenBlock const& top = m_blocks[m_blockDepth - 1];
+            if (top.indent != column)
+            {
+                FailAt(content, "bad indentation");
+            }
+            if (top.kind == Block::Sequence)
+            {
+                Item(content, column);
+                continue;
+            }
+
+            Scalar key;
+            char const* afterColon = nullptr;
+            if (dash || !TryScanKey(content, false, key, afterColon))
+            {
+                FailAt(content, "expected a 'key: value' pair");
+            }
+            Push(JsonToken::Key, content, key.text);
+            Value(afterColon, column);
+        }
+    }
+
+    void YamlReader::EndDocument()
+    {
+        if (m_awaiting)
+        {
+            m_awaiting = false;
+            Push(JsonToken::Null, m_end);
+        }
+        while (m_blockDepth > 0)
+        {
+            --m_blockDepth;
+            Push(m_blocks[m_blockDepth].kind == Block::Mapping ? JsonToken::EndObject : JsonToken::EndArray, m_end);
+        }
+        if (!m_started)
+        {
+            Push(JsonToken::Null, m_end); // an empty document
+        }
+        m_started = m_finished = m_ended = true;
+    }
+
+    // Closes the blocks a line at `column` is outside of. A sequence ends at
+    // its own indent too, unless the line is its next entry.
+    void YamlReader::CloseBlocks(uint32_t column, bool dash)
+    {
+        while (m_blockDepth > 0)
+        {
+            OpenBlock const& top = m_blocks[m_blockDepth - 1];
+            if (top.indent < column || (top.indent == column && (top.kind == Block::Mapping || dash)))
+            {
+                break;
+            }
+            --m_blockDepth;
+            Push(top.kind == Block::Mapping ? JsonToken::EndObject : JsonToken::EndArray, m_lineStart + column);
+        }
+        if (m_blockDepth == 0)
+        {
+            m_finished = true;
+        }
+    }
+
+    void YamlReader::Open(Block kind, uint32_t indent, char const* at)
+    {
+        if (Depth() == MaxDepth)
+        {
+            FailAt(at, "nesting too deep");
+        }
+        Push(kind == Block::Mapping ? JsonToken::BeginObject : JsonToken::BeginArray, at);
+        m_blocks[m_blockDepth++] = OpenBlock{ kind, indent };
+    }
+
+    // A node that starts a line or follows "- ": may open a block collection.
+    void YamlReader::Node(char const* p)
+    {
+        uint32_t const column = Column(p);
+        if (IsDash(p))
+        {
+            Open(Block::Sequence, column, p);
+            Item(p, column);
+            return;
+        }
+        if (*p == '{' || *p == '[')
+        {
+            OpenFlow(*p == '{', p);
+            return;
+        }
+
+        Scalar scalar;
+        char const* afterColon = nullptr;
+        if (TryScanKey(p, false, scalar, afterColon))
+        {
+            Open(Block::Mapping, column, p);
+            Push(JsonToken::Key, p, scalar.text);
+            Value(afterColon, column);
+            return;
+        }
+        PushScalar(scalar);
+        EndLine(scalar.end);
+    }
+
+    void YamlReader::Item(char const* p, uint32_t dashColumn)
+    {
+        char const* const q = SkipBlanks(p + 1);
+        if (AtLineEnd(q))
+        {
+            m_awaiting = true;
+            m_awaitingInMapping = false;
+            m_awaitingIndent = dashColumn;
+            m_pos = NextLine(q);
+            return;
+        }
+        Node(q);
+    }
+
+    // The rest of a "key:" line.
+    void YamlReader::Value(char const* p, uint32_t keyColumn)
+    {
+        char const* const q = SkipBlanks(p);
+        if (AtLineEnd(q))
+        {
+            m_awaiting = true;
+            m_awaitingInMapping = true;
+            m_awaitingIndent = keyColumn;
+            m_pos = NextLine(q);
+            return;
+        }
+        if (IsDash(q))
+        {
+            FailAt(q, "a block sequence cannot start on its key's line");
+        }
+        if (*q == '{' || *q == '[')
+        {
+            OpenFlow(*q == '{', q);
+            return;
+        }
+
+        Scalar scalar;
+        char const* afterColon = nullptr;
+        if (TryScanKey(q, false, scalar, afterColon))
+        {
+            FailAt(q, "a nested mapping must start on a new line");
+        }
+        PushScalar(scalar);
+        EndLine(scalar.end);
+    }
+
+    void YamlReader::EndLine(char const* p)
+    {
+        char const* const q = SkipBlanks(p);
+        if (!AtLineEnd(q))
+        {
+            FailAt(q, "unexpected characters after a value");
+        }
+        m_pos = NextLine(q);
+    }
+
+    void YamlReader::ScanFlow()
+    {
+        for (;;)
+        {
+            // Blanks, line breaks and comments all separate flow tokens.
+            char const* p = m_pos;
+            while (p < m_end && (IsBlank(*p) || IsBreak(*p) || *p == '#'))
+            {
+                if (*p == '#')
+                {
+                    if (p != m_begin && !IsBlank(p[-1]) && !IsBreak(p[-1]))
+                    {
+                        break;
+                    }
+                    while (p < m_end && *p != '\n')
+                    {
+                        ++p;
+                    }
+                    continue;
+                }
+                ++p;
+            }
+            if (p == m_end)
+            {
+                FailAt(p, "unterminated flow collection");
+            }
+            m_pos = p;
+
+            char const c = *p;
+            bool const mapping = InFlowMapping();
+            if (c == '}' || c == ']')
+            {
+                if (m_flowState == FlowState::Value)
+                {
+                    Push(JsonToken::Null, p); // "{ key: }"
+                }
+                CloseFlow(c);
+                return;
+            }
+            if (c == ',')
+            {
+                if (m_flowState == FlowState::Value)
+                {
+                    Push(JsonToken::Null, p);
+                }
+                else if (m_flowState != FlowState::CommaOrEnd)
+                {
+                    FailAt(p, "unexpected ','");
+                }
+                m_flowState = mapping ? FlowState::KeyOrEnd : FlowState::ValueOrEnd;
+                m_pos = p + 1;
+                if (m_queued > 0)
+                {
+                    return;
+                }
+                continue;
+            }
+
+            switch (m_flowState)
+            {
+            case FlowState::CommaOrEnd:
+                FailAt(p, mapping ? "expected ',' or '}'" : "expected ',' or ']'");
+            case FlowState::KeyOrEnd:
+            {
+                Scalar key;
+                char const* afterColon = nullptr;
+                if (c == '{' || c == '[' || !TryScanKey(p, true, key, afterColon))
+                {
+                    FailAt(p, "expected a 'key: value' pair");
+                }
+                Push(JsonToken::Key, p, key.text);
+                m_pos = afterColon;
+                m_flowState = FlowState::Value;
+                return;
+            }
+            default:
+            {
+                if (c == '{' || c == '[')
+                {
+                    OpenFlow(c == '{', p);
+                    return;
+                }
+                Scalar scalar;
+                char const* afterColon = nullptr;
+                if (TryScanKey(p, true, scalar, afterColon))
+                {
+                    FailAt(p, mapping ? "a nested mapping needs braces" : "single-pair mappings in flow sequences are not supported");
+                }
+                PushScalar(scalar);
+                m_pos = scalar.end;
+                m_flowState = FlowState::CommaOrEnd;
+                return;
+            }
+            }
+        }
+    }
+
+    void YamlReader::OpenFlow(bool mapping, char const* at)
+    {
+        if (Depth() == MaxDepth)
+        {
+            FailAt(at, "nesting too deep");
+        }
+        uint64_t const bit = uint64_t{ 1 } << m_flowDepth;
+        m_flowMappings = mapping ? (m_flowMappings | bit) : (m_flowMappings & ~bit);
+        ++m_flowDepth;
+        Push(mapping ? JsonToken::BeginObject : JsonToken::BeginArray, at);
+        m_pos = at + 1;
+        m_flowState = mapping ? FlowState::KeyOrEnd : FlowState::ValueOrEnd;
+    }
+
+    void YamlReader::CloseFlow(char bracket)
+    {
+        bool const mapping = bracket == '}';
+        if (InFlowMapping() != mapping)
+        {
+            FailAt(m_pos, "mismatched closing bracket");
+        }
+        --m_flowDepth;
+        Push(mapping ? JsonToken::EndObject : JsonToken::EndArray, m_pos);
+        ++m_pos;
+        m_flowState = FlowState::CommaOrEnd;
+        if (m_flowDepth == 0)
+        {
+            // Back in block context, which continues on the next line.
+            if (m_blockDepth == 0)
+            {
+                m_finished = true;
+            }
+            EndLine(m_pos);
+        }
+    }
+
+    // Scans the scalar at `p` into `key` and reports whether a ':' makes it
+    // a mapping key; `afterColon` is set when it does.
+    bool YamlReader::TryScanKey(char const* p, bool flow, Scalar& key, char const*& afterColon)
+    {
+        key = ScanScalar(p, flow);
+        char const* const colon = SkipBlanks(key.end);
+        if (colon == m_end || *colon != ':')
+        {
+            return false;
+        }
+        char const next = colon + 1 < m_end ? colon[1] : '\n';
+        if (!IsBlank(next) && !IsBreak(next) && !key.quoted && !(flow && IsFlowIndicator(next)))
+        {
+            return false;
+        }
+        afterColon = colon + 1;
+        return true;
+    }
+
+    YamlReader::Scalar YamlReader::ScanScalar(char const* p, bool flow)
+    {
+        CheckNodeStart(p);
+        switch (*p)
+        {
+        case '"': return ScanDoubleQuoted(p);
+        case '\'': return ScanSingleQuoted(p);
+        default: return ScanPlain(p, flow);
+        }
+    }
+
+    YamlReader::Scalar YamlReader::ScanDoubleQuoted(char const* p)
+    {
+        bool escaped = false;
+        for (char const* q = p + 1; q < m_end; ++q)
+        {
+            char const c = *q;
+            if (c == '"')
+            {
+                return { ScalarText{ std::string_view(p + 1, q - p - 1), escaped ? ScalarEncoding::YamlDoubleQuoted : ScalarEncoding::Raw }, q + 1, true };
+            }
+            if (IsBreak(c))
+            {
+                FailAt(q, "multi-line quoted scalars are not supported");
+            }
+            if (c != '\\')
+            {
+                continue;
+            }
+
+            escaped = true;
+            if (++q == m_end)
+            {
+                break;
+            }
+            int digits = 0;
+            switch (*q)
+            {
+            case '0': case 'a': case 'b': case 't': case '\t': case 'n': case 'v': case 'f': case 'r': case 'e':
+            case ' ': case '"': case '/': case '\\': case 'N': case '_': case 'L': case 'P':
+                break;
+            case 'x': digits = 2; break;
+            case 'u': digits = 4; break;
+            case 'U': digits = 8; break;
+            default:
+                FailAt(q, "invalid escape sequence");
+            }
+            for (int i = 0; i < digits; ++i)
+            {
+                if (++q == m_end || !std::isxdigit(static_cast<unsigned char>(*q)))
+                {
+                    FailAt(q, "invalid hexadecimal escape");
+                }
+            }
+        }
+        FailAt(p, "unterminated string");
+    }
+
+    YamlReader::Scalar YamlReader::ScanSingleQuoted(char const* p)
+    {
+        bool doubled = false;
+        for (char const* q = p + 1; q < m_end; ++q)
+        {
+            if (*q == '\'')
+            {
+                if (q + 1 < m_end && q[1] == '\'')
+                {
+                    doubled = true;
+                    ++q;
+                    continue;
+                }
+                return { ScalarText{ std::string_view(p + 1, q - p - 1), doubled ? ScalarEncoding::YamlSingleQuoted : ScalarEncoding::Raw }, q + 1, true };
+            }
+            if (IsBreak(*q))
+            {
+                FailAt(q, "multi-line quoted scalars are not supported");
+            }
+        }
+        FailAt(p, "unterminated string");
+    }
+
+    // Runs to the end of the line, a comment, a ": " or, in flow context, a
+    // flow indicator; trailing blanks are not part of the value.
+    YamlReader::Scalar YamlReader::ScanPlain(char const* p, bool flow)
+    {
+        char const* end = p;
+        for (char const* q = p; q < m_end && !IsBreak(*q); ++q)
+        {
+            char const c = *q;
+            if (c == ':')
+            {
+                char const next = q + 1 < m_end ? q[1] : '\n';
+                if (IsBlank(next) || IsBreak(next) || (flow && IsFlowIndicator(next)))
+                {
+                    break;
+                }
+            }
+            else if (c == '#' && q > p && IsBlank(q[-1]))
+            {
+                break;
+            }
+            else if (flow && IsFlowIndicator(c))
+            {
+                break;
+            }
+            if (!IsBlank(c))
+            {
+                end = q + 1;
+            }
+        }
+        return { ScalarText{ std::string_view(p, end - p), ScalarEncoding::Raw }, end, false };
+    }
+
+    void YamlReader::CheckNodeStart(char const* p) const
+    {
+        char const next = p + 1 < m_end ? p[1] : '\n';
+        switch (*p)
+        {
+        case '&':
+        case '*':
+            FailAt(p, "anchors and aliases are not supported");
+        case '!':
+            FailAt(p, "tags are not supported");
+        case '|':
+        case '>':
+            FailAt(p, "block scalars are not supported");
+        case '%':
+            FailAt(p, "directives are not supported");
+        case '@':
+        case '`':
+        case ',':
+        case ']':
+        case '}':
+            FailAt(p, "unexpected character");
+        case '?':
+            if (IsBlank(next) || IsBreak(next))
+            {
+                FailAt(p, "complex keys are not supported");
+            }
+            break;
+        case ':':
+            if (IsBlank(next) || IsBreak(next))
+            {
+                FailAt(p, "empty keys are not supported");
+            }
+            break;
+        case '-':
+            if (IsBlank(next) || IsBreak(next))
+            {
+                FailAt(p, "unexpected sequence entry");
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    void YamlReader::PushScalar(Scalar const& scalar)
+    {
+        JsonToken const token = scalar.quoted ? JsonToken::String : Resolve(scalar.text.source);
+        Push(token, scalar.text.source.data() - (scalar.quoted ? 1 : 0), scalar.text);
+    }
+
+    void YamlReader::Push(JsonToken token, char const* at, ScalarText text)
+    {
+        if (m_queued == m_queue.size())
+        {
+            FailAt(at, "nesting too deep");
+        }
+        m_queue[m_queued++] = Pending{ token, text, at };
+    }
+
+    bool YamlReader::AtLineEnd(char const* p) const noexcept
+    {
+        return p == m_end || IsBreak(*p) || *p == '#';
+    }
+
+    bool YamlReader::IsDash(char const* p) const noexcept
+    {
+        return p < m_end && *p == '-' && (p + 1 == m_end || IsBlank(p[1]) || IsBreak(p[1]));
+    }
+
+    char const* YamlReader::SkipBlanks(char const* p) const noexcept
+    {
+        while (p < m_end && IsBlank(*p))
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    char const* YamlReader::NextLine(char const* p) const noexcept
+    {
+        while (p < m_end && *p != '\n')
+        {
+            ++p;
+        }
+        return p < m_end ? p + 1 : p;
+    }
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "Configuration/ConfigFieldSink.h"
+#include "Configuration/JsonReader.h"
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace khm
+{
+    // Pull tokenizer for the YAML that configs are written in. It produces
+    // the same tokens as JsonReader, so ConfigParser walks both formats with
+    // one schema, and like JsonReader it never allocates: scalars are views
+    // into the input.
+    //
+    // Supported: block and flow mappings and sequences, plain, single- and
+    // double-quoted scalars, comments and a leading "---". Plain scalars are
+    // resolved with the core schema (null/~, true/false, decimal integers);
+    // any scalar can also be read as a string. Rejected: anchors, aliases,
+    // tags, block scalars (| and >), multi-line scalars, complex keys and
+    // multiple documents. Malformed input throws ConfigurationError with a
+    // line:column position.
+    class YamlReader
+    {
+    public:
+        static constexpr uint32_t MaxDepth = 64;
+
+        // `name: 42` is a fine name in YAML.
+        static constexpr bool ScalarsAreStrings = true;
+
+        explicit YamlReader(std::string_view text) noexcept;
+
+        JsonToken Next();
+
+        // Skips the value whose first token was just returned by Next().
+        void SkipValue(JsonToken first);
+
+        // Valid after Key and every scalar token.
+        ScalarText const& Text() const noexcept { return m_text; }
+
+        // Valid after a Number token.
+        std::string_view NumberText() const noexcept { return m_text.source; }
+
+        [[noreturn]] void Fail(std::string_view message) const;
+
+    private:
+        enum class Block : uint8_t { Mapping, Sequence };
+
+        enum class FlowState : uint8_t
+        {
+            KeyOrEnd,   // after '{' or ',' in a mapping
+            Value,      // after ':'
+            ValueOrEnd, // after '[' or ',' in a sequence
+            CommaOrEnd, // after a value
+        };
+
+        struct OpenBlock
+        {
+            Block kind;
+            uint32_t indent;
+        };
+
+        struct Pending
+        {
+            JsonToken token;
+            ScalarText text;
+            char const* at;
+        };
+
+        struct Scalar
+        {
+            ScalarText text;
+            char const* end;
+            bool quoted;
+        };
+
+        // Block context: tokenizes lines until at least one token is queued.
+        void ScanLines();
+        void EndDocument();
+        void CloseBlocks(uint32_t column, bool dash);
+        void Open(Block kind, uint32_t indent, char const* at);
+        void Node(char const* p);
+        void Item(char const* p, uint32_t dashColumn);
+        void Value(char const* p, uint32_t keyColumn);
+        void EndLine(char const* p);
+
+        // Flow context: queues the next token of a { } or [ ] collection.
+        void ScanFlow();
+        void OpenFlow(bool mapping, char const* at);
+        void CloseFlow(char bracket);
+
+        bool TryScanKey(char const* p, bool flow, Scalar& key, char const*& afterColon);
+        Scalar ScanScalar(char const* p, bool flow);
+        Scalar ScanDoubleQuoted(char const* p);
+        Scalar ScanSingleQuoted(char const* p);
+        Scalar ScanPlain(char const* p, bool flow);
+        void CheckNodeStart(char const* p) const;
+        void PushScalar(Scalar const& scalar);
+        void Push(JsonToken token, char const* at, ScalarText text = {});
+
+        uint32_t Column(char const* p) const noexcept { return static_cast<uint32_t>(p - m_lineStart); }
+        bool AtLineEnd(char const* p) const noexcept; // also at a comment
+        bool IsDash(char const* p) const noexcept;    // a block sequence entry
+        char const* SkipBlanks(char const* p) const noexcept;
+        char const* NextLine(char const* p) const noexcept;
+        uint32_t Depth() const noexcept { return m_blockDepth + m_flowDepth; }
+        bool InFlowMapping() const noexcept { return (m_flowMappings >> (m_flowDepth - 1)) & 1; }
+        [[noreturn]] void FailAt(char const* at, std::string_view message) const;
+
+        char const* m_begin;
+        char const* m_pos;       // block context: start of the next line
+        char const* m_lineStart; // of the line being tokenized
+        char const* m_end;
+
+        std::array<OpenBlock, MaxDepth> m_blocks{};
+        uint32_t m_blockDepth = 0;
+        uint64_t m_flowMappings = 0; // bit n set: flow level n+1 is a mapping
+        uint32_t m_flowDepth = 0;
+        FlowState m_flowState = FlowState::ValueOrEnd;
+
+        // A key or "-" ended its line; the next line holds its value unless
+        // it is not indented past `m_awaitingIndent`.
+        bool m_awaiting = false;
+        bool m_awaitingInMapping = false;
+        uint32_t m_awaitingIndent = 0;
+
+        bool m_started = false;
+        bool m_finished = false; // the root node is complete
+        bool m_ended = false;    // every collection is closed
+
+        // Tokens of the current line, in order; one line can open and close
+        // several collections.
+        std::array<Pending, MaxDepth + 8> m_queue{};
+        uint32_t m_queued = 0;
+        uint32_t m_taken = 0;
+
+        ScalarText m_text;
+        char const* m_tokenAt;
+    };
+}
@@ -0,0 +1,261 @@
+#include "pch.h"
+#include "Core/ConflictAnalyzer.h"
+
+#include "Core/HotkeyDispatchTable.h"
+#include "Core/KeySequenceTable.h"
+#include "Utils/Hash.h"
+
+#include <algorithm>
+
+namespace khm
+{
+    namespace
+    {
+        constexpr uint32_t NoAction = HotkeyDispatchTable::NoAction;
+
+        void Insert(std::vector<uint32_t>& members, uint32_t action)
+        {
+            members.insert(std::ranges::lower_bound(members, action), action);
+        }
+
+        void Erase(std::vector<uint32_t>& members, uint32_t action) noexcept
+        {
+            auto const found = std::ranges::lower_bound(members, action);
+            if (found != members.end() && *found == action)
+            {
+                members.erase(found);
+            }
+        }
+
+        // True when the shorter of the two sequences is a prefix of the other.
+        bool Overlaps(ActionTable const& actions, ActionRecord const& a, ActionRecord const& b) noexcept
+        {
+            uint32_t const length = std::min(actions.SequenceLength(a), actions.SequenceLength(b));
+            for (uint32_t step = 0; step < length; ++step)
+            {
+                if (actions.SequenceStep(a, step) != actions.SequenceStep(b, step))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    void ConflictAnalyzer::Update(DispatchSnapshot const& snapshot)
+    {
+        ActionTable const& actions = snapshot.configuration.actions;
+        std::vector<BucketKey> dirty;
+
+        uint32_t const slots = std::max(actions.Size(), static_cast<uint32_t>(m_members.size()));
+        m_members.resize(slots);
+        for (uint32_t i = 0; i < slots; ++i)
+        {
+            Member const next = i < actions.Size() ? Describe(snapshot, i) : Member{};
+            Member& previous = m_members[i];
+            if (next == previous)
+            {
+                continue;
+            }
+            for (BucketKey const key : { previous.chord, previous.sequence })
+            {
+                if (key != NoBucket)
+                {
+                    Erase(m_buckets[key].members, i);
+                    dirty.push_back(key);
+                }
+            }
+            for (BucketKey const key : { next.chord, next.sequence })
+            {
+                if (key != NoBucket)
+                {
+                    Insert(m_buckets[key].members, i);
+                    dirty.push_back(key);
+                }
+            }
+            previous = next;
+        }
+        m_members.resize(actions.Size());
+
+        // Any chord can mask the sequences that start with it.
+        size_t const chords = dirty.size();
+        for (size_t i = 0; i < chords; ++i)
+        {
+            if (!IsSequenceBucket(dirty[i]))
+            {
+                dirty.push_back(SequenceBucket(BucketHotkey(dirty[i])));
+            }
+        }
+        std::ranges::sort(dirty);
+        dirty.erase(std::ranges::unique(dirty).begin(), dirty.end());
+
+        m_recomputed = 0;
+        for (BucketKey const key : dirty)
+        {
+            auto const found = m_buckets.find(key);
+            if (found == m_buckets.end())
+            {
+                continue;
+            }
+            if (found->second.members.empty())
+            {
+                m_buckets.erase(found);
+                continue;
+            }
+            Recompute(snapshot, key, found->second);
+            ++m_recomputed;
+        }
+
+        m_conflicts.clear();
+        for (auto const& [key, bucket] : m_buckets)
+        {
+            m_conflicts.insert(m_conflicts.end(), bucket.conflicts.begin(), bucket.conflicts.end());
+        }
+        std::ranges::sort(m_conflicts, [](Conflict const& a, Conflict const& b) {
+            return a.action != b.action ? a.action < b.action : a.kind < b.kind;
+        });
+    }
+
+    ConflictAnalyzer::Member ConflictAnalyzer::Describe(DispatchSnapshot const& snapshot, uint32_t index)
+    {
+        ActionTable const& actions = snapshot.configuration.actions;
+        ActionRecord const& action = actions[index];
+        Member member;
+        if (!action.enabled)
+        {
+            return member;
+        }
+
+        if (action.hasHotkey)
+        {
+            uint32_t const profile = index < snapshot.actionProfiles.size() ? snapshot.actionProfiles[index] : 0;
+            uint32_t const scope = profile == 0 ? 0 : ScopeOf(snapshot.profiles[profile - 1]);
+            member.chord = ChordBucket(scope, action.hotkey);
+        }
+
+        // Sequences the trie would reject outright are the loader's to report.
+        uint32_t const length = actions.SequenceLength(action);
+        bool valid = length >= MinSequenceLength && length <= MaxSequenceLength;
+        for (uint32_t step = 0; step < length && valid; ++step)
+        {
+            Hotkey const hotkey = actions.SequenceStep(action, step);
+            valid = hotkey.key != 0 && !IsModifierKey(hotkey.key);
+        }
+        if (valid)
+        {
+            std::string_view const steps = actions.String(action.sequence);
+            member.sequence = SequenceBucket(actions.SequenceStep(action, 0));
+            member.steps = Fnv1a64(std::as_bytes(std::span{ steps.data(), steps.size() }));
+        }
+        return member;
+    }
+
+    uint32_t ConflictAnalyzer::ScopeOf(std::wstring const& profileKey)
+    {
+        return m_scopes.try_emplace(profileKey, static_cast<uint32_t>(m_scopes.size() + 1)).first->second;
+    }
+
+    void ConflictAnalyzer::Recompute(DispatchSnapshot const& snapshot, BucketKey key, Bucket& bucket)
+    {
+        bucket.conflicts.clear();
+        Hotkey const hotkey = BucketHotkey(key);
+        if (IsSequenceBucket(key))
+        {
+            RecomputeSequences(snapshot, hotkey, bucket);
+            return;
+        }
+
+        // Every member of a chord bucket resolves through the same table.
+        uint32_t const winner = snapshot.TableOf(bucket.members.front()).Lookup(hotkey);
+        for (uint32_t const action : bucket.members)
+        {
+            if (winner != action && winner != NoAction)
+            {
+                bucket.conflicts.push_back({ ConflictKind::DuplicateChord, action, winner, hotkey });
+            }
+        }
+        if ((hotkey.modifiers & ModWin) != 0 && winner != NoAction && !IsRegistrable(hotkey))
+        {
+            bucket.conflicts.push_back({ ConflictKind::Reserved, winner, NoAction, hotkey });
+        }
+    }
+
+    void ConflictAnalyzer::RecomputeSequences(DispatchSnapshot const& snapshot, Hotkey first, Bucket& bucket)
+    {
+        ActionTable const& actions = snapshot.configuration.actions;
+        KeySequenceTable const& trie = *snapshot.sequences;
+
+        uint32_t const chord = snapshot.table->Lookup(first);
+        for (uint32_t const action : bucket.members)
+        {
+            ActionRecord const& record = actions[action];
+            if (chord != NoAction)
+            {
+                bucket.conflicts.push_back({ ConflictKind::MaskedSequence, action, chord, first });
+                continue;
+            }
+
+            // Walk the trie: a terminal on the way belongs to a sequence this
+            // one equals or extends.
+            uint32_t const length = actions.SequenceLength(record);
+            uint32_t state = KeySequenceTable::Root;
+            uint32_t other = NoAction;
+            for (uint32_t step = 0; step < length && state != KeySequenceTable::NoState; ++step)
+            {
+                state = trie.Next(state, actions.SequenceStep(record, step));
+                uint32_t const terminal = state == KeySequenceTable::NoState ? NoAction : trie.ActionAt(state);
+                if (terminal != NoAction && terminal != action)
+                {
+                    other = terminal;
+                    break;
+                }
+            }
+
+            if (other == NoAction && state != KeySequenceTable::NoState && trie.ActionAt(state) == action)
+            {
+                // Bound; a profile's chord still hides it in that app.
+                for (auto const& table : snapshot.profileTables)
+                {
+                    uint32_t const owner = table->Lookup(first);
+                    if (owner != NoAction)
+                    {
+                        bucket.conflicts.push_back({ ConflictKind::MaskedSequence, action, owner, first });
+                    }
+                }
+                continue;
+            }
+
+            // Otherwise it ends inside a longer sequence, which the trie
+            // cannot name; it is an earlier member of this bucket.
+            for (uint32_t const candidate : bucket.members)
+            {
+                if (other != NoAction || candidate >= action)
+                {
+                    break;
+                }
+                if (Overlaps(actions, record, actions[candidate]))
+                {
+                    other = candidate;
+                }
+            }
+            bucket.conflicts.push_back({ ConflictKind::SequencePrefix, action, other, first });
+        }
+    }
+
+    bool ConflictAnalyzer::IsRegistrable(Hotkey hotkey) noexcept
+    {
+        UINT modifiers = MOD_NOREPEAT;
+        if (hotkey.modifiers & ModWin) modifiers |= MOD_WIN;
+        if (hotkey.modifiers & ModCtrl) modifiers |= MOD_CONTROL;
+        if (hotkey.modifiers & ModShift) modifiers |= MOD_SHIFT;
+        if (hotkey.modifiers & ModAlt) modifiers |= MOD_ALT;
+
+        // Registered to this thread for as long as it takes to find out.
+        if (RegisterHotKey(nullptr, ProbeHotkeyId, modifiers, hotkey.key))
+        {
+            UnregisterHotKey(nullptr, ProbeHotkeyId);
+            return true;
+        }
+        return GetLastError() != ERROR_HOTKEY_ALREADY_REGISTERED;
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Core/DispatchSnapshot.h"
+#include "Core/Hotkey.h"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace khm
+{
+    enum class ConflictKind : uint8_t
+    {
+        DuplicateChord, // the same chord in the same scope; `other` keeps it
+        MaskedSequence, // the first step is a chord `other` owns (in its profile's app, if it has one)
+        SequencePrefix, // equals, extends or is a prefix of the sequence `other`
+        Reserved,       // RegisterHotKey refused the chord: Windows or another app owns it
+    };
+
+    struct Conflict
+    {
+        ConflictKind kind = ConflictKind::DuplicateChord;
+        uint32_t action = 0;  // the binding that loses
+        uint32_t other = 0;   // the binding it loses to; NoAction for Reserved
+        Hotkey hotkey;
+    };
+
+    // Finds the bindings of a snapshot that cannot fire as written. Bindings
+    // are bucketed by (scope, chord), sequences by their first step, and
+    // winners are read back from the compiled tables and trie, so a report
+    // always matches what the hook does. Action slots survive a reload, so
+    // Update() only re-examines the buckets whose members changed. Not
+    // thread-safe; the settings thread owns one.
+    class ConflictAnalyzer
+    {
+    public:
+        void Update(DispatchSnapshot const& snapshot);
+
+        // Ordered by losing action.
+        std::span<Conflict const> Conflicts() const noexcept { return m_conflicts; }
+
+        // Buckets the last Update() re-examined.
+        uint32_t RecomputedBuckets() const noexcept { return m_recomputed; }
+
+    private:
+        using BucketKey = uint64_t;
+        static constexpr BucketKey NoBucket = UINT64_MAX;
+        static constexpr int ProbeHotkeyId = 0xB000;
+
+        struct Member
+        {
+            BucketKey chord = NoBucket;
+            BucketKey sequence = NoBucket;
+            uint64_t steps = 0; // fingerprint of the sequence
+
+            bool operator==(Member const&) const noexcept = default;
+        };
+
+        struct Bucket
+        {
+            std::vector<uint32_t> members; // ascending action index
+            std::vector<Conflict> conflicts;
+        };
+
+        static constexpr BucketKey ChordBucket(uint32_t scope, Hotkey hotkey) noexcept
+        {
+            return (static_cast<uint64_t>(scope) << 13) | hotkey.Index();
+        }
+
+        static constexpr BucketKey SequenceBucket(Hotkey first) noexcept
+        {
+            return (uint64_t{ 1 } << 12) | first.Index();
+        }
+
+        static constexpr Hotkey BucketHotkey(BucketKey key) noexcept
+        {
+            return Hotkey{ static_cast<uint8_t>((key >> 8) & 0x0F), static_cast<uint8_t>(key) };
+        }
+
+        static constexpr bool IsSequenceBucket(BucketKey key) noexcept { return (key & (uint64_t{ 1 } << 12)) != 0; }
+
+        Member Describe(DispatchSnapshot const& snapshot, uint32_t index);
+        uint32_t ScopeOf(std::wstring const& profileKey);
+        void Recompute(DispatchSnapshot const& snapshot, BucketKey key, Bucket& bucket);
+        void RecomputeSequences(DispatchSnapshot const& snapshot, Hotkey first, Bucket& bucket);
+        static bool IsRegistrable(Hotkey hotkey) noexcept;
+
+        std::vector<Member> m_members; // per action slot
+        std::unordered_map<BucketKey, Bucket> m_buckets;
+        std::unordered_map<std::wstring, uint32_t> m_scopes; // profile keys, interned for the analyzer's lifetime
+        std::vector<Conflict> m_conflicts;
+        uint32_t m_recomputed = 0;
+    };
+}
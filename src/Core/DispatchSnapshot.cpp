@@ -0,0 +1,162 @@
+#include "pch.h"
+#include "Core/DispatchSnapshot.h"
+
+#include "Utils/Text.h"
+
+namespace khm
+{
+    namespace
+    {
+        std::unique_ptr<KeySequenceTable> CompileSequences(LoadedConfiguration const& configuration, HotkeyDispatchTable const& chords)
+        {
+            return KeySequenceTable::Compile(configuration.actions, chords, configuration.settings.sequenceTimeoutMs);
+        }
+
+        void CompileProfiles(DispatchSnapshot& snapshot)
+        {
+            ActionTable const& actions = snapshot.configuration.actions;
+            snapshot.actionProfiles.assign(actions.Size(), 0);
+            for (uint32_t i = 0; i < actions.Size(); ++i)
+            {
+                ActionRecord const& action = actions[i];
+                if (action.profile.length == 0 || !action.enabled || !action.hasHotkey)
+                {
+                    continue;
+                }
+                std::wstring key = DispatchSnapshot::ProfileKey(Widen(actions.String(action.profile)));
+                uint32_t profile = snapshot.FindProfile(key);
+                if (profile == 0)
+                {
+                    snapshot.profiles.push_back(std::move(key));
+                    profile = static_cast<uint32_t>(snapshot.profiles.size());
+                }
+                snapshot.actionProfiles[i] = profile;
+            }
+
+            for (uint32_t profile = 1; profile <= snapshot.profiles.size(); ++profile)
+            {
+                snapshot.profileTables.push_back(HotkeyDispatchTable::CompileProfile(actions, snapshot.actionProfiles, profile));
+            }
+            for (uint32_t i = 0; i < actions.Size(); ++i)
+            {
+                uint32_t const profile = snapshot.actionProfiles[i];
+                if (profile != 0 && snapshot.profileTables[profile - 1]->Lookup(actions[i].hotkey) == i)
+                {
+                    ++snapshot.profileBindingCount;
+                }
+            }
+        }
+
+        bool SameSettings(Settings const& a, Settings const& b) noexcept
+        {
+            return a.startWithWindows == b.startWithWindows
+                && a.showTrayIcon == b.showTrayIcon
+                && a.enableLogging == b.enableLogging
+                && a.logLevel == b.logLevel
+                && a.sequenceTimeoutMs == b.sequenceTimeoutMs
+                && a.hookPriority == b.hookPriority
+                && a.actionQos == b.actionQos;
+        }
+    }
+
+    std::unique_ptr<DispatchSnapshot> DispatchSnapshot::Create(LoadedConfiguration configuration)
+    {
+        auto snapshot = std::make_unique<DispatchSnapshot>();
+        snapshot->configuration = std::move(configuration);
+        snapshot->table = HotkeyDispatchTable::Compile(snapshot->configuration.actions);
+        snapshot->sequences = CompileSequences(snapshot->configuration, *snapshot->table);
+        CompileProfiles(*snapshot);
+        snapshot->generation = 1;
+        snapshot->actionsGeneration = 1;
+        return snapshot;
+    }
+
+    std::unique_ptr<DispatchSnapshot> DispatchSnapshot::Create(LoadedConfiguration configuration, std::unique_ptr<HotkeyDispatchTable> table)
+    {
+        auto snapshot = std::make_unique<DispatchSnapshot>();
+        snapshot->configuration = std::move(configuration);
+        snapshot->table = std::move(table);
+        snapshot->sequences = CompileSequences(snapshot->configuration, *snapshot->table);
+        CompileProfiles(*snapshot);
+        snapshot->generation = 1;
+        snapshot->actionsGeneration = 1;
+        return snapshot;
+    }
+
+    std::unique_ptr<DispatchSnapshot> DispatchSnapshot::Reload(DispatchSnapshot const& current, LoadedConfiguration next, ConfigurationDiff& diff)
+    {
+        ActionTable aligned = AlignToSlots(current.configuration.actions, next.actions, diff);
+        if (diff.Empty() && SameSettings(current.configuration.settings, next.settings) && current.configuration.version == next.version
+            && current.configuration.sourceHash == next.sourceHash)
+        {
+            return nullptr;
+        }
+
+        auto snapshot = std::make_unique<DispatchSnapshot>();
+        snapshot->configuration.version = std::move(next.version);
+        snapshot->configuration.settings = next.settings;
+        snapshot->configuration.actions = std::move(aligned);
+        snapshot->configuration.sourceHash = next.sourceHash;
+        snapshot->table = HotkeyDispatchTable::Compile(snapshot->configuration.actions);
+        snapshot->sequences = CompileSequences(snapshot->configuration, *snapshot->table);
+        CompileProfiles(*snapshot);
+        snapshot->generation = current.generation + 1;
+        snapshot->actionsGeneration = snapshot->generation;
+        return snapshot;
+    }
+
+    std::unique_ptr<DispatchSnapshot> DispatchSnapshot::WithEnabled(DispatchSnapshot const& current, uint32_t slot, bool enabled)
+    {
+        auto snapshot = std::make_unique<DispatchSnapshot>();
+        snapshot->configuration.version = current.configuration.version;
+        snapshot->configuration.settings = current.configuration.settings;
+        snapshot->configuration.actions = current.configuration.actions.Clone();
+        snapshot->configuration.sourceHash = current.configuration.sourceHash;
+        snapshot->configuration.actions.MutableRecords()[slot].enabled = enabled;
+        snapshot->table = HotkeyDispatchTable::Compile(snapshot->configuration.actions);
+        snapshot->sequences = CompileSequences(snapshot->configuration, *snapshot->table);
+        CompileProfiles(*snapshot);
+        snapshot->generation = current.generation + 1;
+        snapshot->actionsGeneration = current.actionsGeneration;
+        return snapshot;
+    }
+
+    uint32_t DispatchSnapshot::FindProfile(std::wstring_view key) const noexcept
+    {
+        // A handful of profiles at most; resolved off the hook thread.
+        for (size_t i = 0; i < profiles.size(); ++i)
+        {
+            if (profiles[i] == key)
+            {
+                return static_cast<uint32_t>(i + 1);
+            }
+        }
+        return 0;
+    }
+
+    void DispatchSnapshot::AppendHotRanges(std::vector<MemoryRange>& ranges) const
+    {
+        // Process() checks the matched record's passThrough.
+        std::span<ActionRecord const> const records = configuration.actions.Records();
+        ranges.push_back({ this, sizeof(*this) });
+        ranges.push_back({ records.data(), records.size_bytes() });
+        ranges.push_back({ table.get(), sizeof(HotkeyDispatchTable) });
+        ranges.push_back({ profileTables.data(), profileTables.size() * sizeof(profileTables[0]) });
+        for (auto const& profileTable : profileTables)
+        {
+            ranges.push_back({ profileTable.get(), sizeof(HotkeyDispatchTable) });
+        }
+        sequences->AppendHotRanges(ranges);
+    }
+
+    std::wstring DispatchSnapshot::ProfileKey(std::wstring_view imageOrName)
+    {
+        size_t const separator = imageOrName.find_last_of(L"\\/");
+        std::wstring key{ separator == std::wstring_view::npos ? imageOrName : imageOrName.substr(separator + 1) };
+        if (!key.empty())
+        {
+            CharUpperBuffW(key.data(), static_cast<DWORD>(key.size()));
+        }
+        return key;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Configuration/Configuration.h"
+#include "Configuration/ConfigurationDiff.h"
+#include "Core/HotkeyDispatchTable.h"
+#include "Core/KeySequenceTable.h"
+#include "Utils/RcuPointer.h"
+#include "Utils/WorkingSet.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace khm
+{
+    // Everything the hook and executor read for one configuration generation.
+    // Published as a unit through DispatchSnapshotPointer; never mutated once
+    // published.
+    struct DispatchSnapshot
+    {
+        LoadedConfiguration configuration;
+        std::unique_ptr<HotkeyDispatchTable> table;
+        std::unique_ptr<KeySequenceTable> sequences;
+        uint64_t generation = 0;
+        // The generation whose actions ActionCache prepared; older than
+        // `generation` when only enabled flags changed since (see WithEnabled).
+        uint64_t actionsGeneration = 0;
+
+        // Per-foreground-app bindings. `profiles` holds the ProfileKey() of
+        // each profile, `actionProfiles` each action's profile (0 for global,
+        // else an index + 1 into `profiles`) and `profileTables` the table the
+        // hook uses while that profile's app is in the foreground.
+        std::vector<std::wstring> profiles;
+        std::vector<uint32_t> actionProfiles;
+        std::vector<std::unique_ptr<HotkeyDispatchTable>> profileTables;
+        uint32_t profileBindingCount = 0;
+
+        static std::unique_ptr<DispatchSnapshot> Create(LoadedConfiguration configuration);
+        // `table` comes from the cache; sequences are cheap enough to recompile.
+        static std::unique_ptr<DispatchSnapshot> Create(LoadedConfiguration configuration, std::unique_ptr<HotkeyDispatchTable> table);
+
+        // Chords plus sequences, as shown on the tray icon.
+        uint32_t BindingCount() const noexcept { return table->BindingCount() + sequences->SequenceCount() + profileBindingCount; }
+
+        // What ForegroundTracker publishes for the hook; a context resolved
+        // against another generation falls back to the global table.
+        static constexpr uint64_t ProfileContext(uint64_t generation, uint32_t profile) noexcept
+        {
+            return (generation << 32) | profile;
+        }
+
+        HotkeyDispatchTable const& TableFor(uint64_t context) const noexcept
+        {
+            uint32_t const profile = static_cast<uint32_t>(context);
+            if (profile != 0 && profile <= profileTables.size() && (context >> 32) == (generation & 0xFFFFFFFF))
+            {
+                return *profileTables[profile - 1];
+            }
+            return *table;
+        }
+
+        // The table `actionIndex` is bound in.
+        HotkeyDispatchTable const& TableOf(uint32_t actionIndex) const noexcept
+        {
+            uint32_t const profile = actionIndex < actionProfiles.size() ? actionProfiles[actionIndex] : 0;
+            return profile == 0 ? *table : *profileTables[profile - 1];
+        }
+
+        // Profile number for an executable's ProfileKey(), 0 when it has none.
+        uint32_t FindProfile(std::wstring_view key) const noexcept;
+
+        // Everything the hook reads from this generation, for WorkingSet::Pin().
+        void AppendHotRanges(std::vector<MemoryRange>& ranges) const;
+
+        // Case-folded file name of an executable path or name.
+        static std::wstring ProfileKey(std::wstring_view imageOrName);
+
+        // Builds the successor of `current` with action slots kept stable by id.
+        // Returns null when the new configuration changes nothing.
+        static std::unique_ptr<DispatchSnapshot> Reload(DispatchSnapshot const& current, LoadedConfiguration next, ConfigurationDiff& diff);
+
+        // The successor of `current` with one action enabled or disabled: no
+        // alignment, and its prepared actions carry over. `slot` must name a
+        // live action.
+        static std::unique_ptr<DispatchSnapshot> WithEnabled(DispatchSnapshot const& current, uint32_t slot, bool enabled);
+    };
+
+    using DispatchSnapshotPointer = RcuPointer<DispatchSnapshot>;
+}
@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "Core/ForegroundTracker.h"
+
+namespace khm
+{
+    ForegroundTracker::ForegroundTracker(DispatchSnapshotPointer& snapshots) :
+        m_snapshots(snapshots.RegisterReader())
+    {
+    }
+
+    ForegroundTracker::~ForegroundTracker()
+    {
+        Stop();
+    }
+
+    void ForegroundTracker::Start()
+    {
+        if (m_thread.joinable())
+        {
+            return;
+        }
+        m_ready = winrt::handle(winrt::check_pointer(CreateEventW(nullptr, TRUE, FALSE, nullptr)));
+        m_thread = std::thread([this] { Run(); });
+
+        // Stop() and Refresh() post to the thread, so it must own a queue first.
+        WaitForSingleObject(m_ready.get(), INFINITE);
+    }
+
+    void ForegroundTracker::Stop() noexcept
+    {
+        if (!m_thread.joinable())
+        {
+            return;
+        }
+        PostThreadMessageW(m_threadId, WM_QUIT, 0, 0);
+        m_thread.join();
+        m_context.store(0, std::memory_order_release);
+        m_processId = 0;
+        m_imageKey.clear();
+    }
+
+    void ForegroundTracker::Refresh() noexcept
+    {
+        if (m_thread.joinable())
+        {
+            PostThreadMessageW(m_threadId, RefreshMessage, 0, 0);
+        }
+    }
+
+    void ForegroundTracker::Run() noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), L"khm.foreground");
+
+        m_threadId = GetCurrentThreadId();
+        MSG msg;
+        PeekMessageW(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+        s_active = this;
+
+        // Our own windows count too: the Settings window has no profile.
+        HWINEVENTHOOK const hook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, nullptr, OnWinEvent, 0, 0, WINEVENT_OUTOFCONTEXT);
+        SetEvent(m_ready.get());
+
+        if (hook != nullptr)
+        {
+            OnForeground(GetForegroundWindow());
+            while (GetMessageW(&msg, nullptr, 0, 0) > 0)
+            {
+                if (msg.message == RefreshMessage)
+                {
+                    Resolve();
+                    continue;
+                }
+                DispatchMessageW(&msg);
+            }
+            UnhookWinEvent(hook);
+        }
+        else
+        {
+            OutputDebugStringA("KeyboardHookManager: foreground hook failed\n");
+        }
+        s_active = nullptr;
+    }
+
+    void CALLBACK ForegroundTracker::OnWinEvent(HWINEVENTHOOK, DWORD, HWND window, LONG object, LONG child, DWORD, DWORD) noexcept
+    {
+        if (s_active != nullptr && object == OBJID_WINDOW && child == CHILDID_SELF)
+        {
+            s_active->OnForeground(window);
+        }
+    }
+
+    void ForegroundTracker::OnForeground(HWND window) noexcept
+    {
+        DWORD processId = 0;
+        if (window != nullptr)
+        {
+            GetWindowThreadProcessId(window, &processId);
+        }
+        if (processId == m_processId && processId != 0)
+        {
+            return; // another window of the same app
+        }
+        m_processId = processId;
+
+        try
+        {
+            m_imageKey.clear();
+            winrt::handle const process{ processId != 0 ? OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId) : nullptr };
+            wchar_t image[MAX_PATH * 2];
+            DWORD imageLength = ARRAYSIZE(image);
+            if (process && QueryFullProcessImageNameW(process.get(), 0, image, &imageLength))
+            {
+                m_imageKey = DispatchSnapshot::ProfileKey({ image, imageLength });
+            }
+        }
+        catch (...)
+        {
+            m_imageKey.clear();
+        }
+        Resolve();
+    }
+
+    void ForegroundTracker::Resolve() noexcept
+    {
+        uint64_t context = 0;
+        {
+            RcuReadGuard<DispatchSnapshot> const snapshot(m_snapshots);
+            uint32_t const profile = m_imageKey.empty() ? 0 : snapshot->FindProfile(m_imageKey);
+            if (profile != 0)
+            {
+                context = DispatchSnapshot::ProfileContext(snapshot->generation, profile);
+            }
+        }
+        m_context.store(context, std::memory_order_release);
+    }
+}
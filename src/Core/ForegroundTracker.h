@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Core/DispatchSnapshot.h"
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace khm
+{
+    // Follows EVENT_SYSTEM_FOREGROUND on its own thread and resolves the
+    // foreground executable to a binding profile of the current snapshot,
+    // so the hook picks its dispatch table with one atomic load instead of
+    // querying the foreground process on every key.
+    class ForegroundTracker
+    {
+    public:
+        explicit ForegroundTracker(DispatchSnapshotPointer& snapshots);
+        ~ForegroundTracker();
+
+        ForegroundTracker(ForegroundTracker const&) = delete;
+        ForegroundTracker& operator=(ForegroundTracker const&) = delete;
+
+        // Both are idempotent. Only runs while some action has a profile.
+        void Start();
+        void Stop() noexcept;
+
+        // Re-resolves the foreground app against a newly published snapshot.
+        // Any thread.
+        void Refresh() noexcept;
+
+        // Hook thread: the context to pass to DispatchSnapshot::TableFor.
+        uint64_t Context() const noexcept { return m_context.load(std::memory_order_acquire); }
+
+    private:
+        static constexpr UINT RefreshMessage = WM_APP;
+
+        static void CALLBACK OnWinEvent(HWINEVENTHOOK hook, DWORD event, HWND window, LONG object, LONG child, DWORD thread, DWORD time) noexcept;
+
+        void Run() noexcept;
+        void OnForeground(HWND window) noexcept;
+        void Resolve() noexcept;
+
+        static inline ForegroundTracker* s_active = nullptr; // set on the tracker thread
+
+        DispatchSnapshotPointer::Reader& m_snapshots;
+        std::atomic<uint64_t> m_context{ 0 };
+
+        std::thread m_thread;
+        DWORD m_threadId = 0;
+        winrt::handle m_ready;
+
+        // Tracker thread only.
+        DWORD m_processId = 0;
+        std::wstring m_imageKey;
+    };
+}
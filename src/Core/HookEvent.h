@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Core/HookProcessor.h"
+#include "Utils/Instrumentation.h"
+#include "Utils/SpscRing.h"
+
+#include <cstdint>
+
+namespace khm
+{
+    // What the hook hands to the executor: everything else is looked up
+    // from the action table on the executor side.
+    struct HookEvent
+    {
+        uint32_t actionIndex;
+        uint8_t modifiers;
+        uint8_t vk;
+        uint16_t reserved;
+        int64_t timestamp; // QPC ticks, see IHotkeyHandler::OnHotkey
+    };
+    static_assert(sizeof(HookEvent) == 16);
+
+    inline constexpr size_t HookEventRingCapacity = 1024;
+
+    // The hook thread is the only producer and the executor thread the only consumer.
+    class HookEventRing final : public IHotkeyHandler, public SpscRing<HookEvent, HookEventRingCapacity>
+    {
+    public:
+        void OnHotkey(uint32_t actionIndex, KBDLLHOOKSTRUCT const& event, uint8_t modifiers, int64_t timestamp) noexcept override
+        {
+            bool const pushed = TryPush(HookEvent{ actionIndex, modifiers, static_cast<uint8_t>(event.vkCode), 0, timestamp });
+            if (pushed && Instrumentation::Enabled())
+            {
+                Instrumentation::Record(LatencyStage::Handoff, Instrumentation::Now() - timestamp);
+            }
+        }
+    };
+}
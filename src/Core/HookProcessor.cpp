@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "Core/HookProcessor.h"
+
+#include "Utils/Instrumentation.h"
+#include "Utils/Logger.h"
+
+// All of it runs inside the hook callback; the section stays locked in
+// memory while the process is trimmed (see WorkingSet).
+#pragma code_seg(push, ".text$khm_hot")
+
+namespace khm
+{
+    namespace
+    {
+        constexpr LogFormat HotkeyMatched{ LogLevel::Debug, "hotkey modifiers={x} vk={x} matched action {}" };
+    }
+
+    bool HookProcessor::Process(WPARAM message, KBDLLHOOKSTRUCT const& event, uint8_t modifiers) noexcept
+    {
+        if (event.dwExtraInfo == InjectedEventTag)
+        {
+            return false;
+        }
+        if (m_recorder != nullptr)
+        {
+            m_recorder->Record(message, event, modifiers);
+        }
+
+        int64_t const entered = Instrumentation::Enabled() ? Instrumentation::Now() : 0;
+        uint8_t const vk = static_cast<uint8_t>(event.vkCode);
+        bool const keyDown = message == WM_KEYDOWN || message == WM_SYSKEYDOWN;
+
+        if (!keyDown)
+        {
+            if (m_suppressedKeys.test(vk))
+            {
+                m_suppressedKeys.reset(vk);
+                return Swallows();
+            }
+            if ((vk == VK_LWIN || vk == VK_RWIN) && m_winChordFired)
+            {
+                m_winChordFired = false;
+                SendStartMenuMask();
+            }
+            return false;
+        }
+
+        if (m_suppressedKeys.test(vk))
+        {
+            // Autorepeat of a trigger key that is still held.
+            return Swallows();
+        }
+
+        // Never a chord trigger, and pressing Ctrl between "Ctrl+K" and "N"
+        // must not cancel the sequence.
+        if (m_snapshots == nullptr || IsModifierKey(vk))
+        {
+            return false;
+        }
+
+        uint32_t actionIndex = HotkeyDispatchTable::NoAction;
+        bool stepped = false;
+        {
+            RcuReadGuard<DispatchSnapshot> const snapshot(*m_snapshots);
+            KeySequenceTable const& sequences = *snapshot->sequences;
+            Hotkey const hotkey{ modifiers, vk };
+
+            // Sequence steps are always swallowed, so they belong to the hook.
+            if (Swallows() && m_sequenceState != KeySequenceTable::Root)
+            {
+                // event.time is in milliseconds; the unsigned difference
+                // survives its 49-day wrap.
+                bool const live = m_sequenceGeneration == snapshot->generation && event.time - m_sequenceTime <= sequences.TimeoutMs();
+                uint32_t const next = live ? sequences.Next(m_sequenceState, hotkey) : KeySequenceTable::NoState;
+                m_sequenceState = KeySequenceTable::Root;
+                if (next != KeySequenceTable::NoState)
+                {
+                    stepped = true;
+                    actionIndex = sequences.ActionAt(next);
+                    if (actionIndex == HotkeyDispatchTable::NoAction)
+                    {
+                        m_sequenceState = next;
+                        m_sequenceTime = event.time;
+                    }
+                }
+            }
+
+            // A key that breaks a pending sequence is matched from scratch.
+            if (!stepped)
+            {
+                uint64_t const context = m_foreground != nullptr ? m_foreground->Context() : 0;
+                actionIndex = snapshot->TableFor(context).Lookup(modifiers, vk);
+                if (actionIndex != HotkeyDispatchTable::NoAction
+                    && snapshot->configuration.actions[actionIndex].passThrough == Swallows())
+                {
+                    // The other key source's binding.
+                    actionIndex = HotkeyDispatchTable::NoAction;
+                }
+                else if (actionIndex == HotkeyDispatchTable::NoAction && Swallows())
+                {
+                    uint32_t const next = sequences.Next(KeySequenceTable::Root, hotkey);
+                    if (next != KeySequenceTable::NoState)
+                    {
+                        // Sequences have at least two steps, so this is never final.
+                        stepped = true;
+                        m_sequenceState = next;
+                        m_sequenceGeneration = snapshot->generation;
+                        m_sequenceTime = event.time;
+                    }
+                }
+            }
+        }
+
+        if (actionIndex == HotkeyDispatchTable::NoAction)
+        {
+            if (stepped)
+            {
+                // Part of a sequence: the application must not see it.
+                m_suppressedKeys.set(vk);
+                m_winChordFired |= (modifiers & ModWin) != 0;
+                return true;
+            }
+            return false;
+        }
+
+        int64_t const matched = Instrumentation::Now();
+        if (entered != 0)
+        {
+            Instrumentation::Record(LatencyStage::Match, matched - entered);
+        }
+
+        Log(HotkeyMatched, modifiers, vk, actionIndex);
+        m_suppressedKeys.set(vk);
+        // A passed-through chord reaches the shell whole, so releasing Win opens nothing.
+        if ((modifiers & ModWin) && Swallows())
+        {
+            m_winChordFired = true;
+        }
+        if (m_handler != nullptr)
+        {
+            m_handler->OnHotkey(actionIndex, event, modifiers, entered != 0 ? entered : matched);
+        }
+        return Swallows();
+    }
+
+    void HookProcessor::SendStartMenuMask() noexcept
+    {
+        INPUT inputs[2]{};
+        for (INPUT& input : inputs)
+        {
+            input.type = INPUT_KEYBOARD;
+            input.ki.wVk = MenuMaskKey;
+            input.ki.dwExtraInfo = InjectedEventTag;
+        }
+        inputs[1].ki.dwFlags = KEYEVENTF_KEYUP;
+        SendInput(ARRAYSIZE(inputs), inputs, sizeof(INPUT));
+    }
+}
+
+#pragma code_seg(pop)
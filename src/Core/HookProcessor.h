@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Core/DispatchSnapshot.h"
+#include "Core/ForegroundTracker.h"
+#include "Core/HotkeyDispatchTable.h"
+#include "Core/InputTrace.h"
+
+#include <windows.h>
+
+#include <bitset>
+#include <cstdint>
+
+namespace khm
+{
+    // dwExtraInfo stamped on every event we inject ourselves ("KHM").
+    inline constexpr ULONG_PTR InjectedEventTag = 0x004B484D;
+
+    // Unassigned virtual key, tapped so that the shell does not treat a lone
+    // Win (or an application a lone Alt) release as a menu request.
+    inline constexpr WORD MenuMaskKey = 0xE8;
+
+    class IHotkeyHandler
+    {
+    public:
+        virtual ~IHotkeyHandler() = default;
+
+        // Runs on the hook thread; must not block or allocate. `timestamp` is
+        // the QPC value at hook entry when instrumentation is enabled and at
+        // match time otherwise.
+        virtual void OnHotkey(uint32_t actionIndex, KBDLLHOOKSTRUCT const& event, uint8_t modifiers, int64_t timestamp) noexcept = 0;
+    };
+
+    enum class HookMode : uint8_t
+    {
+        Intercept, // WH_KEYBOARD_LL: sequences and the chords that swallow their key
+        Observe,   // Raw Input: passThrough chords only; nothing can be swallowed
+    };
+
+    // Hot-path key matching, separated from the Win32 hook so that it can be
+    // driven directly with synthetic KBDLLHOOKSTRUCT streams. Each key source
+    // owns a processor; the two modes split the bindings between them.
+    class HookProcessor
+    {
+    public:
+        // Call before the key source starts.
+        void SetMode(HookMode mode) noexcept { m_mode = mode; }
+
+        // Call before the hook is installed. The tables are re-read from the
+        // current snapshot on every key-down, so reloads take effect without
+        // reinstalling the hook.
+        void Attach(DispatchSnapshotPointer& snapshots) { m_snapshots = &snapshots.RegisterReader(); }
+        void SetHandler(IHotkeyHandler* handler) noexcept { m_handler = handler; }
+
+        // Chords are looked up in the table of the foreground app's profile.
+        void SetForeground(ForegroundTracker const* foreground) noexcept { m_foreground = foreground; }
+
+        // Every event Process() is given from then on, except our own
+        // injected input, is also handed to `recorder`. Call before the key
+        // source starts.
+        void SetRecorder(InputRecorder* recorder) noexcept { m_recorder = recorder; }
+
+        // Returns true when the event belongs to a binding and must be
+        // swallowed; always false in Observe mode. `modifiers` are the
+        // ModifierFlags held at the event, as the key source's
+        // ModifierTracker reports them.
+        bool Process(WPARAM message, KBDLLHOOKSTRUCT const& event, uint8_t modifiers) noexcept;
+
+    private:
+        static void SendStartMenuMask() noexcept;
+
+        bool Swallows() const noexcept { return m_mode == HookMode::Intercept; }
+
+        HookMode m_mode = HookMode::Intercept;
+        DispatchSnapshotPointer::Reader* m_snapshots = nullptr;
+        IHotkeyHandler* m_handler = nullptr;
+        ForegroundTracker const* m_foreground = nullptr;
+        InputRecorder* m_recorder = nullptr;
+
+        // Trigger keys whose key-down we swallowed; their autorepeat and
+        // key-up are swallowed too so applications never see half a chord.
+        // In Observe mode they only keep autorepeat from firing again.
+        std::bitset<VirtualKeyCount> m_suppressedKeys;
+        bool m_winChordFired = false;
+
+        // Pending key sequence; the state only means something in the
+        // snapshot generation it was reached in.
+        uint32_t m_sequenceState = KeySequenceTable::Root;
+        uint64_t m_sequenceGeneration = 0;
+        DWORD m_sequenceTime = 0;
+    };
+}
@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "Core/HookWatchdog.h"
+
+#include "Utils/Logger.h"
+
+#include <algorithm>
+
+namespace khm
+{
+    namespace
+    {
+        constexpr LogFormat HookSilent{ LogLevel::Warning, "keyboard hook stopped delivering; reinstalling (previous reinstalls: {})" };
+        constexpr LogFormat HookOverrun{ LogLevel::Warning, "keyboard event answered past LowLevelHooksTimeout ({} ms)" };
+    }
+
+    HookWatchdog::HookWatchdog(KeyboardHook& hook) noexcept :
+        m_hook(hook)
+    {
+    }
+
+    HookWatchdog::~HookWatchdog()
+    {
+        Stop();
+    }
+
+    void HookWatchdog::Start()
+    {
+        if (m_thread.joinable())
+        {
+            return;
+        }
+        m_stop = winrt::handle(winrt::check_pointer(CreateEventW(nullptr, TRUE, FALSE, nullptr)));
+        m_nextProbe = 0;
+        m_backoffMs = QuietMs;
+        m_suspect = false;
+        m_thread = std::thread([this] { Run(); });
+    }
+
+    void HookWatchdog::Stop() noexcept
+    {
+        if (m_thread.joinable())
+        {
+            SetEvent(m_stop.get());
+            m_thread.join();
+        }
+    }
+
+    void HookWatchdog::Run() noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), L"khm.hook-watchdog");
+
+        while (WaitForSingleObject(m_stop.get(), PollIntervalMs) == WAIT_TIMEOUT)
+        {
+            ULONGLONG const now = GetTickCount64();
+            if (!ShouldProbe(now))
+            {
+                continue;
+            }
+            if (Probe())
+            {
+                m_suspect = false;
+                m_backoffMs = QuietMs;
+                m_nextProbe = now + QuietMs;
+                continue;
+            }
+
+            Log(HookSilent, KeyboardHook::Health().reinstalls);
+            m_hook.Reinstall();
+            m_suspect = true;
+            m_reinstalledAt = GetTickCount();
+            // A canary can also be lost to a secure desktop, so repeated
+            // failures are retried ever more slowly.
+            m_nextProbe = now + m_backoffMs;
+            m_backoffMs = std::min(m_backoffMs * 2, MaxBackoffMs);
+        }
+    }
+
+    bool HookWatchdog::ShouldProbe(ULONGLONG now) noexcept
+    {
+        if (m_hook.TakeOverrun())
+        {
+            Log(HookOverrun, KeyboardHook::Health().timeoutMs);
+            return true;
+        }
+        if (!m_suspect || now < m_nextProbe)
+        {
+            return false;
+        }
+
+        // A keystroke since the reinstall shows the new hook works.
+        if (m_hook.IdleMs() < GetTickCount() - m_reinstalledAt)
+        {
+            m_suspect = false;
+            m_backoffMs = QuietMs;
+            return false;
+        }
+        return true;
+    }
+
+    bool HookWatchdog::Probe() noexcept
+    {
+        uint64_t const seen = m_hook.Canaries();
+        if (!m_hook.InjectCanary())
+        {
+            return true; // refused, e.g. by UIPI: no evidence either way
+        }
+        if (WaitForSingleObject(m_stop.get(), CanaryTimeoutMs) != WAIT_TIMEOUT)
+        {
+            return true;
+        }
+        return m_hook.Canaries() != seen;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Core/KeyboardHook.h"
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <cstdint>
+#include <thread>
+
+namespace khm
+{
+    // Confirms that Windows is still delivering to the keyboard hook and
+    // reinstalls it when not. Windows only drops a hook that did not answer
+    // within LowLevelHooksTimeout, whether the callback was slow or the
+    // event sat queued for a starved hook thread, so a canary keystroke is
+    // injected after such an overrun, and again after each reinstall until
+    // a keystroke of any kind reaches the hook. Mouse activity says nothing
+    // about the keyboard, and an idle session's idle timer is never reset by
+    // us while the hook is healthy.
+    class HookWatchdog
+    {
+    public:
+        static constexpr uint32_t PollIntervalMs = 1000;
+        static constexpr uint32_t QuietMs = 5000;          // first retry after a failed probe
+        static constexpr uint32_t CanaryTimeoutMs = 500;
+        static constexpr uint32_t MaxBackoffMs = 60'000;   // between probes that keep failing
+
+        explicit HookWatchdog(KeyboardHook& hook) noexcept;
+        ~HookWatchdog();
+
+        HookWatchdog(HookWatchdog const&) = delete;
+        HookWatchdog& operator=(HookWatchdog const&) = delete;
+
+        void Start();
+        void Stop() noexcept;
+
+    private:
+        void Run() noexcept;
+        bool ShouldProbe(ULONGLONG now) noexcept;
+        bool Probe() noexcept;
+
+        KeyboardHook& m_hook;
+        std::thread m_thread;
+        winrt::handle m_stop;
+
+        // Watchdog thread only.
+        ULONGLONG m_nextProbe = 0;
+        uint32_t m_backoffMs = QuietMs;
+        bool m_suspect = false;     // reinstalled, and not yet heard from since
+        DWORD m_reinstalledAt = 0;  // GetTickCount(), as KeyboardHook::IdleMs() counts
+    };
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+namespace khm
+{
+    // Modifier bits, in the order the config schema lists them.
+    enum ModifierFlags : uint8_t
+    {
+        ModNone = 0,
+        ModWin = 1 << 0,
+        ModCtrl = 1 << 1,
+        ModShift = 1 << 2,
+        ModAlt = 1 << 3,
+    };
+
+    inline constexpr uint32_t ModifierCombinations = 16;
+    inline constexpr uint32_t VirtualKeyCount = 256;
+
+    // Steps allowed in a key sequence ("Ctrl+K, N"), and the time allowed
+    // between two of them.
+    inline constexpr uint32_t MinSequenceLength = 2;
+    inline constexpr uint32_t MaxSequenceLength = 8;
+    inline constexpr uint32_t DefaultSequenceTimeoutMs = 1000;
+    inline constexpr uint32_t MinSequenceTimeoutMs = 100;
+    inline constexpr uint32_t MaxSequenceTimeoutMs = 10000;
+
+    struct Hotkey
+    {
+        uint8_t modifiers = ModNone;
+        uint8_t key = 0;
+
+        // Flat slot index used by the dispatch table: (modifier mask, vk).
+        constexpr uint32_t Index() const noexcept
+        {
+            return (static_cast<uint32_t>(modifiers & 0x0F) << 8) | key;
+        }
+
+        constexpr bool operator==(Hotkey const&) const noexcept = default;
+    };
+
+    // Modifier keys cannot be the trigger key of a chord.
+    constexpr bool IsModifierKey(uint8_t vk) noexcept
+    {
+        switch (vk)
+        {
+        case 0x10: // VK_SHIFT
+        case 0x11: // VK_CONTROL
+        case 0x12: // VK_MENU
+        case 0x5B: // VK_LWIN
+        case 0x5C: // VK_RWIN
+        case 0xA0: // VK_LSHIFT
+        case 0xA1: // VK_RSHIFT
+        case 0xA2: // VK_LCONTROL
+        case 0xA3: // VK_RCONTROL
+        case 0xA4: // VK_LMENU
+        case 0xA5: // VK_RMENU
+            return true;
+        default:
+            return false;
+        }
+    }
+}
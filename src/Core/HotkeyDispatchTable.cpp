@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "Core/HotkeyDispatchTable.h"
+
+#include "Configuration/Configuration.h"
+
+namespace khm
+{
+    HotkeyDispatchTable::HotkeyDispatchTable() noexcept
+    {
+        m_slots.fill(NoAction);
+    }
+
+    std::unique_ptr<HotkeyDispatchTable> HotkeyDispatchTable::Compile(std::span<ActionDefinition const> actions)
+    {
+        auto table = std::make_unique<HotkeyDispatchTable>();
+        for (size_t i = 0; i < actions.size(); ++i)
+        {
+            ActionDefinition const& action = actions[i];
+            if (action.enabled && action.hotkey && action.profile.empty())
+            {
+                table->Bind(action.hotkey->ToHotkey(), static_cast<uint32_t>(i));
+            }
+        }
+        return table;
+    }
+
+    std::unique_ptr<HotkeyDispatchTable> HotkeyDispatchTable::Compile(ActionTable const& actions)
+    {
+        auto table = std::make_unique<HotkeyDispatchTable>();
+        for (uint32_t i = 0; i < actions.Size(); ++i)
+        {
+            ActionRecord const& action = actions[i];
+            if (action.enabled && action.hasHotkey && action.profile.length == 0)
+            {
+                table->Bind(action.hotkey, i);
+            }
+        }
+        return table;
+    }
+
+    std::unique_ptr<HotkeyDispatchTable> HotkeyDispatchTable::CompileProfile(ActionTable const& actions, std::span<uint32_t const> profiles, uint32_t profile)
+    {
+        auto table = std::make_unique<HotkeyDispatchTable>();
+        for (uint32_t pass = 0; pass < 2; ++pass)
+        {
+            uint32_t const wanted = pass == 0 ? profile : 0;
+            for (uint32_t i = 0; i < actions.Size(); ++i)
+            {
+                ActionRecord const& action = actions[i];
+                if (action.enabled && action.hasHotkey && profiles[i] == wanted)
+                {
+                    table->Bind(action.hotkey, i);
+                }
+            }
+        }
+        return table;
+    }
+
+    std::unique_ptr<HotkeyDispatchTable> HotkeyDispatchTable::FromSlots(std::span<uint32_t const, SlotCount> slots, uint32_t actionCount)
+    {
+        auto table = std::make_unique<HotkeyDispatchTable>();
+        for (uint32_t i = 0; i < SlotCount; ++i)
+        {
+            uint32_t const slot = slots[i];
+            if (slot == NoAction)
+            {
+                continue;
+            }
+            if (slot >= actionCount)
+            {
+                return nullptr;
+            }
+            table->m_slots[i] = slot;
+            ++table->m_bindingCount;
+        }
+        return table;
+    }
+
+    bool HotkeyDispatchTable::Bind(Hotkey hotkey, uint32_t actionIndex) noexcept
+    {
+        uint32_t& slot = m_slots[hotkey.Index()];
+        if (slot != NoAction || hotkey.key == 0 || IsModifierKey(hotkey.key))
+        {
+            return false;
+        }
+        slot = actionIndex;
+        ++m_bindingCount;
+        return true;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Core/Hotkey.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace khm
+{
+    struct ActionDefinition;
+    class ActionTable;
+
+    // Flat (modifier mask, vk) -> action index table, compiled once per load.
+    // Lookup is a single indexed load regardless of how many bindings exist,
+    // which keeps the WH_KEYBOARD_LL callback well clear of LowLevelHooksTimeout.
+    class HotkeyDispatchTable
+    {
+    public:
+        static constexpr uint32_t SlotCount = ModifierCombinations * VirtualKeyCount;
+        static constexpr uint32_t NoAction = UINT32_MAX;
+
+        HotkeyDispatchTable() noexcept;
+
+        // Enabled actions with a hotkey and no profile are bound by their
+        // index in `actions`. When two actions share a chord the first one wins.
+        static std::unique_ptr<HotkeyDispatchTable> Compile(std::span<ActionDefinition const> actions);
+        static std::unique_ptr<HotkeyDispatchTable> Compile(ActionTable const& actions);
+
+        // The table used while `profile` is in the foreground: the actions
+        // whose `profiles` entry is `profile`, then every global binding
+        // they do not shadow.
+        static std::unique_ptr<HotkeyDispatchTable> CompileProfile(ActionTable const& actions, std::span<uint32_t const> profiles, uint32_t profile);
+
+        // Restores a table saved with Slots(); null if any slot points past
+        // `actionCount`.
+        static std::unique_ptr<HotkeyDispatchTable> FromSlots(std::span<uint32_t const, SlotCount> slots, uint32_t actionCount);
+
+        uint32_t Lookup(uint8_t modifiers, uint8_t vk) const noexcept
+        {
+            return m_slots[(static_cast<uint32_t>(modifiers & 0x0F) << 8) | vk];
+        }
+
+        uint32_t Lookup(Hotkey hotkey) const noexcept
+        {
+            return m_slots[hotkey.Index()];
+        }
+
+        bool Bind(Hotkey hotkey, uint32_t actionIndex) noexcept;
+
+        uint32_t BindingCount() const noexcept { return m_bindingCount; }
+        std::span<uint32_t const, SlotCount> Slots() const noexcept { return m_slots; }
+
+    private:
+        alignas(64) std::array<uint32_t, SlotCount> m_slots;
+        uint32_t m_bindingCount = 0;
+    };
+}
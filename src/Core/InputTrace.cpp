@@ -0,0 +1,225 @@
+#include "pch.h"
+#include "Core/InputTrace.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace khm
+{
+    namespace
+    {
+        constexpr size_t MaxRecordBytes = 5 + 3;
+
+        void WriteAll(HANDLE file, void const* data, size_t bytes)
+        {
+            DWORD done = 0;
+            if (bytes > MAXDWORD || !WriteFile(file, data, static_cast<DWORD>(bytes), &done, nullptr) || done != bytes)
+            {
+                winrt::throw_last_error();
+            }
+        }
+    }
+
+    InputTraceWriter::InputTraceWriter(std::filesystem::path const& path) :
+        m_file(CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr))
+    {
+        if (!m_file)
+        {
+            winrt::throw_last_error();
+        }
+        InputTraceHeader const header{ InputTraceHeader::Magic, InputTraceHeader::CurrentVersion, 0, 0, 0 };
+        WriteAll(m_file.get(), &header, sizeof(header));
+        m_buffer.reserve(64 * 1024);
+    }
+
+    InputTraceWriter::~InputTraceWriter()
+    {
+        if (m_file)
+        {
+            try
+            {
+                Close();
+            }
+            catch (...)
+            {
+            }
+        }
+    }
+
+    void InputTraceWriter::Append(TraceEvent const& event)
+    {
+        if (m_count == 0)
+        {
+            m_startTime = m_previousTime = event.time;
+        }
+        // Unsigned, so the difference survives time's 49-day wrap.
+        uint32_t delta = event.time - m_previousTime;
+        m_previousTime = event.time;
+
+        uint8_t record[MaxRecordBytes];
+        size_t size = 0;
+        while (delta >= 0x80)
+        {
+            record[size++] = static_cast<uint8_t>(delta | 0x80);
+            delta >>= 7;
+        }
+        record[size++] = static_cast<uint8_t>(delta);
+        record[size++] = event.vk;
+        record[size++] = event.flags;
+        record[size++] = event.modifiers;
+        m_buffer.insert(m_buffer.end(), record, record + size);
+        ++m_count;
+    }
+
+    void InputTraceWriter::Flush()
+    {
+        if (!m_buffer.empty())
+        {
+            WriteAll(m_file.get(), m_buffer.data(), m_buffer.size());
+            m_buffer.clear();
+        }
+    }
+
+    void InputTraceWriter::Close()
+    {
+        if (!m_file)
+        {
+            return;
+        }
+        Flush();
+        InputTraceHeader const header{ InputTraceHeader::Magic, InputTraceHeader::CurrentVersion, 0, m_startTime, m_count };
+        LARGE_INTEGER const start{};
+        winrt::check_bool(SetFilePointerEx(m_file.get(), start, nullptr, FILE_BEGIN));
+        WriteAll(m_file.get(), &header, sizeof(header));
+        m_file.close();
+    }
+
+    InputTraceReader::InputTraceReader(std::filesystem::path const& path) :
+        m_file(path)
+    {
+        if (m_file.Size() < sizeof(InputTraceHeader))
+        {
+            throw std::runtime_error(path.string() + ": not an input trace");
+        }
+        std::memcpy(&m_header, m_file.Bytes().data(), sizeof(m_header));
+        if (m_header.magic != InputTraceHeader::Magic)
+        {
+            throw std::runtime_error(path.string() + ": not an input trace");
+        }
+        if (m_header.version != InputTraceHeader::CurrentVersion)
+        {
+            throw std::runtime_error(path.string() + ": input trace version " + std::to_string(m_header.version) + " is not supported");
+        }
+        Rewind();
+    }
+
+    bool InputTraceReader::Next(TraceEvent& event)
+    {
+        auto const bytes = m_file.Bytes();
+        if (m_offset == bytes.size())
+        {
+            return false;
+        }
+
+        uint32_t delta = 0;
+        for (uint32_t shift = 0;; shift += 7)
+        {
+            if (m_offset == bytes.size() || shift > 28)
+            {
+                throw std::runtime_error("input trace is truncated or corrupt at byte " + std::to_string(m_offset));
+            }
+            uint8_t const b = static_cast<uint8_t>(bytes[m_offset++]);
+            delta |= static_cast<uint32_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0)
+            {
+                break;
+            }
+        }
+        if (bytes.size() - m_offset < 3)
+        {
+            throw std::runtime_error("input trace is truncated or corrupt at byte " + std::to_string(m_offset));
+        }
+
+        m_time += delta;
+        event.time = m_time;
+        event.vk = static_cast<uint8_t>(bytes[m_offset]);
+        event.flags = static_cast<uint8_t>(bytes[m_offset + 1]);
+        event.modifiers = static_cast<uint8_t>(bytes[m_offset + 2]);
+        event.reserved = 0;
+        m_offset += 3;
+        return true;
+    }
+
+    void InputTraceReader::Rewind() noexcept
+    {
+        m_offset = sizeof(InputTraceHeader);
+        m_time = m_header.startTime;
+    }
+
+    InputRecorder::InputRecorder(std::filesystem::path const& path) :
+        m_writer(path),
+        m_ring(std::make_unique<SpscRing<TraceEvent, RingCapacity>>()),
+        m_stop(winrt::check_pointer(CreateEventW(nullptr, TRUE, FALSE, nullptr)))
+    {
+    }
+
+    InputRecorder::~InputRecorder()
+    {
+        Stop();
+    }
+
+    void InputRecorder::Start()
+    {
+        if (!m_thread.joinable())
+        {
+            ResetEvent(m_stop.get());
+            m_thread = std::thread([this] { Run(); });
+        }
+    }
+
+    void InputRecorder::Stop() noexcept
+    {
+        if (m_thread.joinable())
+        {
+            SetEvent(m_stop.get());
+            m_thread.join();
+        }
+        try
+        {
+            m_writer.Close();
+        }
+        catch (...)
+        {
+            OutputDebugStringA("KeyboardHookManager: input trace could not be closed\n");
+        }
+    }
+
+    void InputRecorder::Run() noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), L"khm.recorder");
+        // The key sources enqueue without waking anyone; polling keeps the
+        // hook from paying for a wake-up per keystroke.
+        while (WaitForSingleObject(m_stop.get(), FlushIntervalMs) == WAIT_TIMEOUT)
+        {
+            Drain();
+        }
+        Drain();
+    }
+
+    void InputRecorder::Drain() noexcept
+    {
+        try
+        {
+            TraceEvent event;
+            while (m_ring->TryPop(event))
+            {
+                m_writer.Append(event);
+            }
+            m_writer.Flush();
+        }
+        catch (...)
+        {
+            OutputDebugStringA("KeyboardHookManager: input trace write failed\n");
+        }
+    }
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "Utils/MappedFile.h"
+#include "Utils/SpscRing.h"
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace khm
+{
+    // Set in TraceEvent::flags, next to the LLKHF_* bits, for WM_SYSKEYDOWN
+    // and WM_SYSKEYUP; LLKHF_ leaves the bit unused.
+    inline constexpr uint8_t TraceSysKeyFlag = 0x40;
+
+    // One keyboard event as HookProcessor::Process() was handed it. The scan
+    // code and dwExtraInfo are not kept: matching never reads them, and
+    // injected events are filtered out before they are recorded.
+    struct TraceEvent
+    {
+        uint32_t time; // KBDLLHOOKSTRUCT::time, milliseconds
+        uint8_t vk;
+        uint8_t flags; // LLKHF_* | TraceSysKeyFlag
+        uint8_t modifiers;
+        uint8_t reserved;
+
+        static TraceEvent From(WPARAM message, KBDLLHOOKSTRUCT const& event, uint8_t modifiers) noexcept
+        {
+            bool const sys = message == WM_SYSKEYDOWN || message == WM_SYSKEYUP;
+            uint8_t const flags = static_cast<uint8_t>((event.flags & ~TraceSysKeyFlag) | (sys ? TraceSysKeyFlag : 0));
+            return { event.time, static_cast<uint8_t>(event.vkCode), flags, modifiers, 0 };
+        }
+
+        WPARAM Message() const noexcept
+        {
+            bool const sys = (flags & TraceSysKeyFlag) != 0;
+            if (flags & LLKHF_UP)
+            {
+                return sys ? WM_SYSKEYUP : WM_KEYUP;
+            }
+            return sys ? WM_SYSKEYDOWN : WM_KEYDOWN;
+        }
+
+        KBDLLHOOKSTRUCT Data() const noexcept
+        {
+            KBDLLHOOKSTRUCT data{};
+            data.vkCode = vk;
+            data.flags = flags & ~TraceSysKeyFlag;
+            data.time = time;
+            return data;
+        }
+    };
+    static_assert(sizeof(TraceEvent) == 8);
+
+    // A trace file is this header followed by one record per event:
+    //
+    //   varint  milliseconds since the previous event (LEB128, 1-5 bytes)
+    //   uint8   virtual key
+    //   uint8   TraceEvent::flags
+    //   uint8   modifier mask (ModWin, ...)
+    //
+    // so typing costs four bytes a keystroke. Little-endian throughout.
+    struct InputTraceHeader
+    {
+        static constexpr uint32_t Magic = 0x544D484B; // "KHMT"
+        static constexpr uint16_t CurrentVersion = 1;
+
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t startTime;  // time of the first event
+        uint32_t eventCount; // written on Close(); 0 when the recorder never got there
+    };
+    static_assert(sizeof(InputTraceHeader) == 16);
+
+    // Appends events to a new trace file. Single thread.
+    class InputTraceWriter
+    {
+    public:
+        // Creates or truncates `path`; throws winrt::hresult_error.
+        explicit InputTraceWriter(std::filesystem::path const& path);
+        ~InputTraceWriter();
+
+        InputTraceWriter(InputTraceWriter const&) = delete;
+        InputTraceWriter& operator=(InputTraceWriter const&) = delete;
+
+        // Buffers; nothing reaches the file before Flush() or Close().
+        void Append(TraceEvent const& event);
+        void Flush();
+        // Flushes and fills in the header's event count.
+        void Close();
+
+        uint32_t EventCount() const noexcept { return m_count; }
+
+    private:
+        winrt::file_handle m_file;
+        std::vector<uint8_t> m_buffer;
+        uint32_t m_startTime = 0;
+        uint32_t m_previousTime = 0;
+        uint32_t m_count = 0;
+    };
+
+    // Decodes a trace file through a read-only mapping. Throws
+    // winrt::hresult_error when the file cannot be mapped and
+    // std::runtime_error when it is not a trace or a record is cut short.
+    class InputTraceReader
+    {
+    public:
+        explicit InputTraceReader(std::filesystem::path const& path);
+
+        // False once every event has been read.
+        bool Next(TraceEvent& event);
+        void Rewind() noexcept;
+
+        InputTraceHeader const& Header() const noexcept { return m_header; }
+        size_t Bytes() const noexcept { return m_file.Size(); }
+
+    private:
+        MappedFile m_file;
+        InputTraceHeader m_header{};
+        size_t m_offset = 0;
+        uint32_t m_time = 0;
+    };
+
+    // Captures live input into a trace: Record() copies the event into a
+    // ring on the key source's thread, a background thread encodes it and
+    // writes it out every FlushIntervalMs. Events that find the ring full
+    // are dropped and counted. Record() has a single producer, so attach the
+    // recorder to one HookProcessor.
+    class InputRecorder
+    {
+    public:
+        static constexpr size_t RingCapacity = 4096;
+        static constexpr uint32_t FlushIntervalMs = 250;
+
+        // Creates the file at once; throws winrt::hresult_error.
+        explicit InputRecorder(std::filesystem::path const& path);
+        ~InputRecorder();
+
+        InputRecorder(InputRecorder const&) = delete;
+        InputRecorder& operator=(InputRecorder const&) = delete;
+
+        void Start();
+        // Writes what is left and closes the file.
+        void Stop() noexcept;
+
+        // Key source thread; never blocks or allocates.
+        void Record(WPARAM message, KBDLLHOOKSTRUCT const& event, uint8_t modifiers) noexcept
+        {
+            m_ring->TryEnqueue(TraceEvent::From(message, event, modifiers));
+        }
+
+        uint64_t Dropped() const noexcept { return m_ring->Dropped(); }
+
+    private:
+        void Run() noexcept;
+        void Drain() noexcept;
+
+        InputTraceWriter m_writer;
+        std::unique_ptr<SpscRing<TraceEvent, RingCapacity>> m_ring;
+        winrt::handle m_stop;
+        std::thread m_thread;
+    };
+}
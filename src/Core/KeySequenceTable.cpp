@@ -0,0 +1,108 @@
+#include "pch.h"
+#include "Core/KeySequenceTable.h"
+
+#include "Configuration/ActionTable.h"
+#include "Core/HotkeyDispatchTable.h"
+
+#include <algorithm>
+#include <bit>
+#include <unordered_map>
+
+namespace khm
+{
+    KeySequenceTable::KeySequenceTable() :
+        m_edges(2),
+        m_actions(1, HotkeyDispatchTable::NoAction),
+        m_mask(1)
+    {
+    }
+
+    std::unique_ptr<KeySequenceTable> KeySequenceTable::Compile(ActionTable const& actions, HotkeyDispatchTable const& chords, uint32_t timeoutMs)
+    {
+        auto table = std::make_unique<KeySequenceTable>();
+        table->m_timeoutMs = timeoutMs;
+
+        // Built as a plain trie first; flattened into the probe table below.
+        std::vector<uint32_t>& terminal = table->m_actions;
+        std::vector<bool> hasChildren(1, false);
+        std::unordered_map<uint64_t, uint32_t> edges;
+
+        for (uint32_t i = 0; i < actions.Size(); ++i)
+        {
+            ActionRecord const& action = actions[i];
+            uint32_t const length = actions.SequenceLength(action);
+            if (!action.enabled || length < MinSequenceLength || length > MaxSequenceLength)
+            {
+                continue;
+            }
+
+            bool valid = chords.Lookup(actions.SequenceStep(action, 0)) == HotkeyDispatchTable::NoAction;
+            for (uint32_t step = 0; step < length && valid; ++step)
+            {
+                Hotkey const hotkey = actions.SequenceStep(action, step);
+                valid = hotkey.key != 0 && !IsModifierKey(hotkey.key);
+            }
+            if (!valid)
+            {
+                continue;
+            }
+
+            // Walk the shared prefix; nodes are only created past the point
+            // where the sequence is known not to collide.
+            uint32_t state = Root;
+            uint32_t step = 0;
+            for (; step < length; ++step)
+            {
+                auto const found = edges.find(EdgeKey(state, actions.SequenceStep(action, step)));
+                if (found == edges.end())
+                {
+                    break;
+                }
+                state = found->second;
+                if (terminal[state] != HotkeyDispatchTable::NoAction)
+                {
+                    break;
+                }
+            }
+            if (terminal[state] != HotkeyDispatchTable::NoAction || (step == length && hasChildren[state]))
+            {
+                continue;
+            }
+
+            for (; step < length; ++step)
+            {
+                uint32_t const next = static_cast<uint32_t>(terminal.size());
+                terminal.push_back(HotkeyDispatchTable::NoAction);
+                hasChildren.push_back(false);
+                hasChildren[state] = true;
+                edges.emplace(EdgeKey(state, actions.SequenceStep(action, step)), next);
+                state = next;
+            }
+            terminal[state] = i;
+            ++table->m_sequenceCount;
+        }
+
+        // At most half full, so probes stay short and always reach a free slot.
+        uint32_t const bits = std::max<uint32_t>(1, static_cast<uint32_t>(std::bit_width(edges.size() * 2 - (edges.empty() ? 0 : 1))));
+        table->m_edges.assign(size_t{ 1 } << bits, Edge{});
+        table->m_mask = (uint64_t{ 1 } << bits) - 1;
+        table->m_shift = 64 - bits;
+        for (auto const& [key, target] : edges)
+        {
+            uint64_t slot = table->Hash(key);
+            while (table->m_edges[slot].key != 0)
+            {
+                slot = (slot + 1) & table->m_mask;
+            }
+            table->m_edges[slot] = Edge{ key, target };
+        }
+        return table;
+    }
+
+    void KeySequenceTable::AppendHotRanges(std::vector<MemoryRange>& ranges) const
+    {
+        ranges.push_back({ this, sizeof(*this) });
+        ranges.push_back({ m_edges.data(), m_edges.size() * sizeof(Edge) });
+        ranges.push_back({ m_actions.data(), m_actions.size() * sizeof(uint32_t) });
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Core/Hotkey.h"
+#include "Utils/WorkingSet.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace khm
+{
+    class ActionTable;
+    class HotkeyDispatchTable;
+
+    // All key sequences of a configuration merged into one trie, compiled
+    // once per load. Transitions live in a single open-addressed table keyed
+    // by (state, chord), so the hook advances a pending sequence with one
+    // hash probe no matter how many sequences are bound.
+    class KeySequenceTable
+    {
+    public:
+        static constexpr uint32_t Root = 0;
+        static constexpr uint32_t NoState = UINT32_MAX;
+
+        KeySequenceTable();
+
+        // Enabled actions with a sequence are bound by their index in
+        // `actions`. A sequence is dropped when its first step is already a
+        // chord in `chords`, or when it equals, extends or is a prefix of an
+        // earlier sequence; as with chords, the first one wins.
+        static std::unique_ptr<KeySequenceTable> Compile(ActionTable const& actions, HotkeyDispatchTable const& chords, uint32_t timeoutMs);
+
+        // State reached from `state` by pressing `hotkey`, or NoState.
+        uint32_t Next(uint32_t state, Hotkey hotkey) const noexcept
+        {
+            uint64_t const key = EdgeKey(state, hotkey);
+            for (uint64_t slot = Hash(key);; slot = (slot + 1) & m_mask)
+            {
+                Edge const& edge = m_edges[slot];
+                if (edge.key == key)
+                {
+                    return edge.target;
+                }
+                if (edge.key == 0)
+                {
+                    return NoState;
+                }
+            }
+        }
+
+        // Bound action when `state` completes a sequence, else NoAction.
+        uint32_t ActionAt(uint32_t state) const noexcept { return m_actions[state]; }
+
+        // Longest pause allowed between two steps, compared against
+        // KBDLLHOOKSTRUCT::time.
+        uint32_t TimeoutMs() const noexcept { return m_timeoutMs; }
+
+        uint32_t SequenceCount() const noexcept { return m_sequenceCount; }
+
+        // The storage Next() and ActionAt() read, for WorkingSet::Pin().
+        void AppendHotRanges(std::vector<MemoryRange>& ranges) const;
+
+    private:
+        struct Edge
+        {
+            uint64_t key = 0; // EdgeKey(); 0 marks a free slot
+            uint32_t target = NoState;
+        };
+
+        static constexpr uint64_t EdgeKey(uint32_t state, Hotkey hotkey) noexcept
+        {
+            return ((static_cast<uint64_t>(state) << 12) | hotkey.Index()) + 1;
+        }
+
+        uint64_t Hash(uint64_t key) const noexcept
+        {
+            return (key * 0x9E3779B97F4A7C15ull) >> m_shift;
+        }
+
+        std::vector<Edge> m_edges;
+        std::vector<uint32_t> m_actions; // per state
+        uint64_t m_mask = 0;
+        uint32_t m_shift = 63;
+        uint32_t m_timeoutMs = DefaultSequenceTimeoutMs;
+        uint32_t m_sequenceCount = 0;
+    };
+}
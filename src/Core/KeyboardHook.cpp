@@ -0,0 +1,253 @@
+#include "pch.h"
+#include "Core/KeyboardHook.h"
+
+#include "Utils/Instrumentation.h"
+#include "Utils/ThreadQos.h"
+#include "Utils/WorkingSet.h"
+
+namespace khm
+{
+    namespace
+    {
+        int ThreadPriorityOf(HookPriority priority) noexcept
+        {
+            switch (priority)
+            {
+            case HookPriority::Highest: return THREAD_PRIORITY_HIGHEST;
+            case HookPriority::AboveNormal: return THREAD_PRIORITY_ABOVE_NORMAL;
+            case HookPriority::Normal: return THREAD_PRIORITY_NORMAL;
+            default: return THREAD_PRIORITY_TIME_CRITICAL;
+            }
+        }
+    }
+
+    KeyboardHook* KeyboardHook::s_instance = nullptr;
+
+    KeyboardHook::KeyboardHook(HookProcessor& processor) noexcept :
+        m_processor(processor)
+    {
+    }
+
+    KeyboardHook::~KeyboardHook()
+    {
+        Uninstall();
+    }
+
+    void KeyboardHook::Install()
+    {
+        if (m_thread.joinable())
+        {
+            return;
+        }
+        if (s_instance != nullptr)
+        {
+            throw std::logic_error("another KeyboardHook is already installed");
+        }
+
+        uint32_t const timeoutMs = ReadTimeoutMs();
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        m_timeoutTicks = frequency.QuadPart * timeoutMs / 1000;
+        m_slowTicks = m_timeoutTicks / 2;
+        m_timeoutMs = timeoutMs;
+        s_timeoutMs.store(timeoutMs, std::memory_order_relaxed);
+        m_lastEventTime.store(GetTickCount(), std::memory_order_relaxed);
+
+        s_instance = this;
+        m_modifiers.Invalidate();
+        m_ready = winrt::handle(winrt::check_pointer(CreateEventW(nullptr, TRUE, FALSE, nullptr)));
+        m_thread = std::thread([this] { Run(); });
+        WaitForSingleObject(m_ready.get(), INFINITE);
+        if (m_installError != 0)
+        {
+            m_thread.join();
+            s_instance = nullptr;
+            winrt::throw_hresult(HRESULT_FROM_WIN32(m_installError));
+        }
+    }
+
+    void KeyboardHook::Uninstall() noexcept
+    {
+        if (m_thread.joinable())
+        {
+            PostThreadMessageW(m_threadId, WM_QUIT, 0, 0);
+            m_thread.join();
+            s_instance = nullptr;
+        }
+    }
+
+    void KeyboardHook::Reinstall() noexcept
+    {
+        if (m_thread.joinable())
+        {
+            PostThreadMessageW(m_threadId, ReinstallMessage, 0, 0);
+        }
+    }
+
+    bool KeyboardHook::InjectCanary() noexcept
+    {
+        // An unassigned key the hook swallows; should the hook be gone, the
+        // foreground app sees a key that means nothing.
+        INPUT inputs[2]{};
+        for (INPUT& input : inputs)
+        {
+            input.type = INPUT_KEYBOARD;
+            input.ki.wVk = MenuMaskKey;
+            input.ki.dwExtraInfo = CanaryEventTag;
+        }
+        inputs[1].ki.dwFlags = KEYEVENTF_KEYUP;
+        return SendInput(ARRAYSIZE(inputs), inputs, sizeof(INPUT)) == ARRAYSIZE(inputs);
+    }
+
+    void KeyboardHook::SetPriority(HookPriority priority) noexcept
+    {
+        m_priority.store(priority, std::memory_order_relaxed);
+        if (m_thread.joinable())
+        {
+            SetThreadPriority(m_thread.native_handle(), ThreadPriorityOf(priority));
+        }
+    }
+
+    HookHealth KeyboardHook::Health() noexcept
+    {
+        HookHealth health;
+        health.timeoutMs = s_timeoutMs.load(std::memory_order_relaxed);
+        health.maxCallbackNs = Instrumentation::TicksToNanoseconds(s_maxCallbackTicks.load(std::memory_order_relaxed));
+        health.slowCallbacks = s_slowCallbacks.load(std::memory_order_relaxed);
+        health.canaries = s_canaries.load(std::memory_order_relaxed);
+        health.reinstalls = s_reinstalls.load(std::memory_order_relaxed);
+        return health;
+    }
+
+    void KeyboardHook::Run() noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), L"khm.hook");
+        SetThreadPriority(GetCurrentThread(), ThreadPriorityOf(m_priority.load(std::memory_order_relaxed)));
+        ThreadQos::DisableThrottling();
+        WorkingSet::PinnedStack const stack;
+
+        m_threadId = GetCurrentThreadId();
+        MSG msg;
+        PeekMessageW(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+        m_installError = Register() ? 0 : GetLastError();
+        SetEvent(m_ready.get());
+        if (m_installError != 0)
+        {
+            return;
+        }
+        // Keys released in a window the hook does not hear from (an elevated
+        // one, say) would otherwise stay down.
+        HWINEVENTHOOK const foreground = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, nullptr, OnForeground, 0, 0, WINEVENT_OUTOFCONTEXT);
+
+        while (GetMessageW(&msg, nullptr, 0, 0) > 0)
+        {
+            if (msg.hwnd == nullptr && msg.message == ReinstallMessage)
+            {
+                // Fails harmlessly when Windows already removed the hook.
+                UnhookWindowsHookEx(m_hook);
+                m_hook = nullptr;
+                // Whatever happened while the hook was gone went unseen.
+                m_modifiers.Invalidate();
+                if (Register())
+                {
+                    s_reinstalls.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    OutputDebugStringA("KeyboardHookManager: hook reinstall failed\n");
+                }
+                continue;
+            }
+            TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+        }
+
+        if (foreground != nullptr)
+        {
+            UnhookWinEvent(foreground);
+        }
+        if (m_hook != nullptr)
+        {
+            UnhookWindowsHookEx(m_hook);
+            m_hook = nullptr;
+        }
+    }
+
+    void CALLBACK KeyboardHook::OnForeground(HWINEVENTHOOK, DWORD, HWND, LONG, LONG, DWORD, DWORD) noexcept
+    {
+        // Delivered through the hook thread's own message loop.
+        if (s_instance != nullptr)
+        {
+            s_instance->m_modifiers.Invalidate();
+        }
+    }
+
+    bool KeyboardHook::Register() noexcept
+    {
+        m_hook = SetWindowsHookExW(WH_KEYBOARD_LL, &KeyboardHook::HookProc, GetModuleHandleW(nullptr), 0);
+        return m_hook != nullptr;
+    }
+
+    uint32_t KeyboardHook::ReadTimeoutMs() noexcept
+    {
+        DWORD value = 0;
+        DWORD bytes = sizeof(value);
+        if (RegGetValueW(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"LowLevelHooksTimeout", RRF_RT_REG_DWORD, nullptr, &value, &bytes) != ERROR_SUCCESS
+            || value == 0)
+        {
+            return DefaultTimeoutMs;
+        }
+        return value;
+    }
+
+    // The callback path stays locked in memory while the process is
+    // trimmed (see WorkingSet).
+#pragma code_seg(push, ".text$khm_hot")
+
+    void KeyboardHook::Measure(int64_t ticks, DWORD lateMs) noexcept
+    {
+        // Hook thread only, so plain load/store keep the maximum.
+        if (static_cast<uint64_t>(ticks) > s_maxCallbackTicks.load(std::memory_order_relaxed))
+        {
+            s_maxCallbackTicks.store(static_cast<uint64_t>(ticks), std::memory_order_relaxed);
+        }
+        if (ticks > m_slowTicks)
+        {
+            s_slowCallbacks.fetch_add(1, std::memory_order_relaxed);
+        }
+        // The timeout also runs while the event waits for a starved hook
+        // thread, which a fast callback says nothing about.
+        if (ticks > m_timeoutTicks || lateMs > m_timeoutMs)
+        {
+            m_overrun.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    LRESULT CALLBACK KeyboardHook::HookProc(int code, WPARAM wParam, LPARAM lParam)
+    {
+        if (code == HC_ACTION && s_instance != nullptr)
+        {
+            auto const& event = *reinterpret_cast<KBDLLHOOKSTRUCT const*>(lParam);
+            s_instance->m_lastEventTime.store(event.time, std::memory_order_relaxed);
+            if (event.dwExtraInfo == CanaryEventTag)
+            {
+                s_canaries.fetch_add(1, std::memory_order_relaxed);
+                return 1;
+            }
+
+            // Our own injected input (macros, the Start menu mask) still
+            // moves the modifier state, but is passed on unmatched.
+            int64_t const entered = Instrumentation::Now();
+            uint8_t const modifiers = s_instance->m_modifiers.Observe(event);
+            bool const handled = event.dwExtraInfo != InjectedEventTag && s_instance->m_processor.Process(wParam, event, modifiers);
+            s_instance->Measure(Instrumentation::Now() - entered, GetTickCount() - event.time);
+            if (handled)
+            {
+                return 1;
+            }
+        }
+        return CallNextHookEx(nullptr, code, wParam, lParam);
+    }
+
+#pragma code_seg(pop)
+}
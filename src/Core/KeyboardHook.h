@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Core/HookProcessor.h"
+#include "Core/ModifierTracker.h"
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace khm
+{
+    // Marks the watchdog's canary keystrokes; the hook swallows them.
+    inline constexpr ULONG_PTR CanaryEventTag = InjectedEventTag + 1;
+
+    struct HookHealth
+    {
+        uint32_t timeoutMs = 0;      // LowLevelHooksTimeout in effect
+        uint64_t maxCallbackNs = 0;
+        uint64_t slowCallbacks = 0;  // callbacks that used more than half of the timeout
+        uint64_t canaries = 0;       // canary keystrokes the hook delivered
+        uint64_t reinstalls = 0;
+    };
+
+    // Owns the WH_KEYBOARD_LL registration and the high-priority thread
+    // whose message loop services it, so nothing else the process does can
+    // delay a callback. The thread is exempt from power throttling, so load
+    // elsewhere cannot push it onto a slowed-down core either. Callback
+    // durations, and how late each event is answered against its
+    // KBDLLHOOKSTRUCT::time, are tracked against LowLevelHooksTimeout, past
+    // which Windows silently removes the hook; HookWatchdog uses the rest of
+    // the interface to notice and recover. Modifier state comes from the
+    // event stream (see ModifierTracker) and is re-read after a foreground
+    // change, a reinstall and ResyncModifiers(). Only one instance may be
+    // installed at once.
+    class KeyboardHook
+    {
+    public:
+        static constexpr uint32_t DefaultTimeoutMs = 300;
+
+        explicit KeyboardHook(HookProcessor& processor) noexcept;
+        ~KeyboardHook();
+
+        KeyboardHook(KeyboardHook const&) = delete;
+        KeyboardHook& operator=(KeyboardHook const&) = delete;
+
+        // Starts the hook thread; throws when the hook cannot be registered.
+        void Install();
+        void Uninstall() noexcept;
+        bool IsInstalled() const noexcept { return m_thread.joinable(); }
+
+        // Watchdog side; any thread.
+        void Reinstall() noexcept;
+        bool InjectCanary() noexcept;
+        uint64_t Canaries() const noexcept { return s_canaries.load(std::memory_order_relaxed); }
+        // Milliseconds since the hook last received any event.
+        uint32_t IdleMs() const noexcept { return GetTickCount() - m_lastEventTime.load(std::memory_order_relaxed); }
+        // True once after a callback overran the timeout, or an event was
+        // answered later than that after it was generated.
+        bool TakeOverrun() noexcept { return m_overrun.exchange(false, std::memory_order_relaxed); }
+
+        static HookHealth Health() noexcept;
+
+        // The modifiers are re-read from the system at the next event, for
+        // what the hook cannot have seen, such as a session unlock. Any thread.
+        void ResyncModifiers() noexcept { m_modifiers.Invalidate(); }
+
+        // Takes effect at once on an installed hook and on every later
+        // Install(). Any thread.
+        void SetPriority(HookPriority priority) noexcept;
+
+    private:
+        static constexpr UINT ReinstallMessage = WM_APP;
+
+        static LRESULT CALLBACK HookProc(int code, WPARAM wParam, LPARAM lParam);
+        static void CALLBACK OnForeground(HWINEVENTHOOK hook, DWORD event, HWND window, LONG object, LONG child, DWORD thread, DWORD time) noexcept;
+        static uint32_t ReadTimeoutMs() noexcept;
+
+        void Run() noexcept;
+        bool Register() noexcept;
+        void Measure(int64_t ticks, DWORD lateMs) noexcept;
+
+        static KeyboardHook* s_instance;
+        static inline std::atomic<uint32_t> s_timeoutMs{ 0 };
+        static inline std::atomic<uint64_t> s_maxCallbackTicks{ 0 };
+        static inline std::atomic<uint64_t> s_slowCallbacks{ 0 };
+        static inline std::atomic<uint64_t> s_canaries{ 0 };
+        static inline std::atomic<uint64_t> s_reinstalls{ 0 };
+
+        HookProcessor& m_processor;
+        HHOOK m_hook = nullptr; // hook thread only
+        ModifierTracker m_modifiers;
+
+        std::thread m_thread;
+        DWORD m_threadId = 0;
+        DWORD m_installError = 0;
+        std::atomic<HookPriority> m_priority{ HookPriority::TimeCritical };
+        winrt::handle m_ready;
+
+        int64_t m_slowTicks = 0;
+        int64_t m_timeoutTicks = 0;
+        uint32_t m_timeoutMs = 0;
+        std::atomic<DWORD> m_lastEventTime{ 0 }; // KBDLLHOOKSTRUCT::time
+        std::atomic<bool> m_overrun{ false };
+    };
+}
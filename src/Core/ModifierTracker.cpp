@@ -0,0 +1,24 @@
+#include "pch.h"
+#include "Core/ModifierTracker.h"
+
+namespace khm
+{
+    void ModifierTracker::Resynchronize() noexcept
+    {
+        static constexpr UINT Keys[] = { VK_LSHIFT, VK_RSHIFT, VK_LCONTROL, VK_RCONTROL, VK_LMENU, VK_RMENU, VK_LWIN, VK_RWIN };
+
+        // Cleared first: an Invalidate() racing with the reads below then
+        // still forces another pass.
+        m_stale.store(false, std::memory_order_relaxed);
+        uint8_t sided = 0;
+        for (UINT vk : Keys)
+        {
+            if (GetAsyncKeyState(static_cast<int>(vk)) & 0x8000)
+            {
+                sided |= SidedBit(vk);
+            }
+        }
+        m_sided = sided;
+        m_mask = Fold(sided);
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Core/Hotkey.h"
+
+#include <windows.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace khm
+{
+    // Modifier state kept from the key event stream itself, so a key source
+    // reads one byte per event instead of calling GetAsyncKeyState four
+    // times, and sees the state as of the event rather than as of the call.
+    // Left and right keys are tracked apart: releasing one Shift while the
+    // other is held keeps ModShift.
+    //
+    // Whatever the stream misses (keys released while an elevated window or
+    // the secure desktop had focus, a window in which the hook was not
+    // installed) leaves the state wrong until Invalidate(), after which the
+    // next event first re-reads every modifier once. Owned by the key source
+    // thread; Invalidate() from any thread.
+    class ModifierTracker
+    {
+    public:
+        enum SidedModifier : uint8_t
+        {
+            LeftShift = 1 << 0,
+            RightShift = 1 << 1,
+            LeftCtrl = 1 << 2,
+            RightCtrl = 1 << 3,
+            LeftAlt = 1 << 4,
+            RightAlt = 1 << 5,
+            LeftWin = 1 << 6,
+            RightWin = 1 << 7,
+        };
+
+        // Applies `event` and returns the ModifierFlags to match it with.
+        // Feed every event, our own injected ones included: they move the
+        // key state just as physical ones do.
+        uint8_t Observe(KBDLLHOOKSTRUCT const& event) noexcept
+        {
+            if (m_stale.load(std::memory_order_relaxed)) [[unlikely]]
+            {
+                Resynchronize();
+            }
+            uint8_t const bit = SidedBit(event.vkCode);
+            if (bit != 0)
+            {
+                m_sided = (event.flags & LLKHF_UP) ? (m_sided & ~bit) : (m_sided | bit);
+                m_mask = Fold(m_sided);
+            }
+            return m_mask;
+        }
+
+        void Invalidate() noexcept { m_stale.store(true, std::memory_order_relaxed); }
+
+        // Owner thread: reads the eight keys with GetAsyncKeyState.
+        void Resynchronize() noexcept;
+
+        uint8_t Sided() const noexcept { return m_sided; }
+        uint8_t Mask() const noexcept { return m_mask; }
+
+        // Generic VK_SHIFT/VK_CONTROL/VK_MENU only come from injected input,
+        // which does not say which side it meant; they count as the left key.
+        static constexpr uint8_t SidedBit(uint32_t vk) noexcept
+        {
+            switch (vk)
+            {
+            case VK_LSHIFT: case VK_SHIFT: return LeftShift;
+            case VK_RSHIFT: return RightShift;
+            case VK_LCONTROL: case VK_CONTROL: return LeftCtrl;
+            case VK_RCONTROL: return RightCtrl;
+            case VK_LMENU: case VK_MENU: return LeftAlt;
+            case VK_RMENU: return RightAlt;
+            case VK_LWIN: return LeftWin;
+            case VK_RWIN: return RightWin;
+            default: return 0;
+            }
+        }
+
+        static constexpr uint8_t Fold(uint8_t sided) noexcept
+        {
+            return static_cast<uint8_t>(((sided & (LeftWin | RightWin)) ? ModWin : ModNone)
+                | ((sided & (LeftCtrl | RightCtrl)) ? ModCtrl : ModNone)
+                | ((sided & (LeftShift | RightShift)) ? ModShift : ModNone)
+                | ((sided & (LeftAlt | RightAlt)) ? ModAlt : ModNone));
+        }
+
+    private:
+        uint8_t m_sided = 0;
+        uint8_t m_mask = ModNone;
+        std::atomic<bool> m_stale{ true }; // the first event reads the real state
+    };
+}
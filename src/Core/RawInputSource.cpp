@@ -0,0 +1,182 @@
+#include "pch.h"
+#include "Core/RawInputSource.h"
+
+#include "Utils/ThreadQos.h"
+#include "Utils/WorkingSet.h"
+
+namespace khm
+{
+    namespace
+    {
+        constexpr wchar_t WindowClass[] = L"KeyboardHookManager.RawInput";
+        constexpr USHORT GenericDesktopPage = 0x01;
+        constexpr USHORT KeyboardUsage = 0x06;
+
+        // Raw Input reports the generic modifier keys; the hook, and so the
+        // processor, sees the left/right ones.
+        UINT SidedVirtualKey(RAWKEYBOARD const& key) noexcept
+        {
+            bool const extended = (key.Flags & RI_KEY_E0) != 0;
+            switch (key.VKey)
+            {
+            case VK_SHIFT: return MapVirtualKeyW(key.MakeCode, MAPVK_VSC_TO_VK_EX);
+            case VK_CONTROL: return extended ? VK_RCONTROL : VK_LCONTROL;
+            case VK_MENU: return extended ? VK_RMENU : VK_LMENU;
+            default: return key.VKey;
+            }
+        }
+    }
+
+    RawInputSource::RawInputSource(HookProcessor& processor) noexcept :
+        m_processor(processor)
+    {
+    }
+
+    RawInputSource::~RawInputSource()
+    {
+        Stop();
+    }
+
+    void RawInputSource::Start()
+    {
+        if (m_thread.joinable())
+        {
+            return;
+        }
+        m_ready = winrt::handle(winrt::check_pointer(CreateEventW(nullptr, TRUE, FALSE, nullptr)));
+        m_thread = std::thread([this] { Run(); });
+        WaitForSingleObject(m_ready.get(), INFINITE);
+        if (m_startError != 0)
+        {
+            m_thread.join();
+            winrt::throw_hresult(HRESULT_FROM_WIN32(m_startError));
+        }
+    }
+
+    void RawInputSource::Stop() noexcept
+    {
+        if (m_thread.joinable())
+        {
+            PostThreadMessageW(m_threadId, WM_QUIT, 0, 0);
+            m_thread.join();
+        }
+    }
+
+    void RawInputSource::Run() noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), L"khm.rawinput");
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+        ThreadQos::DisableThrottling();
+        WorkingSet::PinnedStack const stack;
+
+        m_threadId = GetCurrentThreadId();
+        MSG msg;
+        PeekMessageW(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+        m_startError = Register() ? 0 : GetLastError();
+        SetEvent(m_ready.get());
+
+        if (m_startError == 0)
+        {
+            s_active = this;
+            m_modifiers.Invalidate();
+            HWINEVENTHOOK const foreground = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, nullptr, OnForeground, 0, 0, WINEVENT_OUTOFCONTEXT);
+            while (GetMessageW(&msg, nullptr, 0, 0) > 0)
+            {
+                DispatchMessageW(&msg);
+            }
+            if (foreground != nullptr)
+            {
+                UnhookWinEvent(foreground);
+            }
+            s_active = nullptr;
+            RAWINPUTDEVICE device{ GenericDesktopPage, KeyboardUsage, RIDEV_REMOVE, nullptr };
+            RegisterRawInputDevices(&device, 1, sizeof(device));
+        }
+        if (m_window != nullptr)
+        {
+            DestroyWindow(m_window);
+            m_window = nullptr;
+        }
+    }
+
+    bool RawInputSource::Register() noexcept
+    {
+        HINSTANCE const instance = GetModuleHandleW(nullptr);
+        WNDCLASSEXW windowClass{ sizeof(windowClass) };
+        windowClass.lpfnWndProc = WindowProc;
+        windowClass.hInstance = instance;
+        windowClass.lpszClassName = WindowClass;
+        if (!RegisterClassExW(&windowClass) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS)
+        {
+            return false;
+        }
+
+        // Message-only: INPUTSINK needs a target window, not a visible one.
+        m_window = CreateWindowExW(0, WindowClass, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, instance, this);
+        if (m_window == nullptr)
+        {
+            return false;
+        }
+
+        RAWINPUTDEVICE device{ GenericDesktopPage, KeyboardUsage, RIDEV_INPUTSINK, m_window };
+        return RegisterRawInputDevices(&device, 1, sizeof(device)) != FALSE;
+    }
+
+    void CALLBACK RawInputSource::OnForeground(HWINEVENTHOOK, DWORD, HWND, LONG, LONG, DWORD, DWORD) noexcept
+    {
+        if (s_active != nullptr)
+        {
+            s_active->m_modifiers.Invalidate();
+        }
+    }
+
+    // The input path stays locked in memory while the process is trimmed
+    // (see WorkingSet).
+#pragma code_seg(push, ".text$khm_hot")
+
+    LRESULT CALLBACK RawInputSource::WindowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam) noexcept
+    {
+        if (message == WM_NCCREATE)
+        {
+            auto* const self = static_cast<RawInputSource*>(reinterpret_cast<CREATESTRUCTW const*>(lParam)->lpCreateParams);
+            SetWindowLongPtrW(window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(self));
+        }
+        else if (message == WM_INPUT)
+        {
+            if (auto* const self = reinterpret_cast<RawInputSource*>(GetWindowLongPtrW(window, GWLP_USERDATA)))
+            {
+                self->OnInput(reinterpret_cast<HRAWINPUT>(lParam));
+            }
+            // Lets Windows free the input data.
+        }
+        return DefWindowProcW(window, message, wParam, lParam);
+    }
+
+    void RawInputSource::OnInput(HRAWINPUT input) noexcept
+    {
+        RAWINPUT raw;
+        UINT size = sizeof(raw);
+        if (GetRawInputData(input, RID_INPUT, &raw, &size, sizeof(RAWINPUTHEADER)) == static_cast<UINT>(-1)
+            || raw.header.dwType != RIM_TYPEKEYBOARD)
+        {
+            return;
+        }
+
+        RAWKEYBOARD const& key = raw.data.keyboard;
+        if (key.VKey == 0 || key.VKey >= 0xFF)
+        {
+            return; // fake keys, e.g. the E1 prefix of Pause
+        }
+
+        // Shaped like what the hook would have received for the same key.
+        KBDLLHOOKSTRUCT event{};
+        event.vkCode = SidedVirtualKey(key);
+        event.scanCode = key.MakeCode;
+        event.flags = ((key.Flags & RI_KEY_E0) != 0 ? LLKHF_EXTENDED : 0) | ((key.Flags & RI_KEY_BREAK) != 0 ? LLKHF_UP : 0);
+        event.time = static_cast<DWORD>(GetMessageTime());
+        event.dwExtraInfo = key.ExtraInformation;
+        m_processor.Process(key.Message, event, m_modifiers.Observe(event));
+    }
+
+#pragma code_seg(pop)
+}
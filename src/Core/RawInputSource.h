@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Core/HookProcessor.h"
+#include "Core/ModifierTracker.h"
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <thread>
+
+namespace khm
+{
+    // Observes the keyboard through Raw Input (RIDEV_INPUTSINK) for the
+    // bindings marked passThrough. Unlike the low-level hook it sits beside
+    // the input path rather than in it: Windows never waits on it and no
+    // LowLevelHooksTimeout applies, but it cannot swallow a key, so every
+    // binding that must be suppressed stays on KeyboardHook. Like the hook,
+    // it does not see input sent to elevated windows (UIPI), so it re-reads
+    // the modifiers after every foreground change.
+    class RawInputSource
+    {
+    public:
+        // `processor` must be in HookMode::Observe.
+        explicit RawInputSource(HookProcessor& processor) noexcept;
+        ~RawInputSource();
+
+        RawInputSource(RawInputSource const&) = delete;
+        RawInputSource& operator=(RawInputSource const&) = delete;
+
+        // Starts the input thread; throws when the device cannot be registered.
+        void Start();
+        void Stop() noexcept;
+        bool IsRunning() const noexcept { return m_thread.joinable(); }
+
+        // As KeyboardHook::ResyncModifiers(). Any thread.
+        void ResyncModifiers() noexcept { m_modifiers.Invalidate(); }
+
+    private:
+        static LRESULT CALLBACK WindowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam) noexcept;
+        static void CALLBACK OnForeground(HWINEVENTHOOK hook, DWORD event, HWND window, LONG object, LONG child, DWORD thread, DWORD time) noexcept;
+
+        void Run() noexcept;
+        bool Register() noexcept;
+        void OnInput(HRAWINPUT input) noexcept;
+
+        static inline RawInputSource* s_active = nullptr; // set on the input thread
+
+        HookProcessor& m_processor;
+        HWND m_window = nullptr; // input thread only
+        ModifierTracker m_modifiers;
+
+        std::thread m_thread;
+        DWORD m_threadId = 0;
+        DWORD m_startError = 0;
+        winrt::handle m_ready;
+    };
+}
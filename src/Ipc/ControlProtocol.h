@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+
+namespace khm
+{
+    // Wire format of the control pipe. Every message is a little-endian
+    // uint32 byte count followed by that many bytes:
+    //
+    //   request:  ControlRequestHeader, then the opcode's payload
+    //   response: ControlResponseHeader, then the payload
+    //
+    // Clients may pipeline any number of requests; responses come back in
+    // request order and echo the request's tag.
+    //
+    //   Ping               -             -> -
+    //   Trigger            UTF-8 id      -> -               (Busy when the queue is full, Rejected when disabled)
+    //   QueryBinding       UTF-8 id      -> ControlBinding, then 2 bytes (modifiers, vk) per sequence step
+    //   QueryStats         -             -> ControlStats
+    //   PushConfiguration  UTF-8 JSON    -> uint64 generation, or Rejected with a UTF-8 message (Busy when it cannot be queued)
+    //   AttachShared       -             -> ControlSharedImage, then the UTF-16 section name
+    //
+    // The per-session pipe answers all but AttachShared; the shared service
+    // pipe only Ping and AttachShared. Others get BadRequest.
+    enum class ControlOpcode : uint8_t
+    {
+        Ping = 0,
+        Trigger = 1,
+        QueryBinding = 2,
+        QueryStats = 3,
+        PushConfiguration = 4,
+        AttachShared = 5,
+    };
+
+    enum class ControlStatus : uint8_t
+    {
+        Ok = 0,
+        NotFound = 1,
+        Busy = 2,
+        BadRequest = 3,
+        Rejected = 4,
+    };
+
+    // Larger messages close the connection.
+    inline constexpr uint32_t MaxControlMessage = 16u << 20;
+
+    // The pipe is \\.\pipe\ followed by this and the session id, and only
+    // accepts local clients running as the same user.
+    inline constexpr wchar_t ControlPipePrefix[] = L"KeyboardHookManager.control.";
+
+    // \\.\pipe\ followed by this is the shared configuration service's pipe
+    // (--service), open to every interactive session's agent (--agent).
+    inline constexpr wchar_t SharedServicePipeName[] = L"KeyboardHookManager.service";
+
+#pragma pack(push, 1)
+    struct ControlRequestHeader
+    {
+        ControlOpcode opcode;
+        uint8_t reserved[3];
+        uint32_t tag;
+    };
+
+    struct ControlResponseHeader
+    {
+        ControlStatus status;
+        uint8_t reserved[3];
+        uint32_t tag;
+    };
+
+    struct ControlBinding
+    {
+        uint32_t slot;       // action index; stable across reloads
+        uint8_t enabled;
+        uint8_t hasHotkey;
+        uint8_t bound;       // the hook dispatches the hotkey to this action
+        uint8_t modifiers;
+        uint8_t vk;
+        uint8_t sequenceSteps;
+    };
+
+    struct ControlStats
+    {
+        uint64_t generation;
+        uint32_t actionCount;
+        uint32_t bindingCount;
+        uint64_t executed;
+        uint64_t failed;
+        uint64_t skipped;
+        uint64_t dropped;    // hook and control events lost to full queues
+        uint64_t hookReinstalls;
+        uint64_t slowCallbacks; // hook callbacks past half of LowLevelHooksTimeout
+        uint64_t workingSetBytes;
+        uint64_t privateBytes;
+        uint64_t pinnedBytes;   // locked for the hotkey path
+        uint64_t trims;         // idle working-set trims
+    };
+
+    struct ControlSharedImage
+    {
+        uint64_t generation;
+        uint32_t imageBytes;    // section size to map
+        uint32_t nameLength;    // UTF-16 code units that follow
+    };
+#pragma pack(pop)
+
+    static_assert(sizeof(ControlRequestHeader) == 8 && sizeof(ControlResponseHeader) == 8);
+}
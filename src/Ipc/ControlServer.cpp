@@ -0,0 +1,639 @@
+#include "pch.h"
+#include "Ipc/ControlServer.h"
+
+#include "Core/KeyboardHook.h"
+#include "Utils/WorkingSet.h"
+
+#include <sddl.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace khm
+{
+    namespace
+    {
+        // Grown buffers above this are released when their client leaves.
+        constexpr size_t RetainedBufferBytes = 64 * 1024;
+
+        void AppendResponse(std::vector<uint8_t>& output, ControlStatus status, uint32_t tag, void const* payload = nullptr, size_t size = 0)
+        {
+            uint32_t const length = static_cast<uint32_t>(sizeof(ControlResponseHeader) + size);
+            ControlResponseHeader const header{ status, {}, tag };
+            size_t const at = output.size();
+            output.resize(at + sizeof(length) + length);
+            std::memcpy(output.data() + at, &length, sizeof(length));
+            std::memcpy(output.data() + at + sizeof(length), &header, sizeof(header));
+            if (size != 0)
+            {
+                std::memcpy(output.data() + at + sizeof(length) + sizeof(header), payload, size);
+            }
+        }
+
+        // Full access for the current user only; everyone else is refused at
+        // open. The same user's other sessions pass the DACL, so Accept()
+        // checks the client's session.
+        std::wstring CurrentUserOnlySddl()
+        {
+            winrt::handle token;
+            winrt::check_bool(OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, token.put()));
+            DWORD size = 0;
+            GetTokenInformation(token.get(), TokenUser, nullptr, 0, &size);
+            std::vector<std::byte> buffer(size);
+            winrt::check_bool(GetTokenInformation(token.get(), TokenUser, buffer.data(), size, &size));
+
+            wchar_t* sid = nullptr;
+            winrt::check_bool(ConvertSidToStringSidW(reinterpret_cast<TOKEN_USER const*>(buffer.data())->User.Sid, &sid));
+            std::wstring sddl = L"D:P(A;;GA;;;" + std::wstring{ sid } + L")";
+            LocalFree(sid);
+            return sddl;
+        }
+
+        // System and administrators get everything, interactive users read
+        // and write: 0x12008b is FILE_GENERIC_READ | FILE_WRITE_DATA, without
+        // the FILE_CREATE_PIPE_INSTANCE in FILE_GENERIC_WRITE that would let
+        // any user add an instance of their own in front of the agents.
+        constexpr wchar_t InteractiveUsersSddl[] = L"D:P(A;;GA;;;SY)(A;;GA;;;BA)(A;;0x12008b;;;IU)";
+    }
+
+    ControlServer::ControlServer(DispatchSnapshotPointer& snapshots, ActionExecutor& executor, ConfigurationHandler pushConfiguration, Dispatcher dispatch) :
+        m_snapshots(&snapshots.RegisterReader()),
+        m_executor(&executor),
+        m_pushConfiguration(std::move(pushConfiguration)),
+        m_dispatch(std::move(dispatch))
+    {
+    }
+
+    ControlServer::ControlServer(SharedImageHandler attachShared) :
+        m_attachShared(std::move(attachShared))
+    {
+    }
+
+    ControlServer::~ControlServer()
+    {
+        Stop();
+    }
+
+    std::wstring ControlServer::PipeName()
+    {
+        DWORD session = 0;
+        ProcessIdToSessionId(GetCurrentProcessId(), &session);
+        return L"\\\\.\\pipe\\" + std::wstring{ ControlPipePrefix } + std::to_wstring(session);
+    }
+
+    std::wstring ControlServer::ServicePipeName()
+    {
+        return L"\\\\.\\pipe\\" + std::wstring{ SharedServicePipeName };
+    }
+
+    void ControlServer::Start()
+    {
+        if (m_thread.joinable())
+        {
+            return;
+        }
+
+        PSECURITY_DESCRIPTOR descriptor = nullptr;
+        std::wstring const sddl = IsService() ? std::wstring{ InteractiveUsersSddl } : CurrentUserOnlySddl();
+        winrt::check_bool(ConvertStringSecurityDescriptorToSecurityDescriptorW(sddl.c_str(), SDDL_REVISION_1, &descriptor, nullptr));
+        SECURITY_ATTRIBUTES attributes{ sizeof(attributes), descriptor, FALSE };
+
+        m_port = winrt::handle(winrt::check_pointer(CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1)));
+        std::wstring const name = IsService() ? ServicePipeName() : PipeName();
+        try
+        {
+            for (uint32_t i = 0; i < InstanceCount; ++i)
+            {
+                // The first instance claims the name, so a second copy of the
+                // app (or anyone else) cannot sit in front of our clients.
+                DWORD const openMode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (i == 0 ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+                Connection& connection = m_connections[i];
+                connection.pipe.attach(CreateNamedPipeW(name.c_str(), openMode, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                    PIPE_UNLIMITED_INSTANCES, static_cast<DWORD>(InitialBufferBytes), static_cast<DWORD>(InitialBufferBytes), 0, &attributes));
+                if (!connection.pipe)
+                {
+                    winrt::throw_last_error();
+                }
+                winrt::check_pointer(CreateIoCompletionPort(connection.pipe.get(), m_port.get(), reinterpret_cast<ULONG_PTR>(&connection), 0));
+                connection.input.resize(InitialBufferBytes);
+            }
+        }
+        catch (...)
+        {
+            LocalFree(descriptor);
+            for (Connection& connection : m_connections)
+            {
+                connection.pipe.close();
+            }
+            m_port.close();
+            throw;
+        }
+        LocalFree(descriptor);
+
+        m_stopping = false;
+        ProcessIdToSessionId(GetCurrentProcessId(), &m_session);
+        for (Connection& connection : m_connections)
+        {
+            Listen(connection);
+        }
+        m_thread = std::thread([this] { Run(); });
+    }
+
+    void ControlServer::Stop() noexcept
+    {
+        if (!m_thread.joinable())
+        {
+            return;
+        }
+        PostQueuedCompletionStatus(m_port.get(), 0, 0, nullptr);
+        m_thread.join();
+        for (Connection& connection : m_connections)
+        {
+            connection.pipe.close();
+        }
+        m_port.close();
+    }
+
+    void ControlServer::Run() noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), L"khm.control");
+
+        for (;;)
+        {
+            DWORD bytes = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED* overlapped = nullptr;
+            BOOL const ok = GetQueuedCompletionStatus(m_port.get(), &bytes, &key, &overlapped, INFINITE);
+            if (overlapped == nullptr)
+            {
+                break; // Stop(), or the port itself failed
+            }
+            OnCompletion(*reinterpret_cast<Connection*>(key), overlapped, bytes, ok != FALSE);
+        }
+
+        // The OVERLAPPEDs and buffers must outlive every operation on them.
+        m_stopping = true;
+        uint32_t pending = 0;
+        for (Connection& connection : m_connections)
+        {
+            if (connection.pendingIo != 0)
+            {
+                CancelIoEx(connection.pipe.get(), nullptr);
+                pending += connection.pendingIo;
+            }
+        }
+        while (pending != 0)
+        {
+            DWORD bytes = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED* overlapped = nullptr;
+            GetQueuedCompletionStatus(m_port.get(), &bytes, &key, &overlapped, 1000);
+            if (overlapped == nullptr)
+            {
+                break;
+            }
+            --reinterpret_cast<Connection*>(key)->pendingIo;
+            --pending;
+        }
+    }
+
+    void ControlServer::OnCompletion(Connection& connection, OVERLAPPED* overlapped, DWORD bytes, bool ok) noexcept
+    {
+        --connection.pendingIo;
+        bool const isWrite = overlapped == &connection.writeOverlapped;
+        if (isWrite)
+        {
+            connection.writePending = false;
+        }
+        else if (overlapped == &connection.pushOverlapped)
+        {
+            connection.pushPending = false;
+        }
+        if (connection.closing)
+        {
+            if (connection.pendingIo == 0)
+            {
+                Recycle(connection);
+            }
+            return;
+        }
+        if (!ok)
+        {
+            Close(connection); // client went away
+            return;
+        }
+
+        if (isWrite)
+        {
+            Flush(connection);
+            return;
+        }
+        if (overlapped == &connection.pushOverlapped)
+        {
+            OnPushed(connection);
+            return;
+        }
+        if (!connection.connected)
+        {
+            Accept(connection);
+            return;
+        }
+
+        connection.inputUsed += bytes;
+        Resume(connection);
+    }
+
+    void ControlServer::OnPushed(Connection& connection) noexcept
+    {
+        if (connection.pushed.empty())
+        {
+            Close(connection); // there was no memory for the answer
+            return;
+        }
+        try
+        {
+            connection.output.insert(connection.output.end(), connection.pushed.begin(), connection.pushed.end());
+        }
+        catch (...)
+        {
+            Close(connection);
+            return;
+        }
+        connection.pushed.clear();
+        Resume(connection);
+    }
+
+    void ControlServer::Resume(Connection& connection) noexcept
+    {
+        bool valid = false;
+        try
+        {
+            valid = HandleRequests(connection);
+        }
+        catch (...)
+        {
+        }
+        if (!valid)
+        {
+            Close(connection);
+            return;
+        }
+        Flush(connection);
+        if (!connection.closing && !connection.pushPending)
+        {
+            Read(connection);
+        }
+    }
+
+    void ControlServer::Listen(Connection& connection) noexcept
+    {
+        connection.connected = false;
+        connection.closing = false;
+        for (uint32_t attempt = 0; attempt < ListenAttempts; ++attempt)
+        {
+            connection.readOverlapped = {};
+            if (ConnectNamedPipe(connection.pipe.get(), &connection.readOverlapped))
+            {
+                ++connection.pendingIo; // completed inline, and still queued
+                return;
+            }
+            DWORD const error = GetLastError();
+            if (error == ERROR_IO_PENDING)
+            {
+                ++connection.pendingIo;
+                return;
+            }
+            if (error == ERROR_PIPE_CONNECTED)
+            {
+                // The client beat us to it; no completion is queued for this.
+                Accept(connection);
+                return;
+            }
+            // ERROR_NO_DATA: a client came and went before we listened. The
+            // instance is only usable again once disconnected.
+            DisconnectNamedPipe(connection.pipe.get());
+        }
+        OutputDebugStringA("KeyboardHookManager: control pipe listen failed\n");
+    }
+
+    void ControlServer::Accept(Connection& connection) noexcept
+    {
+        connection.connected = true;
+        ULONG session = 0;
+        if (!IsService() && (!GetNamedPipeClientSessionId(connection.pipe.get(), &session) || session != m_session))
+        {
+            Close(connection);
+            return;
+        }
+        Read(connection);
+    }
+
+    void ControlServer::Read(Connection& connection) noexcept
+    {
+        // Room for a whole request once its length is known.
+        size_t needed = connection.inputUsed + InitialBufferBytes / 2;
+        if (connection.inputUsed >= sizeof(uint32_t))
+        {
+            uint32_t length = 0;
+            std::memcpy(&length, connection.input.data(), sizeof(length));
+            needed = std::max(needed, sizeof(length) + size_t{ length });
+        }
+        if (connection.input.size() < needed)
+        {
+            try
+            {
+                connection.input.resize(std::max(needed, connection.input.size() * 2));
+            }
+            catch (...)
+            {
+                Close(connection);
+                return;
+            }
+        }
+
+        connection.readOverlapped = {};
+        if (!ReadFile(connection.pipe.get(), connection.input.data() + connection.inputUsed, static_cast<DWORD>(connection.input.size() - connection.inputUsed),
+                nullptr, &connection.readOverlapped) && GetLastError() != ERROR_IO_PENDING)
+        {
+            Close(connection);
+            return;
+        }
+        ++connection.pendingIo; // completions are queued even when ReadFile finishes inline
+    }
+
+    void ControlServer::Flush(Connection& connection) noexcept
+    {
+        if (connection.writePending || connection.output.empty())
+        {
+            return;
+        }
+        connection.writing.swap(connection.output);
+        connection.output.clear();
+
+        connection.writeOverlapped = {};
+        if (!WriteFile(connection.pipe.get(), connection.writing.data(), static_cast<DWORD>(connection.writing.size()), nullptr, &connection.writeOverlapped)
+            && GetLastError() != ERROR_IO_PENDING)
+        {
+            Close(connection);
+            return;
+        }
+        connection.writePending = true;
+        ++connection.pendingIo;
+    }
+
+    void ControlServer::Close(Connection& connection) noexcept
+    {
+        connection.closing = true;
+        if (connection.pendingIo == 0)
+        {
+            Recycle(connection);
+        }
+        else
+        {
+            // Recycled once the cancelled operations have completed.
+            CancelIoEx(connection.pipe.get(), nullptr);
+        }
+    }
+
+    void ControlServer::Recycle(Connection& connection) noexcept
+    {
+        DisconnectNamedPipe(connection.pipe.get());
+        connection.inputUsed = 0;
+        connection.output.clear();
+        connection.writing.clear();
+        connection.pushed.clear();
+        if (connection.input.size() > RetainedBufferBytes)
+        {
+            connection.input = std::vector<uint8_t>(InitialBufferBytes);
+        }
+        for (std::vector<uint8_t>* buffer : { &connection.output, &connection.writing, &connection.pushed })
+        {
+            if (buffer->capacity() > RetainedBufferBytes)
+            {
+                *buffer = {};
+            }
+        }
+        if (!m_stopping)
+        {
+            Listen(connection);
+        }
+    }
+
+    bool ControlServer::HandleRequests(Connection& connection)
+    {
+        uint8_t* const input = connection.input.data();
+        size_t offset = 0;
+        while (!connection.pushPending && connection.inputUsed - offset >= sizeof(uint32_t))
+        {
+            uint32_t length = 0;
+            std::memcpy(&length, input + offset, sizeof(length));
+            if (length < sizeof(ControlRequestHeader) || length > MaxControlMessage)
+            {
+                return false;
+            }
+            if (connection.inputUsed - offset - sizeof(length) < length)
+            {
+                break;
+            }
+
+            ControlRequestHeader request;
+            std::memcpy(&request, input + offset + sizeof(length), sizeof(request));
+            std::string_view const payload(reinterpret_cast<char const*>(input + offset + sizeof(length) + sizeof(request)), length - sizeof(request));
+            Handle(request, payload, connection);
+            offset += sizeof(length) + length;
+        }
+
+        if (offset != 0)
+        {
+            std::memmove(input, input + offset, connection.inputUsed - offset);
+            connection.inputUsed -= offset;
+        }
+        // A client that never reads its responses is cut off.
+        return connection.output.size() <= MaxControlMessage;
+    }
+
+    void ControlServer::Handle(ControlRequestHeader const& request, std::string_view payload, Connection& connection)
+    {
+        std::vector<uint8_t>& output = connection.output;
+
+        // Ping works on both pipes; AttachShared only on the service's, and
+        // everything else only on a session's.
+        if (request.opcode != ControlOpcode::Ping && (request.opcode == ControlOpcode::AttachShared) != IsService())
+        {
+            AppendResponse(output, ControlStatus::BadRequest, request.tag);
+            return;
+        }
+
+        switch (request.opcode)
+        {
+        case ControlOpcode::Ping:
+            AppendResponse(output, ControlStatus::Ok, request.tag);
+            break;
+        case ControlOpcode::Trigger:
+            Trigger(payload, output, request.tag);
+            break;
+        case ControlOpcode::QueryBinding:
+            QueryBinding(payload, output, request.tag);
+            break;
+        case ControlOpcode::QueryStats:
+            QueryStats(output, request.tag);
+            break;
+        case ControlOpcode::PushConfiguration:
+            PushConfiguration(payload, connection, request.tag);
+            break;
+        case ControlOpcode::AttachShared:
+            AttachShared(output, request.tag);
+            break;
+        default:
+            AppendResponse(output, ControlStatus::BadRequest, request.tag);
+            break;
+        }
+    }
+
+    void ControlServer::Trigger(std::string_view id, std::vector<uint8_t>& output, uint32_t tag)
+    {
+        uint32_t index = ActionTable::NotFound;
+        bool enabled = false;
+        {
+            RcuReadGuard<DispatchSnapshot> const snapshot(*m_snapshots);
+            ActionTable const& actions = snapshot->configuration.actions;
+            index = actions.Find(id);
+            enabled = index != ActionTable::NotFound && actions[index].enabled;
+        }
+        if (index != ActionTable::NotFound && !enabled)
+        {
+            constexpr std::string_view Disabled = "action is disabled";
+            AppendResponse(output, ControlStatus::Rejected, tag, Disabled.data(), Disabled.size());
+            return;
+        }
+        ControlStatus const status = index == ActionTable::NotFound ? ControlStatus::NotFound
+            : m_executor->Trigger(index) ? ControlStatus::Ok
+            : ControlStatus::Busy;
+        AppendResponse(output, status, tag);
+    }
+
+    void ControlServer::QueryBinding(std::string_view id, std::vector<uint8_t>& output, uint32_t tag)
+    {
+        RcuReadGuard<DispatchSnapshot> const snapshot(*m_snapshots);
+        ActionTable const& actions = snapshot->configuration.actions;
+        uint32_t const index = actions.Find(id);
+        if (index == ActionTable::NotFound)
+        {
+            AppendResponse(output, ControlStatus::NotFound, tag);
+            return;
+        }
+
+        ActionRecord const& action = actions[index];
+        uint32_t const steps = actions.SequenceLength(action);
+        bool bound = action.hasHotkey && snapshot->TableOf(index).Lookup(action.hotkey) == index;
+        if (!bound && steps != 0)
+        {
+            uint32_t state = KeySequenceTable::Root;
+            for (uint32_t step = 0; step < steps && state != KeySequenceTable::NoState; ++step)
+            {
+                state = snapshot->sequences->Next(state, actions.SequenceStep(action, step));
+            }
+            bound = state != KeySequenceTable::NoState && snapshot->sequences->ActionAt(state) == index;
+        }
+
+        uint8_t payload[sizeof(ControlBinding) + MaxSequenceLength * 2];
+        ControlBinding const binding{
+            index,
+            static_cast<uint8_t>(action.enabled),
+            static_cast<uint8_t>(action.hasHotkey),
+            static_cast<uint8_t>(bound),
+            action.hotkey.modifiers,
+            action.hotkey.key,
+            static_cast<uint8_t>(steps),
+        };
+        std::memcpy(payload, &binding, sizeof(binding));
+        std::memcpy(payload + sizeof(binding), actions.String(action.sequence).data(), action.sequence.length);
+        AppendResponse(output, ControlStatus::Ok, tag, payload, sizeof(binding) + action.sequence.length);
+    }
+
+    void ControlServer::QueryStats(std::vector<uint8_t>& output, uint32_t tag)
+    {
+        ControlStats stats{};
+        {
+            RcuReadGuard<DispatchSnapshot> const snapshot(*m_snapshots);
+            stats.generation = snapshot->generation;
+            stats.actionCount = snapshot->configuration.actions.Size();
+            stats.bindingCount = snapshot->BindingCount();
+        }
+        stats.executed = m_executor->Executed();
+        stats.failed = m_executor->Failed();
+        stats.skipped = m_executor->Skipped();
+        stats.dropped = m_executor->Dropped();
+        HookHealth const hook = KeyboardHook::Health();
+        stats.hookReinstalls = hook.reinstalls;
+        stats.slowCallbacks = hook.slowCallbacks;
+        ResidentMemory const memory = WorkingSet::Query();
+        stats.workingSetBytes = memory.workingSetBytes;
+        stats.privateBytes = memory.privateBytes;
+        stats.pinnedBytes = memory.pinnedBytes;
+        stats.trims = memory.trims;
+        AppendResponse(output, ControlStatus::Ok, tag, &stats, sizeof(stats));
+    }
+
+    void ControlServer::PushConfiguration(std::string_view json, Connection& connection, uint32_t tag)
+    {
+        // Parsing takes as long as the configuration is big and publishing
+        // waits for readers; off this thread, neither holds up the other
+        // connections. The payload is copied: its buffer takes the next read.
+        auto work = [this, target = &connection, tag, json = std::string(json)] {
+            std::vector<uint8_t>& answer = target->pushed;
+            try
+            {
+                try
+                {
+                    uint64_t const generation = m_pushConfiguration(json);
+                    AppendResponse(answer, ControlStatus::Ok, tag, &generation, sizeof(generation));
+                }
+                catch (std::exception const& e)
+                {
+                    std::string_view const message = e.what();
+                    AppendResponse(answer, ControlStatus::Rejected, tag, message.data(), message.size());
+                }
+                catch (winrt::hresult_error const& e)
+                {
+                    std::string const message = winrt::to_string(e.message());
+                    AppendResponse(answer, ControlStatus::Rejected, tag, message.data(), message.size());
+                }
+            }
+            catch (...)
+            {
+                answer.clear();
+            }
+            PostQueuedCompletionStatus(m_port.get(), 0, reinterpret_cast<ULONG_PTR>(target), &target->pushOverlapped);
+        };
+        try
+        {
+            m_dispatch(std::move(work));
+        }
+        catch (...)
+        {
+            AppendResponse(connection.output, ControlStatus::Busy, tag);
+            return;
+        }
+        // Only this thread dequeues the answer, so there is no race with it.
+        connection.pushPending = true;
+        ++connection.pendingIo;
+    }
+
+    void ControlServer::AttachShared(std::vector<uint8_t>& output, uint32_t tag)
+    {
+        SharedImage const image = m_attachShared();
+        if (image.section.empty())
+        {
+            AppendResponse(output, ControlStatus::NotFound, tag);
+            return;
+        }
+
+        ControlSharedImage const info{ image.generation, image.bytes, static_cast<uint32_t>(image.section.size()) };
+        size_t const nameBytes = image.section.size() * sizeof(wchar_t);
+        std::vector<uint8_t> payload(sizeof(info) + nameBytes);
+        std::memcpy(payload.data(), &info, sizeof(info));
+        std::memcpy(payload.data() + sizeof(info), image.section.data(), nameBytes);
+        AppendResponse(output, ControlStatus::Ok, tag, payload.data(), payload.size());
+    }
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Actions/ActionExecutor.h"
+#include "Core/DispatchSnapshot.h"
+#include "Ipc/ControlProtocol.h"
+#include "Ipc/SharedConfiguration.h"
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace khm
+{
+    // Named-pipe server for scripted control (see ControlProtocol.h). A few
+    // pipe instances share one completion port serviced by a single thread,
+    // so triggers reach the executor from exactly one producer. Each
+    // connection keeps its buffers across requests and clients; every read
+    // completion answers all the complete requests it holds in one write.
+    // A pushed configuration is parsed and published elsewhere: its
+    // connection stops reading until the answer comes back through the
+    // port, so responses stay in request order.
+    //
+    // The shared configuration service runs the same server on its own pipe,
+    // answering only Ping and AttachShared.
+    class ControlServer
+    {
+    public:
+        // Applies a pushed configuration and returns the published
+        // generation. Throws ConfigurationError for a rejected one.
+        using ConfigurationHandler = std::function<uint64_t(std::string_view json)>;
+
+        // Runs `work` later on the thread that publishes configurations,
+        // never on the caller's. Throws when it cannot be queued.
+        using Dispatcher = std::function<void(std::function<void()> work)>;
+
+        // The image agents should map; empty section before the first publish.
+        using SharedImageHandler = std::function<SharedImage()>;
+
+        // Per-session pipe, for the current user in the current session only.
+        ControlServer(DispatchSnapshotPointer& snapshots, ActionExecutor& executor, ConfigurationHandler pushConfiguration, Dispatcher dispatch);
+        // Service pipe, for every interactive user.
+        explicit ControlServer(SharedImageHandler attachShared);
+        ~ControlServer();
+
+        ControlServer(ControlServer const&) = delete;
+        ControlServer& operator=(ControlServer const&) = delete;
+
+        // Throws when the pipe cannot be created, e.g. because another
+        // instance already owns it.
+        void Start();
+        void Stop() noexcept;
+
+        static std::wstring PipeName();
+        static std::wstring ServicePipeName();
+
+    private:
+        static constexpr uint32_t InstanceCount = 4;
+        static constexpr size_t InitialBufferBytes = 4096;
+        static constexpr uint32_t ListenAttempts = 3; // per instance, before it is given up
+
+        struct Connection
+        {
+            winrt::file_handle pipe;
+            OVERLAPPED readOverlapped{};  // also carries ConnectNamedPipe
+            OVERLAPPED writeOverlapped{};
+            OVERLAPPED pushOverlapped{};  // posted once a pushed configuration is answered
+            std::vector<uint8_t> input;
+            size_t inputUsed = 0;
+            std::vector<uint8_t> output;  // responses not yet handed to WriteFile
+            std::vector<uint8_t> writing; // owned by the pending WriteFile
+            std::vector<uint8_t> pushed;  // owned by the dispatched push
+            uint32_t pendingIo = 0;
+            bool connected = false;
+            bool writePending = false;
+            bool pushPending = false;     // no reads or requests until it is answered
+            bool closing = false;
+        };
+
+        void Run() noexcept;
+        void OnCompletion(Connection& connection, OVERLAPPED* overlapped, DWORD bytes, bool ok) noexcept;
+        void Listen(Connection& connection) noexcept;
+        void Accept(Connection& connection) noexcept;
+        void Read(Connection& connection) noexcept;
+        void Flush(Connection& connection) noexcept;
+        void Close(Connection& connection) noexcept;
+        void Recycle(Connection& connection) noexcept;
+
+        // Answers every complete request at the front of the input buffer.
+        bool HandleRequests(Connection& connection);
+        void Handle(ControlRequestHeader const& request, std::string_view payload, Connection& connection);
+        // Back on the server thread with a push's answer.
+        void OnPushed(Connection& connection) noexcept;
+        void Resume(Connection& connection) noexcept;
+
+        void Trigger(std::string_view id, std::vector<uint8_t>& output, uint32_t tag);
+        void QueryBinding(std::string_view id, std::vector<uint8_t>& output, uint32_t tag);
+        void QueryStats(std::vector<uint8_t>& output, uint32_t tag);
+        void PushConfiguration(std::string_view json, Connection& connection, uint32_t tag);
+        void AttachShared(std::vector<uint8_t>& output, uint32_t tag);
+
+        bool IsService() const noexcept { return m_executor == nullptr; }
+
+        // Null on the service pipe.
+        DispatchSnapshotPointer::Reader* m_snapshots = nullptr;
+        ActionExecutor* m_executor = nullptr;
+        ConfigurationHandler m_pushConfiguration;
+        Dispatcher m_dispatch;
+        SharedImageHandler m_attachShared;
+
+        winrt::handle m_port;
+        std::array<Connection, InstanceCount> m_connections;
+        std::thread m_thread;
+        bool m_stopping = false; // server thread only
+        DWORD m_session = 0;     // whose clients the per-session pipe admits
+    };
+}
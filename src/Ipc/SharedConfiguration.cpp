@@ -0,0 +1,316 @@
+#include "pch.h"
+#include "Ipc/SharedConfiguration.h"
+
+#include "Ipc/ControlProtocol.h"
+
+#include <sddl.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace khm
+{
+    namespace
+    {
+        constexpr wchar_t SectionPrefix[] = L"Global\\KeyboardHookManager.config.";
+        constexpr wchar_t SupersededSuffix[] = L".superseded";
+        constexpr DWORD ConnectTimeoutMs = 2000;
+        constexpr uint32_t MaxAttachResponse = 64 * 1024;
+
+        // System and administrators get everything; interactive users (every
+        // RDS session) only FILE_MAP_READ on a section and SYNCHRONIZE on an
+        // event.
+        constexpr wchar_t SectionSddl[] = L"D:P(A;;GA;;;SY)(A;;GA;;;BA)(A;;0x4;;;IU)";
+        constexpr wchar_t EventSddl[] = L"D:P(A;;GA;;;SY)(A;;GA;;;BA)(A;;0x100000;;;IU)";
+
+        class SecurityAttributes
+        {
+        public:
+            explicit SecurityAttributes(wchar_t const* sddl)
+            {
+                winrt::check_bool(ConvertStringSecurityDescriptorToSecurityDescriptorW(sddl, SDDL_REVISION_1, &m_attributes.lpSecurityDescriptor, nullptr));
+            }
+            ~SecurityAttributes() { LocalFree(m_attributes.lpSecurityDescriptor); }
+
+            SecurityAttributes(SecurityAttributes const&) = delete;
+            SecurityAttributes& operator=(SecurityAttributes const&) = delete;
+
+            SECURITY_ATTRIBUTES* get() noexcept { return &m_attributes; }
+
+        private:
+            SECURITY_ATTRIBUTES m_attributes{ sizeof(SECURITY_ATTRIBUTES), nullptr, FALSE };
+        };
+
+        // A name that already exists is someone else's object, never ours.
+        HANDLE CheckCreated(HANDLE handle)
+        {
+            if (handle == nullptr)
+            {
+                winrt::throw_last_error();
+            }
+            if (GetLastError() == ERROR_ALREADY_EXISTS)
+            {
+                CloseHandle(handle);
+                winrt::throw_hresult(HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS));
+            }
+            return handle;
+        }
+
+        void ReadAll(HANDLE pipe, void* data, size_t bytes)
+        {
+            auto* cursor = static_cast<uint8_t*>(data);
+            while (bytes != 0)
+            {
+                DWORD done = 0;
+                if (!ReadFile(pipe, cursor, static_cast<DWORD>(bytes), &done, nullptr))
+                {
+                    winrt::throw_last_error();
+                }
+                if (done == 0)
+                {
+                    throw std::runtime_error("shared configuration service closed the pipe");
+                }
+                cursor += done;
+                bytes -= done;
+            }
+        }
+    }
+
+    SharedConfigurationPublisher::SharedConfigurationPublisher() :
+        m_prefix(SectionPrefix + std::to_wstring(GetCurrentProcessId()) + L"." + std::to_wstring(GetTickCount64()) + L".")
+    {
+    }
+
+    SharedConfigurationPublisher::~SharedConfigurationPublisher()
+    {
+        // Agents re-query, find no service and keep what they have.
+        if (m_superseded)
+        {
+            SetEvent(m_superseded.get());
+        }
+    }
+
+    void SharedConfigurationPublisher::Publish(DispatchSnapshot const& snapshot)
+    {
+        std::vector<std::byte> const image = ConfigurationCache::Serialize(snapshot.configuration, *snapshot.table);
+        if (image.size() > UINT32_MAX)
+        {
+            winrt::throw_hresult(E_INVALIDARG);
+        }
+        std::wstring const name = m_prefix + std::to_wstring(snapshot.generation);
+
+        SecurityAttributes sectionAttributes(SectionSddl);
+        winrt::handle section{ CheckCreated(CreateFileMappingW(INVALID_HANDLE_VALUE, sectionAttributes.get(), PAGE_READWRITE, 0,
+            static_cast<DWORD>(image.size()), name.c_str())) };
+        void* const view = MapViewOfFile(section.get(), FILE_MAP_WRITE, 0, 0, image.size());
+        if (view == nullptr)
+        {
+            winrt::throw_last_error();
+        }
+        std::memcpy(view, image.data(), image.size());
+        UnmapViewOfFile(view);
+
+        SecurityAttributes eventAttributes(EventSddl);
+        winrt::handle superseded{ CheckCreated(CreateEventW(eventAttributes.get(), TRUE, FALSE, (name + SupersededSuffix).c_str())) };
+
+        std::scoped_lock lock(m_lock);
+        if (m_superseded)
+        {
+            SetEvent(m_superseded.get());
+        }
+        // The previous section lives on only while an agent still maps it.
+        m_section = std::move(section);
+        m_superseded = std::move(superseded);
+        m_current = { snapshot.generation, static_cast<uint32_t>(image.size()), name };
+    }
+
+    SharedImage SharedConfigurationPublisher::Current() const
+    {
+        std::scoped_lock lock(m_lock);
+        return m_current;
+    }
+
+    SharedImage SharedConfigurationClient::Query()
+    {
+        std::wstring const name = L"\\\\.\\pipe\\" + std::wstring{ SharedServicePipeName };
+        winrt::file_handle pipe;
+        for (int attempt = 0;; ++attempt)
+        {
+            pipe.attach(CreateFileW(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr));
+            if (pipe)
+            {
+                break;
+            }
+            // All instances busy: the service answers in microseconds.
+            if (GetLastError() != ERROR_PIPE_BUSY || attempt == 2 || !WaitNamedPipeW(name.c_str(), ConnectTimeoutMs))
+            {
+                winrt::throw_last_error();
+            }
+        }
+
+        ULONG session = 0;
+        if (!GetNamedPipeServerSessionId(pipe.get(), &session) || session != 0)
+        {
+            throw std::runtime_error("shared configuration pipe is not served by the service");
+        }
+
+        uint8_t request[sizeof(uint32_t) + sizeof(ControlRequestHeader)];
+        uint32_t length = sizeof(ControlRequestHeader);
+        ControlRequestHeader const header{ ControlOpcode::AttachShared, {}, 0 };
+        std::memcpy(request, &length, sizeof(length));
+        std::memcpy(request + sizeof(length), &header, sizeof(header));
+        DWORD done = 0;
+        if (!WriteFile(pipe.get(), request, sizeof(request), &done, nullptr) || done != sizeof(request))
+        {
+            winrt::throw_last_error();
+        }
+
+        ReadAll(pipe.get(), &length, sizeof(length));
+        if (length < sizeof(ControlResponseHeader) || length > MaxAttachResponse)
+        {
+            throw std::runtime_error("shared configuration service sent a malformed response");
+        }
+        std::vector<uint8_t> response(length);
+        ReadAll(pipe.get(), response.data(), response.size());
+
+        ControlResponseHeader status;
+        std::memcpy(&status, response.data(), sizeof(status));
+        if (status.status != ControlStatus::Ok)
+        {
+            throw std::runtime_error("shared configuration service has no configuration to share");
+        }
+
+        ControlSharedImage info;
+        size_t const fixed = sizeof(ControlResponseHeader) + sizeof(ControlSharedImage);
+        if (length < fixed)
+        {
+            throw std::runtime_error("shared configuration service sent a malformed response");
+        }
+        std::memcpy(&info, response.data() + sizeof(ControlResponseHeader), sizeof(info));
+        if (info.nameLength == 0 || size_t{ info.nameLength } * sizeof(wchar_t) != length - fixed)
+        {
+            throw std::runtime_error("shared configuration service sent a malformed response");
+        }
+
+        SharedImage image;
+        image.generation = info.generation;
+        image.bytes = info.imageBytes;
+        image.section.resize(info.nameLength);
+        std::memcpy(image.section.data(), response.data() + fixed, length - fixed);
+        return image;
+    }
+
+    std::optional<CachedConfiguration> SharedConfigurationClient::Open(SharedImage const& image) noexcept
+    {
+        winrt::handle const section{ OpenFileMappingW(FILE_MAP_READ, FALSE, image.section.c_str()) };
+        if (!section)
+        {
+            return std::nullopt;
+        }
+        void const* const view = MapViewOfFile(section.get(), FILE_MAP_READ, 0, 0, image.bytes);
+        if (view == nullptr)
+        {
+            return std::nullopt;
+        }
+        std::optional<CachedConfiguration> cached = ConfigurationCache::Parse({ static_cast<std::byte const*>(view), image.bytes });
+        UnmapViewOfFile(view);
+        return cached;
+    }
+
+    SharedConfigurationWatcher::SharedConfigurationWatcher(Callback onChanged) :
+        m_onChanged(std::move(onChanged))
+    {
+    }
+
+    SharedConfigurationWatcher::~SharedConfigurationWatcher()
+    {
+        Stop();
+    }
+
+    void SharedConfigurationWatcher::Start()
+    {
+        if (m_thread.joinable())
+        {
+            return;
+        }
+        m_stopEvent.attach(winrt::check_pointer(CreateEventW(nullptr, TRUE, FALSE, nullptr)));
+        m_retargetEvent.attach(winrt::check_pointer(CreateEventW(nullptr, FALSE, FALSE, nullptr)));
+        m_thread = std::thread([this] { Run(); });
+    }
+
+    void SharedConfigurationWatcher::Stop() noexcept
+    {
+        if (m_thread.joinable())
+        {
+            SetEvent(m_stopEvent.get());
+            m_thread.join();
+        }
+        m_stopEvent.close();
+        m_retargetEvent.close();
+    }
+
+    void SharedConfigurationWatcher::Watch(SharedImage const& image)
+    {
+        // Before the first attach there is nothing to watch but the poll.
+        std::wstring eventName = image.section.empty() ? std::wstring{} : image.section + SupersededSuffix;
+        {
+            std::scoped_lock lock(m_lock);
+            if (m_eventName == eventName)
+            {
+                return;
+            }
+            m_eventName = std::move(eventName);
+        }
+        if (m_retargetEvent)
+        {
+            SetEvent(m_retargetEvent.get());
+        }
+    }
+
+    void SharedConfigurationWatcher::Run() noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), L"khm.shared");
+
+        // Once the current image has been reported superseded, only a
+        // retarget or the poll interval runs the callback again.
+        bool notified = false;
+        for (;;)
+        {
+            winrt::handle superseded;
+            if (!notified)
+            {
+                bool watching = false;
+                {
+                    std::scoped_lock lock(m_lock);
+                    watching = !m_eventName.empty();
+                    if (watching)
+                    {
+                        superseded.attach(OpenEventW(SYNCHRONIZE, FALSE, m_eventName.c_str()));
+                    }
+                }
+                if (watching && !superseded)
+                {
+                    // Gone before we opened it: the service has moved on, or stopped.
+                    notified = true;
+                    m_onChanged();
+                    continue;
+                }
+            }
+
+            HANDLE const waits[] = { m_stopEvent.get(), m_retargetEvent.get(), superseded.get() };
+            DWORD const result = WaitForMultipleObjects(superseded ? 3 : 2, waits, FALSE, PollIntervalMs);
+            if (result == WAIT_OBJECT_0)
+            {
+                return;
+            }
+            if (result == WAIT_OBJECT_0 + 1)
+            {
+                notified = false;
+                continue;
+            }
+            notified |= result == WAIT_OBJECT_0 + 2; // stays set
+            m_onChanged();
+        }
+    }
+}
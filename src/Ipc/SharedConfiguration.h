@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Configuration/ConfigurationCache.h"
+#include "Core/DispatchSnapshot.h"
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace khm
+{
+    // Where one published configuration lives.
+    struct SharedImage
+    {
+        uint64_t generation = 0;
+        uint32_t bytes = 0;
+        std::wstring section; // Global\ section name; empty before the first publish
+    };
+
+    // Service side of --service/--agent on multi-session hosts. Every
+    // configuration the service loads is serialized once, as the
+    // ConfigurationCache image, into a pagefile-backed section that every
+    // interactive user may map read-only, so no agent parses the JSON.
+    // Sections are never written twice: each generation gets a new one, with
+    // a manual-reset "<section>.superseded" event the service sets when the
+    // next generation is out (and when it stops).
+    class SharedConfigurationPublisher
+    {
+    public:
+        SharedConfigurationPublisher();
+        ~SharedConfigurationPublisher();
+
+        SharedConfigurationPublisher(SharedConfigurationPublisher const&) = delete;
+        SharedConfigurationPublisher& operator=(SharedConfigurationPublisher const&) = delete;
+
+        // Throws winrt::hresult_error when the section cannot be created,
+        // e.g. without SeCreateGlobalPrivilege, which services have.
+        void Publish(DispatchSnapshot const& snapshot);
+
+        // Any thread; what the service pipe answers AttachShared with.
+        SharedImage Current() const;
+
+    private:
+        mutable std::mutex m_lock;
+        std::wstring m_prefix; // unique per run: agents may still hold a previous run's objects
+        winrt::handle m_section;
+        winrt::handle m_superseded;
+        SharedImage m_current;
+    };
+
+    // Agent side: finds and maps the service's current image.
+    class SharedConfigurationClient
+    {
+    public:
+        // One AttachShared round trip on the service pipe. Throws
+        // winrt::hresult_error when the service cannot be reached and
+        // std::runtime_error for a malformed answer, or a pipe served from
+        // outside session 0 (some user sitting on the name).
+        static SharedImage Query();
+
+        // nullopt when the section is gone (superseded before we got to it)
+        // or does not hold a valid image. The records are copied into the
+        // agent's table, which a reload re-slots anyway; what the section
+        // saves every session is the parse.
+        static std::optional<CachedConfiguration> Open(SharedImage const& image) noexcept;
+    };
+
+    // Calls `onChanged` on its own thread once the watched image has been
+    // superseded, and every PollIntervalMs besides: a restarted service
+    // cannot signal the previous run's events.
+    class SharedConfigurationWatcher
+    {
+    public:
+        static constexpr DWORD PollIntervalMs = 30'000;
+
+        using Callback = std::function<void()>;
+
+        explicit SharedConfigurationWatcher(Callback onChanged);
+        ~SharedConfigurationWatcher();
+
+        SharedConfigurationWatcher(SharedConfigurationWatcher const&) = delete;
+        SharedConfigurationWatcher& operator=(SharedConfigurationWatcher const&) = delete;
+
+        void Start();
+        void Stop() noexcept;
+
+        // Any thread, the callback included: the image the agent now runs.
+        void Watch(SharedImage const& image);
+
+    private:
+        void Run() noexcept;
+
+        Callback m_onChanged;
+        std::mutex m_lock;
+        std::wstring m_eventName;
+        winrt::handle m_stopEvent;
+        winrt::handle m_retargetEvent;
+        std::thread m_thread;
+    };
+}
@@ -0,0 +1,155 @@
+#include "pch.h"
+#include "UI/ActionSearchIndex.h"
+
+#include <windows.h>
+
+#include <algorithm>
+
+namespace khm
+{
+    void ActionSearchIndex::Update(uint32_t slot, std::wstring_view text)
+    {
+        std::wstring folded = Fold(text);
+        if (slot < m_texts.size() && m_texts[slot] == folded)
+        {
+            return;
+        }
+        Remove(slot);
+        if (slot >= m_texts.size())
+        {
+            m_texts.resize(slot + 1);
+        }
+        for (Gram gram : Grams(folded))
+        {
+            std::vector<uint32_t>& postings = m_postings[gram];
+            postings.insert(std::ranges::lower_bound(postings, slot), slot);
+        }
+        m_texts[slot] = std::move(folded);
+    }
+
+    void ActionSearchIndex::Remove(uint32_t slot)
+    {
+        if (slot >= m_texts.size() || m_texts[slot].empty())
+        {
+            return;
+        }
+        for (Gram gram : Grams(m_texts[slot]))
+        {
+            auto const postings = m_postings.find(gram);
+            if (postings == m_postings.end())
+            {
+                continue;
+            }
+            auto const at = std::ranges::lower_bound(postings->second, slot);
+            if (at != postings->second.end() && *at == slot)
+            {
+                postings->second.erase(at);
+            }
+            if (postings->second.empty())
+            {
+                m_postings.erase(postings);
+            }
+        }
+        m_texts[slot].clear();
+    }
+
+    void ActionSearchIndex::Clear() noexcept
+    {
+        m_texts.clear();
+        m_postings.clear();
+    }
+
+    std::vector<uint32_t> ActionSearchIndex::Search(std::wstring_view query) const
+    {
+        std::wstring const folded = Fold(query);
+        if (folded.empty())
+        {
+            return {};
+        }
+
+        // Every match is on the list of each of the query's grams; the
+        // shortest list is the cheapest to verify.
+        std::vector<uint32_t> const* candidates = nullptr;
+        size_t const gram = std::min(folded.size(), MaxGram);
+        for (size_t i = 0; i + gram <= folded.size(); ++i)
+        {
+            auto const postings = m_postings.find(MakeGram(std::wstring_view{ folded }.substr(i, gram)));
+            if (postings == m_postings.end())
+            {
+                return {};
+            }
+            if (candidates == nullptr || postings->second.size() < candidates->size())
+            {
+                candidates = &postings->second;
+            }
+        }
+
+        std::vector<uint32_t> slots;
+        if (folded.size() <= MaxGram)
+        {
+            slots = *candidates;
+        }
+        else
+        {
+            for (uint32_t slot : *candidates)
+            {
+                if (Matches(slot, folded))
+                {
+                    slots.push_back(slot);
+                }
+            }
+        }
+        return slots;
+    }
+
+    void ActionSearchIndex::Refine(std::vector<uint32_t>& slots, std::wstring_view query) const
+    {
+        std::wstring const folded = Fold(query);
+        std::erase_if(slots, [&](uint32_t slot) { return !Matches(slot, folded); });
+    }
+
+    std::wstring ActionSearchIndex::Fold(std::wstring_view text)
+    {
+        std::wstring folded{ text };
+        if (!folded.empty())
+        {
+            CharLowerBuffW(folded.data(), static_cast<DWORD>(folded.size()));
+        }
+        return folded;
+    }
+
+    std::vector<ActionSearchIndex::Gram> ActionSearchIndex::Grams(std::wstring_view folded)
+    {
+        std::vector<Gram> grams;
+        grams.reserve(folded.size() * MaxGram);
+        for (size_t i = 0; i < folded.size(); ++i)
+        {
+            for (size_t length = 1; length <= MaxGram && i + length <= folded.size(); ++length)
+            {
+                if (folded[i + length - 1] == FieldSeparator)
+                {
+                    break;
+                }
+                grams.push_back(MakeGram(folded.substr(i, length)));
+            }
+        }
+        std::ranges::sort(grams);
+        grams.erase(std::ranges::unique(grams).begin(), grams.end());
+        return grams;
+    }
+
+    ActionSearchIndex::Gram ActionSearchIndex::MakeGram(std::wstring_view text) noexcept
+    {
+        Gram gram = text.size();
+        for (wchar_t c : text)
+        {
+            gram = (gram << 16) | static_cast<uint16_t>(c);
+        }
+        return gram;
+    }
+
+    bool ActionSearchIndex::Matches(uint32_t slot, std::wstring_view folded) const noexcept
+    {
+        return slot < m_texts.size() && m_texts[slot].find(folded) != std::wstring::npos;
+    }
+}
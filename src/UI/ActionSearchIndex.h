@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace khm
+{
+    // Case-insensitive substring search over the hotkey list. Every 1-, 2-
+    // and 3-character gram of a slot's text has a sorted posting list, so a
+    // query only verifies the slots on its rarest gram's list. Slots are
+    // re-indexed one at a time as reloads change them.
+    class ActionSearchIndex
+    {
+    public:
+        static constexpr size_t MaxGram = 3;
+
+        // Separates the searchable fields of one slot; no gram spans it.
+        static constexpr wchar_t FieldSeparator = L'\n';
+
+        // `text` is the slot's fields joined by FieldSeparator.
+        void Update(uint32_t slot, std::wstring_view text);
+        void Remove(uint32_t slot);
+        void Clear() noexcept;
+
+        // Matching slots in ascending order.
+        std::vector<uint32_t> Search(std::wstring_view query) const;
+
+        // Drops the slots of `slots` that do not match; for a query that
+        // extends the one `slots` was found with.
+        void Refine(std::vector<uint32_t>& slots, std::wstring_view query) const;
+
+        static std::wstring Fold(std::wstring_view text);
+
+    private:
+        using Gram = uint64_t; // up to MaxGram UTF-16 units and the length
+
+        static std::vector<Gram> Grams(std::wstring_view folded);
+        static Gram MakeGram(std::wstring_view text) noexcept;
+
+        bool Matches(uint32_t slot, std::wstring_view folded) const noexcept;
+
+        std::vector<std::wstring> m_texts; // folded, by slot
+        std::unordered_map<Gram, std::vector<uint32_t>> m_postings;
+    };
+}
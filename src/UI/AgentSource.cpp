@@ -0,0 +1,118 @@
+#include "pch.h"
+#include "UI/AgentSource.h"
+
+#include "Configuration/ConfigurationCache.h"
+#include "Configuration/ConfigurationLoader.h"
+#include "Configuration/ConfigurationOverlay.h"
+
+#include <stdexcept>
+
+namespace khm
+{
+    namespace
+    {
+        // Switches `agent` to the service's current image and returns its
+        // dispatch table, or null when the agent already runs that image. An
+        // image superseded between the query and the open is retried with the
+        // next one. Throws when the service cannot be reached.
+        std::unique_ptr<HotkeyDispatchTable> AttachShared(AgentSource& agent)
+        {
+            for (int attempt = 0; attempt < 3; ++attempt)
+            {
+                SharedImage image = SharedConfigurationClient::Query();
+                if (image.section == agent.image.section)
+                {
+                    return nullptr;
+                }
+                if (std::optional<CachedConfiguration> cached = SharedConfigurationClient::Open(image))
+                {
+                    agent.base = std::move(cached->configuration);
+                    agent.image = std::move(image);
+                    return std::move(cached->table);
+                }
+            }
+            throw std::runtime_error("the shared configuration could not be mapped");
+        }
+
+        // Re-reads the overrides file if it changed, appeared or went away;
+        // true when the effective configuration has to be rebuilt.
+        bool RefreshOverrides(AgentSource& agent)
+        {
+            std::error_code error;
+            if (!std::filesystem::exists(agent.overridesPath, error))
+            {
+                bool const had = agent.overrides.has_value();
+                agent.overrides.reset();
+                return had;
+            }
+            uint64_t const known = agent.overrides ? agent.overrides->sourceHash : 0;
+            if (std::optional<LoadedConfiguration> loaded = ConfigurationLoader::LoadIfChanged(agent.overridesPath, known))
+            {
+                agent.overrides = std::move(loaded);
+                return true;
+            }
+            return false;
+        }
+
+        void ReportServiceUnavailable(char const* message) noexcept
+        {
+            OutputDebugStringA("KeyboardHookManager: shared configuration service unavailable: ");
+            OutputDebugStringA(message);
+            OutputDebugStringA("\n");
+        }
+
+        void ReportServiceUnavailable(winrt::hresult_error const& e) noexcept
+        {
+            OutputDebugStringW(L"KeyboardHookManager: shared configuration service unavailable: ");
+            OutputDebugStringW(e.message().c_str());
+            OutputDebugStringW(L"\n");
+        }
+    }
+
+    LoadedConfiguration EffectiveConfiguration(AgentSource const& agent)
+    {
+        return agent.overrides ? ConfigurationOverlay::Apply(agent.base, *agent.overrides) : ConfigurationOverlay::Copy(agent.base);
+    }
+
+    std::unique_ptr<DispatchSnapshot> LoadAgentSnapshot(AgentSource& agent)
+    {
+        std::unique_ptr<HotkeyDispatchTable> table;
+        try
+        {
+            table = AttachShared(agent);
+        }
+        catch (std::exception const& e)
+        {
+            ReportServiceUnavailable(e.what());
+        }
+        catch (winrt::hresult_error const& e)
+        {
+            ReportServiceUnavailable(e);
+        }
+        RefreshOverrides(agent);
+        if (table != nullptr && !agent.overrides)
+        {
+            return DispatchSnapshot::Create(ConfigurationOverlay::Copy(agent.base), std::move(table));
+        }
+        return DispatchSnapshot::Create(EffectiveConfiguration(agent));
+    }
+
+    bool RefreshAgent(AgentSource& agent)
+    {
+        bool changed = false;
+        try
+        {
+            changed = AttachShared(agent) != nullptr;
+            agent.watcher->Watch(agent.image);
+        }
+        catch (std::exception const& e)
+        {
+            ReportServiceUnavailable(e.what());
+        }
+        catch (winrt::hresult_error const& e)
+        {
+            ReportServiceUnavailable(e);
+        }
+        return RefreshOverrides(agent) || changed;
+    }
+}
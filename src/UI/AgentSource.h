@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Configuration/Configuration.h"
+#include "Core/DispatchSnapshot.h"
+#include "Ipc/SharedConfiguration.h"
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+namespace khm
+{
+    // What an --agent runs: the service's current image, and the user's
+    // overrides layered over it when the file exists.
+    struct AgentSource
+    {
+        std::filesystem::path overridesPath;
+        SharedImage image;
+        LoadedConfiguration base;
+        std::optional<LoadedConfiguration> overrides;
+        SharedConfigurationWatcher* watcher = nullptr;
+    };
+
+    LoadedConfiguration EffectiveConfiguration(AgentSource const& agent);
+
+    // Without overrides the service's compiled table is used as it is. An
+    // agent started before the service runs on its overrides alone, or
+    // nothing, until a poll of the shared watcher attaches.
+    std::unique_ptr<DispatchSnapshot> LoadAgentSnapshot(AgentSource& agent);
+
+    // Follows the service to its current image and re-reads the overrides;
+    // true when the effective configuration has to be rebuilt. The service
+    // being unreachable keeps the image the agent already has. Throws when
+    // the overrides fail to load.
+    bool RefreshAgent(AgentSource& agent);
+}
@@ -0,0 +1,700 @@
+#include "pch.h"
+
+#include "Actions/ActionExecutor.h"
+#include "Actions/WindowIndex.h"
+#include "Configuration/ConfigurationCache.h"
+#include "Configuration/ConfigurationLoader.h"
+#include "Configuration/ConfigurationMerge.h"
+#include "Configuration/ConfigurationWatcher.h"
+#include "Core/DispatchSnapshot.h"
+#include "Core/ForegroundTracker.h"
+#include "Core/HookEvent.h"
+#include "Core/HookProcessor.h"
+#include "Core/HookWatchdog.h"
+#include "Core/InputTrace.h"
+#include "Core/KeyboardHook.h"
+#include "Core/RawInputSource.h"
+#include "Ipc/ControlServer.h"
+#include "Ipc/SharedConfiguration.h"
+#include "UI/AgentSource.h"
+#include "UI/ServiceMain.h"
+#include "UI/SettingsHost.h"
+#include "UI/Startup.h"
+#include "UI/TrayIcon.h"
+#include "Utils/Instrumentation.h"
+#include "Utils/Logger.h"
+#include "Utils/WorkingSet.h"
+
+#include <shellapi.h>
+#include <shlobj.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    constexpr khm::LogFormat WorkingSetTrimmed{ khm::LogLevel::Info, "idle: working set {} KB (from {} KB), {} KB pinned" };
+
+    // Posted to the idle window by whatever leaves garbage behind: startup,
+    // a reload, the settings UI unloading. The trim runs once none has come
+    // in for IdleTrimDelayMs. A window rather than the thread, so neither
+    // the message nor the timer is lost while the tray menu's modal loop
+    // runs.
+    constexpr UINT ScheduleTrimMessage = WM_APP + 1;
+    // Posted to the idle window with a heap std::function<void()> in
+    // lParam: control pipe work that has to run on the main thread.
+    constexpr UINT RunOnMainMessage = WM_APP + 2;
+    constexpr UINT IdleTrimDelayMs = 10'000;
+    constexpr UINT_PTR IdleTrimTimer = 1;
+    constexpr wchar_t IdleWindowClass[] = L"KeyboardHookManager.Idle";
+
+    std::filesystem::path DefaultConfigPath(KNOWNFOLDERID const& folderId, wchar_t const* fileName)
+    {
+        PWSTR folder = nullptr;
+        winrt::check_hresult(SHGetKnownFolderPath(folderId, 0, nullptr, &folder));
+        std::filesystem::path path{ folder };
+        CoTaskMemFree(folder);
+        return path / L"KeyboardHookManager" / fileName;
+    }
+
+    struct CommandLine
+    {
+        std::filesystem::path configPath;
+
+        // Import/export mode: merges the config and `imports` (in that
+        // order of precedence) into `exportPath`, or into the config itself
+        // when no export is given, then exits without starting the hook.
+        std::vector<std::filesystem::path> imports;
+        std::filesystem::path exportPath;
+        khm::MergeCollisions collisions = khm::MergeCollisions::Disable;
+
+        // Writes every key event the hook sees to an input trace, for
+        // replaying against the engine later (tests/Benchmarks/TraceReplay).
+        std::filesystem::path recordPath;
+
+        // Multi-session hosts: one --service per machine shares the parsed
+        // machine configuration (%ProgramData%) with an --agent per session,
+        // whose --config is then that user's overrides.
+        bool service = false;
+        bool agent = false;
+
+        bool ImportExport() const noexcept { return !imports.empty() || !exportPath.empty(); }
+    };
+
+    CommandLine ParseCommandLine()
+    {
+        int argc = 0;
+        LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+        CommandLine command;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::wstring_view const option{ argv[i] };
+            bool const hasValue = i + 1 < argc;
+            if (option == L"--config" && hasValue)
+            {
+                command.configPath = argv[++i];
+            }
+            else if (option == L"--import" && hasValue)
+            {
+                command.imports.emplace_back(argv[++i]);
+            }
+            else if (option == L"--export" && hasValue)
+            {
+                command.exportPath = argv[++i];
+            }
+            else if (option == L"--record" && hasValue)
+            {
+                command.recordPath = argv[++i];
+            }
+            else if (option == L"--drop-collisions")
+            {
+                command.collisions = khm::MergeCollisions::Drop;
+            }
+            else if (option == L"--service")
+            {
+                command.service = true;
+            }
+            else if (option == L"--agent")
+            {
+                command.agent = true;
+            }
+        }
+        LocalFree(argv);
+        if (command.configPath.empty())
+        {
+            command.configPath = command.service ? DefaultConfigPath(FOLDERID_ProgramData, L"config.json")
+                : command.agent ? DefaultConfigPath(FOLDERID_LocalAppData, L"overrides.json")
+                : DefaultConfigPath(FOLDERID_LocalAppData, L"config.json");
+        }
+        return command;
+    }
+
+    // Prints to the console the tool was started from, if any; the process
+    // is a GUI one and has no console of its own.
+    void ReportToConsole(std::string const& text)
+    {
+        if (AttachConsole(ATTACH_PARENT_PROCESS))
+        {
+            DWORD written = 0;
+            WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), text.data(), static_cast<DWORD>(text.size()), &written, nullptr);
+            FreeConsole();
+        }
+        else
+        {
+            MessageBoxW(nullptr, winrt::to_hstring(text).c_str(), L"Keyboard Hook Manager", MB_ICONINFORMATION | MB_OK);
+        }
+    }
+
+    int RunImportExport(CommandLine const& command)
+    {
+        std::vector<std::filesystem::path> inputs;
+        inputs.push_back(command.configPath);
+        inputs.insert(inputs.end(), command.imports.begin(), command.imports.end());
+        std::filesystem::path const& output = command.exportPath.empty() ? command.configPath : command.exportPath;
+        try
+        {
+            khm::MergeReport const report = khm::ConfigurationMerge::Merge(inputs, output, command.collisions);
+            ReportToConsole(output.string() + ": " + std::to_string(report.written) + " of " + std::to_string(report.read) + " actions written, "
+                + std::to_string(report.duplicates) + " duplicate ids skipped, " + std::to_string(report.collisions) + " hotkey collisions "
+                + (command.collisions == khm::MergeCollisions::Drop ? "dropped" : "disabled") + "\n");
+            return 0;
+        }
+        catch (khm::ConfigurationError const& e)
+        {
+            ReportToConsole(std::string(e.what()) + "\n");
+            return 1;
+        }
+    }
+
+    // The index hooks every window in the session, so it only runs while an
+    // action asks for it.
+    void UpdateWindowIndex(khm::WindowIndex& windows, khm::ActionTable const& actions)
+    {
+        bool const needed = std::ranges::any_of(actions.Records(),
+            [](khm::ActionRecord const& action) { return action.enabled && action.activateIfRunning; });
+        if (needed)
+        {
+            windows.Start();
+        }
+        else
+        {
+            windows.Stop();
+        }
+    }
+
+    // Keeps the hook on the global table unless some action has a profile.
+    void UpdateForegroundTracker(khm::ForegroundTracker& foreground, khm::DispatchSnapshot const& snapshot)
+    {
+        if (snapshot.profiles.empty())
+        {
+            foreground.Stop();
+        }
+        else
+        {
+            foreground.Start();
+            foreground.Refresh();
+        }
+    }
+
+    struct KeySources
+    {
+        khm::KeyboardHook& hook;
+        khm::HookWatchdog& watchdog;
+        khm::RawInputSource& rawInput;
+        bool recording = false; // --record taps the hook's processor
+    };
+
+    // The hook only runs while some binding has to swallow its key (every
+    // sequence, and chords unless passThrough) or input is being recorded,
+    // Raw Input only while some chord is passThrough.
+    void UpdateKeySources(KeySources& keys, khm::LoadedConfiguration const& configuration)
+    {
+        khm::ActionTable const& actions = configuration.actions;
+        bool intercepts = false;
+        bool observes = false;
+        for (khm::ActionRecord const& action : actions.Records())
+        {
+            if (action.enabled)
+            {
+                intercepts |= actions.SequenceLength(action) != 0 || (action.hasHotkey && !action.passThrough);
+                observes |= action.hasHotkey && action.passThrough;
+            }
+        }
+
+        intercepts |= keys.recording;
+        keys.hook.SetPriority(configuration.settings.hookPriority);
+        if (intercepts && !keys.hook.IsInstalled())
+        {
+            keys.hook.Install();
+            keys.watchdog.Start();
+        }
+        else if (!intercepts)
+        {
+            keys.watchdog.Stop();
+            keys.hook.Uninstall();
+        }
+
+        if (observes)
+        {
+            keys.rawInput.Start();
+        }
+        else
+        {
+            keys.rawInput.Stop();
+        }
+    }
+
+    // What a new configuration is published into.
+    struct Runtime
+    {
+        khm::DispatchSnapshotPointer& snapshots;
+        khm::TrayIcon& tray;
+        khm::ActionExecutor& executor;
+        khm::WindowIndex& windows;
+        khm::ForegroundTracker& foreground;
+        khm::SettingsHost& settings;
+        KeySources keys;
+        std::mutex publishing; // the watcher and the control pipe both publish
+
+        HWND idleWindow = nullptr; // main thread, message-only
+        std::vector<khm::MemoryRange> hotObjects; // what the key sources and the executor touch besides the snapshot
+    };
+
+    void ScheduleTrim(Runtime& runtime) noexcept
+    {
+        PostMessageW(runtime.idleWindow, ScheduleTrimMessage, 0, 0);
+    }
+
+    void RunOnMain(Runtime& runtime, std::function<void()> work)
+    {
+        auto queued = std::make_unique<std::function<void()>>(std::move(work));
+        if (!PostMessageW(runtime.idleWindow, RunOnMainMessage, 0, reinterpret_cast<LPARAM>(queued.get())))
+        {
+            winrt::throw_last_error();
+        }
+        queued.release();
+    }
+
+    // What was posted but never ran once the loop has ended.
+    void DiscardPendingWork(HWND window) noexcept
+    {
+        MSG msg;
+        while (PeekMessageW(&msg, window, RunOnMainMessage, RunOnMainMessage, PM_REMOVE))
+        {
+            delete reinterpret_cast<std::function<void()>*>(msg.lParam);
+        }
+    }
+
+    // Main thread. Only while the settings UI is unloaded; with it open the
+    // process is in use and would fault everything straight back in.
+    void TrimIfIdle(Runtime& runtime) noexcept
+    {
+        using namespace khm;
+
+        if (runtime.settings.IsLoaded())
+        {
+            return;
+        }
+        try
+        {
+            std::vector<MemoryRange> ranges = runtime.hotObjects;
+            // Held until pinned, so the snapshot cannot be reclaimed under us.
+            std::scoped_lock lock(runtime.publishing);
+            runtime.snapshots.Current()->AppendHotRanges(ranges);
+            Instrumentation::AppendHotRanges(ranges);
+            Logger::AppendHotRanges(ranges);
+            WorkingSet::Pin(ranges);
+        }
+        catch (std::exception const&)
+        {
+            return;
+        }
+
+        uint64_t const before = WorkingSet::Query().workingSetBytes;
+        WorkingSet::Trim();
+        ResidentMemory const after = WorkingSet::Query();
+        Log(WorkingSetTrimmed, after.workingSetBytes / 1024, before / 1024, after.pinnedBytes / 1024);
+    }
+
+    LRESULT CALLBACK IdleWindowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam) noexcept
+    {
+        if (message == WM_NCCREATE)
+        {
+            auto* const runtime = static_cast<Runtime*>(reinterpret_cast<CREATESTRUCTW const*>(lParam)->lpCreateParams);
+            SetWindowLongPtrW(window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(runtime));
+        }
+        else if (message == ScheduleTrimMessage)
+        {
+            // Restarts a pending countdown.
+            SetTimer(window, IdleTrimTimer, IdleTrimDelayMs, nullptr);
+            return 0;
+        }
+        else if (message == RunOnMainMessage)
+        {
+            std::unique_ptr<std::function<void()>> const work(reinterpret_cast<std::function<void()>*>(lParam));
+            (*work)();
+            return 0;
+        }
+        else if (message == WM_TIMER && wParam == IdleTrimTimer)
+        {
+            KillTimer(window, IdleTrimTimer);
+            if (auto* const runtime = reinterpret_cast<Runtime*>(GetWindowLongPtrW(window, GWLP_USERDATA)))
+            {
+                TrimIfIdle(*runtime);
+            }
+            return 0;
+        }
+        return DefWindowProcW(window, message, wParam, lParam);
+    }
+
+    HWND CreateIdleWindow(HINSTANCE instance, Runtime& runtime)
+    {
+        WNDCLASSEXW windowClass{ sizeof(windowClass) };
+        windowClass.lpfnWndProc = IdleWindowProc;
+        windowClass.hInstance = instance;
+        windowClass.lpszClassName = IdleWindowClass;
+        if (!RegisterClassExW(&windowClass) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS)
+        {
+            winrt::throw_last_error();
+        }
+
+        HWND const window = CreateWindowExW(0, IdleWindowClass, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, instance, &runtime);
+        if (window == nullptr)
+        {
+            winrt::throw_last_error();
+        }
+        return window;
+    }
+
+    // Caller holds runtime.publishing.
+    khm::DispatchSnapshot const& PublishSnapshot(Runtime& runtime, std::unique_ptr<khm::DispatchSnapshot> next, khm::ConfigurationDiff const& diff)
+    {
+        using namespace khm;
+
+        // The key sources come first: a hook that fails to install leaves
+        // the running snapshot published, and its sources as they were.
+        try
+        {
+            UpdateKeySources(runtime.keys, next->configuration);
+        }
+        catch (...)
+        {
+            try
+            {
+                UpdateKeySources(runtime.keys, runtime.snapshots.Current()->configuration);
+            }
+            catch (...)
+            {
+            }
+            throw;
+        }
+        ApplyLogging(next->configuration.settings);
+        bool const actionsChanged = next->actionsGeneration != runtime.snapshots.Current()->actionsGeneration;
+        runtime.snapshots.Publish(std::move(next));
+        DispatchSnapshot const& published = *runtime.snapshots.Current();
+        if (actionsChanged)
+        {
+            // Resolve the new LaunchApp targets now, not on the first hotkey.
+            runtime.executor.RefreshActionCache();
+        }
+        UpdateWindowIndex(runtime.windows, published.configuration.actions);
+        UpdateForegroundTracker(runtime.foreground, published);
+        runtime.tray.PostUpdate(published.configuration.settings.showTrayIcon, published.BindingCount());
+        runtime.settings.Refresh();
+        ScheduleTrim(runtime);
+        Log(ConfigurationPublished, published.generation, diff.added, diff.removed, diff.changed);
+        return published;
+    }
+
+    // Caller holds runtime.publishing. Returns the live snapshot, which is
+    // the current one when `loaded` changes nothing.
+    khm::DispatchSnapshot const& Publish(Runtime& runtime, khm::LoadedConfiguration loaded)
+    {
+        using namespace khm;
+
+        ConfigurationDiff diff;
+        if (auto next = DispatchSnapshot::Reload(*runtime.snapshots.Current(), std::move(loaded), diff))
+        {
+            return PublishSnapshot(runtime, std::move(next), diff);
+        }
+        return *runtime.snapshots.Current();
+    }
+
+    // Runs on the watcher thread. A configuration that fails to load leaves
+    // the running one in place, along with the key sources it runs on.
+    void Reload(Runtime& runtime, std::filesystem::path const& path) noexcept
+    {
+        using namespace khm;
+
+        try
+        {
+            std::scoped_lock lock(runtime.publishing);
+            DispatchSnapshot const& current = *runtime.snapshots.Current();
+            std::optional<LoadedConfiguration> loaded = ConfigurationLoader::LoadIfChanged(path, current.configuration.sourceHash);
+            if (!loaded)
+            {
+                return;
+            }
+
+            uint64_t const generation = current.generation;
+            DispatchSnapshot const& published = Publish(runtime, std::move(*loaded));
+            if (published.generation != generation)
+            {
+                ConfigurationCache::Store(path, published.configuration, *published.table);
+            }
+        }
+        catch (...)
+        {
+            ReportReloadFailure(runtime.snapshots.Current()->generation);
+        }
+    }
+
+    // Runs on the overrides' watcher thread or the shared image's. Nothing
+    // is published unless the image or the overrides changed, so a pushed
+    // configuration survives the polls. The service being unreachable keeps
+    // the image the agent already has; a restarted one is picked up by the
+    // next poll.
+    void ReloadAgent(Runtime& runtime, khm::AgentSource& agent) noexcept
+    {
+        using namespace khm;
+
+        try
+        {
+            std::scoped_lock lock(runtime.publishing);
+            if (RefreshAgent(agent))
+            {
+                Publish(runtime, EffectiveConfiguration(agent));
+            }
+        }
+        catch (...)
+        {
+            ReportReloadFailure(runtime.snapshots.Current()->generation);
+        }
+    }
+
+    // Runs on the main thread, handed over by the control pipe's. The
+    // pushed configuration stays live until the file changes; it is never
+    // written to the file or the cache.
+    uint64_t PushConfiguration(Runtime& runtime, std::string_view json)
+    {
+        using namespace khm;
+
+        LoadedConfiguration loaded = ConfigurationLoader::ParseStreaming(json);
+        std::scoped_lock lock(runtime.publishing);
+        return Publish(runtime, std::move(loaded)).generation;
+    }
+
+    // Runs on the settings UI thread. Like a pushed configuration, the
+    // change stays live until the file changes; nothing is parsed and only
+    // the flipped slot differs from the current snapshot.
+    void SetActionEnabled(Runtime& runtime, uint32_t slot, bool enabled) noexcept
+    {
+        using namespace khm;
+
+        try
+        {
+            std::scoped_lock lock(runtime.publishing);
+            DispatchSnapshot const& current = *runtime.snapshots.Current();
+            ActionTable const& actions = current.configuration.actions;
+            if (slot >= actions.Size() || IsTombstone(actions[slot]) || actions[slot].enabled == enabled)
+            {
+                return;
+            }
+
+            // Nothing to align or re-prepare: the executor keeps its prepared
+            // actions, and the settings UI's conflict analysis only revisits
+            // this action's buckets.
+            ConfigurationDiff diff;
+            diff.changed = 1;
+            PublishSnapshot(runtime, DispatchSnapshot::WithEnabled(current, slot, enabled), diff);
+        }
+        catch (...)
+        {
+            ReportReloadFailure(runtime.snapshots.Current()->generation);
+        }
+    }
+
+    void ReportFatal(char const* message)
+    {
+        MessageBoxW(nullptr, winrt::to_hstring(message).c_str(), L"Keyboard Hook Manager", MB_ICONERROR | MB_OK);
+    }
+}
+
+int WINAPI wWinMain(HINSTANCE instance, HINSTANCE, PWSTR, int)
+{
+    using namespace khm;
+
+    try
+    {
+        CommandLine const command = ParseCommandLine();
+        if (command.ImportExport())
+        {
+            return RunImportExport(command);
+        }
+        if (command.service)
+        {
+            return RunService(command.configPath);
+        }
+
+        Instrumentation::Initialize();
+
+        std::filesystem::path const& configPath = command.configPath;
+        std::filesystem::path logPath = configPath;
+        logPath += L".log";
+        Logger::Start(logPath);
+
+        // An agent's overrides file is optional, but watching needs its folder.
+        AgentSource agent{ configPath };
+        if (command.agent)
+        {
+            std::filesystem::create_directories(configPath.parent_path());
+        }
+
+        bool fromCache = false;
+        DispatchSnapshotPointer snapshots(command.agent ? LoadAgentSnapshot(agent) : LoadInitialSnapshot(configPath, fromCache));
+        ApplyLogging(snapshots.Current()->configuration.settings);
+
+        // Large (inline storage) and shared by two threads for the process lifetime.
+        auto ring = std::make_unique<HookEventRing>();
+        WindowIndex windows;
+        UpdateWindowIndex(windows, snapshots.Current()->configuration.actions);
+        ActionExecutor executor(*ring, snapshots, windows);
+        executor.Start();
+
+        ForegroundTracker foreground(snapshots);
+        UpdateForegroundTracker(foreground, *snapshots.Current());
+
+        HookProcessor processor;
+        processor.Attach(snapshots);
+        processor.SetHandler(ring.get());
+        processor.SetForeground(&foreground);
+
+        std::unique_ptr<InputRecorder> recorder;
+        if (!command.recordPath.empty())
+        {
+            recorder = std::make_unique<InputRecorder>(command.recordPath);
+            recorder->Start();
+            processor.SetRecorder(recorder.get());
+        }
+
+        // Raw Input has its own processor and ring: passThrough chords.
+        HookProcessor observer;
+        observer.SetMode(HookMode::Observe);
+        observer.Attach(snapshots);
+        observer.SetHandler(&executor.ObservedKeys());
+        observer.SetForeground(&foreground);
+
+        KeyboardHook hook(processor);
+        HookWatchdog watchdog(hook);
+        RawInputSource rawInput(observer);
+        KeySources keys{ hook, watchdog, rawInput, recorder != nullptr };
+        UpdateKeySources(keys, snapshots.Current()->configuration);
+
+        // Settings stays unloaded (no Windows App SDK, no XAML) until opened.
+        // An agent has none: its configuration belongs to the service.
+        SettingsHost settings(instance, snapshots, configPath);
+        std::function<void()> openSettings;
+        if (!command.agent)
+        {
+            openSettings = [&] { settings.Open(); };
+        }
+        // The lock screen is on the secure desktop, which the key sources do
+        // not hear; whatever was held when it came up was released there.
+        TrayIcon tray(instance, { openSettings, [] { PostQuitMessage(0); }, [&] { executor.RefreshActionCache(); },
+            [&] { hook.ResyncModifiers(); rawInput.ResyncModifiers(); } });
+        tray.Create();
+        {
+            DispatchSnapshot const& initial = *snapshots.Current();
+            tray.Update(initial.configuration.settings.showTrayIcon, initial.BindingCount());
+        }
+
+        Runtime runtime{ snapshots, tray, executor, windows, foreground, settings, keys };
+        runtime.idleWindow = CreateIdleWindow(instance, runtime);
+        runtime.hotObjects = {
+            { ring.get(), sizeof(HookEventRing) }, { &snapshots, sizeof(snapshots) }, { &processor, sizeof(processor) },
+            { &observer, sizeof(observer) }, { &hook, sizeof(hook) }, { &rawInput, sizeof(rawInput) },
+            { &foreground, sizeof(foreground) }, { &executor, sizeof(executor) },
+        };
+        settings.SetEnableHandler([&](uint32_t slot, bool enabled) { SetActionEnabled(runtime, slot, enabled); });
+        settings.SetReleaseHandler([&] { ScheduleTrim(runtime); });
+        SharedConfigurationWatcher shared([&] { ReloadAgent(runtime, agent); });
+        agent.watcher = &shared;
+        ConfigurationWatcher watcher(configPath, std::chrono::milliseconds(250), [&] {
+            if (command.agent)
+            {
+                ReloadAgent(runtime, agent);
+            }
+            else
+            {
+                Reload(runtime, configPath);
+            }
+        });
+        watcher.Start();
+        if (command.agent)
+        {
+            shared.Watch(agent.image);
+            shared.Start();
+        }
+        if (fromCache)
+        {
+            // Verify the cache against the JSON off the startup path.
+            watcher.Trigger();
+        }
+
+        ControlServer control(snapshots, executor, [&](std::string_view json) { return PushConfiguration(runtime, json); },
+            [&](std::function<void()> work) { RunOnMain(runtime, std::move(work)); });
+        try
+        {
+            control.Start();
+        }
+        catch (winrt::hresult_error const& e)
+        {
+            // Hotkeys work without it; most likely another instance owns the pipe.
+            OutputDebugStringW(L"KeyboardHookManager: control pipe unavailable: ");
+            OutputDebugStringW(e.message().c_str());
+            OutputDebugStringW(L"\n");
+        }
+
+        // Startup leaves as much behind as any reload.
+        ScheduleTrim(runtime);
+
+        MSG msg;
+        while (GetMessageW(&msg, nullptr, 0, 0) > 0)
+        {
+            TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+        }
+
+        watchdog.Stop();
+        hook.Uninstall();
+        rawInput.Stop();
+        if (recorder != nullptr)
+        {
+            recorder->Stop();
+        }
+        control.Stop();
+        shared.Stop();
+        watcher.Stop();
+        settings.Shutdown();
+        DiscardPendingWork(runtime.idleWindow);
+        DestroyWindow(runtime.idleWindow);
+        executor.Stop();
+        windows.Stop();
+        foreground.Stop();
+        Logger::Stop();
+        Instrumentation::Shutdown();
+        return static_cast<int>(msg.wParam);
+    }
+    catch (std::exception const& e)
+    {
+        ReportFatal(e.what());
+    }
+    catch (winrt::hresult_error const& e)
+    {
+        ReportFatal(winrt::to_string(e.message()).c_str());
+    }
+    return 1;
+}
@@ -0,0 +1,172 @@
+#include "pch.h"
+#include "UI/ServiceMain.h"
+
+#include "Configuration/ConfigurationCache.h"
+#include "Configuration/ConfigurationLoader.h"
+#include "Configuration/ConfigurationWatcher.h"
+#include "Core/DispatchSnapshot.h"
+#include "Ipc/ControlServer.h"
+#include "Ipc/SharedConfiguration.h"
+#include "UI/Startup.h"
+#include "Utils/Instrumentation.h"
+#include "Utils/Logger.h"
+
+#include <winsvc.h>
+
+#include <functional>
+
+namespace khm
+{
+    namespace
+    {
+        constexpr wchar_t ServiceName[] = L"KeyboardHookManager";
+
+        // Runs on the service's watcher thread, the only one that publishes
+        // after startup.
+        void ReloadShared(SharedConfigurationPublisher& publisher, std::unique_ptr<DispatchSnapshot>& current, std::filesystem::path const& path) noexcept
+        {
+            try
+            {
+                std::optional<LoadedConfiguration> loaded = ConfigurationLoader::LoadIfChanged(path, current->configuration.sourceHash);
+                if (!loaded)
+                {
+                    return;
+                }
+
+                // Aligned like any reload, so an id keeps its slot across
+                // generations in every agent as well.
+                ConfigurationDiff diff;
+                if (auto next = DispatchSnapshot::Reload(*current, std::move(*loaded), diff))
+                {
+                    ApplyLogging(next->configuration.settings);
+                    publisher.Publish(*next);
+                    ConfigurationCache::Store(path, next->configuration, *next->table);
+                    current = std::move(next);
+                    Log(ConfigurationPublished, current->generation, diff.added, diff.removed, diff.changed);
+                }
+            }
+            catch (...)
+            {
+                ReportReloadFailure(current->generation);
+            }
+        }
+
+        // Returns once `stop` is set.
+        void RunSharedService(std::filesystem::path const& configPath, HANDLE stop, std::function<void()> const& running)
+        {
+            Instrumentation::Initialize();
+            std::filesystem::path logPath = configPath;
+            logPath += L".log";
+            Logger::Start(logPath);
+
+            bool fromCache = false;
+            std::unique_ptr<DispatchSnapshot> current = LoadInitialSnapshot(configPath, fromCache);
+            ApplyLogging(current->configuration.settings);
+            SharedConfigurationPublisher publisher;
+            publisher.Publish(*current);
+
+            ConfigurationWatcher watcher(configPath, std::chrono::milliseconds(250), [&] { ReloadShared(publisher, current, configPath); });
+            watcher.Start();
+            if (fromCache)
+            {
+                watcher.Trigger();
+            }
+            // Unlike a session's pipe this one is the service: without it no
+            // agent can attach, so failing to own it fails the start.
+            ControlServer control([&] { return publisher.Current(); });
+            control.Start();
+
+            running();
+            WaitForSingleObject(stop, INFINITE);
+
+            control.Stop();
+            watcher.Stop();
+            Logger::Stop();
+            Instrumentation::Shutdown();
+        }
+
+        struct ServiceState
+        {
+            std::filesystem::path configPath;
+            winrt::handle stop;
+            SERVICE_STATUS_HANDLE status = nullptr;
+        };
+
+        ServiceState g_service;
+
+        void ReportServiceStatus(DWORD state, DWORD exitCode = NO_ERROR) noexcept
+        {
+            SERVICE_STATUS status{};
+            status.dwServiceType = SERVICE_WIN32_OWN_PROCESS;
+            status.dwCurrentState = state;
+            status.dwControlsAccepted = state == SERVICE_RUNNING ? SERVICE_ACCEPT_STOP | SERVICE_ACCEPT_SHUTDOWN : 0;
+            status.dwWin32ExitCode = exitCode;
+            status.dwWaitHint = state == SERVICE_START_PENDING || state == SERVICE_STOP_PENDING ? 10'000 : 0;
+            SetServiceStatus(g_service.status, &status);
+        }
+
+        DWORD WINAPI ServiceControl(DWORD control, DWORD, void*, void*) noexcept
+        {
+            switch (control)
+            {
+            case SERVICE_CONTROL_STOP:
+            case SERVICE_CONTROL_SHUTDOWN:
+                ReportServiceStatus(SERVICE_STOP_PENDING);
+                SetEvent(g_service.stop.get());
+                return NO_ERROR;
+            case SERVICE_CONTROL_INTERROGATE:
+                return NO_ERROR;
+            default:
+                return ERROR_CALL_NOT_IMPLEMENTED;
+            }
+        }
+
+        void WINAPI ServiceMain(DWORD, LPWSTR*) noexcept
+        {
+            g_service.status = RegisterServiceCtrlHandlerExW(ServiceName, ServiceControl, nullptr);
+            if (g_service.status == nullptr)
+            {
+                return;
+            }
+            ReportServiceStatus(SERVICE_START_PENDING);
+            DWORD exitCode = NO_ERROR;
+            try
+            {
+                RunSharedService(g_service.configPath, g_service.stop.get(), [] { ReportServiceStatus(SERVICE_RUNNING); });
+            }
+            catch (std::exception const& e)
+            {
+                OutputDebugStringA("KeyboardHookManager: service failed: ");
+                OutputDebugStringA(e.what());
+                OutputDebugStringA("\n");
+                exitCode = ERROR_EXCEPTION_IN_SERVICE;
+            }
+            catch (winrt::hresult_error const& e)
+            {
+                OutputDebugStringW(L"KeyboardHookManager: service failed: ");
+                OutputDebugStringW(e.message().c_str());
+                OutputDebugStringW(L"\n");
+                exitCode = ERROR_EXCEPTION_IN_SERVICE;
+            }
+            ReportServiceStatus(SERVICE_STOPPED, exitCode);
+        }
+    }
+
+    int RunService(std::filesystem::path const& configPath)
+    {
+        g_service.configPath = configPath;
+        g_service.stop = winrt::handle(winrt::check_pointer(CreateEventW(nullptr, TRUE, FALSE, nullptr)));
+
+        SERVICE_TABLE_ENTRYW const table[] = { { const_cast<LPWSTR>(ServiceName), ServiceMain }, { nullptr, nullptr } };
+        if (StartServiceCtrlDispatcherW(table))
+        {
+            return 0;
+        }
+        if (GetLastError() != ERROR_FAILED_SERVICE_CONTROLLER_CONNECT)
+        {
+            winrt::throw_last_error();
+        }
+        RunSharedService(configPath, g_service.stop.get(), [] {});
+        return 0;
+    }
+}
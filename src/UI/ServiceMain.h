@@ -0,0 +1,15 @@
+#pragma once
+
+#include <filesystem>
+
+namespace khm
+{
+    // --service: one per machine, in session 0. Loads the machine-wide
+    // configuration at `configPath`, follows its file and publishes every
+    // generation to the agents; it has no hook, executor or UI of its own.
+    //
+    // Under the service control manager the dispatcher owns the calling
+    // thread until the service stops. Started by hand instead (a console, a
+    // debugger) the service runs until the process is ended.
+    int RunService(std::filesystem::path const& configPath);
+}
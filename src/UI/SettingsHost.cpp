@@ -0,0 +1,436 @@
+#include "pch.h"
+#include "UI/SettingsHost.h"
+
+#include "Core/HotkeyDispatchTable.h"
+#include "Utils/Hash.h"
+#include "Utils/Text.h"
+
+#include <MddBootstrap.h>
+#include <WindowsAppSDK-VersionInfo.h>
+#include <winrt/Microsoft.UI.Dispatching.h>
+#include <winrt/Microsoft.UI.Xaml.Hosting.h>
+
+#include <cwchar>
+
+namespace khm
+{
+    namespace
+    {
+        // Thread messages posted by Open() and Refresh() while the UI thread
+        // is running.
+        constexpr UINT ShowMessage = WM_APP + 1;
+        constexpr UINT RefreshMessage = WM_APP + 2;
+
+        // The bootstrapper is loaded by hand rather than imported so that the
+        // process does not map it (or the framework package) at startup.
+        class RuntimeBootstrap
+        {
+        public:
+            RuntimeBootstrap()
+            {
+                m_module = LoadLibraryExW(L"Microsoft.WindowsAppRuntime.Bootstrap.dll", nullptr,
+                    LOAD_LIBRARY_SEARCH_APPLICATION_DIR | LOAD_LIBRARY_SEARCH_SYSTEM32);
+                if (m_module == nullptr)
+                {
+                    winrt::throw_last_error();
+                }
+
+                auto const initialize = reinterpret_cast<decltype(&MddBootstrapInitialize2)>(GetProcAddress(m_module, "MddBootstrapInitialize2"));
+                m_shutdown = reinterpret_cast<decltype(&MddBootstrapShutdown)>(GetProcAddress(m_module, "MddBootstrapShutdown"));
+                if (initialize == nullptr || m_shutdown == nullptr)
+                {
+                    FreeLibrary(m_module);
+                    winrt::throw_last_error();
+                }
+
+                PACKAGE_VERSION minimum{};
+                minimum.Version = WINDOWSAPPSDK_RUNTIME_VERSION_UINT64;
+                HRESULT const result = initialize(WINDOWSAPPSDK_RELEASE_MAJORMINOR, WINDOWSAPPSDK_RELEASE_VERSION_TAG_W, minimum,
+                    MddBootstrapInitializeOptions_OnNoMatch_ShowUI);
+                if (FAILED(result))
+                {
+                    FreeLibrary(m_module);
+                    winrt::throw_hresult(result);
+                }
+            }
+
+            ~RuntimeBootstrap()
+            {
+                m_shutdown();
+                FreeLibrary(m_module);
+            }
+
+            RuntimeBootstrap(RuntimeBootstrap const&) = delete;
+            RuntimeBootstrap& operator=(RuntimeBootstrap const&) = delete;
+
+        private:
+            HMODULE m_module = nullptr;
+            decltype(&MddBootstrapShutdown) m_shutdown = nullptr;
+        };
+
+        std::wstring FormatHotkey(Hotkey hotkey, std::string_view keyName)
+        {
+            std::wstring text;
+            if (hotkey.modifiers & ModWin) text += L"Win+";
+            if (hotkey.modifiers & ModCtrl) text += L"Ctrl+";
+            if (hotkey.modifiers & ModShift) text += L"Shift+";
+            if (hotkey.modifiers & ModAlt) text += L"Alt+";
+
+            if (!keyName.empty())
+            {
+                return text + Widen(keyName);
+            }
+
+            wchar_t name[32];
+            LONG const scanCode = static_cast<LONG>(MapVirtualKeyW(hotkey.key, MAPVK_VK_TO_VSC)) << 16;
+            if (GetKeyNameTextW(scanCode, name, ARRAYSIZE(name)) <= 0)
+            {
+                swprintf_s(name, L"VK 0x%02X", hotkey.key);
+            }
+            return text + name;
+        }
+
+        // Everything a row shows or is searched by; string offsets differ
+        // between tables, so the strings are hashed, not the record.
+        uint64_t Fingerprint(ActionTable const& actions, ActionRecord const& action) noexcept
+        {
+            uint8_t const flags[] = {
+                static_cast<uint8_t>(action.enabled), static_cast<uint8_t>(action.hasHotkey), static_cast<uint8_t>(action.passThrough),
+                action.hotkey.modifiers, action.hotkey.key,
+            };
+            uint64_t hash = Fnv1a64(std::as_bytes(std::span{ flags }));
+            for (StringRef ref : { action.id, action.name, action.type, action.keyName, action.sequence, action.profile })
+            {
+                std::string_view const text = actions.String(ref);
+                uint32_t const length = ref.length;
+                hash = Fnv1a64(std::as_bytes(std::span{ &length, 1 }), hash);
+                hash = Fnv1a64(std::as_bytes(std::span{ text }), hash);
+            }
+            return hash;
+        }
+
+        std::wstring ActionName(ActionTable const& actions, uint32_t index)
+        {
+            ActionRecord const& action = actions[index];
+            return L"'" + Widen(actions.String(action.name.length != 0 ? action.name : action.id)) + L"'";
+        }
+
+        std::wstring FormatConflict(ActionTable const& actions, Conflict const& conflict)
+        {
+            std::wstring const name = ActionName(actions, conflict.action);
+            std::wstring const other = conflict.other != HotkeyDispatchTable::NoAction ? ActionName(actions, conflict.other) : L"another binding";
+            std::wstring const hotkey = FormatHotkey(conflict.hotkey, {});
+            switch (conflict.kind)
+            {
+            case ConflictKind::DuplicateChord:
+                return hotkey + L": " + name + L" never fires, " + other + L" has the same chord";
+            case ConflictKind::MaskedSequence:
+                return hotkey + L": " + name + L" cannot start where " + other + L" binds its first step";
+            case ConflictKind::SequencePrefix:
+                return hotkey + L": " + name + L" equals, extends or prefixes " + other;
+            case ConflictKind::Reserved:
+                return hotkey + L": " + name + L" is reserved by Windows or registered by another app";
+            }
+            return {};
+        }
+    }
+
+    SettingsHost::SettingsHost(HINSTANCE instance, DispatchSnapshotPointer& snapshots, std::filesystem::path configPath) :
+        m_instance(instance),
+        m_snapshots(snapshots.RegisterReader()),
+        m_configPath(std::move(configPath)),
+        m_stopEvent(winrt::check_pointer(CreateEventW(nullptr, TRUE, FALSE, nullptr)))
+    {
+    }
+
+    SettingsHost::~SettingsHost()
+    {
+        Shutdown();
+    }
+
+    void SettingsHost::Open()
+    {
+        std::thread finished;
+        {
+            std::scoped_lock lock(m_lock);
+            if (m_running)
+            {
+                // Fails only while the thread is still starting, and then it
+                // opens the window by itself.
+                PostThreadMessageW(GetThreadId(m_thread.native_handle()), ShowMessage, 0, 0);
+                return;
+            }
+            finished = std::move(m_thread);
+        }
+
+        // A previous UI thread that released itself may still be unloading.
+        // The new thread waits for it: this one runs the tray's messages, and
+        // the hook's too when they share it.
+        std::scoped_lock lock(m_lock);
+        m_running = true;
+        m_thread = std::thread([this, previous = std::move(finished)]() mutable {
+            if (previous.joinable())
+            {
+                previous.join();
+            }
+            Run();
+        });
+    }
+
+    void SettingsHost::Shutdown() noexcept
+    {
+        SetEvent(m_stopEvent.get());
+        std::thread thread;
+        {
+            std::scoped_lock lock(m_lock);
+            thread = std::move(m_thread);
+        }
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+
+    void SettingsHost::Refresh() noexcept
+    {
+        std::scoped_lock lock(m_lock);
+        if (m_running)
+        {
+            PostThreadMessageW(GetThreadId(m_thread.native_handle()), RefreshMessage, 0, 0);
+        }
+    }
+
+    bool SettingsHost::IsLoaded() noexcept
+    {
+        std::scoped_lock lock(m_lock);
+        return m_running;
+    }
+
+    void SettingsHost::Run() noexcept
+    {
+        SetThreadDescription(GetCurrentThread(), L"khm.settings");
+
+        bool apartment = false;
+        try
+        {
+            winrt::init_apartment(winrt::apartment_type::single_threaded);
+            apartment = true;
+            RuntimeBootstrap const runtime;
+            RunWindow();
+        }
+        catch (winrt::hresult_error const& e)
+        {
+            OutputDebugStringW(L"KeyboardHookManager: settings UI failed: ");
+            OutputDebugStringW(e.message().c_str());
+            OutputDebugStringW(L"\n");
+        }
+        catch (std::exception const& e)
+        {
+            OutputDebugStringA("KeyboardHookManager: settings UI failed: ");
+            OutputDebugStringA(e.what());
+            OutputDebugStringA("\n");
+        }
+
+        if (apartment)
+        {
+            winrt::uninit_apartment();
+        }
+
+        {
+            // Once Open() has started a successor, m_running is its flag.
+            std::scoped_lock lock(m_lock);
+            if (!m_thread.joinable() || m_thread.get_id() == std::this_thread::get_id())
+            {
+                m_running = false;
+            }
+        }
+        if (m_released && WaitForSingleObject(m_stopEvent.get(), 0) != WAIT_OBJECT_0)
+        {
+            m_released();
+        }
+    }
+
+    void SettingsHost::RunWindow()
+    {
+        using namespace winrt::Microsoft::UI;
+
+        auto const queue = Dispatching::DispatcherQueueController::CreateOnCurrentThread();
+        auto const xaml = Xaml::Hosting::WindowsXamlManager::InitializeForCurrentThread();
+
+        auto window = std::make_unique<SettingsWindow>(m_instance, BuildModel(), m_setEnabled);
+        ULONGLONG closedAt = 0;
+        HANDLE const stop = m_stopEvent.get();
+
+        for (;;)
+        {
+            DWORD timeout = INFINITE;
+            if (!window)
+            {
+                ULONGLONG const idle = GetTickCount64() - closedAt;
+                ULONGLONG const limit = static_cast<ULONGLONG>(IdleRelease.count());
+                timeout = idle >= limit ? 0 : static_cast<DWORD>(limit - idle);
+            }
+
+            DWORD const wait = MsgWaitForMultipleObjectsEx(1, &stop, timeout, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+            if (wait == WAIT_OBJECT_0)
+            {
+                break;
+            }
+            if (wait == WAIT_TIMEOUT)
+            {
+                if (ReleaseIfIdle())
+                {
+                    break;
+                }
+                window = std::make_unique<SettingsWindow>(m_instance, BuildModel(), m_setEnabled);
+                continue;
+            }
+
+            MSG msg;
+            while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE))
+            {
+                if (msg.hwnd == nullptr && msg.message == ShowMessage)
+                {
+                    if (window)
+                    {
+                        window->Refresh(BuildModel());
+                        window->Show();
+                    }
+                    else
+                    {
+                        window = std::make_unique<SettingsWindow>(m_instance, BuildModel(), m_setEnabled);
+                    }
+                    continue;
+                }
+                if (msg.hwnd == nullptr && msg.message == RefreshMessage)
+                {
+                    if (window)
+                    {
+                        window->Refresh(BuildModel());
+                    }
+                    continue;
+                }
+                TranslateMessage(&msg);
+                DispatchMessageW(&msg);
+            }
+
+            if (window && !window->IsOpen())
+            {
+                window.reset();
+                closedAt = GetTickCount64();
+            }
+        }
+
+        window.reset();
+        xaml.Close();
+        queue.ShutdownQueue();
+    }
+
+    bool SettingsHost::ReleaseIfIdle() noexcept
+    {
+        // Open() posts under the same lock, so a request either shows up here
+        // or arrives after m_running is false and starts a new thread.
+        std::scoped_lock lock(m_lock);
+        MSG msg;
+        if (PeekMessageW(&msg, nullptr, ShowMessage, ShowMessage, PM_REMOVE))
+        {
+            return false;
+        }
+        m_running = false;
+        return true;
+    }
+
+    SettingsModel SettingsHost::BuildModel()
+    {
+        SettingsModel model;
+        model.configPath = m_configPath;
+        {
+            RcuReadGuard<DispatchSnapshot> const snapshot(m_snapshots);
+            ActionTable const& actions = snapshot->configuration.actions;
+            model.settings = snapshot->configuration.settings;
+            model.generation = snapshot->generation;
+            UpdateRows(actions, model.changedSlots);
+            model.bindings = &m_rows;
+
+            // Only the buckets touched since the last model are re-examined.
+            m_conflicts.Update(*snapshot.get());
+            for (Conflict const& conflict : m_conflicts.Conflicts())
+            {
+                model.conflicts.push_back(FormatConflict(actions, conflict));
+            }
+        }
+
+        for (size_t stage = 0; stage < model.latency.size(); ++stage)
+        {
+            model.latency[stage] = Instrumentation::Summarize(static_cast<LatencyStage>(stage));
+        }
+        model.hook = KeyboardHook::Health();
+        return model;
+    }
+
+    void SettingsHost::UpdateRows(ActionTable const& actions, std::vector<uint32_t>& changed)
+    {
+        uint32_t const count = actions.Size();
+        uint32_t const previous = static_cast<uint32_t>(m_rows.rows.size());
+        for (uint32_t slot = count; slot < previous; ++slot)
+        {
+            m_rows.listedCount -= m_rows.rows[slot].listed;
+            m_rows.search.Remove(slot);
+        }
+        m_rows.rows.resize(count);
+        m_rowPrints.resize(count);
+
+        for (uint32_t slot = 0; slot < count; ++slot)
+        {
+            ActionRecord const& action = actions[slot];
+            uint64_t const print = Fingerprint(actions, action);
+            if (slot < previous && print == m_rowPrints[slot])
+            {
+                continue;
+            }
+            m_rowPrints[slot] = print;
+            changed.push_back(slot);
+
+            BindingRows::Row& row = m_rows.rows[slot];
+            m_rows.listedCount -= row.listed;
+            uint32_t const steps = actions.SequenceLength(action);
+            if (IsTombstone(action) || (!action.hasHotkey && steps == 0))
+            {
+                row = {};
+                m_rows.search.Remove(slot);
+                continue;
+            }
+
+            row.listed = true;
+            row.enabled = action.enabled;
+            row.hotkey.clear();
+            if (action.hasHotkey)
+            {
+                row.hotkey = FormatHotkey(action.hotkey, actions.String(action.keyName));
+            }
+            for (uint32_t step = 0; step < steps; ++step)
+            {
+                row.hotkey += row.hotkey.empty() ? L"" : (step == 0 ? L" or " : L", ");
+                row.hotkey += FormatHotkey(actions.SequenceStep(action, step), {});
+            }
+            row.name = Widen(actions.String(action.name.length != 0 ? action.name : action.id));
+            row.type = Widen(actions.String(action.type));
+            if (action.profile.length != 0)
+            {
+                row.type += L" (" + Widen(actions.String(action.profile)) + L")";
+            }
+            if (action.passThrough && action.hasHotkey)
+            {
+                row.type += L" (pass-through)";
+            }
+            m_rows.listedCount += 1;
+
+            std::wstring text = Widen(actions.String(action.name));
+            text += ActionSearchIndex::FieldSeparator;
+            text += Widen(actions.String(action.id));
+            text += ActionSearchIndex::FieldSeparator;
+            text += Widen(actions.String(action.keyName));
+            m_rows.search.Update(slot, text);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Core/ConflictAnalyzer.h"
+#include "Core/DispatchSnapshot.h"
+#include "UI/SettingsWindow.h"
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace khm
+{
+    // Owns the settings UI thread. Nothing from the Windows App SDK is loaded
+    // until the first Open(): the thread bootstraps the runtime, creates its
+    // DispatcherQueue and XAML manager, and tears all of it down again once
+    // the window has been closed for IdleRelease.
+    class SettingsHost
+    {
+    public:
+        static constexpr std::chrono::milliseconds IdleRelease{ 60'000 };
+
+        SettingsHost(HINSTANCE instance, DispatchSnapshotPointer& snapshots, std::filesystem::path configPath);
+        ~SettingsHost();
+
+        SettingsHost(SettingsHost const&) = delete;
+        SettingsHost& operator=(SettingsHost const&) = delete;
+
+        // Shows the window, starting the UI thread if needed. Main thread only.
+        void Open();
+        void Shutdown() noexcept;
+
+        // Rebuilds an open window from the current snapshot. Any thread.
+        void Refresh() noexcept;
+
+        // Whether the UI thread (and with it the runtime and XAML) is up.
+        // Any thread.
+        bool IsLoaded() noexcept;
+
+        // Called on the UI thread when the user flips an action's switch.
+        // Set before the first Open().
+        void SetEnableHandler(SettingsWindow::EnableCallback handler) { m_setEnabled = std::move(handler); }
+
+        // Called on the UI thread once it has unloaded everything, unless
+        // it is shutting down. Set before the first Open().
+        void SetReleaseHandler(std::function<void()> handler) { m_released = std::move(handler); }
+
+    private:
+        void Run() noexcept;
+        void RunWindow();
+        bool ReleaseIfIdle() noexcept;
+        SettingsModel BuildModel();
+        void UpdateRows(ActionTable const& actions, std::vector<uint32_t>& changed);
+
+        HINSTANCE m_instance;
+        DispatchSnapshotPointer::Reader& m_snapshots;
+        std::filesystem::path m_configPath;
+
+        std::mutex m_lock;
+        std::thread m_thread;
+        bool m_running = false; // guarded by m_lock
+        winrt::handle m_stopEvent;
+        SettingsWindow::EnableCallback m_setEnabled;
+        std::function<void()> m_released;
+
+        // UI thread only; kept across threads so reloads stay incremental.
+        ConflictAnalyzer m_conflicts;
+        BindingRows m_rows;
+        std::vector<uint64_t> m_rowPrints; // fingerprint of the action each row was formatted from
+    };
+}
@@ -0,0 +1,710 @@
+#include "pch.h"
+#include "UI/SettingsWindow.h"
+
+#include "Configuration/ConfigurationMerge.h"
+#include "Configuration/ConfigurationError.h"
+
+#include <winrt/Microsoft.UI.h>
+#include <winrt/Microsoft.UI.Content.h>
+#include <winrt/Microsoft.UI.Interop.h>
+#include <winrt/Microsoft.UI.Xaml.h>
+#include <winrt/Microsoft.UI.Xaml.Controls.h>
+#include <winrt/Microsoft.UI.Xaml.Hosting.h>
+#include <winrt/Microsoft.UI.Xaml.Media.h>
+#include <winrt/Windows.Foundation.Collections.h>
+#include <winrt/Windows.Graphics.h>
+
+#include <shellapi.h>
+#include <shobjidl_core.h>
+
+#include <algorithm>
+#include <cwchar>
+
+namespace wf = winrt::Windows::Foundation;
+namespace wfc = winrt::Windows::Foundation::Collections;
+namespace xaml = winrt::Microsoft::UI::Xaml;
+namespace controls = winrt::Microsoft::UI::Xaml::Controls;
+namespace hosting = winrt::Microsoft::UI::Xaml::Hosting;
+
+namespace khm
+{
+    namespace
+    {
+        constexpr wchar_t WindowClass[] = L"KeyboardHookManager.Settings";
+
+        constexpr wchar_t const* StageNames[] = { L"Match", L"Handoff", L"Action start", L"Action run" };
+        static_assert(ARRAYSIZE(StageNames) == static_cast<size_t>(LatencyStage::Count));
+
+        controls::TextBlock Text(std::wstring_view text, double size)
+        {
+            controls::TextBlock block;
+            block.Text(winrt::hstring{ text });
+            block.FontSize(size);
+            block.TextWrapping(xaml::TextWrapping::Wrap);
+            return block;
+        }
+
+        // Settings are edited in the JSON (hot-reloaded); the switches only
+        // reflect it.
+        controls::ToggleSwitch Toggle(wchar_t const* header, bool on)
+        {
+            controls::ToggleSwitch toggle;
+            toggle.Header(winrt::box_value(winrt::hstring{ header }));
+            toggle.IsOn(on);
+            toggle.IsEnabled(false);
+            return toggle;
+        }
+
+        constexpr COMDLG_FILTERSPEC ImportFileTypes[] = { { L"Configuration", L"*.json;*.yaml;*.yml" }, { L"All files", L"*.*" } };
+        constexpr COMDLG_FILTERSPEC ExportFileTypes[] = { { L"JSON configuration", L"*.json" } }; // what ConfigurationWriter writes
+
+        // Empty when the user cancels.
+        std::vector<std::filesystem::path> PickImportFiles(HWND owner)
+        {
+            auto const dialog = winrt::create_instance<IFileOpenDialog>(CLSID_FileOpenDialog);
+            FILEOPENDIALOGOPTIONS options = 0;
+            winrt::check_hresult(dialog->GetOptions(&options));
+            winrt::check_hresult(dialog->SetOptions(options | FOS_ALLOWMULTISELECT | FOS_FILEMUSTEXIST | FOS_FORCEFILESYSTEM));
+            winrt::check_hresult(dialog->SetFileTypes(ARRAYSIZE(ImportFileTypes), ImportFileTypes));
+            winrt::check_hresult(dialog->SetTitle(L"Import configurations"));
+            if (dialog->Show(owner) != S_OK)
+            {
+                return {};
+            }
+
+            winrt::com_ptr<IShellItemArray> items;
+            winrt::check_hresult(dialog->GetResults(items.put()));
+            DWORD count = 0;
+            winrt::check_hresult(items->GetCount(&count));
+            std::vector<std::filesystem::path> paths;
+            for (DWORD i = 0; i < count; ++i)
+            {
+                winrt::com_ptr<IShellItem> item;
+                winrt::check_hresult(items->GetItemAt(i, item.put()));
+                PWSTR path = nullptr;
+                winrt::check_hresult(item->GetDisplayName(SIGDN_FILESYSPATH, &path));
+                paths.emplace_back(path);
+                CoTaskMemFree(path);
+            }
+            return paths;
+        }
+
+        std::filesystem::path PickExportFile(HWND owner)
+        {
+            auto const dialog = winrt::create_instance<IFileSaveDialog>(CLSID_FileSaveDialog);
+            FILEOPENDIALOGOPTIONS options = 0;
+            winrt::check_hresult(dialog->GetOptions(&options));
+            winrt::check_hresult(dialog->SetOptions(options | FOS_OVERWRITEPROMPT | FOS_FORCEFILESYSTEM));
+            winrt::check_hresult(dialog->SetFileTypes(ARRAYSIZE(ExportFileTypes), ExportFileTypes));
+            winrt::check_hresult(dialog->SetDefaultExtension(L"json"));
+            winrt::check_hresult(dialog->SetTitle(L"Export configuration"));
+            if (dialog->Show(owner) != S_OK)
+            {
+                return {};
+            }
+
+            winrt::com_ptr<IShellItem> item;
+            winrt::check_hresult(dialog->GetResult(item.put()));
+            PWSTR path = nullptr;
+            winrt::check_hresult(item->GetDisplayName(SIGDN_FILESYSPATH, &path));
+            std::filesystem::path result{ path };
+            CoTaskMemFree(path);
+            return result;
+        }
+
+        std::wstring DescribeMerge(MergeReport const& report)
+        {
+            wchar_t text[160];
+            swprintf_s(text, L"%u of %u actions written; %u duplicate ids skipped, %u hotkey collisions disabled.",
+                report.written, report.read, report.duplicates, report.collisions);
+            return text;
+        }
+
+        std::wstring FormatLatency(wchar_t const* stage, LatencySummary const& summary)
+        {
+            wchar_t line[160];
+            swprintf_s(line, L"%-13ls p50 %.1f us   p99 %.1f us   p99.9 %.1f us   max %.1f us   (%llu)", stage,
+                summary.p50Ns / 1000.0, summary.p99Ns / 1000.0, summary.p999Ns / 1000.0, summary.maxNs / 1000.0,
+                static_cast<unsigned long long>(summary.count));
+            return line;
+        }
+
+        // The filtered rows as the ItemsRepeater sees them: slot numbers that
+        // are only boxed when a row is realized, so a list of thousands
+        // costs one WinRT object per visible row. Read-only; the window
+        // swaps the slots and raises the change itself.
+        struct RowSource : winrt::implements<RowSource, wfc::IObservableVector<wf::IInspectable>, wfc::IVector<wf::IInspectable>, wfc::IIterable<wf::IInspectable>>
+        {
+            std::vector<uint32_t> slots; // ascending
+
+            wf::IInspectable GetAt(uint32_t index) const
+            {
+                if (index >= slots.size())
+                {
+                    throw winrt::hresult_out_of_bounds();
+                }
+                return winrt::box_value(slots[index]);
+            }
+
+            uint32_t Size() const noexcept { return static_cast<uint32_t>(slots.size()); }
+
+            bool IndexOf(wf::IInspectable const& value, uint32_t& index) const
+            {
+                uint32_t const slot = winrt::unbox_value_or<uint32_t>(value, UINT32_MAX);
+                auto const at = std::ranges::lower_bound(slots, slot);
+                index = static_cast<uint32_t>(at - slots.begin());
+                return at != slots.end() && *at == slot;
+            }
+
+            uint32_t GetMany(uint32_t start, winrt::array_view<wf::IInspectable> items) const
+            {
+                uint32_t count = 0;
+                for (; count < items.size() && start + count < slots.size(); ++count)
+                {
+                    items[count] = winrt::box_value(slots[start + count]);
+                }
+                return count;
+            }
+
+            // Only for consumers that enumerate instead of indexing.
+            wfc::IVectorView<wf::IInspectable> GetView() const { return Boxed().GetView(); }
+            wfc::IIterator<wf::IInspectable> First() const { return Boxed().First(); }
+
+            void SetAt(uint32_t, wf::IInspectable const&) { throw winrt::hresult_illegal_method_call(); }
+            void InsertAt(uint32_t, wf::IInspectable const&) { throw winrt::hresult_illegal_method_call(); }
+            void RemoveAt(uint32_t) { throw winrt::hresult_illegal_method_call(); }
+            void Append(wf::IInspectable const&) { throw winrt::hresult_illegal_method_call(); }
+            void RemoveAtEnd() { throw winrt::hresult_illegal_method_call(); }
+            void Clear() { throw winrt::hresult_illegal_method_call(); }
+            void ReplaceAll(winrt::array_view<wf::IInspectable const>) { throw winrt::hresult_illegal_method_call(); }
+
+            winrt::event_token VectorChanged(wfc::VectorChangedEventHandler<wf::IInspectable> const& handler)
+            {
+                return m_changed.add(handler);
+            }
+
+            void VectorChanged(winrt::event_token const& token) noexcept
+            {
+                m_changed.remove(token);
+            }
+
+            void Reset(std::vector<uint32_t> next)
+            {
+                slots = std::move(next);
+                Raise(wfc::CollectionChange::Reset, 0);
+            }
+
+            // Re-realizes one row, if it is realized at all.
+            void ItemChanged(uint32_t index)
+            {
+                Raise(wfc::CollectionChange::ItemChanged, index);
+            }
+
+        private:
+            struct ChangedArgs : winrt::implements<ChangedArgs, wfc::IVectorChangedEventArgs>
+            {
+                ChangedArgs(wfc::CollectionChange change, uint32_t index) noexcept : m_change(change), m_index(index) {}
+
+                wfc::CollectionChange CollectionChange() const noexcept { return m_change; }
+                uint32_t Index() const noexcept { return m_index; }
+
+                wfc::CollectionChange m_change;
+                uint32_t m_index;
+            };
+
+            void Raise(wfc::CollectionChange change, uint32_t index)
+            {
+                m_changed(*this, winrt::make<ChangedArgs>(change, index));
+            }
+
+            wfc::IVector<wf::IInspectable> Boxed() const
+            {
+                std::vector<wf::IInspectable> items;
+                items.reserve(slots.size());
+                for (uint32_t slot : slots)
+                {
+                    items.push_back(winrt::box_value(slot));
+                }
+                return winrt::single_threaded_vector(std::move(items));
+            }
+
+            winrt::event<wfc::VectorChangedEventHandler<wf::IInspectable>> m_changed;
+        };
+
+        // Builds and recycles the row elements: a switch for `enabled` and
+        // the hotkey, name and type columns.
+        struct RowFactory : winrt::implements<RowFactory, xaml::IElementFactory>
+        {
+            RowFactory(BindingRows const* const& rows, SettingsWindow::EnableCallback setEnabled) :
+                m_rows(rows),
+                m_setEnabled(std::move(setEnabled))
+            {
+            }
+
+            xaml::UIElement GetElement(xaml::ElementFactoryGetArgs const& args)
+            {
+                controls::Grid row{ nullptr };
+                if (m_pool.empty())
+                {
+                    row = Create();
+                }
+                else
+                {
+                    row = std::move(m_pool.back());
+                    m_pool.pop_back();
+                }
+
+                uint32_t const slot = winrt::unbox_value<uint32_t>(args.Data());
+                BindingRows::Row const& binding = m_rows->rows[slot];
+                auto children = row.Children();
+                controls::CheckBox const enabled = children.GetAt(0).as<controls::CheckBox>();
+                enabled.Tag(args.Data());
+                enabled.IsChecked(binding.enabled);
+                children.GetAt(1).as<controls::TextBlock>().Text(winrt::hstring{ binding.hotkey });
+                children.GetAt(2).as<controls::TextBlock>().Text(winrt::hstring{ binding.name });
+                children.GetAt(3).as<controls::TextBlock>().Text(winrt::hstring{ binding.type });
+                return row;
+            }
+
+            void RecycleElement(xaml::ElementFactoryRecycleArgs const& args)
+            {
+                m_pool.push_back(args.Element().as<controls::Grid>());
+            }
+
+        private:
+            controls::Grid Create()
+            {
+                controls::Grid row;
+                row.ColumnSpacing(12);
+                auto columns = row.ColumnDefinitions();
+                for (xaml::GridLength width : { xaml::GridLength{ 0, xaml::GridUnitType::Auto }, xaml::GridLength{ 200, xaml::GridUnitType::Pixel },
+                         xaml::GridLength{ 1, xaml::GridUnitType::Star }, xaml::GridLength{ 0, xaml::GridUnitType::Auto } })
+                {
+                    controls::ColumnDefinition column;
+                    column.Width(width);
+                    columns.Append(column);
+                }
+
+                controls::CheckBox enabled;
+                enabled.MinWidth(0);
+                // Click only fires for the user, never when a row is re-realized.
+                enabled.Click([setEnabled = m_setEnabled](wf::IInspectable const& sender, xaml::RoutedEventArgs const&) {
+                    controls::CheckBox const box = sender.as<controls::CheckBox>();
+                    if (setEnabled)
+                    {
+                        setEnabled(winrt::unbox_value<uint32_t>(box.Tag()), box.IsChecked().Value());
+                    }
+                });
+                row.Children().Append(enabled);
+                for (int32_t column = 1; column <= 3; ++column)
+                {
+                    controls::TextBlock text;
+                    text.VerticalAlignment(xaml::VerticalAlignment::Center);
+                    text.TextTrimming(xaml::TextTrimming::CharacterEllipsis);
+                    controls::Grid::SetColumn(text, column);
+                    row.Children().Append(text);
+                }
+                return row;
+            }
+
+            BindingRows const* const& m_rows; // the window's current model
+            SettingsWindow::EnableCallback m_setEnabled;
+            std::vector<controls::Grid> m_pool;
+        };
+    }
+
+    struct SettingsWindow::Impl
+    {
+        HWND window = nullptr;
+        hosting::DesktopWindowXamlSource source{ nullptr };
+        controls::ScrollViewer root{ nullptr };
+        EnableCallback setEnabled;
+
+        // Built once; Refresh() replaces the children of the two panels and
+        // updates the list in place.
+        controls::StackPanel details{ nullptr };
+        controls::StackPanel status{ nullptr };
+        controls::TextBlock listHeading{ nullptr };
+        controls::TextBlock transferText{ nullptr };
+        winrt::com_ptr<RowSource> rowSource;
+        BindingRows const* rows = nullptr;
+        std::wstring query;
+        std::wstring transferStatus; // outcome of the last import or export
+
+        static LRESULT CALLBACK WindowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam) noexcept
+        {
+            if (message == WM_NCCREATE)
+            {
+                auto* const self = static_cast<Impl*>(reinterpret_cast<CREATESTRUCTW const*>(lParam)->lpCreateParams);
+                self->window = window;
+                SetWindowLongPtrW(window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(self));
+            }
+
+            auto* const self = reinterpret_cast<Impl*>(GetWindowLongPtrW(window, GWLP_USERDATA));
+            if (self != nullptr)
+            {
+                switch (message)
+                {
+                case WM_SIZE:
+                    self->Resize();
+                    return 0;
+                case WM_DESTROY:
+                    self->Close();
+                    break;
+                default:
+                    break;
+                }
+            }
+            return DefWindowProcW(window, message, wParam, lParam);
+        }
+
+        void Resize() noexcept
+        {
+            if (source)
+            {
+                RECT client;
+                GetClientRect(window, &client);
+                source.SiteBridge().MoveAndResize({ 0, 0, static_cast<int32_t>(client.right - client.left), static_cast<int32_t>(client.bottom - client.top) });
+            }
+        }
+
+        void Close() noexcept
+        {
+            if (source)
+            {
+                source.Close();
+                source = nullptr;
+            }
+            root = nullptr;
+            details = nullptr;
+            status = nullptr;
+            listHeading = nullptr;
+            transferText = nullptr;
+            rowSource = nullptr;
+            SetWindowLongPtrW(window, GWLP_USERDATA, 0);
+            window = nullptr;
+        }
+
+        controls::StackPanel Build()
+        {
+            controls::StackPanel panel;
+            panel.Padding(xaml::Thickness{ 24, 24, 24, 24 });
+            panel.Spacing(12);
+            auto children = panel.Children();
+
+            details = controls::StackPanel();
+            details.Spacing(12);
+            children.Append(details);
+
+            listHeading = Text({}, 18);
+            children.Append(listHeading);
+
+            controls::TextBox search;
+            search.PlaceholderText(L"Search by name, id or key");
+            search.TextChanged([this](wf::IInspectable const& sender, controls::TextChangedEventArgs const&) {
+                Search(std::wstring{ sender.as<controls::TextBox>().Text() });
+            });
+            children.Append(search);
+
+            rowSource = winrt::make_self<RowSource>();
+            controls::ItemsRepeater list;
+            list.ItemTemplate(winrt::make<RowFactory>(rows, setEnabled));
+            list.ItemsSource(rowSource.as<wfc::IObservableVector<wf::IInspectable>>());
+            controls::ScrollViewer scroller;
+            scroller.Height(360);
+            scroller.Content(list);
+            children.Append(scroller);
+
+            status = controls::StackPanel();
+            status.Spacing(12);
+            children.Append(status);
+            return panel;
+        }
+
+        void Update(SettingsModel const& model)
+        {
+            BuildDetails(model);
+            BuildStatus(model);
+
+            bool const fresh = rows != model.bindings;
+            rows = model.bindings;
+            std::vector<uint32_t> visible = Filter();
+            if (fresh || visible != rowSource->slots)
+            {
+                rowSource->Reset(std::move(visible));
+            }
+            else
+            {
+                // Same rows on show: only the reformatted ones are re-realized.
+                for (uint32_t slot : model.changedSlots)
+                {
+                    uint32_t index = 0;
+                    if (rowSource->IndexOf(winrt::box_value(slot), index))
+                    {
+                        rowSource->ItemChanged(index);
+                    }
+                }
+            }
+            UpdateHeading();
+        }
+
+        void Search(std::wstring next)
+        {
+            if (rows == nullptr)
+            {
+                return;
+            }
+            std::vector<uint32_t> visible;
+            if (!query.empty() && next.find(query) != std::wstring::npos)
+            {
+                // Typing on narrows the current matches.
+                visible = rowSource->slots;
+                rows->search.Refine(visible, next);
+                query = std::move(next);
+            }
+            else
+            {
+                query = std::move(next);
+                visible = Filter();
+            }
+            rowSource->Reset(std::move(visible));
+            UpdateHeading();
+        }
+
+        std::vector<uint32_t> Filter() const
+        {
+            if (!query.empty())
+            {
+                return rows->search.Search(query);
+            }
+            std::vector<uint32_t> visible;
+            visible.reserve(rows->listedCount);
+            for (uint32_t slot = 0; slot < rows->rows.size(); ++slot)
+            {
+                if (rows->rows[slot].listed)
+                {
+                    visible.push_back(slot);
+                }
+            }
+            return visible;
+        }
+
+        void UpdateHeading()
+        {
+            wchar_t heading[64];
+            if (query.empty())
+            {
+                swprintf_s(heading, L"Hotkeys (%u)", rows->listedCount);
+            }
+            else
+            {
+                swprintf_s(heading, L"Hotkeys (%u of %u)", rowSource->Size(), rows->listedCount);
+            }
+            listHeading.Text(heading);
+        }
+
+        void BuildDetails(SettingsModel const& model)
+        {
+            auto children = details.Children();
+            children.Clear();
+
+            children.Append(Text(L"Keyboard Hook Manager", 24));
+            children.Append(Text(model.configPath.wstring(), 12));
+
+            children.Append(Toggle(L"Start with Windows", model.settings.startWithWindows));
+            children.Append(Toggle(L"Show tray icon", model.settings.showTrayIcon));
+            children.Append(Toggle(L"Enable logging", model.settings.enableLogging));
+
+            controls::StackPanel buttons;
+            buttons.Orientation(controls::Orientation::Horizontal);
+            buttons.Spacing(8);
+
+            controls::Button open;
+            open.Content(winrt::box_value(winrt::hstring{ L"Open configuration file" }));
+            open.Click([owner = window, path = model.configPath.wstring()](auto&&, auto&&) {
+                ShellExecuteW(owner, L"open", path.c_str(), nullptr, nullptr, SW_SHOWNORMAL);
+            });
+            buttons.Children().Append(open);
+
+            controls::Button importButton;
+            importButton.Content(winrt::box_value(winrt::hstring{ L"Import..." }));
+            importButton.Click([this, path = model.configPath](auto&&, auto&&) { Import(path); });
+            buttons.Children().Append(importButton);
+
+            controls::Button exportButton;
+            exportButton.Content(winrt::box_value(winrt::hstring{ L"Export..." }));
+            exportButton.Click([this, path = model.configPath](auto&&, auto&&) { Export(path); });
+            buttons.Children().Append(exportButton);
+            children.Append(buttons);
+
+            transferText = Text(transferStatus, 12);
+            children.Append(transferText);
+        }
+
+        // Merges the picked files into the live config, which keeps its own
+        // actions on conflict; the watcher then reloads it like any edit.
+        void Import(std::filesystem::path const& configPath)
+        {
+            RunTransfer([&] {
+                std::vector<std::filesystem::path> inputs = PickImportFiles(window);
+                if (inputs.empty())
+                {
+                    return false;
+                }
+                inputs.insert(inputs.begin(), configPath);
+                transferStatus = L"Imported: " + DescribeMerge(ConfigurationMerge::Merge(inputs, configPath));
+                return true;
+            });
+        }
+
+        void Export(std::filesystem::path const& configPath)
+        {
+            RunTransfer([&] {
+                std::filesystem::path const output = PickExportFile(window);
+                if (output.empty())
+                {
+                    return false;
+                }
+                transferStatus = L"Exported to " + output.wstring() + L": " + DescribeMerge(ConfigurationMerge::Merge({ &configPath, 1 }, output));
+                return true;
+            });
+        }
+
+        // Runs on the UI thread: a merge streams and is quick even for large
+        // files, and the dialogs are modal anyway.
+        template <typename Transfer>
+        void RunTransfer(Transfer&& transfer) noexcept
+        {
+            try
+            {
+                if (!transfer())
+                {
+                    return;
+                }
+            }
+            catch (ConfigurationError const& e)
+            {
+                transferStatus = winrt::to_hstring(e.what()).c_str();
+            }
+            catch (winrt::hresult_error const& e)
+            {
+                transferStatus = e.message().c_str();
+            }
+            if (transferText)
+            {
+                transferText.Text(winrt::hstring{ transferStatus });
+            }
+        }
+
+        void BuildStatus(SettingsModel const& model)
+        {
+            auto children = status.Children();
+            children.Clear();
+
+            wchar_t heading[64];
+            swprintf_s(heading, L"Conflicts (%zu)", model.conflicts.size());
+            children.Append(Text(heading, 18));
+            if (model.conflicts.empty())
+            {
+                children.Append(Text(L"Every binding can fire.", 12));
+            }
+            for (std::wstring const& conflict : model.conflicts)
+            {
+                children.Append(Text(conflict, 12));
+            }
+
+            children.Append(Text(L"Hook latency", 18));
+            if (!model.settings.enableLogging)
+            {
+                children.Append(Text(L"Instrumentation is off; set settings.enableLogging to collect latency.", 12));
+            }
+            for (size_t stage = 0; stage < model.latency.size(); ++stage)
+            {
+                controls::TextBlock line = Text(FormatLatency(StageNames[stage], model.latency[stage]), 12);
+                line.FontFamily(xaml::Media::FontFamily(L"Consolas"));
+                children.Append(line);
+            }
+
+            wchar_t health[160];
+            swprintf_s(health, L"Hook: slowest callback %.1f us of %u ms allowed, %llu slow, %llu reinstalled, %llu canaries",
+                model.hook.maxCallbackNs / 1000.0, model.hook.timeoutMs, static_cast<unsigned long long>(model.hook.slowCallbacks),
+                static_cast<unsigned long long>(model.hook.reinstalls), static_cast<unsigned long long>(model.hook.canaries));
+            children.Append(Text(health, 12));
+        }
+    };
+
+    SettingsWindow::SettingsWindow(HINSTANCE instance, SettingsModel const& model, EnableCallback setEnabled) :
+        m_impl(std::make_unique<Impl>())
+    {
+        m_impl->setEnabled = std::move(setEnabled);
+        WNDCLASSEXW windowClass{ sizeof(windowClass) };
+        windowClass.lpfnWndProc = Impl::WindowProc;
+        windowClass.hInstance = instance;
+        windowClass.hCursor = LoadCursorW(nullptr, IDC_ARROW);
+        windowClass.hbrBackground = reinterpret_cast<HBRUSH>(COLOR_WINDOW + 1);
+        windowClass.lpszClassName = WindowClass;
+        if (!RegisterClassExW(&windowClass) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS)
+        {
+            winrt::throw_last_error();
+        }
+
+        HWND const window = CreateWindowExW(0, WindowClass, L"Keyboard Hook Manager Settings", WS_OVERLAPPEDWINDOW,
+            CW_USEDEFAULT, CW_USEDEFAULT, 640, 720, nullptr, nullptr, instance, m_impl.get());
+        if (window == nullptr)
+        {
+            winrt::throw_last_error();
+        }
+
+        try
+        {
+            m_impl->source = hosting::DesktopWindowXamlSource();
+            m_impl->source.Initialize(winrt::Microsoft::UI::GetWindowIdFromWindow(window));
+
+            // No XAML Application object exists in this process, so the control
+            // styles are merged in at the root instead of App.xaml.
+            m_impl->root = controls::ScrollViewer();
+            m_impl->root.Resources().MergedDictionaries().Append(controls::XamlControlsResources());
+            m_impl->source.Content(m_impl->root);
+
+            m_impl->root.Content(m_impl->Build());
+            Refresh(model);
+        }
+        catch (...)
+        {
+            DestroyWindow(window);
+            throw;
+        }
+        m_impl->Resize();
+        Show();
+    }
+
+    SettingsWindow::~SettingsWindow()
+    {
+        if (m_impl->window != nullptr)
+        {
+            DestroyWindow(m_impl->window);
+        }
+    }
+
+    void SettingsWindow::Show() noexcept
+    {
+        if (m_impl->window != nullptr)
+        {
+            ShowWindow(m_impl->window, IsIconic(m_impl->window) ? SW_RESTORE : SW_SHOWNORMAL);
+            SetForegroundWindow(m_impl->window);
+        }
+    }
+
+    void SettingsWindow::Refresh(SettingsModel const& model)
+    {
+        if (m_impl->root)
+        {
+            m_impl->Update(model);
+        }
+    }
+
+    bool SettingsWindow::IsOpen() const noexcept
+    {
+        return m_impl->window != nullptr;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Configuration/Configuration.h"
+#include "Core/KeyboardHook.h"
+#include "UI/ActionSearchIndex.h"
+#include "Utils/Instrumentation.h"
+
+#include <windows.h>
+
+#include <array>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace khm
+{
+    // The hotkey list, one row per action slot. SettingsHost keeps it across
+    // refreshes and only reformats the slots a reload touched, so neither it
+    // nor the window's list is rebuilt for a change to a few actions.
+    struct BindingRows
+    {
+        struct Row
+        {
+            std::wstring hotkey;
+            std::wstring name;
+            std::wstring type;
+            bool listed = false; // not a tombstone, and has a hotkey or sequence
+            bool enabled = true;
+        };
+
+        std::vector<Row> rows; // by action slot
+        uint32_t listedCount = 0;
+        ActionSearchIndex search; // name, id and keyName of the listed rows
+    };
+
+    // Plain copy of what the window shows, taken under the RCU guard so the
+    // UI never holds a snapshot while XAML lays out. The rows are shared, not
+    // copied: SettingsHost owns them and only touches them on the UI thread.
+    struct SettingsModel
+    {
+        std::filesystem::path configPath;
+        Settings settings;
+        uint64_t generation = 0;
+        BindingRows const* bindings = nullptr;
+        std::vector<uint32_t> changedSlots; // rows reformatted since the previous model, ascending
+        std::vector<std::wstring> conflicts;
+        std::array<LatencySummary, static_cast<size_t>(LatencyStage::Count)> latency{};
+        HookHealth hook;
+    };
+
+    // Win32 window hosting a XAML island built in code. This header is the
+    // only UI-facing surface other code sees; the Microsoft.UI.Xaml headers
+    // stay inside SettingsWindow.cpp. The creating thread must already own a
+    // DispatcherQueue and an initialized WindowsXamlManager.
+    class SettingsWindow
+    {
+    public:
+        // `setEnabled` runs when the user flips an action's switch.
+        using EnableCallback = std::function<void(uint32_t slot, bool enabled)>;
+
+        SettingsWindow(HINSTANCE instance, SettingsModel const& model, EnableCallback setEnabled);
+        ~SettingsWindow();
+
+        SettingsWindow(SettingsWindow const&) = delete;
+        SettingsWindow& operator=(SettingsWindow const&) = delete;
+
+        void Show() noexcept;
+        // Rebuilds the small sections; the hotkey list only re-realizes the
+        // rows in model.changedSlots, unless the filtered set itself changed.
+        void Refresh(SettingsModel const& model);
+
+        // False once the user has closed the window.
+        bool IsOpen() const noexcept;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
+}
@@ -0,0 +1,59 @@
+#include "pch.h"
+#include "UI/Startup.h"
+
+#include "Configuration/ConfigurationCache.h"
+#include "Configuration/ConfigurationError.h"
+#include "Configuration/ConfigurationLoader.h"
+#include "Utils/Instrumentation.h"
+
+namespace khm
+{
+    namespace
+    {
+        constexpr LogFormat ReloadRejected{ LogLevel::Error, "configuration rejected; generation {} stays live" };
+        constexpr LogFormat ReloadFailed{ LogLevel::Error, "configuration update failed; generation {} stays live" };
+        constexpr LogFormat ReloadFailedHresult{ LogLevel::Error, "configuration update failed (hr {x}); generation {} stays live" };
+    }
+
+    void ApplyLogging(Settings const& settings)
+    {
+        Instrumentation::SetEnabled(settings.enableLogging);
+        Logger::SetLevel(settings.enableLogging ? settings.logLevel : LogLevel::Off);
+    }
+
+    std::unique_ptr<DispatchSnapshot> LoadInitialSnapshot(std::filesystem::path const& path, bool& fromCache)
+    {
+        if (std::optional<CachedConfiguration> cached = ConfigurationCache::Load(path))
+        {
+            fromCache = true;
+            return DispatchSnapshot::Create(std::move(cached->configuration), std::move(cached->table));
+        }
+
+        fromCache = false;
+        auto snapshot = DispatchSnapshot::Create(ConfigurationLoader::LoadStreaming(path));
+        ConfigurationCache::Store(path, snapshot->configuration, *snapshot->table);
+        return snapshot;
+    }
+
+    void ReportReloadFailure(uint64_t generation) noexcept
+    {
+        // Log records carry integers only: what went wrong is told apart by
+        // the message, and a Windows error by its HRESULT.
+        try
+        {
+            throw;
+        }
+        catch (ConfigurationError const&)
+        {
+            Log(ReloadRejected, generation);
+        }
+        catch (winrt::hresult_error const& e)
+        {
+            Log(ReloadFailedHresult, static_cast<uint32_t>(e.code()), generation);
+        }
+        catch (...)
+        {
+            Log(ReloadFailed, generation);
+        }
+    }
+}
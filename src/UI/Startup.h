@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Configuration/Configuration.h"
+#include "Core/DispatchSnapshot.h"
+#include "Utils/Logger.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+namespace khm
+{
+    // What the entry points share: the session app (Main.cpp), its --agent
+    // flavour (AgentSource.h) and the shared configuration --service
+    // (ServiceMain.h).
+
+    inline constexpr LogFormat ConfigurationPublished{ LogLevel::Info, "published generation {}: {} added, {} removed, {} changed" };
+
+    // settings.enableLogging turns on both the latency histograms and the
+    // log file, at settings.logLevel (Debug adds every matched hotkey).
+    void ApplyLogging(Settings const& settings);
+
+    // Prefers the precompiled cache; `fromCache` tells the caller the JSON
+    // still has to be checked against it.
+    std::unique_ptr<DispatchSnapshot> LoadInitialSnapshot(std::filesystem::path const& path, bool& fromCache);
+
+    // Call from the catch block of a reload, push or toggle that threw;
+    // `generation` is the one that stays live.
+    void ReportReloadFailure(uint64_t generation) noexcept;
+}
@@ -0,0 +1,235 @@
+#include "pch.h"
+#include "UI/TrayIcon.h"
+
+#include <shellapi.h>
+#include <wtsapi32.h>
+
+#include <cwchar>
+
+#pragma comment(lib, "wtsapi32.lib")
+
+namespace khm
+{
+    namespace
+    {
+        constexpr wchar_t WindowClass[] = L"KeyboardHookManager.Tray";
+        constexpr UINT IconId = 1;
+        constexpr UINT CallbackMessage = WM_APP + 1;
+        constexpr UINT UpdateMessage = WM_APP + 2;
+
+        enum MenuCommand : UINT
+        {
+            SettingsCommand = 1,
+            ExitCommand,
+        };
+
+        NOTIFYICONDATAW IconData(HWND window, uint32_t hotkeyCount) noexcept
+        {
+            NOTIFYICONDATAW data{ sizeof(data) };
+            data.hWnd = window;
+            data.uID = IconId;
+            swprintf_s(data.szTip, L"Keyboard Hook Manager (%u hotkeys)", hotkeyCount);
+            return data;
+        }
+    }
+
+    TrayIcon::TrayIcon(HINSTANCE instance, Callbacks callbacks) :
+        m_instance(instance),
+        m_callbacks(std::move(callbacks))
+    {
+    }
+
+    TrayIcon::~TrayIcon()
+    {
+        Remove();
+        if (m_sessionNotifications)
+        {
+            WTSUnRegisterSessionNotification(m_window);
+        }
+        if (m_window != nullptr)
+        {
+            DestroyWindow(m_window);
+        }
+    }
+
+    void TrayIcon::Create()
+    {
+        WNDCLASSEXW windowClass{ sizeof(windowClass) };
+        windowClass.lpfnWndProc = WindowProc;
+        windowClass.hInstance = m_instance;
+        windowClass.lpszClassName = WindowClass;
+        if (!RegisterClassExW(&windowClass) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS)
+        {
+            winrt::throw_last_error();
+        }
+
+        // A top-level (not message-only) window, so it receives the broadcast
+        // TaskbarCreated message when Explorer restarts.
+        m_window = CreateWindowExW(0, WindowClass, L"", 0, 0, 0, 0, 0, nullptr, nullptr, m_instance, this);
+        if (m_window == nullptr)
+        {
+            winrt::throw_last_error();
+        }
+
+        m_taskbarCreated = RegisterWindowMessageW(L"TaskbarCreated");
+        m_sessionNotifications = WTSRegisterSessionNotification(m_window, NOTIFY_FOR_THIS_SESSION) != FALSE;
+        m_icon = LoadIconW(m_instance, MAKEINTRESOURCEW(1));
+        if (m_icon == nullptr)
+        {
+            m_icon = LoadIconW(nullptr, IDI_APPLICATION);
+        }
+    }
+
+    void TrayIcon::Update(bool visible, uint32_t hotkeyCount) noexcept
+    {
+        m_hotkeyCount = hotkeyCount;
+        m_visible = visible;
+        if (!visible)
+        {
+            Remove();
+        }
+        else if (!m_added)
+        {
+            Add();
+        }
+        else
+        {
+            Modify();
+        }
+    }
+
+    void TrayIcon::PostUpdate(bool visible, uint32_t hotkeyCount) noexcept
+    {
+        PostMessageW(m_window, UpdateMessage, visible, hotkeyCount);
+    }
+
+    void TrayIcon::Add() noexcept
+    {
+        NOTIFYICONDATAW data = IconData(m_window, m_hotkeyCount);
+        data.uFlags = NIF_MESSAGE | NIF_ICON | NIF_TIP | NIF_SHOWTIP;
+        data.uCallbackMessage = CallbackMessage;
+        data.hIcon = m_icon;
+        if (Shell_NotifyIconW(NIM_ADD, &data))
+        {
+            data.uVersion = NOTIFYICON_VERSION_4;
+            Shell_NotifyIconW(NIM_SETVERSION, &data);
+            m_added = true;
+        }
+    }
+
+    void TrayIcon::Modify() noexcept
+    {
+        NOTIFYICONDATAW data = IconData(m_window, m_hotkeyCount);
+        data.uFlags = NIF_TIP | NIF_SHOWTIP;
+        Shell_NotifyIconW(NIM_MODIFY, &data);
+    }
+
+    void TrayIcon::Remove() noexcept
+    {
+        if (m_added)
+        {
+            NOTIFYICONDATAW data = IconData(m_window, m_hotkeyCount);
+            Shell_NotifyIconW(NIM_DELETE, &data);
+            m_added = false;
+        }
+    }
+
+    void TrayIcon::ShowMenu() noexcept
+    {
+        HMENU const menu = CreatePopupMenu();
+        if (menu == nullptr)
+        {
+            return;
+        }
+        AppendMenuW(menu, MF_STRING, SettingsCommand, L"&Settings");
+        AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+        AppendMenuW(menu, MF_STRING, ExitCommand, L"E&xit");
+        SetMenuDefaultItem(menu, SettingsCommand, FALSE);
+
+        // Required for the menu to close when the user clicks elsewhere.
+        SetForegroundWindow(m_window);
+        POINT cursor;
+        GetCursorPos(&cursor);
+        UINT const command = TrackPopupMenuEx(menu, TPM_RETURNCMD | TPM_NONOTIFY | TPM_RIGHTBUTTON, cursor.x, cursor.y, m_window, nullptr);
+        DestroyMenu(menu);
+
+        if (command == SettingsCommand && m_callbacks.openSettings)
+        {
+            m_callbacks.openSettings();
+        }
+        else if (command == ExitCommand && m_callbacks.exit)
+        {
+            m_callbacks.exit();
+        }
+    }
+
+    LRESULT CALLBACK TrayIcon::WindowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam) noexcept
+    {
+        if (message == WM_NCCREATE)
+        {
+            auto* const self = static_cast<TrayIcon*>(reinterpret_cast<CREATESTRUCTW const*>(lParam)->lpCreateParams);
+            self->m_window = window;
+            SetWindowLongPtrW(window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(self));
+        }
+        auto* const self = reinterpret_cast<TrayIcon*>(GetWindowLongPtrW(window, GWLP_USERDATA));
+        return self != nullptr ? self->HandleMessage(message, wParam, lParam) : DefWindowProcW(window, message, wParam, lParam);
+    }
+
+    LRESULT TrayIcon::HandleMessage(UINT message, WPARAM wParam, LPARAM lParam) noexcept
+    {
+        if (message == CallbackMessage)
+        {
+            // NOTIFYICON_VERSION_4: the event is in the low word of lParam.
+            switch (LOWORD(lParam))
+            {
+            case WM_CONTEXTMENU:
+                ShowMenu();
+                break;
+            case NIN_SELECT:
+            case NIN_KEYSELECT:
+                if (m_callbacks.openSettings)
+                {
+                    m_callbacks.openSettings();
+                }
+                break;
+            default:
+                break;
+            }
+            return 0;
+        }
+        if (message == UpdateMessage)
+        {
+            Update(wParam != 0, static_cast<uint32_t>(lParam));
+            return 0;
+        }
+        if (message == WM_SETTINGCHANGE && lParam != 0)
+        {
+            // Broadcast by the System control panel (and setx) after the user
+            // or machine environment has been edited.
+            wchar_t const* const area = reinterpret_cast<wchar_t const*>(lParam);
+            if (CompareStringOrdinal(area, -1, L"Environment", -1, TRUE) == CSTR_EQUAL && m_callbacks.environmentChanged)
+            {
+                m_callbacks.environmentChanged();
+            }
+            return 0;
+        }
+        if (message == WM_WTSSESSION_CHANGE)
+        {
+            if (wParam == WTS_SESSION_UNLOCK && m_callbacks.sessionUnlocked)
+            {
+                m_callbacks.sessionUnlocked();
+            }
+            return 0;
+        }
+        if (message == m_taskbarCreated && m_taskbarCreated != 0)
+        {
+            m_added = false;
+            if (m_visible)
+            {
+                Add();
+            }
+            return 0;
+        }
+        return DefWindowProcW(m_window, message, wParam, lParam);
+    }
+}
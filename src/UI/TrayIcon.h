@@ -0,0 +1,60 @@
+#pragma once
+
+#include <windows.h>
+
+#include <cstdint>
+#include <functional>
+
+namespace khm
+{
+    // Notification-area icon on a hidden Win32 window owned by the main
+    // thread. Pulls in nothing beyond user32/shell32, so it is up before any
+    // XAML is loaded.
+    class TrayIcon
+    {
+    public:
+        struct Callbacks
+        {
+            std::function<void()> openSettings;
+            std::function<void()> exit;
+            std::function<void()> environmentChanged; // WM_SETTINGCHANGE "Environment"
+            std::function<void()> sessionUnlocked;    // WM_WTSSESSION_CHANGE WTS_SESSION_UNLOCK
+        };
+
+        TrayIcon(HINSTANCE instance, Callbacks callbacks);
+        ~TrayIcon();
+
+        TrayIcon(TrayIcon const&) = delete;
+        TrayIcon& operator=(TrayIcon const&) = delete;
+
+        // Creates the hidden window; throws on failure.
+        void Create();
+
+        // Main thread only.
+        void Update(bool visible, uint32_t hotkeyCount) noexcept;
+
+        // Any thread; applied on the main thread.
+        void PostUpdate(bool visible, uint32_t hotkeyCount) noexcept;
+
+        HWND Window() const noexcept { return m_window; }
+
+    private:
+        static LRESULT CALLBACK WindowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam) noexcept;
+        LRESULT HandleMessage(UINT message, WPARAM wParam, LPARAM lParam) noexcept;
+
+        void Add() noexcept;
+        void Remove() noexcept;
+        void Modify() noexcept;
+        void ShowMenu() noexcept;
+
+        HINSTANCE m_instance;
+        Callbacks m_callbacks;
+        HWND m_window = nullptr;
+        HICON m_icon = nullptr;
+        UINT m_taskbarCreated = 0;
+        bool m_visible = false;
+        bool m_added = false;
+        bool m_sessionNotifications = false;
+        uint32_t m_hotkeyCount = 0;
+    };
+}
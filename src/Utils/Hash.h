@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace khm
+{
+    inline constexpr uint64_t Fnv1a64Basis = 14695981039346656037ull;
+
+    // 64-bit FNV-1a. Fingerprints configuration sources so an unchanged file
+    // is never parsed twice. Pass a previous result as `hash` to continue it.
+    inline uint64_t Fnv1a64(std::span<std::byte const> bytes, uint64_t hash = Fnv1a64Basis) noexcept
+    {
+        for (std::byte b : bytes)
+        {
+            hash = (hash ^ static_cast<uint8_t>(b)) * 1099511628211ull;
+        }
+        return hash;
+    }
+}
@@ -0,0 +1,195 @@
+#include "pch.h"
+#include "Utils/Instrumentation.h"
+
+#include <TraceLoggingProvider.h>
+#include <evntrace.h>
+
+// {6B1E0C55-3F2A-4D7E-9B64-2C1D8A6F0E47}
+TRACELOGGING_DEFINE_PROVIDER(
+    g_khmTraceProvider,
+    "KeyboardHookManager",
+    (0x6b1e0c55, 0x3f2a, 0x4d7e, 0x9b, 0x64, 0x2c, 0x1d, 0x8a, 0x6f, 0x0e, 0x47));
+
+namespace khm
+{
+    std::atomic<bool> Instrumentation::s_enabled{ false };
+
+    namespace
+    {
+        constexpr size_t StageCount = static_cast<size_t>(LatencyStage::Count);
+
+        struct ThreadSlot
+        {
+            std::atomic<bool> claimed{ false };
+            std::array<LatencyHistogram, StageCount> stages;
+        };
+
+        // Zero-initialized storage; pages are only committed once a thread
+        // actually records into its slot. Slots are not recycled, which is
+        // fine for the handful of long-lived threads on the hotkey path.
+        ThreadSlot g_slots[Instrumentation::MaxThreads];
+        std::atomic<uint32_t> g_overflowSamples{ 0 };
+        int64_t g_frequency = 1;
+
+        thread_local ThreadSlot* t_slot = nullptr;
+    }
+
+    // Record() runs on the hook and executor threads, and stays locked in
+    // memory with them while the process is trimmed (see WorkingSet).
+#pragma code_seg(push, ".text$khm_hot")
+
+    namespace
+    {
+        ThreadSlot* ClaimSlot() noexcept
+        {
+            for (ThreadSlot& slot : g_slots)
+            {
+                bool expected = false;
+                if (slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+                {
+                    return &slot;
+                }
+            }
+            return nullptr;
+        }
+
+        char const* StageName(LatencyStage stage) noexcept
+        {
+            switch (stage)
+            {
+            case LatencyStage::Match: return "Match";
+            case LatencyStage::Handoff: return "Handoff";
+            case LatencyStage::ActionStart: return "ActionStart";
+            case LatencyStage::ActionRun: return "ActionRun";
+            default: return "Unknown";
+            }
+        }
+    }
+
+    void Instrumentation::Record(LatencyStage stage, int64_t ticks) noexcept
+    {
+        ThreadSlot* slot = t_slot;
+        if (slot == nullptr)
+        {
+            slot = t_slot = ClaimSlot();
+            if (slot == nullptr)
+            {
+                g_overflowSamples.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+
+        uint64_t const value = ticks > 0 ? static_cast<uint64_t>(ticks) : 0;
+        slot->stages[static_cast<size_t>(stage)].Record(value);
+
+        if (TraceLoggingProviderEnabled(g_khmTraceProvider, WINEVENT_LEVEL_VERBOSE, 0))
+        {
+            TraceLoggingWrite(
+                g_khmTraceProvider,
+                "HookLatency",
+                TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+                TraceLoggingString(StageName(stage), "Stage"),
+                TraceLoggingUInt64(TicksToNanoseconds(value), "DurationNs"));
+        }
+    }
+
+    uint64_t Instrumentation::TicksToNanoseconds(uint64_t ticks) noexcept
+    {
+        uint64_t const frequency = static_cast<uint64_t>(g_frequency);
+        return (ticks / frequency) * 1'000'000'000 + (ticks % frequency) * 1'000'000'000 / frequency;
+    }
+
+#pragma code_seg(pop)
+
+    namespace
+    {
+
+        // A capture-state request (e.g. `xperf -capturestate`) emits the
+        // current summaries so a WPA trace always carries them.
+        void NTAPI OnProviderControl(LPCGUID, ULONG controlCode, UCHAR, ULONGLONG, ULONGLONG, PEVENT_FILTER_DESCRIPTOR, PVOID) noexcept
+        {
+            if (controlCode != EVENT_CONTROL_CODE_CAPTURE_STATE)
+            {
+                return;
+            }
+            for (size_t i = 0; i < StageCount; ++i)
+            {
+                auto const stage = static_cast<LatencyStage>(i);
+                LatencySummary const summary = Instrumentation::Summarize(stage);
+                TraceLoggingWrite(
+                    g_khmTraceProvider,
+                    "LatencySummary",
+                    TraceLoggingString(StageName(stage), "Stage"),
+                    TraceLoggingUInt64(summary.count, "Count"),
+                    TraceLoggingUInt64(summary.p50Ns, "P50Ns"),
+                    TraceLoggingUInt64(summary.p99Ns, "P99Ns"),
+                    TraceLoggingUInt64(summary.p999Ns, "P999Ns"),
+                    TraceLoggingUInt64(summary.maxNs, "MaxNs"));
+            }
+        }
+    }
+
+    void Instrumentation::Initialize() noexcept
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        g_frequency = frequency.QuadPart;
+        TraceLoggingRegisterEx(g_khmTraceProvider, &OnProviderControl, nullptr);
+    }
+
+    void Instrumentation::Shutdown() noexcept
+    {
+        TraceLoggingUnregister(g_khmTraceProvider);
+    }
+
+    LatencySummary Instrumentation::Summarize(LatencyStage stage) noexcept
+    {
+        // ~8 KB; too large to put on a caller's stack casually.
+        static thread_local LatencyAccumulator merged;
+        merged = {};
+        for (ThreadSlot const& slot : g_slots)
+        {
+            if (slot.claimed.load(std::memory_order_acquire))
+            {
+                merged.Add(slot.stages[static_cast<size_t>(stage)]);
+            }
+        }
+
+        LatencySummary summary;
+        summary.count = merged.total;
+        summary.p50Ns = TicksToNanoseconds(merged.ValueAt(0.50));
+        summary.p99Ns = TicksToNanoseconds(merged.ValueAt(0.99));
+        summary.p999Ns = TicksToNanoseconds(merged.ValueAt(0.999));
+        summary.maxNs = TicksToNanoseconds(merged.max);
+        return summary;
+    }
+
+    void Instrumentation::Reset() noexcept
+    {
+        for (ThreadSlot& slot : g_slots)
+        {
+            for (LatencyHistogram& histogram : slot.stages)
+            {
+                histogram.Reset();
+            }
+        }
+    }
+
+    void Instrumentation::AppendHotRanges(std::vector<MemoryRange>& ranges)
+    {
+        if (!Enabled())
+        {
+            return;
+        }
+        ranges.push_back({ &s_enabled, sizeof(s_enabled) });
+        ranges.push_back({ &g_frequency, sizeof(g_frequency) });
+        ranges.push_back({ &g_overflowSamples, sizeof(g_overflowSamples) });
+        for (ThreadSlot const& slot : g_slots)
+        {
+            if (slot.claimed.load(std::memory_order_acquire))
+            {
+                ranges.push_back({ &slot, sizeof(slot) });
+            }
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Utils/LatencyHistogram.h"
+#include "Utils/WorkingSet.h"
+
+#include <windows.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace khm
+{
+    // Stages of the hotkey path, each measured from hook entry.
+    enum class LatencyStage : uint8_t
+    {
+        Match,        // hook entry -> dispatch table hit
+        Handoff,      // hook entry -> event published to the ring
+        ActionStart,  // hook entry -> executor begins running the action
+        ActionRun,    // time spent inside the action itself
+        Count
+    };
+
+    struct LatencySummary
+    {
+        uint64_t count = 0;
+        uint64_t p50Ns = 0;
+        uint64_t p99Ns = 0;
+        uint64_t p999Ns = 0;
+        uint64_t maxNs = 0;
+    };
+
+    // Per-stage latency histograms. Each recording thread owns a preallocated
+    // slot, so Record() takes no locks and performs no RMW operations. When
+    // disabled (the default) callers skip even the timestamp reads.
+    class Instrumentation
+    {
+    public:
+        static constexpr uint32_t MaxThreads = 32;
+
+        // Registers the ETW (TraceLogging) provider. Events are only produced
+        // while a trace session has the provider enabled.
+        static void Initialize() noexcept;
+        static void Shutdown() noexcept;
+
+        static bool Enabled() noexcept { return s_enabled.load(std::memory_order_relaxed); }
+        static void SetEnabled(bool enabled) noexcept { s_enabled.store(enabled, std::memory_order_relaxed); }
+
+        static int64_t Now() noexcept
+        {
+            LARGE_INTEGER counter;
+            QueryPerformanceCounter(&counter);
+            return counter.QuadPart;
+        }
+
+        // `ticks` are QueryPerformanceCounter units.
+        static void Record(LatencyStage stage, int64_t ticks) noexcept;
+
+        static LatencySummary Summarize(LatencyStage stage) noexcept;
+        static void Reset() noexcept;
+
+        static uint64_t TicksToNanoseconds(uint64_t ticks) noexcept;
+
+        // What Record() touches, for WorkingSet::Pin(): nothing while
+        // disabled, else the slots claimed so far.
+        static void AppendHotRanges(std::vector<MemoryRange>& ranges);
+
+    private:
+        static std::atomic<bool> s_enabled;
+    };
+}
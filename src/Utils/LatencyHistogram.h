@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+namespace khm
+{
+    // HDR-style log-linear histogram over unsigned tick counts: 32 linear
+    // sub-buckets per power of two, so any recorded value is reported within
+    // ~3%. Recording is wait-free for a single writer; readers may run
+    // concurrently on other threads and see a slightly stale view.
+    class LatencyHistogram
+    {
+    public:
+        static constexpr uint32_t SubBucketBits = 5;
+        static constexpr uint32_t SubBucketCount = 1u << SubBucketBits;
+        static constexpr uint32_t MaxValueBits = 36;
+        static constexpr uint32_t BucketCount = (MaxValueBits - SubBucketBits + 1) * SubBucketCount;
+
+        static constexpr uint32_t BucketFor(uint64_t value) noexcept
+        {
+            if (value < SubBucketCount)
+            {
+                return static_cast<uint32_t>(value);
+            }
+            uint32_t const width = std::min<uint32_t>(static_cast<uint32_t>(std::bit_width(value)), MaxValueBits);
+            uint32_t const shift = width - SubBucketBits - 1;
+            uint64_t const top = std::min<uint64_t>(value >> shift, 2 * SubBucketCount - 1);
+            return (shift + 1) * SubBucketCount + static_cast<uint32_t>(top - SubBucketCount);
+        }
+
+        // Upper bound of the values that land in `bucket`.
+        static constexpr uint64_t BucketUpperBound(uint32_t bucket) noexcept
+        {
+            if (bucket < SubBucketCount)
+            {
+                return bucket;
+            }
+            uint32_t const shift = bucket / SubBucketCount - 1;
+            uint64_t const top = SubBucketCount + bucket % SubBucketCount;
+            return ((top + 1) << shift) - 1;
+        }
+
+        // Single writer only.
+        void Record(uint64_t value) noexcept
+        {
+            auto& bucket = m_counts[BucketFor(value)];
+            bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            m_total.store(m_total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if (value > m_max.load(std::memory_order_relaxed))
+            {
+                m_max.store(value, std::memory_order_relaxed);
+            }
+        }
+
+        void Reset() noexcept
+        {
+            for (auto& count : m_counts)
+            {
+                count.store(0, std::memory_order_relaxed);
+            }
+            m_total.store(0, std::memory_order_relaxed);
+            m_max.store(0, std::memory_order_relaxed);
+        }
+
+        uint64_t Count(uint32_t bucket) const noexcept { return m_counts[bucket].load(std::memory_order_relaxed); }
+        uint64_t Total() const noexcept { return m_total.load(std::memory_order_relaxed); }
+        uint64_t Max() const noexcept { return m_max.load(std::memory_order_relaxed); }
+
+    private:
+        std::array<std::atomic<uint64_t>, BucketCount> m_counts{};
+        std::atomic<uint64_t> m_total{ 0 };
+        std::atomic<uint64_t> m_max{ 0 };
+    };
+
+    // Plain (non-atomic) merge target for one or more LatencyHistograms.
+    struct LatencyAccumulator
+    {
+        std::array<uint64_t, LatencyHistogram::BucketCount> counts{};
+        uint64_t total = 0;
+        uint64_t max = 0;
+
+        void Add(LatencyHistogram const& histogram) noexcept
+        {
+            for (uint32_t i = 0; i < LatencyHistogram::BucketCount; ++i)
+            {
+                uint64_t const count = histogram.Count(i);
+                counts[i] += count;
+                total += count;
+            }
+            max = std::max(max, histogram.Max());
+        }
+
+        // `quantile` in [0, 1]; returns ticks, clamped to the observed max.
+        uint64_t ValueAt(double quantile) const noexcept
+        {
+            if (total == 0)
+            {
+                return 0;
+            }
+            uint64_t const rank = std::max<uint64_t>(1, static_cast<uint64_t>(quantile * static_cast<double>(total) + 0.5));
+            uint64_t seen = 0;
+            for (uint32_t i = 0; i < LatencyHistogram::BucketCount; ++i)
+            {
+                seen += counts[i];
+                if (seen >= rank)
+                {
+                    return std::min(LatencyHistogram::BucketUpperBound(i), max);
+                }
+            }
+            return max;
+        }
+    };
+}
@@ -0,0 +1,418 @@
+#include "pch.h"
+#include "Utils/Logger.h"
+
+#include "Utils/Instrumentation.h"
+#include "Utils/SpscRing.h"
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace khm
+{
+    std::atomic<uint8_t> Logger::s_level{ static_cast<uint8_t>(LogLevel::Off) };
+
+    namespace
+    {
+        struct LogRecord
+        {
+            LogFormat const* format = nullptr;
+            int64_t timestamp = 0; // QueryPerformanceCounter units
+            uint32_t count = 0;
+            std::array<uint64_t, MaxLogArguments> arguments{};
+        };
+
+        // Owned by one thread at a time. A thread that exits retires its
+        // slot; the writer frees it once the ring is drained.
+        struct ThreadSlot
+        {
+            std::atomic<DWORD> owner{ 0 };
+            std::atomic<bool> retired{ false };
+            SpscRing<LogRecord, Logger::RingCapacity> ring;
+        };
+
+        // Zero-initialized like the instrumentation slots; a ring's pages
+        // are only committed once its thread logs.
+        ThreadSlot g_slots[Logger::MaxThreads];
+        std::atomic<uint64_t> g_unslotted{ 0 };
+
+        struct SlotLease
+        {
+            ThreadSlot* slot = nullptr;
+
+            ~SlotLease()
+            {
+                if (slot != nullptr)
+                {
+                    slot->retired.store(true, std::memory_order_release);
+                }
+            }
+        };
+
+        thread_local SlotLease t_lease;
+
+        char const* LevelName(LogLevel level) noexcept
+        {
+            switch (level)
+            {
+            case LogLevel::Debug: return "DEBUG";
+            case LogLevel::Info: return "INFO ";
+            case LogLevel::Warning: return "WARN ";
+            case LogLevel::Error: return "ERROR";
+            default: return "?    ";
+            }
+        }
+
+        void AppendNumber(std::string& out, uint64_t value, char spec)
+        {
+            char digits[24];
+            std::to_chars_result result{};
+            switch (spec)
+            {
+            case 'x':
+                out += "0x";
+                result = std::to_chars(digits, digits + sizeof(digits), value, 16);
+                break;
+            case 'i':
+                result = std::to_chars(digits, digits + sizeof(digits), static_cast<int64_t>(value));
+                break;
+            default:
+                result = std::to_chars(digits, digits + sizeof(digits), value);
+                break;
+            }
+            out.append(digits, result.ptr);
+        }
+
+        void AppendMessage(std::string& out, LogRecord const& record)
+        {
+            uint32_t next = 0;
+            for (char const* text = record.format->text; *text != '\0'; ++text)
+            {
+                if (*text == '{' && next < record.count)
+                {
+                    char const* const close = std::strchr(text, '}');
+                    if (close != nullptr && close - text <= 2)
+                    {
+                        AppendNumber(out, record.arguments[next++], close - text == 2 ? text[1] : '\0');
+                        text = close;
+                        continue;
+                    }
+                }
+                out += *text;
+            }
+        }
+
+        // Everything the background thread owns.
+        class LogWriter
+        {
+        public:
+            explicit LogWriter(std::filesystem::path path) :
+                m_path(std::move(path))
+            {
+                FILETIME now;
+                GetSystemTimePreciseAsFileTime(&now);
+                m_wallBase = (static_cast<int64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+                m_tickBase = Instrumentation::Now();
+                m_batch.reserve(Logger::RingCapacity);
+            }
+
+            void Run(HANDLE stop) noexcept
+            {
+                SetThreadDescription(GetCurrentThread(), L"khm.logger");
+                while (WaitForSingleObject(stop, Logger::FlushIntervalMs) == WAIT_TIMEOUT)
+                {
+                    Flush();
+                }
+                Flush();
+                WaitPending();
+            }
+
+        private:
+            struct Entry
+            {
+                LogRecord record;
+                DWORD threadId;
+            };
+
+            void Flush() noexcept
+            {
+                try
+                {
+                    Drain();
+                    uint64_t const dropped = Logger::Dropped();
+                    if (m_batch.empty() && dropped == m_reportedDrops)
+                    {
+                        return;
+                    }
+
+                    // Rings are per thread; the file reads in time order.
+                    std::ranges::stable_sort(m_batch, {}, [](Entry const& entry) { return entry.record.timestamp; });
+                    std::string& buffer = m_buffers[m_current];
+                    for (Entry const& entry : m_batch)
+                    {
+                        AppendLine(buffer, entry);
+                    }
+                    if (dropped != m_reportedDrops)
+                    {
+                        buffer += "-- ";
+                        AppendNumber(buffer, dropped - m_reportedDrops, '\0');
+                        buffer += " log records dropped\r\n";
+                        m_reportedDrops = dropped;
+                    }
+                    m_batch.clear();
+                    Write();
+                }
+                catch (...)
+                {
+                    m_batch.clear();
+                    m_buffers[m_current].clear();
+                }
+            }
+
+            void Drain()
+            {
+                for (ThreadSlot& slot : g_slots)
+                {
+                    DWORD const owner = slot.owner.load(std::memory_order_acquire);
+                    if (owner == 0)
+                    {
+                        continue;
+                    }
+                    // Read before draining: a retired thread has pushed its last record.
+                    bool const retired = slot.retired.load(std::memory_order_acquire);
+                    LogRecord record;
+                    while (slot.ring.TryPop(record))
+                    {
+                        m_batch.push_back({ record, owner });
+                    }
+                    if (retired)
+                    {
+                        slot.retired.store(false, std::memory_order_relaxed);
+                        slot.owner.store(0, std::memory_order_release);
+                    }
+                }
+            }
+
+            void AppendLine(std::string& out, Entry const& entry)
+            {
+                int64_t const ticks = entry.record.timestamp - m_tickBase;
+                int64_t const offset = ticks >= 0
+                    ? static_cast<int64_t>(Instrumentation::TicksToNanoseconds(static_cast<uint64_t>(ticks)) / 100)
+                    : -static_cast<int64_t>(Instrumentation::TicksToNanoseconds(static_cast<uint64_t>(-ticks)) / 100);
+                uint64_t const wall = static_cast<uint64_t>(m_wallBase + offset);
+
+                FILETIME const fileTime{ static_cast<DWORD>(wall), static_cast<DWORD>(wall >> 32) };
+                SYSTEMTIME utc{};
+                FileTimeToSystemTime(&fileTime, &utc);
+
+                char prefix[80];
+                int const length = std::snprintf(prefix, sizeof(prefix), "%04u-%02u-%02uT%02u:%02u:%02u.%06uZ %5lu %s ",
+                    utc.wYear, utc.wMonth, utc.wDay, utc.wHour, utc.wMinute, utc.wSecond,
+                    static_cast<unsigned>(wall % 10'000'000 / 10), static_cast<unsigned long>(entry.threadId),
+                    LevelName(entry.record.format->level));
+                out.append(prefix, static_cast<size_t>(std::max(length, 0)));
+                AppendMessage(out, entry.record);
+                out += "\r\n";
+            }
+
+            // Formats the next batch while the previous one is still being
+            // written; the buffers swap once a write has been issued.
+            void Write()
+            {
+                std::string& buffer = m_buffers[m_current];
+                WaitPending();
+                if (!m_file && !Open())
+                {
+                    buffer.clear();
+                    return;
+                }
+                if (m_size != 0 && m_size + buffer.size() > Logger::MaxFileBytes && !Rotate())
+                {
+                    buffer.clear();
+                    return;
+                }
+
+                m_overlapped = {};
+                m_overlapped.Offset = static_cast<DWORD>(m_size);
+                m_overlapped.OffsetHigh = static_cast<DWORD>(m_size >> 32);
+                if (!WriteFile(m_file.get(), buffer.data(), static_cast<DWORD>(buffer.size()), nullptr, &m_overlapped)
+                    && GetLastError() != ERROR_IO_PENDING)
+                {
+                    OutputDebugStringA("KeyboardHookManager: log write failed\n");
+                    buffer.clear();
+                    return;
+                }
+                m_pending = true;
+                m_size += buffer.size();
+                m_current ^= 1;
+                m_buffers[m_current].clear();
+            }
+
+            void WaitPending() noexcept
+            {
+                if (m_pending)
+                {
+                    DWORD written = 0;
+                    GetOverlappedResult(m_file.get(), &m_overlapped, &written, TRUE);
+                    m_pending = false;
+                }
+            }
+
+            bool Open() noexcept
+            {
+                m_file.attach(CreateFileW(m_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                    OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr));
+                LARGE_INTEGER size{};
+                if (!m_file || !GetFileSizeEx(m_file.get(), &size))
+                {
+                    OutputDebugStringA("KeyboardHookManager: log file unavailable\n");
+                    m_file.close();
+                    return false;
+                }
+                m_size = static_cast<uint64_t>(size.QuadPart);
+                return true;
+            }
+
+            bool Rotate() noexcept
+            {
+                WaitPending();
+                m_file.close();
+                try
+                {
+                    // <log>.1 -> <log>.2, ..., then <log> -> <log>.1.
+                    for (uint32_t i = Logger::RotatedFiles; i > 0; --i)
+                    {
+                        std::filesystem::path from = m_path;
+                        if (i > 1)
+                        {
+                            from += L"." + std::to_wstring(i - 1);
+                        }
+                        std::filesystem::path to = m_path;
+                        to += L"." + std::to_wstring(i);
+                        MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING);
+                    }
+                }
+                catch (...)
+                {
+                    // Keeps appending to the current file.
+                }
+                return Open();
+            }
+
+            std::filesystem::path m_path;
+            winrt::file_handle m_file;
+            OVERLAPPED m_overlapped{};
+            bool m_pending = false;
+            uint64_t m_size = 0;
+
+            std::array<std::string, 2> m_buffers;
+            uint32_t m_current = 0;
+            std::vector<Entry> m_batch;
+            uint64_t m_reportedDrops = 0;
+
+            int64_t m_wallBase = 0; // FILETIME at m_tickBase
+            int64_t m_tickBase = 0;
+        };
+
+        // Main thread only.
+        std::unique_ptr<LogWriter> g_writer;
+        std::thread g_thread;
+        winrt::handle g_stop;
+    }
+
+    void Logger::Start(std::filesystem::path path)
+    {
+        if (g_thread.joinable())
+        {
+            return;
+        }
+        g_stop = winrt::handle(winrt::check_pointer(CreateEventW(nullptr, TRUE, FALSE, nullptr)));
+        g_writer = std::make_unique<LogWriter>(std::move(path));
+        g_thread = std::thread([writer = g_writer.get(), stop = g_stop.get()] { writer->Run(stop); });
+    }
+
+    void Logger::Stop() noexcept
+    {
+        if (!g_thread.joinable())
+        {
+            return;
+        }
+        SetEvent(g_stop.get());
+        g_thread.join();
+        g_writer.reset();
+        g_stop.close();
+    }
+
+    // Write() runs on the hook and executor threads, and stays locked in
+    // memory with them while the process is trimmed (see WorkingSet).
+#pragma code_seg(push, ".text$khm_hot")
+
+    namespace
+    {
+        ThreadSlot* ClaimSlot() noexcept
+        {
+            DWORD const self = GetCurrentThreadId();
+            for (ThreadSlot& slot : g_slots)
+            {
+                DWORD expected = 0;
+                if (slot.owner.compare_exchange_strong(expected, self, std::memory_order_acq_rel))
+                {
+                    return &slot;
+                }
+            }
+            return nullptr;
+        }
+    }
+
+    void Logger::Write(LogFormat const& format, std::array<uint64_t, MaxLogArguments> const& arguments, uint32_t count) noexcept
+    {
+        ThreadSlot* slot = t_lease.slot;
+        if (slot == nullptr)
+        {
+            slot = t_lease.slot = ClaimSlot();
+            if (slot == nullptr)
+            {
+                g_unslotted.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        slot->ring.TryEnqueue(LogRecord{ &format, Instrumentation::Now(), count, arguments });
+    }
+
+#pragma code_seg(pop)
+
+    uint64_t Logger::Dropped() noexcept
+    {
+        uint64_t dropped = g_unslotted.load(std::memory_order_relaxed);
+        for (ThreadSlot const& slot : g_slots)
+        {
+            dropped += slot.ring.Dropped();
+        }
+        return dropped;
+    }
+
+    void Logger::AppendHotRanges(std::vector<MemoryRange>& ranges)
+    {
+        if (Level() == LogLevel::Off)
+        {
+            return;
+        }
+        ranges.push_back({ &s_level, sizeof(s_level) });
+        ranges.push_back({ &g_unslotted, sizeof(g_unslotted) });
+        for (ThreadSlot const& slot : g_slots)
+        {
+            if (slot.owner.load(std::memory_order_acquire) != 0)
+            {
+                ranges.push_back({ &slot, sizeof(slot) });
+            }
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Utils/WorkingSet.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <type_traits>
+#include <vector>
+
+namespace khm
+{
+    enum class LogLevel : uint8_t
+    {
+        Debug,
+        Info,
+        Warning,
+        Error,
+        Off,
+    };
+
+    // What a call site logs: a level and a message with "{}" (unsigned),
+    // "{i}" (signed) or "{x}" (hex) placeholders. Defined as a constexpr
+    // at namespace scope, so its address identifies the message in a record.
+    struct LogFormat
+    {
+        LogLevel level;
+        char const* text;
+    };
+
+    inline constexpr uint32_t MaxLogArguments = 4;
+
+    // Binary log records in per-thread rings, formatted and written by one
+    // background thread in batches to a rotating file. Logging thread never
+    // formats, allocates, locks or blocks: it copies a pointer, a timestamp
+    // and up to four integers, and a full ring drops the record. A disabled
+    // level costs the single branch in Log().
+    class Logger
+    {
+    public:
+        static constexpr uint32_t MaxThreads = 32;
+        static constexpr uint32_t RingCapacity = 512;
+        static constexpr uint32_t FlushIntervalMs = 250;
+        static constexpr uint64_t MaxFileBytes = 4ull << 20;
+        static constexpr uint32_t RotatedFiles = 2; // <log>.1 and <log>.2
+
+        // The file is only created once a record arrives.
+        static void Start(std::filesystem::path path);
+        static void Stop() noexcept;
+
+        static LogLevel Level() noexcept { return static_cast<LogLevel>(s_level.load(std::memory_order_relaxed)); }
+        static void SetLevel(LogLevel level) noexcept { s_level.store(static_cast<uint8_t>(level), std::memory_order_relaxed); }
+
+        static bool IsEnabled(LogLevel level) noexcept
+        {
+            return static_cast<uint8_t>(level) >= s_level.load(std::memory_order_relaxed);
+        }
+
+        static void Write(LogFormat const& format, std::array<uint64_t, MaxLogArguments> const& arguments, uint32_t count) noexcept;
+
+        // Records lost to full rings or threads beyond MaxThreads.
+        static uint64_t Dropped() noexcept;
+
+        // What Write() touches, for WorkingSet::Pin(): nothing while
+        // logging is off, else the rings claimed so far.
+        static void AppendHotRanges(std::vector<MemoryRange>& ranges);
+
+    private:
+        static std::atomic<uint8_t> s_level;
+    };
+
+    template <typename... Args>
+    inline void Log(LogFormat const& format, Args... arguments) noexcept
+    {
+        static_assert(sizeof...(Args) <= MaxLogArguments, "too many log arguments");
+        static_assert((std::is_integral_v<Args> && ...), "log arguments are integers; format on the reader's side");
+        if (Logger::IsEnabled(format.level)) [[unlikely]]
+        {
+            Logger::Write(format, { static_cast<uint64_t>(arguments)... }, sizeof...(Args));
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#include "pch.h"
+#include "Utils/MappedFile.h"
+
+#include <utility>
+
+namespace khm
+{
+    MappedFile::MappedFile(std::filesystem::path const& path)
+    {
+        winrt::file_handle file{ CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+        if (!file)
+        {
+            winrt::throw_last_error();
+        }
+
+        LARGE_INTEGER size;
+        winrt::check_bool(GetFileSizeEx(file.get(), &size));
+        winrt::check_bool(GetFileTime(file.get(), nullptr, nullptr, &m_lastWrite));
+        if (size.QuadPart == 0)
+        {
+            return;
+        }
+
+        // The view keeps the section (and file) alive after both handles close.
+        winrt::handle mapping{ CreateFileMappingW(file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr) };
+        if (!mapping)
+        {
+            winrt::throw_last_error();
+        }
+        m_view = MapViewOfFile(mapping.get(), FILE_MAP_READ, 0, 0, 0);
+        if (m_view == nullptr)
+        {
+            winrt::throw_last_error();
+        }
+        m_size = static_cast<size_t>(size.QuadPart);
+    }
+
+    MappedFile::~MappedFile()
+    {
+        Reset();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept :
+        m_view(std::exchange(other.m_view, nullptr)),
+        m_size(std::exchange(other.m_size, 0)),
+        m_lastWrite(other.m_lastWrite)
+    {
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            m_view = std::exchange(other.m_view, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+            m_lastWrite = other.m_lastWrite;
+        }
+        return *this;
+    }
+
+    void MappedFile::Reset() noexcept
+    {
+        if (m_view != nullptr)
+        {
+            UnmapViewOfFile(m_view);
+            m_view = nullptr;
+            m_size = 0;
+        }
+    }
+}
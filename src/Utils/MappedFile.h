@@ -0,0 +1,39 @@
+#pragma once
+
+#include <windows.h>
+#include <winrt/base.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+namespace khm
+{
+    // Read-only view of a whole file. Throws winrt::hresult_error when the
+    // file cannot be opened or mapped; an empty file maps to an empty view.
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        explicit MappedFile(std::filesystem::path const& path);
+        ~MappedFile();
+
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        std::span<std::byte const> Bytes() const noexcept { return { static_cast<std::byte const*>(m_view), m_size }; }
+        std::string_view Text() const noexcept { return { static_cast<char const*>(m_view), m_size }; }
+        size_t Size() const noexcept { return m_size; }
+
+        FILETIME LastWriteTime() const noexcept { return m_lastWrite; }
+
+    private:
+        void Reset() noexcept;
+
+        void const* m_view = nullptr;
+        size_t m_size = 0;
+        FILETIME m_lastWrite{};
+    };
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace khm
+{
+    // Read-copy-update cell for data read on latency-critical threads.
+    // Readers never block and never touch a lock; Publish() swaps the pointer
+    // and waits (on the writer's thread) until no reader can still be using
+    // the previous value before handing it back.
+    //
+    // Each reading thread registers once and then brackets its accesses with
+    // Reader::Lock()/Unlock() (or RcuReadGuard).
+    template <typename T>
+    class RcuPointer
+    {
+    public:
+        static constexpr uint32_t MaxReaders = 16;
+
+        class Reader
+        {
+        public:
+            T const* Lock() noexcept
+            {
+                m_epoch->store(m_owner->m_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+                return m_owner->m_current.load(std::memory_order_seq_cst);
+            }
+
+            void Unlock() noexcept
+            {
+                m_epoch->store(0, std::memory_order_release);
+            }
+
+        private:
+            friend class RcuPointer;
+            RcuPointer* m_owner = nullptr;
+            std::atomic<uint64_t>* m_epoch = nullptr;
+        };
+
+        explicit RcuPointer(std::unique_ptr<T> initial) noexcept :
+            m_current(initial.release())
+        {
+        }
+
+        ~RcuPointer()
+        {
+            delete m_current.load(std::memory_order_relaxed);
+        }
+
+        RcuPointer(RcuPointer const&) = delete;
+        RcuPointer& operator=(RcuPointer const&) = delete;
+
+        // Call during setup, before the reading thread starts.
+        Reader& RegisterReader()
+        {
+            std::scoped_lock lock(m_writerLock);
+            if (m_readerCount == MaxReaders)
+            {
+                throw std::length_error("too many RCU readers");
+            }
+            Reader& reader = m_readers[m_readerCount];
+            reader.m_owner = this;
+            reader.m_epoch = &m_readerEpochs[m_readerCount];
+            ++m_readerCount;
+            return reader;
+        }
+
+        // Writer-side view; stable until the next Publish() by the same writer.
+        T const* Current() const noexcept
+        {
+            return m_current.load(std::memory_order_acquire);
+        }
+
+        std::unique_ptr<T> Publish(std::unique_ptr<T> next)
+        {
+            std::scoped_lock lock(m_writerLock);
+            std::unique_ptr<T> previous{ m_current.exchange(next.release(), std::memory_order_seq_cst) };
+            uint64_t const epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+            // Readers on the executor may sit inside a slow action, so back off
+            // to sleeping rather than spinning for long.
+            for (uint32_t i = 0; i < m_readerCount; ++i)
+            {
+                for (uint32_t spins = 0;; ++spins)
+                {
+                    uint64_t const seen = m_readerEpochs[i].load(std::memory_order_seq_cst);
+                    if (seen == 0 || seen >= epoch)
+                    {
+                        break;
+                    }
+                    if (spins < 64)
+                    {
+                        std::this_thread::yield();
+                    }
+                    else
+                    {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    }
+                }
+            }
+            return previous;
+        }
+
+    private:
+        std::atomic<T*> m_current;
+        std::atomic<uint64_t> m_epoch{ 1 };
+        std::array<std::atomic<uint64_t>, MaxReaders> m_readerEpochs{};
+        std::array<Reader, MaxReaders> m_readers{};
+        uint32_t m_readerCount = 0;
+        std::mutex m_writerLock;
+    };
+
+    template <typename T>
+    class RcuReadGuard
+    {
+    public:
+        explicit RcuReadGuard(typename RcuPointer<T>::Reader& reader) noexcept :
+            m_reader(reader),
+            m_value(reader.Lock())
+        {
+        }
+
+        ~RcuReadGuard() { m_reader.Unlock(); }
+
+        RcuReadGuard(RcuReadGuard const&) = delete;
+        RcuReadGuard& operator=(RcuReadGuard const&) = delete;
+
+        T const* get() const noexcept { return m_value; }
+        T const* operator->() const noexcept { return m_value; }
+
+    private:
+        typename RcuPointer<T>::Reader& m_reader;
+        T const* m_value;
+    };
+}
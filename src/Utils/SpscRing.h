@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace khm
+{
+    inline constexpr size_t CacheLineSize = 64;
+
+    // Bounded single-producer/single-consumer ring. Storage is inline, so
+    // pushes never allocate; a full ring drops the item and counts it.
+    template <typename T, size_t Capacity>
+    class SpscRing
+    {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+        static_assert(std::is_trivially_copyable_v<T>);
+
+    public:
+        static constexpr size_t Size = Capacity;
+
+        // Producer side.
+        bool TryPush(T const& item) noexcept
+        {
+            if (!TryEnqueue(item))
+            {
+                return false;
+            }
+            Wake();
+            return true;
+        }
+
+        // Producer side, for consumers that poll: does not wake them.
+        bool TryEnqueue(T const& item) noexcept
+        {
+            uint64_t const head = m_head.load(std::memory_order_relaxed);
+            if (head - m_producerTailCache == Capacity)
+            {
+                m_producerTailCache = m_tail.load(std::memory_order_acquire);
+                if (head - m_producerTailCache == Capacity)
+                {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+            m_items[head & Mask] = item;
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side.
+        bool TryPop(T& item) noexcept
+        {
+            uint64_t const tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_consumerHeadCache)
+            {
+                m_consumerHeadCache = m_head.load(std::memory_order_acquire);
+                if (tail == m_consumerHeadCache)
+                {
+                    return false;
+                }
+            }
+            item = m_items[tail & Mask];
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side. Take a ticket before draining, then Wait(ticket):
+        // any push or Wake() after the ticket was taken ends the wait.
+        uint32_t WaitTicket() const noexcept
+        {
+            return m_signal.load(std::memory_order_acquire);
+        }
+
+        void Wait(uint32_t ticket) const noexcept
+        {
+            m_signal.wait(ticket, std::memory_order_acquire);
+        }
+
+        // Also used to unblock the consumer for shutdown.
+        void Wake() noexcept
+        {
+            m_signal.fetch_add(1, std::memory_order_release);
+            m_signal.notify_one();
+        }
+
+        uint64_t Dropped() const noexcept { return m_dropped.load(std::memory_order_relaxed); }
+        uint64_t Pushed() const noexcept { return m_head.load(std::memory_order_relaxed); }
+
+    private:
+        static constexpr uint64_t Mask = Capacity - 1;
+
+        alignas(CacheLineSize) std::atomic<uint64_t> m_head{ 0 };
+        uint64_t m_producerTailCache = 0;
+        std::atomic<uint64_t> m_dropped{ 0 };
+
+        alignas(CacheLineSize) std::atomic<uint64_t> m_tail{ 0 };
+        uint64_t m_consumerHeadCache = 0;
+
+        alignas(CacheLineSize) std::atomic<uint32_t> m_signal{ 0 };
+
+        alignas(CacheLineSize) std::array<T, Capacity> m_items{};
+    };
+}
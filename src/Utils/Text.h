@@ -0,0 +1,22 @@
+#pragma once
+
+#include <windows.h>
+
+#include <string>
+#include <string_view>
+
+namespace khm
+{
+    // UTF-8 from the configuration to UTF-16 for Win32 and the UI.
+    inline std::wstring Widen(std::string_view text)
+    {
+        std::wstring wide;
+        if (!text.empty())
+        {
+            int const length = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+            wide.resize(static_cast<size_t>(length));
+            MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), wide.data(), length);
+        }
+        return wide;
+    }
+}
@@ -0,0 +1,32 @@
+#include "pch.h"
+#include "Utils/ThreadQos.h"
+
+namespace khm
+{
+    namespace
+    {
+        void SetThrottling(bool throttled) noexcept
+        {
+            // ControlMask set with StateMask clear means never throttle; both
+            // set means always. Fails harmlessly before Windows 10 1709.
+            THREAD_POWER_THROTTLING_STATE state{};
+            state.Version = THREAD_POWER_THROTTLING_CURRENT_VERSION;
+            state.ControlMask = THREAD_POWER_THROTTLING_EXECUTION_SPEED;
+            state.StateMask = throttled ? THREAD_POWER_THROTTLING_EXECUTION_SPEED : 0;
+            SetThreadInformation(GetCurrentThread(), ThreadPowerThrottling, &state, sizeof(state));
+        }
+    }
+
+    void ThreadQos::DisableThrottling() noexcept
+    {
+        SetThrottling(false);
+    }
+
+    void ThreadQos::SetBackground(bool background) noexcept
+    {
+        // Background mode also lowers the priority; ending it restores the
+        // one set before it began.
+        SetThreadPriority(GetCurrentThread(), background ? THREAD_MODE_BACKGROUND_BEGIN : THREAD_MODE_BACKGROUND_END);
+        SetThrottling(background);
+    }
+}
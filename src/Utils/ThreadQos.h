@@ -0,0 +1,23 @@
+#pragma once
+
+#include <windows.h>
+
+namespace khm
+{
+    // Scheduling of the calling thread beyond its priority. Windows 11
+    // puts the threads of a process without a visible window on EcoQoS
+    // (efficiency cores, lowered clocks) unless they opt out, and ranks them
+    // after foreground work under CPU load.
+    class ThreadQos
+    {
+    public:
+        // Opts out of power throttling for good: the thread always runs at
+        // full speed, as the foreground app's do. For the threads a keystroke
+        // waits on.
+        static void DisableThrottling() noexcept;
+
+        // Background: low CPU, I/O and memory priority, and EcoQoS. Normal
+        // restores the default priority and opts out of throttling again.
+        static void SetBackground(bool background) noexcept;
+    };
+}
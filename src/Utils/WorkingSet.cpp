@@ -0,0 +1,201 @@
+#include "pch.h"
+#include "Utils/WorkingSet.h"
+
+#include <psapi.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+// The linker merges the ".text$" groups into .text ordered by suffix, so the
+// functions compiled under `#pragma code_seg(".text$khm_hot")` end up
+// between these two markers.
+#pragma section(".text$khm_0", read, execute)
+#pragma section(".text$khm_z", read, execute)
+
+namespace khm
+{
+    namespace
+    {
+        constexpr uintptr_t PageSize = 4096;
+
+        // Locking is charged against the minimum working set; a little on
+        // top keeps the pages the thread is touching at the time unlocked.
+        constexpr SIZE_T LockSlack = 64 * 1024;
+
+        __declspec(allocate(".text$khm_0")) unsigned char const g_hotCodeBegin[1] = { 0xCC };
+        __declspec(allocate(".text$khm_z")) unsigned char const g_hotCodeEnd[1] = { 0xCC };
+
+        std::mutex g_lock;
+        std::vector<MemoryRange> g_pinned; // page aligned and disjoint, as locked; guarded by g_lock
+        size_t g_pinnedBytes = 0;          // guarded by g_lock
+        size_t g_stackBytes = 0;           // guarded by g_lock
+        SIZE_T g_baseMinimum = 0;          // before anything was locked; guarded by g_lock
+        std::atomic<uint64_t> g_trims{ 0 };
+
+        MemoryRange PageAligned(MemoryRange range) noexcept
+        {
+            uintptr_t const begin = reinterpret_cast<uintptr_t>(range.base) & ~(PageSize - 1);
+            uintptr_t const end = (reinterpret_cast<uintptr_t>(range.base) + range.bytes + PageSize - 1) & ~(PageSize - 1);
+            return { reinterpret_cast<void const*>(begin), end - begin };
+        }
+
+        uintptr_t End(MemoryRange range) noexcept
+        {
+            return reinterpret_cast<uintptr_t>(range.base) + range.bytes;
+        }
+
+        // Caller holds g_lock.
+        void ReserveLockQuota(size_t locked) noexcept
+        {
+            SIZE_T minimum = 0;
+            SIZE_T maximum = 0;
+            DWORD flags = 0;
+            HANDLE const process = GetCurrentProcess();
+            if (!GetProcessWorkingSetSizeEx(process, &minimum, &maximum, &flags))
+            {
+                return;
+            }
+            if (g_baseMinimum == 0)
+            {
+                g_baseMinimum = minimum;
+            }
+            // Soft limits: the minimum only sets how much may be locked.
+            SIZE_T const wanted = g_baseMinimum + locked + LockSlack;
+            SetProcessWorkingSetSizeEx(process, wanted, std::max(maximum, wanted + LockSlack),
+                QUOTA_LIMITS_HARDWS_MIN_DISABLE | QUOTA_LIMITS_HARDWS_MAX_DISABLE);
+        }
+
+        // A frame this large makes the compiler probe each of its pages,
+        // which commits the stack down to below where the caller's loop and
+        // everything it calls will run.
+        __declspec(noinline) MemoryRange CommitStackTop() noexcept
+        {
+            volatile unsigned char frame[WorkingSet::PinnedStack::Bytes];
+            frame[0] = 0;
+            ULONG_PTR low = 0;
+            ULONG_PTR high = 0;
+            GetCurrentThreadStackLimits(&low, &high);
+            uintptr_t const bottom = reinterpret_cast<uintptr_t>(&frame[0]) & ~(PageSize - 1);
+            return { reinterpret_cast<void const*>(bottom), high - bottom };
+        }
+    }
+
+    WorkingSet::PinnedStack::PinnedStack() noexcept :
+        m_range(CommitStackTop())
+    {
+        std::scoped_lock lock(g_lock);
+        ReserveLockQuota(g_pinnedBytes + g_stackBytes + m_range.bytes);
+        if (!VirtualLock(const_cast<void*>(m_range.base), m_range.bytes))
+        {
+            m_range = {};
+            return;
+        }
+        g_stackBytes += m_range.bytes;
+    }
+
+    WorkingSet::PinnedStack::~PinnedStack()
+    {
+        if (m_range.bytes == 0)
+        {
+            return;
+        }
+        std::scoped_lock lock(g_lock);
+        VirtualUnlock(const_cast<void*>(m_range.base), m_range.bytes);
+        g_stackBytes -= m_range.bytes;
+    }
+
+    void WorkingSet::Pin(std::span<MemoryRange const> ranges) noexcept
+    {
+        std::vector<MemoryRange> pages;
+        try
+        {
+            pages.reserve(ranges.size() + 1);
+            pages.push_back(PageAligned({ g_hotCodeBegin, static_cast<size_t>(g_hotCodeEnd + 1 - g_hotCodeBegin) }));
+            for (MemoryRange const& range : ranges)
+            {
+                if (range.bytes != 0)
+                {
+                    pages.push_back(PageAligned(range));
+                }
+            }
+        }
+        catch (...)
+        {
+            return;
+        }
+
+        // Disjoint, so that unlocking one range never unlocks another's page.
+        std::ranges::sort(pages, {}, [](MemoryRange const& range) { return reinterpret_cast<uintptr_t>(range.base); });
+        size_t merged = 0;
+        for (size_t i = 1; i < pages.size(); ++i)
+        {
+            MemoryRange& last = pages[merged];
+            if (reinterpret_cast<uintptr_t>(pages[i].base) <= End(last))
+            {
+                last.bytes = std::max(End(last), End(pages[i])) - reinterpret_cast<uintptr_t>(last.base);
+            }
+            else
+            {
+                pages[++merged] = pages[i];
+            }
+        }
+        pages.resize(merged + 1);
+
+        std::scoped_lock lock(g_lock);
+        // Old ranges may have been freed, and even reused, since; unlocking
+        // them all first means no page of a new range is left unlocked.
+        for (MemoryRange const& range : g_pinned)
+        {
+            VirtualUnlock(const_cast<void*>(range.base), range.bytes);
+        }
+
+        size_t bytes = 0;
+        for (MemoryRange const& range : pages)
+        {
+            bytes += range.bytes;
+        }
+        ReserveLockQuota(bytes + g_stackBytes);
+
+        g_pinnedBytes = 0;
+        std::erase_if(pages, [](MemoryRange const& range) { return !VirtualLock(const_cast<void*>(range.base), range.bytes); });
+        for (MemoryRange const& range : pages)
+        {
+            g_pinnedBytes += range.bytes;
+        }
+        g_pinned = std::move(pages);
+    }
+
+    void WorkingSet::Trim() noexcept
+    {
+        // Freed blocks, such as a reload's parse buffers, stay committed in
+        // their heap until compacted.
+        HANDLE heaps[64];
+        DWORD const count = GetProcessHeaps(ARRAYSIZE(heaps), heaps);
+        for (DWORD i = 0; i < std::min<DWORD>(count, ARRAYSIZE(heaps)); ++i)
+        {
+            HeapCompact(heaps[i], 0);
+        }
+        EmptyWorkingSet(GetCurrentProcess());
+        g_trims.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ResidentMemory WorkingSet::Query() noexcept
+    {
+        ResidentMemory memory;
+        PROCESS_MEMORY_COUNTERS_EX counters{};
+        counters.cb = sizeof(counters);
+        if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters)))
+        {
+            memory.workingSetBytes = counters.WorkingSetSize;
+            memory.peakWorkingSetBytes = counters.PeakWorkingSetSize;
+            memory.privateBytes = counters.PrivateUsage;
+        }
+        {
+            std::scoped_lock lock(g_lock);
+            memory.pinnedBytes = g_pinnedBytes + g_stackBytes;
+        }
+        memory.trims = g_trims.load(std::memory_order_relaxed);
+        return memory;
+    }
+}
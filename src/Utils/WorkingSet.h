@@ -0,0 +1,62 @@
+#pragma once
+
+#include <windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace khm
+{
+    struct MemoryRange
+    {
+        void const* base = nullptr;
+        size_t bytes = 0;
+    };
+
+    struct ResidentMemory
+    {
+        uint64_t workingSetBytes = 0;
+        uint64_t peakWorkingSetBytes = 0;
+        uint64_t privateBytes = 0; // commit charge
+        uint64_t pinnedBytes = 0;  // locked by Pin() and PinnedStack
+        uint64_t trims = 0;
+    };
+
+    // Keeps the resident process small while it sits idle, without letting
+    // the first hotkey afterwards page-fault. The pages the hot path touches
+    // (the pinned ranges, the functions compiled into the ".text$khm_hot"
+    // code section and the key threads' stacks) are locked into the working
+    // set; Trim() releases everything else. Any thread.
+    class WorkingSet
+    {
+    public:
+        // Locks the top of the constructing thread's stack until it is
+        // destroyed; construct it at the start of a hot thread's entry point.
+        class PinnedStack
+        {
+        public:
+            static constexpr size_t Bytes = 32 * 1024;
+
+            PinnedStack() noexcept;
+            ~PinnedStack();
+
+            PinnedStack(PinnedStack const&) = delete;
+            PinnedStack& operator=(PinnedStack const&) = delete;
+
+        private:
+            MemoryRange m_range;
+        };
+
+        // Replaces the previously pinned ranges with `ranges`; the hot code
+        // section is always pinned. The minimum working set grows to cover
+        // what is locked. Ranges may overlap and need not be page aligned.
+        static void Pin(std::span<MemoryRange const> ranges) noexcept;
+
+        // Returns freed heap memory to the system and empties the working
+        // set; pinned pages stay resident.
+        static void Trim() noexcept;
+
+        static ResidentMemory Query() noexcept;
+    };
+}
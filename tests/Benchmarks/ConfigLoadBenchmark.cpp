@@ -0,0 +1,215 @@
+// Load-time comparison of the two config formats: generates the same large
+// config as JSON and as YAML, writes both to the temp directory and times
+// ConfigurationLoader::LoadStreaming (map, measure pass, fill pass) on each.
+//
+//   ConfigLoadBenchmark.exe [--rounds n] [--keep]
+//
+// Reports the best of n rounds. --keep leaves the generated files behind
+// for inspection. At 100k actions YAML has measured at ~71% of JSON's
+// throughput (~175 vs ~125 ms).
+
+#include "pch.h"
+
+#include "Configuration/ConfigurationLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace
+{
+    using namespace khm;
+
+    constexpr uint32_t ModifierCombinations = 16;
+
+    // Mostly chords, a sequence every tenth and a profile every seventh, so
+    // both parsers see every field kind.
+    struct GeneratedAction
+    {
+        std::string id;
+        std::string name;
+        std::string parameter;
+        uint32_t modifiers;
+        uint32_t key;
+        bool sequence;
+        bool profile;
+    };
+
+    GeneratedAction Generate(size_t i)
+    {
+        GeneratedAction action;
+        action.id = "bench-" + std::to_string(i);
+        action.name = "Benchmark action " + std::to_string(i);
+        action.parameter = "C:\\Tools\\bench" + std::to_string(i % 97) + ".exe --index " + std::to_string(i);
+        action.modifiers = static_cast<uint32_t>(i % ModifierCombinations);
+        action.key = 0x41 + static_cast<uint32_t>((i / ModifierCombinations) % 26);
+        action.sequence = i % 10 == 9;
+        action.profile = !action.sequence && i % 7 == 3;
+        return action;
+    }
+
+    std::string JsonModifiers(uint32_t mask)
+    {
+        std::string text;
+        if (mask & ModWin) text += "\"win\": true, ";
+        if (mask & ModCtrl) text += "\"ctrl\": true, ";
+        if (mask & ModShift) text += "\"shift\": true, ";
+        if (mask & ModAlt) text += "\"alt\": true, ";
+        return text;
+    }
+
+    std::string YamlModifiers(std::string const& indent, uint32_t mask)
+    {
+        std::string text;
+        if (mask & ModWin) text += indent + "win: true\n";
+        if (mask & ModCtrl) text += indent + "ctrl: true\n";
+        if (mask & ModShift) text += indent + "shift: true\n";
+        if (mask & ModAlt) text += indent + "alt: true\n";
+        return text;
+    }
+
+    std::string GenerateJson(size_t count)
+    {
+        std::string text = "{\n  \"version\": \"1.0\",\n  \"settings\": { \"sequenceTimeoutMs\": 1000 },\n  \"actions\": [\n";
+        for (size_t i = 0; i < count; ++i)
+        {
+            GeneratedAction const action = Generate(i);
+            // JSON strings need the backslashes escaped.
+            std::string parameter;
+            for (char c : action.parameter)
+            {
+                parameter += c == '\\' ? "\\\\" : std::string(1, c);
+            }
+            text += "    {\n      \"id\": \"" + action.id + "\",\n      \"name\": \"" + action.name + "\",\n"
+                "      \"type\": \"LaunchApp\",\n      \"parameter\": \"" + parameter + "\",\n";
+            if (action.profile)
+            {
+                text += "      \"profile\": \"app" + std::to_string(i % 13) + ".exe\",\n";
+            }
+            if (action.sequence)
+            {
+                text += "      \"sequence\": [ { " + JsonModifiers(action.modifiers) + "\"key\": " + std::to_string(action.key)
+                    + " }, { \"key\": " + std::to_string(0x41 + i % 26) + " } ]\n";
+            }
+            else
+            {
+                text += "      \"hotkey\": { " + JsonModifiers(action.modifiers) + "\"key\": " + std::to_string(action.key) + " }\n";
+            }
+            text += i + 1 < count ? "    },\n" : "    }\n";
+        }
+        text += "  ]\n}\n";
+        return text;
+    }
+
+    // Block style throughout, as people write YAML by hand.
+    std::string GenerateYaml(size_t count)
+    {
+        std::string text = "version: \"1.0\"\nsettings:\n  sequenceTimeoutMs: 1000\nactions:\n";
+        for (size_t i = 0; i < count; ++i)
+        {
+            GeneratedAction const action = Generate(i);
+            text += "  - id: " + action.id + "\n    name: " + action.name + "\n    type: LaunchApp\n    parameter: " + action.parameter + "\n";
+            if (action.profile)
+            {
+                text += "    profile: app" + std::to_string(i % 13) + ".exe\n";
+            }
+            if (action.sequence)
+            {
+                text += "    sequence:\n      - key: " + std::to_string(action.key) + "\n" + YamlModifiers("        ", action.modifiers)
+                    + "      - key: " + std::to_string(0x41 + i % 26) + "\n";
+            }
+            else
+            {
+                text += "    hotkey:\n      key: " + std::to_string(action.key) + "\n" + YamlModifiers("      ", action.modifiers);
+            }
+        }
+        return text;
+    }
+
+    void WriteText(std::filesystem::path const& path, std::string const& text)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(text.data(), static_cast<std::streamsize>(text.size()));
+        if (!file)
+        {
+            throw std::runtime_error("cannot write " + path.string());
+        }
+    }
+
+    // Best of `rounds`, in milliseconds.
+    double TimeLoad(std::filesystem::path const& path, int rounds, size_t expected)
+    {
+        double best = 1e300;
+        for (int round = 0; round < rounds; ++round)
+        {
+            auto const start = std::chrono::steady_clock::now();
+            LoadedConfiguration const loaded = ConfigurationLoader::LoadStreaming(path);
+            auto const elapsed = std::chrono::steady_clock::now() - start;
+            if (loaded.actions.Size() != expected)
+            {
+                throw std::runtime_error(path.string() + ": loaded " + std::to_string(loaded.actions.Size()) + " actions");
+            }
+            best = std::min(best, std::chrono::duration<double, std::milli>(elapsed).count());
+        }
+        return best;
+    }
+
+    void Print(char const* format, size_t actions, size_t bytes, double ms)
+    {
+        std::printf("%-6s %9zu %12zu %10.2f %10.1f %10.0f\n", format, actions, bytes, ms,
+            bytes / (1024.0 * 1024.0) / (ms / 1000.0), actions / (ms / 1000.0));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int rounds = 5;
+    bool keep = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view const option = argv[i];
+        if (option == "--rounds" && i + 1 < argc) rounds = std::max(1, std::atoi(argv[++i]));
+        else if (option == "--keep") keep = true;
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    try
+    {
+        std::filesystem::path const directory = std::filesystem::temp_directory_path();
+        size_t const actionCounts[] = { 1000, 10000, 100000 };
+
+        std::printf("%-6s %9s %12s %10s %10s %10s\n", "format", "actions", "bytes", "best ms", "MB/s", "actions/s");
+        for (size_t count : actionCounts)
+        {
+            std::string const json = GenerateJson(count);
+            std::string const yaml = GenerateYaml(count);
+            std::filesystem::path const jsonPath = directory / ("khm-bench-" + std::to_string(count) + ".json");
+            std::filesystem::path const yamlPath = directory / ("khm-bench-" + std::to_string(count) + ".yaml");
+            WriteText(jsonPath, json);
+            WriteText(yamlPath, yaml);
+
+            Print("json", count, json.size(), TimeLoad(jsonPath, rounds, count));
+            Print("yaml", count, yaml.size(), TimeLoad(yamlPath, rounds, count));
+
+            if (!keep)
+            {
+                std::filesystem::remove(jsonPath);
+                std::filesystem::remove(yamlPath);
+            }
+        }
+    }
+    catch (std::exception const& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
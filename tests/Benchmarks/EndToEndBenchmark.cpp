@@ -0,0 +1,702 @@
+// End-to-end latency of the actions in a config, as the user feels it:
+// injects each action's hotkey (the last step of a sequence) with SendInput
+// into a live KeyboardHook and ActionExecutor and measures, from that
+// SendInput call,
+//
+//   hook      the hook callback for the trigger key
+//   match     its dispatch table hit
+//   pickup    a pool worker starting the action
+//   done      the action returning: CreateProcessW for LaunchApp, SendInput
+//             for TypeText and SendKeys, the tray message for WindowsAction
+//   window    the first top-level window the launched process shows
+//             (SetWinEventHook, EVENT_OBJECT_SHOW); LaunchApp only
+//
+//   EndToEndBenchmark.exe [--config file] [--output file] [--samples n]
+//                         [--launch-samples n] [--warmup n] [--actions id,id]
+//                         [--window-timeout ms]
+//
+// The config defaults to config/example-config.json; actions run in config
+// order, or only those --actions names. Disabled actions, actions limited to
+// a profile (their app would have to be in the foreground) and
+// LockWorkstation are skipped and reported as such. Every launched window is
+// closed again after its sample, so activateIfRunning actions launch each
+// time; an app that opens its window in a process that was already running
+// reports no window stage.
+//
+// Needs an unlocked desktop and the benchmark window in the foreground:
+// TypeText and SendKeys type into it, and their samples are counted lost
+// whenever it is not. Leave the keyboard alone for the whole run.
+//
+// Stages after "hook" are offsets from hook entry read from the
+// Instrumentation histograms, which are reset before each sample and so
+// hold exactly that sample; "window" is taken when the WinEvent reaches our
+// message loop.
+//
+// Results go to --output (default stdout) as JSON: per action, the stage
+// summaries and every sample with the QPC value of its SendInput. To
+// correlate them with ETW, record the run with the profile next to this
+// file:
+//
+//   wpr -start EndToEndBenchmark.wprp -filemode
+//   EndToEndBenchmark.exe --output e2e.json
+//   wpr -stop e2e.etl
+//
+// Each sample is a Sample start/stop event pair on the
+// KeyboardHookManager.Benchmark provider, carrying the action id and sample
+// number. The pair brackets the app's own HookLatency events and the
+// kernel's process, thread and scheduling events for that keystroke.
+
+#include "pch.h"
+
+#include "Actions/ActionExecutor.h"
+#include "Actions/WindowIndex.h"
+#include "Configuration/ConfigurationLoader.h"
+#include "Core/DispatchSnapshot.h"
+#include "Core/HookEvent.h"
+#include "Core/HookProcessor.h"
+#include "Core/KeyboardHook.h"
+#include "Utils/Instrumentation.h"
+
+#include <TraceLoggingProvider.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// {F08C717F-5066-4599-8F0D-481FC6343574}
+TRACELOGGING_DEFINE_PROVIDER(
+    g_benchmarkProvider,
+    "KeyboardHookManager.Benchmark",
+    (0xf08c717f, 0x5066, 0x4599, 0x8f, 0x0d, 0x48, 0x1f, 0xc6, 0x34, 0x35, 0x74));
+
+namespace
+{
+    using namespace khm;
+
+    constexpr DWORD ActionTimeoutMs = 5000;
+    constexpr DWORD CloseTimeoutMs = 5000;
+    constexpr DWORD SequenceStepGapMs = 20;
+    constexpr DWORD SettleMs = 50; // lets typed text and tray commands land before the next sample
+
+    enum Stage : size_t
+    {
+        HookStage,
+        MatchStage,
+        PickupStage,
+        DoneStage,
+        WindowStage,
+        StageCount
+    };
+
+    constexpr char const* StageNames[StageCount] = { "hook", "match", "pickup", "done", "window" };
+
+    struct Options
+    {
+        std::filesystem::path config = "config/example-config.json";
+        char const* outputPath = nullptr;
+        size_t samples = 50;
+        size_t launchSamples = 10;
+        size_t warmup = 1;
+        std::vector<std::string> actions; // empty for all
+        DWORD windowTimeoutMs = 10'000;
+    };
+
+    struct Sample
+    {
+        uint32_t index = 0;
+        int64_t sentQpc = 0;
+        bool ok = false;                          // the action reported success
+        std::array<double, StageCount> us{};      // NaN for a stage not reached
+    };
+
+    struct Stats
+    {
+        size_t count = 0;
+        double meanUs = 0;
+        double p50Us = 0;
+        double p99Us = 0;
+        double maxUs = 0;
+    };
+
+    struct ActionResult
+    {
+        std::string id;
+        std::string type;
+        char const* skipped = nullptr; // reason, or null when it ran
+        size_t lost = 0;                // never reached the executor, or the window was not ours to type into
+        std::vector<Sample> samples;
+    };
+
+    // Sits between the hook and the executor's ring and keeps the hook entry
+    // time of the last match, which every later stage is measured from.
+    class EntryProbe final : public IHotkeyHandler
+    {
+    public:
+        explicit EntryProbe(HookEventRing& ring) noexcept : m_ring(ring) {}
+
+        void OnHotkey(uint32_t actionIndex, KBDLLHOOKSTRUCT const& event, uint8_t modifiers, int64_t timestamp) noexcept override
+        {
+            m_entered.store(timestamp, std::memory_order_relaxed);
+            m_ring.OnHotkey(actionIndex, event, modifiers, timestamp);
+        }
+
+        void Reset() noexcept { m_entered.store(0, std::memory_order_relaxed); }
+        int64_t Entered() const noexcept { return m_entered.load(std::memory_order_relaxed); }
+
+    private:
+        HookEventRing& m_ring;
+        std::atomic<int64_t> m_entered{ 0 };
+    };
+
+    // Main thread only: the WinEvent callback runs inside our message loop.
+    struct WindowWatch
+    {
+        bool armed = false;
+        FILETIME after{}; // processes created before the sample are not the launch
+        HWND window = nullptr;
+        DWORD process = 0;
+        int64_t shownQpc = 0;
+    };
+
+    WindowWatch g_watch;
+
+    void CALLBACK OnShow(HWINEVENTHOOK, DWORD, HWND window, LONG object, LONG child, DWORD, DWORD) noexcept
+    {
+        if (!g_watch.armed || g_watch.window != nullptr || object != OBJID_WINDOW || child != CHILDID_SELF || GetAncestor(window, GA_ROOT) != window)
+        {
+            return;
+        }
+        int64_t const shown = Instrumentation::Now();
+        DWORD process = 0;
+        GetWindowThreadProcessId(window, &process);
+        if (process == 0 || process == GetCurrentProcessId())
+        {
+            return;
+        }
+        winrt::handle const handle{ OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, process) };
+        FILETIME created, exited, kernel, user;
+        if (!handle || !GetProcessTimes(handle.get(), &created, &exited, &kernel, &user) || CompareFileTime(&created, &g_watch.after) < 0)
+        {
+            return;
+        }
+        g_watch.window = window;
+        g_watch.process = process;
+        g_watch.shownQpc = shown;
+    }
+
+    LRESULT CALLBACK WindowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam)
+    {
+        // Typed text and keys end here.
+        if (message == WM_CHAR || message == WM_KEYDOWN || message == WM_KEYUP)
+        {
+            return 0;
+        }
+        return DefWindowProcW(window, message, wParam, lParam);
+    }
+
+    HWND CreateTargetWindow()
+    {
+        WNDCLASSEXW windowClass{ sizeof(windowClass) };
+        windowClass.lpfnWndProc = WindowProc;
+        windowClass.hInstance = GetModuleHandleW(nullptr);
+        windowClass.lpszClassName = L"KeyboardHookManager.EndToEndBenchmark";
+        RegisterClassExW(&windowClass);
+
+        HWND const window = CreateWindowExW(WS_EX_TOPMOST, windowClass.lpszClassName, L"End-to-end benchmark",
+            WS_OVERLAPPEDWINDOW | WS_VISIBLE, 100, 100, 320, 120, nullptr, nullptr, windowClass.hInstance, nullptr);
+        winrt::check_pointer(window);
+        SetForegroundWindow(window);
+        return window;
+    }
+
+    bool Foreground(HWND window)
+    {
+        if (GetForegroundWindow() != window)
+        {
+            ShowWindow(window, SW_RESTORE);
+            SetForegroundWindow(window);
+        }
+        return GetForegroundWindow() == window;
+    }
+
+    void AppendKey(std::vector<INPUT>& inputs, WORD vk, bool up)
+    {
+        INPUT& input = inputs.emplace_back();
+        input.type = INPUT_KEYBOARD;
+        input.ki.wVk = vk;
+        input.ki.dwFlags = up ? KEYEVENTF_KEYUP : 0;
+    }
+
+    // Left-hand modifiers down, the key, modifiers up; untagged, so our own
+    // hook matches it like a physical chord.
+    void InjectChord(Hotkey hotkey)
+    {
+        static constexpr std::pair<uint8_t, WORD> Modifiers[] = {
+            { ModWin, VK_LWIN }, { ModCtrl, VK_LCONTROL }, { ModShift, VK_LSHIFT }, { ModAlt, VK_LMENU } };
+
+        std::vector<INPUT> inputs;
+        for (auto const& [flag, vk] : Modifiers)
+        {
+            if (hotkey.modifiers & flag)
+            {
+                AppendKey(inputs, vk, false);
+            }
+        }
+        AppendKey(inputs, hotkey.key, false);
+        AppendKey(inputs, hotkey.key, true);
+        for (auto it = std::rbegin(Modifiers); it != std::rend(Modifiers); ++it)
+        {
+            if (hotkey.modifiers & it->first)
+            {
+                AppendKey(inputs, it->second, true);
+            }
+        }
+        SendInput(static_cast<UINT>(inputs.size()), inputs.data(), sizeof(INPUT));
+    }
+
+    void PumpMessages()
+    {
+        MSG msg;
+        while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE))
+        {
+            DispatchMessageW(&msg);
+        }
+    }
+
+    void PumpFor(DWORD ms)
+    {
+        ULONGLONG const deadline = GetTickCount64() + ms;
+        for (ULONGLONG now = GetTickCount64(); now < deadline; now = GetTickCount64())
+        {
+            MsgWaitForMultipleObjects(0, nullptr, FALSE, static_cast<DWORD>(deadline - now), QS_ALLINPUT);
+            PumpMessages();
+        }
+    }
+
+    // Pumps messages until the executor finished one more action and, when
+    // `window` is set, the launch showed its window. False when the action
+    // did not finish in time; a missing window only leaves its stage out.
+    bool WaitForSample(ActionExecutor const& executor, uint64_t finished, bool window, DWORD windowTimeoutMs)
+    {
+        ULONGLONG const started = GetTickCount64();
+        for (;;)
+        {
+            bool const done = executor.Executed() + executor.Failed() > finished;
+            if (done && (!window || g_watch.window != nullptr))
+            {
+                return true;
+            }
+            ULONGLONG const elapsed = GetTickCount64() - started;
+            if (elapsed >= (done ? windowTimeoutMs : ActionTimeoutMs))
+            {
+                return done;
+            }
+            // The counters are only polled; the stages are timed elsewhere.
+            MsgWaitForMultipleObjects(0, nullptr, FALSE, 1, QS_ALLINPUT);
+            PumpMessages();
+        }
+    }
+
+    // Asks the launched window to close and waits for its process to exit,
+    // so the next sample launches afresh.
+    void CloseLaunched()
+    {
+        if (g_watch.window == nullptr)
+        {
+            return;
+        }
+        winrt::handle const process{ OpenProcess(SYNCHRONIZE, FALSE, g_watch.process) };
+        PostMessageW(g_watch.window, WM_CLOSE, 0, 0);
+        if (process)
+        {
+            if (WaitForSingleObject(process.get(), CloseTimeoutMs) != WAIT_OBJECT_0)
+            {
+                std::fprintf(stderr, "launched process %lu did not exit; close it by hand\n", g_watch.process);
+            }
+        }
+    }
+
+    double Us(int64_t ticks) noexcept
+    {
+        return ticks <= 0 ? 0.0 : static_cast<double>(Instrumentation::TicksToNanoseconds(static_cast<uint64_t>(ticks))) / 1000.0;
+    }
+
+    double StageUs(LatencyStage stage) noexcept
+    {
+        LatencySummary const summary = Instrumentation::Summarize(stage);
+        return summary.count != 0 ? static_cast<double>(summary.maxNs) / 1000.0 : NAN;
+    }
+
+    char const* SkipReason(ActionTable const& table, ActionRecord const& record, Options const& options)
+    {
+        std::string_view const id = table.String(record.id);
+        if (!options.actions.empty() && std::ranges::find(options.actions, id) == options.actions.end())
+        {
+            return "not selected";
+        }
+        if (!record.enabled)
+        {
+            return "disabled";
+        }
+        if (record.profile.length != 0)
+        {
+            return "profile";
+        }
+        if (!record.hasHotkey && table.SequenceLength(record) == 0)
+        {
+            return "no hotkey";
+        }
+        if (table.String(record.type) == "WindowsAction" && table.String(record.parameter) == "LockWorkstation")
+        {
+            return "locks the session";
+        }
+        return nullptr;
+    }
+
+    ActionResult RunAction(HWND window, ActionExecutor const& executor, EntryProbe& probe, ActionTable const& table, ActionRecord const& record, Options const& options)
+    {
+        ActionResult result;
+        result.id = table.String(record.id);
+        result.type = table.String(record.type);
+        result.skipped = SkipReason(table, record, options);
+        if (result.skipped != nullptr)
+        {
+            return result;
+        }
+
+        bool const launch = result.type == "LaunchApp";
+        bool const types = result.type == "TypeText" || result.type == "SendKeys";
+        size_t const count = launch ? options.launchSamples : options.samples;
+        uint32_t const steps = record.hasHotkey ? 1 : table.SequenceLength(record);
+
+        for (size_t i = 0; i < options.warmup + count; ++i)
+        {
+            if (types && !Foreground(window))
+            {
+                ++result.lost;
+                continue;
+            }
+            for (uint32_t step = 0; step + 1 < steps; ++step)
+            {
+                InjectChord(table.SequenceStep(record, step));
+                PumpFor(SequenceStepGapMs);
+            }
+            Hotkey const trigger = record.hasHotkey ? record.hotkey : table.SequenceStep(record, steps - 1);
+
+            Instrumentation::Reset();
+            probe.Reset();
+            g_watch = {};
+            g_watch.armed = launch;
+            GetSystemTimeAsFileTime(&g_watch.after); // the clock process creation times come from
+            uint64_t const finished = executor.Executed() + executor.Failed();
+            uint64_t const failed = executor.Failed();
+            uint32_t const index = static_cast<uint32_t>(i); // warmup included, as in the trace
+
+            TraceLoggingWrite(g_benchmarkProvider, "Sample",
+                TraceLoggingOpcode(WINEVENT_OPCODE_START),
+                TraceLoggingString(result.id.c_str(), "Action"),
+                TraceLoggingUInt32(index, "Sample"));
+            int64_t const sent = Instrumentation::Now();
+            InjectChord(trigger);
+            bool const finishedInTime = WaitForSample(executor, finished, launch, options.windowTimeoutMs);
+            g_watch.armed = false;
+
+            Sample sample;
+            sample.index = index;
+            sample.sentQpc = sent;
+            sample.us.fill(NAN);
+            int64_t const entered = probe.Entered();
+            if (finishedInTime && entered != 0)
+            {
+                double const hook = Us(entered - sent);
+                sample.ok = executor.Failed() == failed;
+                sample.us[HookStage] = hook;
+                sample.us[MatchStage] = hook + StageUs(LatencyStage::Match);
+                sample.us[PickupStage] = hook + StageUs(LatencyStage::ActionStart);
+                sample.us[DoneStage] = sample.us[PickupStage] + StageUs(LatencyStage::ActionRun);
+                if (g_watch.window != nullptr)
+                {
+                    sample.us[WindowStage] = Us(g_watch.shownQpc - sent);
+                }
+            }
+
+            TraceLoggingWrite(g_benchmarkProvider, "Sample",
+                TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+                TraceLoggingString(result.id.c_str(), "Action"),
+                TraceLoggingUInt32(index, "Sample"),
+                TraceLoggingBool(sample.ok, "Ok"),
+                TraceLoggingFloat64(sample.us[DoneStage], "DoneUs"),
+                TraceLoggingFloat64(sample.us[WindowStage], "WindowUs"));
+
+            CloseLaunched();
+            PumpFor(SettleMs);
+            Foreground(window); // after MinimizeAll and launched windows
+
+            if (!finishedInTime || entered == 0)
+            {
+                ++result.lost;
+            }
+            else if (i >= options.warmup)
+            {
+                result.samples.push_back(sample);
+            }
+        }
+        return result;
+    }
+
+    Stats Summarize(std::vector<Sample> const& samples, Stage stage)
+    {
+        std::vector<double> values;
+        for (Sample const& sample : samples)
+        {
+            if (!std::isnan(sample.us[stage]))
+            {
+                values.push_back(sample.us[stage]);
+            }
+        }
+        Stats stats;
+        stats.count = values.size();
+        if (values.empty())
+        {
+            return stats;
+        }
+        std::ranges::sort(values);
+        double sum = 0;
+        for (double value : values)
+        {
+            sum += value;
+        }
+        stats.meanUs = sum / values.size();
+        stats.p50Us = values[values.size() / 2];
+        stats.p99Us = values[std::min(values.size() - 1, values.size() * 99 / 100)];
+        stats.maxUs = values.back();
+        return stats;
+    }
+
+    std::string Quote(std::string_view text)
+    {
+        std::string quoted = "\"";
+        for (char const c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                quoted += '\\';
+                quoted += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                quoted += escaped;
+            }
+            else
+            {
+                quoted += c;
+            }
+        }
+        return quoted + '"';
+    }
+
+    std::string Number(double value)
+    {
+        if (std::isnan(value))
+        {
+            return "null";
+        }
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.1f", value);
+        return text;
+    }
+
+    std::string ToJson(Options const& options, std::vector<ActionResult> const& results)
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        std::string json = "{\n";
+        json += "  \"benchmark\": \"EndToEnd\",\n";
+        json += "  \"config\": " + Quote(options.config.string()) + ",\n";
+        json += "  \"qpcFrequency\": " + std::to_string(frequency.QuadPart) + ",\n";
+        json += "  \"processors\": " + std::to_string(GetActiveProcessorCount(ALL_PROCESSOR_GROUPS)) + ",\n";
+        json += "  \"actions\": [";
+        for (size_t a = 0; a < results.size(); ++a)
+        {
+            ActionResult const& result = results[a];
+            json += a == 0 ? "\n" : ",\n";
+            json += "    {\n      \"id\": " + Quote(result.id) + ",\n      \"type\": " + Quote(result.type);
+            if (result.skipped != nullptr)
+            {
+                json += ",\n      \"skipped\": " + Quote(result.skipped) + "\n    }";
+                continue;
+            }
+            json += ",\n      \"lost\": " + std::to_string(result.lost) + ",\n      \"stages\": {";
+            for (size_t s = 0; s < StageCount; ++s)
+            {
+                Stats const stats = Summarize(result.samples, static_cast<Stage>(s));
+                json += s == 0 ? "\n" : ",\n";
+                json += std::string("        ") + Quote(StageNames[s]) + ": { \"count\": " + std::to_string(stats.count)
+                    + ", \"meanUs\": " + Number(stats.meanUs) + ", \"p50Us\": " + Number(stats.p50Us)
+                    + ", \"p99Us\": " + Number(stats.p99Us) + ", \"maxUs\": " + Number(stats.maxUs) + " }";
+            }
+            json += "\n      },\n      \"samples\": [";
+            for (size_t i = 0; i < result.samples.size(); ++i)
+            {
+                Sample const& sample = result.samples[i];
+                json += i == 0 ? "\n" : ",\n";
+                json += "        { \"sample\": " + std::to_string(sample.index) + ", \"sentQpc\": " + std::to_string(sample.sentQpc)
+                    + ", \"ok\": " + (sample.ok ? "true" : "false");
+                for (size_t s = 0; s < StageCount; ++s)
+                {
+                    json += std::string(", ") + Quote(std::string(StageNames[s]) + "Us") + ": " + Number(sample.us[s]);
+                }
+                json += " }";
+            }
+            json += result.samples.empty() ? "]\n    }" : "\n      ]\n    }";
+        }
+        json += results.empty() ? "]\n}\n" : "\n  ]\n}\n";
+        return json;
+    }
+
+    void PrintSummary(std::vector<ActionResult> const& results)
+    {
+        std::fprintf(stderr, "%-24s %-8s %10s %10s %10s %10s %10s %6s\n", "action", "stage", "mean us", "p50 us", "p99 us", "max us", "samples", "lost");
+        for (ActionResult const& result : results)
+        {
+            if (result.skipped != nullptr)
+            {
+                std::fprintf(stderr, "%-24s skipped: %s\n", result.id.c_str(), result.skipped);
+                continue;
+            }
+            for (size_t s = 0; s < StageCount; ++s)
+            {
+                Stats const stats = Summarize(result.samples, static_cast<Stage>(s));
+                if (stats.count != 0)
+                {
+                    std::fprintf(stderr, "%-24s %-8s %10.1f %10.1f %10.1f %10.1f %10zu %6zu\n", result.id.c_str(), StageNames[s],
+                        stats.meanUs, stats.p50Us, stats.p99Us, stats.maxUs, stats.count, result.lost);
+                }
+            }
+        }
+    }
+
+    std::vector<std::string> SplitIds(std::string_view list)
+    {
+        std::vector<std::string> ids;
+        while (!list.empty())
+        {
+            size_t const comma = list.find(',');
+            if (comma != 0)
+            {
+                ids.emplace_back(list.substr(0, comma));
+            }
+            list.remove_prefix(comma == std::string_view::npos ? list.size() : comma + 1);
+        }
+        return ids;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string_view const option = argv[i];
+        char const* const value = argv[i + 1];
+        if (option == "--config") options.config = value;
+        else if (option == "--output") options.outputPath = value;
+        else if (option == "--samples") options.samples = static_cast<size_t>(std::atoll(value));
+        else if (option == "--launch-samples") options.launchSamples = static_cast<size_t>(std::atoll(value));
+        else if (option == "--warmup") options.warmup = static_cast<size_t>(std::atoll(value));
+        else if (option == "--actions") options.actions = SplitIds(value);
+        else if (option == "--window-timeout") options.windowTimeoutMs = static_cast<DWORD>(std::atol(value));
+        else
+        {
+            std::fprintf(stderr, "unknown option %s %s\n", argv[i], value);
+            return 2;
+        }
+    }
+
+    Instrumentation::Initialize();
+    TraceLoggingRegister(g_benchmarkProvider);
+    int status = 0;
+    try
+    {
+        DispatchSnapshotPointer snapshots(DispatchSnapshot::Create(ConfigurationLoader::LoadStreaming(options.config)));
+        DispatchSnapshot const& snapshot = *snapshots.Current();
+        ActionTable const& actions = snapshot.configuration.actions;
+
+        HWND const window = CreateTargetWindow();
+        if (GetForegroundWindow() != window)
+        {
+            std::fprintf(stderr, "benchmark window is not in the foreground; TypeText and SendKeys samples will be lost\n");
+        }
+        HWINEVENTHOOK const showHook = SetWinEventHook(EVENT_OBJECT_SHOW, EVENT_OBJECT_SHOW, nullptr, OnShow, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+        winrt::check_pointer(showHook);
+
+        auto ring = std::make_unique<HookEventRing>();
+        WindowIndex windows;
+        if (std::ranges::any_of(actions.Records(), [](ActionRecord const& action) { return action.enabled && action.activateIfRunning; }))
+        {
+            windows.Start();
+        }
+        ActionExecutor executor(*ring, snapshots, windows);
+        executor.Start();
+
+        EntryProbe probe(*ring);
+        HookProcessor processor;
+        processor.Attach(snapshots);
+        processor.SetHandler(&probe);
+        KeyboardHook hook(processor);
+        hook.SetPriority(snapshot.configuration.settings.hookPriority);
+        hook.Install();
+        Instrumentation::SetEnabled(true);
+
+        std::vector<ActionResult> results;
+        for (ActionRecord const& record : actions.Records())
+        {
+            results.push_back(RunAction(window, executor, probe, actions, record, options));
+        }
+
+        Instrumentation::SetEnabled(false);
+        hook.Uninstall();
+        executor.Stop();
+        windows.Stop();
+        UnhookWinEvent(showHook);
+        DestroyWindow(window);
+
+        PrintSummary(results);
+        std::string const json = ToJson(options, results);
+        if (options.outputPath != nullptr)
+        {
+            std::ofstream output(options.outputPath, std::ios::binary | std::ios::trunc);
+            output << json;
+            if (!output)
+            {
+                throw std::runtime_error(std::string("cannot write ") + options.outputPath);
+            }
+        }
+        else
+        {
+            std::fwrite(json.data(), 1, json.size(), stdout);
+        }
+    }
+    catch (winrt::hresult_error const& e)
+    {
+        std::fprintf(stderr, "%ls\n", e.message().c_str());
+        status = 1;
+    }
+    catch (std::exception const& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        status = 1;
+    }
+    TraceLoggingUnregister(g_benchmarkProvider);
+    Instrumentation::Shutdown();
+    return status;
+}
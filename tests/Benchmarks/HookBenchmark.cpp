@@ -0,0 +1,301 @@
+// Hot-path micro-benchmarks: drives HookProcessor directly with synthetic
+// KBDLLHOOKSTRUCT streams and reports ns/event and allocations/event.
+//
+//   HookBenchmark.exe [--baseline file] [--write-baseline file]
+//                     [--threshold percent] [--max-ns ns]
+//
+// Exits non-zero when the hook path allocates, exceeds --max-ns, or is more
+// than --threshold percent slower than the baseline.
+
+#include "pch.h"
+
+#include "Configuration/Configuration.h"
+#include "Core/DispatchSnapshot.h"
+#include "Core/HookEvent.h"
+#include "Core/HookProcessor.h"
+#include "Core/HotkeyDispatchTable.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <new>
+#include <random>
+
+namespace
+{
+    std::atomic<uint64_t> g_allocations{ 0 };
+}
+
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace
+{
+    using namespace khm;
+
+    struct SyntheticEvent
+    {
+        WPARAM message;
+        KBDLLHOOKSTRUCT data;
+        uint8_t modifiers;
+    };
+
+    struct Scenario
+    {
+        char const* name;
+        std::vector<SyntheticEvent> (*generate)(std::mt19937& random, size_t count);
+    };
+
+    struct Result
+    {
+        std::string name;
+        double nsPerEvent;
+        double allocationsPerEvent;
+    };
+
+    constexpr uint8_t BoundModifiers[] = { ModWin, ModCtrl | ModShift, ModCtrl | ModAlt, ModWin | ModShift };
+
+    SyntheticEvent Key(WPARAM message, uint8_t vk, uint8_t modifiers, DWORD time)
+    {
+        SyntheticEvent event{};
+        event.message = message;
+        event.data.vkCode = vk;
+        event.data.time = time;
+        event.data.flags = (message == WM_KEYUP || message == WM_SYSKEYUP) ? LLKHF_UP : 0;
+        event.modifiers = modifiers;
+        return event;
+    }
+
+    // Unmodified letters at ~12 keys/s: almost nothing matches.
+    std::vector<SyntheticEvent> TypingBurst(std::mt19937& random, size_t count)
+    {
+        std::uniform_int_distribution<int> letter('A', 'Z');
+        std::vector<SyntheticEvent> events;
+        events.reserve(count);
+        DWORD time = 0;
+        while (events.size() + 2 <= count)
+        {
+            uint8_t const vk = static_cast<uint8_t>(letter(random));
+            events.push_back(Key(WM_KEYDOWN, vk, ModNone, time += 40));
+            events.push_back(Key(WM_KEYUP, vk, ModNone, time += 40));
+        }
+        return events;
+    }
+
+    // A bound chord held down: one real press followed by autorepeat.
+    std::vector<SyntheticEvent> HeldAutorepeat(std::mt19937&, size_t count)
+    {
+        std::vector<SyntheticEvent> events;
+        events.reserve(count);
+        DWORD time = 0;
+        while (events.size() + 2 <= count)
+        {
+            size_t const repeats = std::min<size_t>(64, count - events.size() - 1);
+            for (size_t i = 0; i < repeats; ++i)
+            {
+                events.push_back(Key(WM_KEYDOWN, 'A', BoundModifiers[0], time += 33));
+            }
+            events.push_back(Key(WM_KEYUP, 'A', BoundModifiers[0], time += 33));
+        }
+        return events;
+    }
+
+    // Random bound and unbound chords as fast as they can be generated.
+    std::vector<SyntheticEvent> ChordStorm(std::mt19937& random, size_t count)
+    {
+        std::uniform_int_distribution<int> key(0x30, 0x5A);
+        std::uniform_int_distribution<int> modifiers(0, 15);
+        std::vector<SyntheticEvent> events;
+        events.reserve(count);
+        DWORD time = 0;
+        while (events.size() + 2 <= count)
+        {
+            uint8_t const vk = static_cast<uint8_t>(key(random));
+            uint8_t const mask = static_cast<uint8_t>(modifiers(random));
+            WPARAM const down = (mask & ModAlt) ? WM_SYSKEYDOWN : WM_KEYDOWN;
+            WPARAM const up = (mask & ModAlt) ? WM_SYSKEYUP : WM_KEYUP;
+            events.push_back(Key(down, vk, mask, ++time));
+            events.push_back(Key(up, vk, mask, ++time));
+        }
+        return events;
+    }
+
+    HotkeyDefinition Chord(uint32_t mask, uint32_t key)
+    {
+        HotkeyDefinition hotkey;
+        hotkey.win = (mask & ModWin) != 0;
+        hotkey.ctrl = (mask & ModCtrl) != 0;
+        hotkey.shift = (mask & ModShift) != 0;
+        hotkey.alt = (mask & ModAlt) != 0;
+        hotkey.key = key;
+        return hotkey;
+    }
+
+    // The chord HeldAutorepeat holds is always bound, so every table size
+    // takes the match and suppress path; the rest are distinct filler chords.
+    // Beyond the table's capacity the extra actions collide and are ignored
+    // by Compile(), exactly as with a real config.
+    std::vector<ActionDefinition> GenerateActions(size_t count)
+    {
+        std::vector<ActionDefinition> actions(count);
+        uint32_t chord = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t mask = BoundModifiers[0];
+            uint32_t key = 'A';
+            while (i > 0 && mask == BoundModifiers[0] && key == 'A')
+            {
+                mask = chord % ModifierCombinations;
+                key = 0x30 + (chord / ModifierCombinations) % 0x2B;
+                ++chord;
+            }
+            HotkeyDefinition const hotkey = Chord(mask, key);
+
+            actions[i].id = L"bench-" + std::to_wstring(i);
+            actions[i].type = L"LaunchApp";
+            actions[i].hotkey = hotkey;
+        }
+        return actions;
+    }
+
+    Result Run(Scenario const& scenario, size_t bindings)
+    {
+        constexpr size_t EventCount = 1 << 20;
+        constexpr int Rounds = 5;
+
+        std::mt19937 random(42);
+        std::vector<SyntheticEvent> const events = scenario.generate(random, EventCount);
+        std::vector<ActionDefinition> const actions = GenerateActions(bindings);
+        // Only the tables are read on the hook path; the snapshot's action
+        // data stays empty.
+        auto snapshot = std::make_unique<DispatchSnapshot>();
+        snapshot->table = HotkeyDispatchTable::Compile(actions);
+        snapshot->sequences = std::make_unique<KeySequenceTable>();
+        DispatchSnapshotPointer snapshots(std::move(snapshot));
+        auto ring = std::make_unique<HookEventRing>();
+
+        HookProcessor processor;
+        processor.Attach(snapshots);
+        processor.SetHandler(ring.get());
+
+        double best = 1e300;
+        uint64_t allocations = 0;
+        HookEvent drained;
+        for (int round = 0; round < Rounds; ++round)
+        {
+            uint64_t const allocationsBefore = g_allocations.load();
+            auto const start = std::chrono::steady_clock::now();
+            for (SyntheticEvent const& event : events)
+            {
+                processor.Process(event.message, event.data, event.modifiers);
+                // Drained as it fills, as TraceReplay does, so matches take
+                // the enqueue path rather than the full-ring drop.
+                while (ring->TryPop(drained))
+                {
+                }
+            }
+            auto const elapsed = std::chrono::steady_clock::now() - start;
+            allocations += g_allocations.load() - allocationsBefore;
+
+            best = std::min(best, std::chrono::duration<double, std::nano>(elapsed).count() / events.size());
+        }
+
+        char name[96];
+        std::snprintf(name, sizeof(name), "%s/%zu", scenario.name, bindings);
+        return Result{ name, best, static_cast<double>(allocations) / (static_cast<double>(events.size()) * Rounds) };
+    }
+
+    std::map<std::string, double> ReadBaseline(char const* path)
+    {
+        std::map<std::string, double> baseline;
+        std::ifstream file(path);
+        std::string name;
+        double ns;
+        while (file >> name >> ns)
+        {
+            baseline[name] = ns;
+        }
+        return baseline;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    char const* baselinePath = nullptr;
+    char const* writeBaselinePath = nullptr;
+    double thresholdPercent = 10.0;
+    double maxNs = 0.0;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string_view const option = argv[i];
+        if (option == "--baseline") baselinePath = argv[i + 1];
+        else if (option == "--write-baseline") writeBaselinePath = argv[i + 1];
+        else if (option == "--threshold") thresholdPercent = std::atof(argv[i + 1]);
+        else if (option == "--max-ns") maxNs = std::atof(argv[i + 1]);
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    Scenario const scenarios[] = {
+        { "typing", &TypingBurst },
+        { "autorepeat", &HeldAutorepeat },
+        { "chords", &ChordStorm },
+    };
+    size_t const bindingCounts[] = { 10, 100, 1000, 10000 };
+
+    std::map<std::string, double> const baseline = baselinePath ? ReadBaseline(baselinePath) : std::map<std::string, double>{};
+    std::vector<Result> results;
+    bool failed = false;
+
+    std::printf("%-24s %12s %14s %10s\n", "scenario/bindings", "ns/event", "allocs/event", "vs base");
+    for (Scenario const& scenario : scenarios)
+    {
+        for (size_t bindings : bindingCounts)
+        {
+            Result const& result = results.emplace_back(Run(scenario, bindings));
+
+            char delta[32] = "-";
+            if (auto it = baseline.find(result.name); it != baseline.end() && it->second > 0)
+            {
+                double const percent = (result.nsPerEvent / it->second - 1.0) * 100.0;
+                std::snprintf(delta, sizeof(delta), "%+.1f%%", percent);
+                failed |= percent > thresholdPercent;
+            }
+            failed |= result.allocationsPerEvent > 0.0;
+            failed |= maxNs > 0.0 && result.nsPerEvent > maxNs;
+
+            std::printf("%-24s %12.2f %14.4f %10s\n", result.name.c_str(), result.nsPerEvent, result.allocationsPerEvent, delta);
+        }
+    }
+
+    if (writeBaselinePath)
+    {
+        std::ofstream file(writeBaselinePath);
+        for (Result const& result : results)
+        {
+            file << result.name << ' ' << result.nsPerEvent << '\n';
+        }
+    }
+
+    if (failed)
+    {
+        std::fprintf(stderr, "hook path regression: allocation, --max-ns or baseline threshold exceeded\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,352 @@
+// End-to-end comparison of the two key sources: injects keystrokes with
+// SendInput into a window of our own and measures, per backend,
+//
+//   delivery   SendInput until the foreground window gets an unbound key,
+//              i.e. what the backend costs every other keystroke
+//   detection  SendInput until the processor has matched a bound key
+//
+//   InputLatencyBenchmark.exe [--samples n] [--load n] [--priority name]
+//
+// "none" runs with neither backend as the delivery baseline. The window has
+// to stay in the foreground for the whole run; start it from a console and
+// leave the keyboard alone.
+//
+// --load keeps n threads spinning at normal priority for the whole run (one
+// per logical processor is a fully loaded machine); --priority sets the hook
+// thread's settings.hookPriority, so the two together show what the
+// priority buys under contention.
+
+#include "pch.h"
+
+#include "Configuration/ConfigurationLoader.h"
+#include "Core/DispatchSnapshot.h"
+#include "Core/HookProcessor.h"
+#include "Core/KeyboardHook.h"
+#include "Core/RawInputSource.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace khm;
+    using Clock = std::chrono::steady_clock;
+
+    constexpr WORD DeliveryKey = VK_F23; // unbound
+    constexpr WORD DetectionKey = VK_F24;
+    constexpr DWORD SampleTimeoutMs = 1000;
+
+    enum class Backend
+    {
+        None,
+        Hook,
+        RawInput,
+    };
+
+    struct Stats
+    {
+        double meanUs = 0;
+        double p50Us = 0;
+        double p99Us = 0;
+        double maxUs = 0;
+    };
+
+    // Window thread only.
+    Clock::time_point g_delivered;
+    bool g_deliveredSet = false;
+
+    class DetectionHandler final : public IHotkeyHandler
+    {
+    public:
+        DetectionHandler() :
+            m_event(winrt::check_pointer(CreateEventW(nullptr, FALSE, FALSE, nullptr)))
+        {
+        }
+
+        void OnHotkey(uint32_t, KBDLLHOOKSTRUCT const&, uint8_t, int64_t) noexcept override
+        {
+            m_detected = Clock::now();
+            SetEvent(m_event.get());
+        }
+
+        HANDLE Event() const noexcept { return m_event.get(); }
+        Clock::time_point Detected() const noexcept { return m_detected; } // after Event() was signalled
+
+    private:
+        winrt::handle m_event;
+        Clock::time_point m_detected;
+    };
+
+    LRESULT CALLBACK WindowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam)
+    {
+        if (message == WM_KEYDOWN && wParam == DeliveryKey)
+        {
+            g_delivered = Clock::now();
+            g_deliveredSet = true;
+            return 0;
+        }
+        return DefWindowProcW(window, message, wParam, lParam);
+    }
+
+    HWND CreateTargetWindow()
+    {
+        WNDCLASSEXW windowClass{ sizeof(windowClass) };
+        windowClass.lpfnWndProc = WindowProc;
+        windowClass.hInstance = GetModuleHandleW(nullptr);
+        windowClass.lpszClassName = L"KeyboardHookManager.InputLatencyBenchmark";
+        RegisterClassExW(&windowClass);
+
+        HWND const window = CreateWindowExW(WS_EX_TOPMOST, windowClass.lpszClassName, L"Input latency benchmark",
+            WS_OVERLAPPEDWINDOW | WS_VISIBLE, 100, 100, 320, 120, nullptr, nullptr, windowClass.hInstance, nullptr);
+        winrt::check_pointer(window);
+        SetForegroundWindow(window);
+        return window;
+    }
+
+    std::unique_ptr<DispatchSnapshot> DetectionSnapshot(bool passThrough)
+    {
+        std::string const json = std::string(R"({ "version": "1.0", "actions": [ { "id": "detect", "type": "LaunchApp", "parameter": "x", "passThrough": )")
+            + (passThrough ? "true" : "false")
+            + R"(, "hotkey": { "key": )" + std::to_string(DetectionKey) + " } } ] }";
+        return DispatchSnapshot::Create(ConfigurationLoader::ParseStreaming(json));
+    }
+
+    // Busy threads competing with the key sources for the processors.
+    class CpuLoad
+    {
+    public:
+        explicit CpuLoad(size_t threads)
+        {
+            for (size_t i = 0; i < threads; ++i)
+            {
+                m_threads.emplace_back([this] { Spin(); });
+            }
+        }
+
+        ~CpuLoad()
+        {
+            m_stop.store(true, std::memory_order_relaxed);
+            for (std::thread& thread : m_threads)
+            {
+                thread.join();
+            }
+        }
+
+        CpuLoad(CpuLoad const&) = delete;
+        CpuLoad& operator=(CpuLoad const&) = delete;
+
+    private:
+        void Spin() const noexcept
+        {
+            uint64_t x = 1;
+            while (!m_stop.load(std::memory_order_relaxed))
+            {
+                for (int i = 0; i < 4096; ++i)
+                {
+                    x = x * 6364136223846793005ull + 1442695040888963407ull;
+                }
+            }
+            m_sink.store(x, std::memory_order_relaxed);
+        }
+
+        std::atomic<bool> m_stop{ false };
+        mutable std::atomic<uint64_t> m_sink{ 0 };
+        std::vector<std::thread> m_threads;
+    };
+
+    bool ParsePriority(std::string_view name, HookPriority& priority)
+    {
+        for (size_t i = 0; i < std::size(HookPriorityNames); ++i)
+        {
+            if (name == HookPriorityNames[i])
+            {
+                priority = static_cast<HookPriority>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Inject(WORD vk)
+    {
+        INPUT inputs[2]{};
+        for (INPUT& input : inputs)
+        {
+            input.type = INPUT_KEYBOARD;
+            input.ki.wVk = vk;
+        }
+        inputs[1].ki.dwFlags = KEYEVENTF_KEYUP;
+        SendInput(ARRAYSIZE(inputs), inputs, sizeof(INPUT));
+    }
+
+    // Pumps the window's messages until the delivery key arrived and, when
+    // `detection` is set, the processor matched the detection key.
+    bool WaitForSample(HANDLE detection)
+    {
+        ULONGLONG const deadline = GetTickCount64() + SampleTimeoutMs;
+        bool detected = detection == nullptr;
+        while (!g_deliveredSet || !detected)
+        {
+            ULONGLONG const now = GetTickCount64();
+            if (now >= deadline)
+            {
+                return false;
+            }
+            HANDLE const handles[] = { detection };
+            DWORD const count = detected ? 0 : 1;
+            DWORD const result = MsgWaitForMultipleObjects(count, handles, FALSE, static_cast<DWORD>(deadline - now), QS_ALLINPUT);
+            if (!detected && result == WAIT_OBJECT_0)
+            {
+                detected = true;
+                continue;
+            }
+            MSG msg;
+            while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE))
+            {
+                DispatchMessageW(&msg);
+            }
+        }
+        return true;
+    }
+
+    Stats Summarize(std::vector<double> samples)
+    {
+        Stats stats;
+        if (samples.empty())
+        {
+            return stats;
+        }
+        std::ranges::sort(samples);
+        double sum = 0;
+        for (double sample : samples)
+        {
+            sum += sample;
+        }
+        stats.meanUs = sum / samples.size();
+        stats.p50Us = samples[samples.size() / 2];
+        stats.p99Us = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+        stats.maxUs = samples.back();
+        return stats;
+    }
+
+    void Print(char const* backend, char const* measure, Stats const& stats, size_t samples, size_t lost)
+    {
+        std::printf("%-10s %-10s %10.1f %10.1f %10.1f %10.1f %8zu %6zu\n",
+            backend, measure, stats.meanUs, stats.p50Us, stats.p99Us, stats.maxUs, samples, lost);
+    }
+
+    void Run(char const* name, Backend backend, size_t sampleCount, HookPriority priority)
+    {
+        constexpr size_t WarmupSamples = 32;
+
+        // The hook swallows its binding, Raw Input only sees passThrough ones.
+        DispatchSnapshotPointer snapshots(DetectionSnapshot(backend == Backend::RawInput));
+        DetectionHandler handler;
+        HookProcessor processor;
+        processor.SetMode(backend == Backend::RawInput ? HookMode::Observe : HookMode::Intercept);
+        processor.Attach(snapshots);
+        processor.SetHandler(&handler);
+
+        KeyboardHook hook(processor);
+        hook.SetPriority(priority);
+        RawInputSource rawInput(processor);
+        if (backend == Backend::Hook)
+        {
+            hook.Install();
+        }
+        else if (backend == Backend::RawInput)
+        {
+            rawInput.Start();
+        }
+
+        std::vector<double> delivery;
+        std::vector<double> detection;
+        size_t lost = 0;
+        for (size_t i = 0; i < WarmupSamples + sampleCount; ++i)
+        {
+            g_deliveredSet = false;
+            ResetEvent(handler.Event());
+            Clock::time_point const sent = Clock::now();
+            Inject(DeliveryKey);
+            if (backend != Backend::None)
+            {
+                Inject(DetectionKey);
+            }
+
+            if (!WaitForSample(backend != Backend::None ? handler.Event() : nullptr))
+            {
+                ++lost;
+            }
+            else if (i >= WarmupSamples)
+            {
+                delivery.push_back(std::chrono::duration<double, std::micro>(g_delivered - sent).count());
+                if (backend != Backend::None)
+                {
+                    detection.push_back(std::chrono::duration<double, std::micro>(handler.Detected() - sent).count());
+                }
+            }
+            Sleep(2); // keeps samples apart so none queues behind the previous one
+        }
+
+        hook.Uninstall();
+        rawInput.Stop();
+
+        Print(name, "delivery", Summarize(delivery), delivery.size(), lost);
+        if (backend != Backend::None)
+        {
+            Print(name, "detection", Summarize(detection), detection.size(), lost);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t samples = 2000;
+    size_t load = 0;
+    HookPriority priority = Settings{}.hookPriority;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string_view const option = argv[i];
+        if (option == "--samples") samples = static_cast<size_t>(std::atoll(argv[i + 1]));
+        else if (option == "--load") load = static_cast<size_t>(std::atoll(argv[i + 1]));
+        else if (option != "--priority" || !ParsePriority(argv[i + 1], priority))
+        {
+            std::fprintf(stderr, "unknown option %s %s\n", argv[i], argv[i + 1]);
+            return 2;
+        }
+    }
+
+    try
+    {
+        HWND const window = CreateTargetWindow();
+        if (GetForegroundWindow() != window)
+        {
+            std::fprintf(stderr, "benchmark window is not in the foreground; delivery samples will be lost\n");
+        }
+
+        CpuLoad const busy(load);
+        std::printf("load %zu thread(s), hook priority %s\n", load, HookPriorityNames[static_cast<size_t>(priority)]);
+        std::printf("%-10s %-10s %10s %10s %10s %10s %8s %6s\n", "backend", "measure", "mean us", "p50 us", "p99 us", "max us", "samples", "lost");
+        Run("none", Backend::None, samples, priority);
+        Run("hook", Backend::Hook, samples, priority);
+        Run("rawinput", Backend::RawInput, samples, priority);
+        DestroyWindow(window);
+    }
+    catch (winrt::hresult_error const& e)
+    {
+        std::fprintf(stderr, "%ls\n", e.message().c_str());
+        return 1;
+    }
+    catch (std::exception const& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,209 @@
+// Bulk merge timing and collision check: generates two JSON configs, writes
+// them to the temp directory and times ConfigurationMerge::Merge of the
+// pair into a third file.
+//
+//   MergeBenchmark.exe [--rounds n] [--keep]
+//
+// The first input binds chords only. Every other action of the second has
+// a hotkey taken by the first input and a free sequence; the action after
+// it has that same sequence and no hotkey. The first of each pair must
+// collide and bind nothing, so the second is not a collision: exits with 1
+// when the merged file disables any other actions. Reports the best of n
+// rounds. --keep leaves the generated files behind.
+
+#include "pch.h"
+
+#include "Configuration/ConfigurationLoader.h"
+#include "Configuration/ConfigurationMerge.h"
+#include "Core/Hotkey.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    using namespace khm;
+
+    constexpr uint32_t ModifierCombinations = 16;
+    constexpr uint32_t ChordKeys = 36;      // A-Z and 0-9, for the first input's chords
+    constexpr uint32_t SequenceKeys = 12;   // F13-F24, for first steps no chord uses
+    constexpr uint32_t GlobalChords = ModifierCombinations * ChordKeys;
+
+    uint32_t ChordKey(uint32_t i)
+    {
+        uint32_t const key = i % ChordKeys;
+        return key < 26 ? 0x41 + key : 0x30 + key - 26;
+    }
+
+    std::string JsonModifiers(uint32_t mask)
+    {
+        std::string text;
+        if (mask & ModWin) text += "\"win\": true, ";
+        if (mask & ModCtrl) text += "\"ctrl\": true, ";
+        if (mask & ModShift) text += "\"shift\": true, ";
+        if (mask & ModAlt) text += "\"alt\": true, ";
+        return text;
+    }
+
+    // Chord i of the first input is unique: past the global chords it moves
+    // into one profile per GlobalChords actions.
+    std::string JsonChord(uint32_t i)
+    {
+        return "{ " + JsonModifiers((i / ChordKeys) % ModifierCombinations) + "\"key\": " + std::to_string(ChordKey(i)) + " }";
+    }
+
+    std::string JsonAction(std::string const& id, size_t i)
+    {
+        return "    {\n      \"id\": \"" + id + "\",\n      \"name\": \"Merge action " + std::to_string(i)
+            + "\",\n      \"type\": \"LaunchApp\",\n      \"parameter\": \"bench" + std::to_string(i % 97) + ".exe\",\n";
+    }
+
+    std::string GenerateFirst(size_t count)
+    {
+        std::string text = "{\n  \"version\": \"1.0\",\n  \"settings\": { \"sequenceTimeoutMs\": 1000 },\n  \"actions\": [\n";
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t const chord = static_cast<uint32_t>(i);
+            text += JsonAction("first-" + std::to_string(i), i);
+            if (chord >= GlobalChords)
+            {
+                text += "      \"profile\": \"app" + std::to_string(chord / GlobalChords) + ".exe\",\n";
+            }
+            text += "      \"hotkey\": " + JsonChord(chord % GlobalChords) + "\n";
+            text += i + 1 < count ? "    },\n" : "    }\n";
+        }
+        text += "  ]\n}\n";
+        return text;
+    }
+
+    // Pair p: a global chord of the first input plus sequence p, then
+    // sequence p alone.
+    std::string GenerateSecond(size_t count)
+    {
+        std::string text = "{\n  \"version\": \"1.0\",\n  \"actions\": [\n";
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t const pair = static_cast<uint32_t>(i / 2);
+            uint32_t const first = pair % (ModifierCombinations * SequenceKeys);
+            uint32_t const second = pair / (ModifierCombinations * SequenceKeys);
+            text += JsonAction("second-" + std::to_string(i), i);
+            if (i % 2 == 0)
+            {
+                text += "      \"hotkey\": " + JsonChord(pair % GlobalChords) + ",\n";
+            }
+            text += "      \"sequence\": [ { " + JsonModifiers(first % ModifierCombinations) + "\"key\": "
+                + std::to_string(0x7C + first / ModifierCombinations) + " }, " + JsonChord(second) + " ]\n";
+            text += i + 1 < count ? "    },\n" : "    }\n";
+        }
+        text += "  ]\n}\n";
+        return text;
+    }
+
+    void WriteText(std::filesystem::path const& path, std::string const& text)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(text.data(), static_cast<std::streamsize>(text.size()));
+        if (!file)
+        {
+            throw std::runtime_error("cannot write " + path.string());
+        }
+    }
+
+    // Only the hotkey-plus-sequence actions of the second input collide.
+    void Verify(std::filesystem::path const& output, size_t count)
+    {
+        LoadedConfiguration const merged = ConfigurationLoader::LoadStreaming(output);
+        if (merged.actions.Size() != 2 * count)
+        {
+            throw std::runtime_error(output.string() + ": merged " + std::to_string(merged.actions.Size()) + " actions");
+        }
+        constexpr std::string_view Second = "second-";
+        for (ActionRecord const& record : merged.actions.Records())
+        {
+            std::string_view const id = merged.actions.String(record.id);
+            bool const collides = id.starts_with(Second) && std::atoi(std::string(id.substr(Second.size())).c_str()) % 2 == 0;
+            if (record.enabled == collides)
+            {
+                throw std::runtime_error(output.string() + ": " + std::string(id) + (collides ? " bound" : " disabled"));
+            }
+        }
+    }
+
+    // Best of `rounds`, in milliseconds.
+    double TimeMerge(std::filesystem::path const (&inputs)[2], std::filesystem::path const& output, int rounds, size_t count)
+    {
+        double best = 1e300;
+        for (int round = 0; round < rounds; ++round)
+        {
+            auto const start = std::chrono::steady_clock::now();
+            MergeReport const report = ConfigurationMerge::Merge(inputs, output);
+            auto const elapsed = std::chrono::steady_clock::now() - start;
+            if (report.written != 2 * count || report.collisions != (count + 1) / 2)
+            {
+                throw std::runtime_error(output.string() + ": " + std::to_string(report.collisions) + " collisions");
+            }
+            best = std::min(best, std::chrono::duration<double, std::milli>(elapsed).count());
+        }
+        Verify(output, count);
+        return best;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int rounds = 5;
+    bool keep = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view const option = argv[i];
+        if (option == "--rounds" && i + 1 < argc) rounds = std::max(1, std::atoi(argv[++i]));
+        else if (option == "--keep") keep = true;
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    try
+    {
+        std::filesystem::path const directory = std::filesystem::temp_directory_path();
+        size_t const actionCounts[] = { 1000, 10000, 100000 };
+
+        std::printf("%9s %12s %10s %10s\n", "actions", "bytes", "best ms", "actions/s");
+        for (size_t count : actionCounts)
+        {
+            std::string const first = GenerateFirst(count);
+            std::string const second = GenerateSecond(count);
+            std::filesystem::path const inputs[] = {
+                directory / ("khm-merge-" + std::to_string(count) + "-a.json"),
+                directory / ("khm-merge-" + std::to_string(count) + "-b.json"),
+            };
+            std::filesystem::path const output = directory / ("khm-merge-" + std::to_string(count) + "-out.json");
+            WriteText(inputs[0], first);
+            WriteText(inputs[1], second);
+
+            double const ms = TimeMerge(inputs, output, rounds, count);
+            std::printf("%9zu %12zu %10.2f %10.0f\n", 2 * count, first.size() + second.size(), ms, 2 * count / (ms / 1000.0));
+
+            if (!keep)
+            {
+                std::filesystem::remove(inputs[0]);
+                std::filesystem::remove(inputs[1]);
+                std::filesystem::remove(output);
+            }
+        }
+    }
+    catch (std::exception const& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,407 @@
+// Replays an input trace (KeyboardHookManager.exe --record file) against
+// the matching and dispatch pipeline: HookProcessor over a snapshot of the
+// given config, handing fired actions to a HookEventRing. No hook, window
+// or desktop session is involved, and no action is run.
+//
+//   TraceReplay.exe --trace file --config file [--speed n|max] [--rounds n]
+//                   [--baseline file] [--write-baseline file] [--threshold percent]
+//   TraceReplay.exe --generate file [--events n]
+//
+// --speed replays at n times the recorded pace (1, 10, 100, ...); the
+// default, max, feeds events back to back. Events keep their recorded
+// times whatever the speed, so sequence timeouts and therefore the fired
+// actions are the same at every speed: the digest over (event, action)
+// pairs identifies the matching behaviour across builds. Per round it
+// reports throughput, the latency of Process() over all events, the match
+// and handoff stages of the events that fired, and at a set speed how far
+// behind schedule events were fed. The foreground app is not recorded, so
+// only global bindings fire.
+//
+// --baseline fails the run when the digest or fired count differs from the
+// baseline, or Process() got more than --threshold percent slower; compare
+// timings only between runs at the same --speed. Win
+// chords still tap the Start menu mask key through SendInput, which does
+// nothing without a desktop.
+//
+// --generate writes a synthetic trace (typing, chords, autorepeat) for runs
+// without a recording.
+
+#include "pch.h"
+
+#include "Configuration/ConfigurationLoader.h"
+#include "Core/DispatchSnapshot.h"
+#include "Core/HookEvent.h"
+#include "Core/HookProcessor.h"
+#include "Core/InputTrace.h"
+#include "Utils/Hash.h"
+#include "Utils/Instrumentation.h"
+#include "Utils/LatencyHistogram.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace khm;
+
+    struct Options
+    {
+        std::filesystem::path trace;
+        std::filesystem::path config;
+        double speed = 0; // 0: as fast as possible
+        int rounds = 3;
+        char const* baselinePath = nullptr;
+        char const* writeBaselinePath = nullptr;
+        double thresholdPercent = 10.0;
+        std::filesystem::path generate;
+        uint32_t generateEvents = 100'000;
+    };
+
+    struct Result
+    {
+        uint64_t events = 0;
+        double seconds = 0;
+        LatencyAccumulator process;
+        uint64_t processTicks = 0;
+        LatencyAccumulator lag;
+        LatencySummary match;
+        LatencySummary handoff;
+        uint64_t fired = 0;
+        uint64_t dropped = 0;
+        uint64_t digest = Fnv1a64Basis;
+        std::vector<uint64_t> firedPerAction;
+    };
+
+    int64_t g_ticksPerMs = 1;
+
+    double Ns(uint64_t ticks)
+    {
+        return static_cast<double>(Instrumentation::TicksToNanoseconds(ticks));
+    }
+
+    // Back off to Sleep() while the event is far away; spin the last stretch.
+    void WaitUntil(int64_t deadline)
+    {
+        for (;;)
+        {
+            int64_t const left = deadline - Instrumentation::Now();
+            if (left <= 0)
+            {
+                return;
+            }
+            if (left > 2 * g_ticksPerMs)
+            {
+                Sleep(1);
+            }
+            else
+            {
+                YieldProcessor();
+            }
+        }
+    }
+
+    Result Replay(InputTraceReader& trace, DispatchSnapshotPointer& snapshots, size_t actionCount, double speed)
+    {
+        Result result;
+        result.firedPerAction.assign(actionCount, 0);
+
+        auto ring = std::make_unique<HookEventRing>();
+        HookProcessor processor;
+        processor.Attach(snapshots);
+        processor.SetHandler(ring.get());
+
+        LatencyHistogram process;
+        LatencyHistogram lag;
+        Instrumentation::Reset();
+        Instrumentation::SetEnabled(true);
+
+        trace.Rewind();
+        TraceEvent event;
+        uint32_t const firstTime = trace.Header().startTime;
+        int64_t const start = Instrumentation::Now();
+        while (trace.Next(event))
+        {
+            if (speed > 0)
+            {
+                int64_t const due = start + static_cast<int64_t>((event.time - firstTime) * static_cast<double>(g_ticksPerMs) / speed);
+                WaitUntil(due);
+                lag.Record(static_cast<uint64_t>(std::max<int64_t>(0, Instrumentation::Now() - due)));
+            }
+
+            KBDLLHOOKSTRUCT const data = event.Data();
+            int64_t const entered = Instrumentation::Now();
+            processor.Process(event.Message(), data, event.modifiers);
+            uint64_t const ticks = static_cast<uint64_t>(Instrumentation::Now() - entered);
+            process.Record(ticks);
+            result.processTicks += ticks;
+
+            // Drained as it fills, so the ring never drops and the digest
+            // stays deterministic.
+            HookEvent fired;
+            while (ring->TryPop(fired))
+            {
+                uint64_t const pair[] = { result.events, fired.actionIndex };
+                result.digest = Fnv1a64(std::as_bytes(std::span(pair)), result.digest);
+                ++result.fired;
+                if (fired.actionIndex < result.firedPerAction.size())
+                {
+                    ++result.firedPerAction[fired.actionIndex];
+                }
+            }
+            ++result.events;
+        }
+        int64_t const elapsed = Instrumentation::Now() - start;
+
+        Instrumentation::SetEnabled(false);
+        result.seconds = Ns(static_cast<uint64_t>(elapsed)) / 1e9;
+        result.process.Add(process);
+        result.lag.Add(lag);
+        result.match = Instrumentation::Summarize(LatencyStage::Match);
+        result.handoff = Instrumentation::Summarize(LatencyStage::Handoff);
+        result.dropped = ring->Dropped();
+        return result;
+    }
+
+    void PrintLatency(char const* name, LatencyAccumulator const& latency)
+    {
+        std::printf("  %-10s p50 %10.0f  p99 %10.0f  p99.9 %10.0f  max %10.0f ns\n", name,
+            Ns(latency.ValueAt(0.50)), Ns(latency.ValueAt(0.99)), Ns(latency.ValueAt(0.999)), Ns(latency.max));
+    }
+
+    void PrintLatency(char const* name, LatencySummary const& latency)
+    {
+        std::printf("  %-10s p50 %10llu  p99 %10llu  p99.9 %10llu  max %10llu ns (%llu fired)\n", name,
+            static_cast<unsigned long long>(latency.p50Ns), static_cast<unsigned long long>(latency.p99Ns),
+            static_cast<unsigned long long>(latency.p999Ns), static_cast<unsigned long long>(latency.maxNs),
+            static_cast<unsigned long long>(latency.count));
+    }
+
+    double MeanProcessNs(Result const& result)
+    {
+        return result.events != 0 ? Ns(result.processTicks) / static_cast<double>(result.events) : 0.0;
+    }
+
+    void AppendKey(InputTraceWriter& writer, uint32_t& time, uint8_t vk, uint8_t modifiers, bool up, uint32_t gapMs)
+    {
+        bool const sys = (modifiers & ModAlt) != 0 && (modifiers & ModCtrl) == 0;
+        KBDLLHOOKSTRUCT data{};
+        data.vkCode = vk;
+        data.flags = up ? LLKHF_UP : 0;
+        data.time = time += gapMs;
+        WPARAM const message = up ? (sys ? WM_SYSKEYUP : WM_KEYUP) : (sys ? WM_SYSKEYDOWN : WM_KEYDOWN);
+        writer.Append(TraceEvent::From(message, data, modifiers));
+    }
+
+    // Mostly typing at ~12 keys/s, with modified chords and held keys mixed
+    // in. Modifier key events themselves are left out: the processor only
+    // reads the modifier mask.
+    void Generate(std::filesystem::path const& path, uint32_t count)
+    {
+        std::mt19937 random(42);
+        std::uniform_int_distribution<int> letter('A', 'Z');
+        std::uniform_int_distribution<int> kind(0, 99);
+        std::uniform_int_distribution<int> modifiers(1, 15);
+        InputTraceWriter writer(path);
+        uint32_t time = 1000;
+        while (writer.EventCount() + 2 <= count)
+        {
+            uint8_t const vk = static_cast<uint8_t>(letter(random));
+            int const roll = kind(random);
+            if (roll < 85)
+            {
+                AppendKey(writer, time, vk, ModNone, false, 40);
+                AppendKey(writer, time, vk, ModNone, true, 40);
+            }
+            else if (roll < 98)
+            {
+                uint8_t const mask = static_cast<uint8_t>(modifiers(random));
+                AppendKey(writer, time, vk, mask, false, 150);
+                AppendKey(writer, time, vk, mask, true, 80);
+            }
+            else
+            {
+                uint32_t const repeats = std::min<uint32_t>(30, count - writer.EventCount() - 1);
+                AppendKey(writer, time, vk, ModNone, false, 40);
+                for (uint32_t i = 1; i < repeats; ++i)
+                {
+                    AppendKey(writer, time, vk, ModNone, false, 33);
+                }
+                AppendKey(writer, time, vk, ModNone, true, 33);
+            }
+        }
+        writer.Close();
+        std::printf("%s: %u events\n", path.string().c_str(), writer.EventCount());
+    }
+
+    std::map<std::string, std::string> ReadBaseline(char const* path)
+    {
+        std::map<std::string, std::string> baseline;
+        std::ifstream file(path);
+        std::string name;
+        std::string value;
+        while (file >> name >> value)
+        {
+            baseline[name] = value;
+        }
+        return baseline;
+    }
+
+    bool Parse(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i + 1 < argc; i += 2)
+        {
+            std::string_view const option = argv[i];
+            char const* value = argv[i + 1];
+            if (option == "--trace") options.trace = value;
+            else if (option == "--config") options.config = value;
+            else if (option == "--speed") options.speed = std::string_view(value) == "max" ? 0.0 : std::max(0.0, std::atof(value));
+            else if (option == "--rounds") options.rounds = std::max(1, std::atoi(value));
+            else if (option == "--baseline") options.baselinePath = value;
+            else if (option == "--write-baseline") options.writeBaselinePath = value;
+            else if (option == "--threshold") options.thresholdPercent = std::atof(value);
+            else if (option == "--generate") options.generate = value;
+            else if (option == "--events") options.generateEvents = static_cast<uint32_t>(std::max(2, std::atoi(value)));
+            else
+            {
+                std::fprintf(stderr, "unknown option %s\n", argv[i]);
+                return false;
+            }
+        }
+        if (options.generate.empty() && (options.trace.empty() || options.config.empty()))
+        {
+            std::fprintf(stderr, "--trace and --config are required\n");
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!Parse(argc, argv, options))
+    {
+        return 2;
+    }
+
+    try
+    {
+        Instrumentation::Initialize();
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        g_ticksPerMs = std::max<int64_t>(1, frequency.QuadPart / 1000);
+
+        if (!options.generate.empty())
+        {
+            Generate(options.generate, options.generateEvents);
+            return 0;
+        }
+
+        LoadedConfiguration configuration = ConfigurationLoader::LoadStreaming(options.config);
+        std::vector<std::string> ids;
+        for (ActionRecord const& action : configuration.actions.Records())
+        {
+            ids.emplace_back(configuration.actions.String(action.id));
+        }
+        DispatchSnapshotPointer snapshots(DispatchSnapshot::Create(std::move(configuration)));
+        InputTraceReader trace(options.trace);
+
+        char speed[32] = "max";
+        if (options.speed > 0)
+        {
+            std::snprintf(speed, sizeof(speed), "%gx", options.speed);
+        }
+        std::printf("%s: %zu bytes, %u events recorded; %zu actions; speed %s\n", options.trace.string().c_str(), trace.Bytes(),
+            trace.Header().eventCount, ids.size(), speed);
+
+        Result best;
+        for (int round = 0; round < options.rounds; ++round)
+        {
+            Result result = Replay(trace, snapshots, ids.size(), options.speed);
+            std::printf("round %d: %llu events in %.3f s, %.0f events/s, %llu fired, %llu dropped, digest %016llx\n", round + 1,
+                static_cast<unsigned long long>(result.events), result.seconds, result.events / std::max(result.seconds, 1e-9),
+                static_cast<unsigned long long>(result.fired), static_cast<unsigned long long>(result.dropped),
+                static_cast<unsigned long long>(result.digest));
+            PrintLatency("process", result.process);
+            PrintLatency("match", result.match);
+            PrintLatency("handoff", result.handoff);
+            if (options.speed > 0)
+            {
+                PrintLatency("lag", result.lag);
+            }
+            if (round != 0 && (result.digest != best.digest || result.fired != best.fired))
+            {
+                std::fprintf(stderr, "replay is not deterministic: round %d fired differently\n", round + 1);
+                return 1;
+            }
+            if (round == 0 || MeanProcessNs(result) < MeanProcessNs(best))
+            {
+                best = std::move(result);
+            }
+        }
+
+        std::vector<size_t> order(ids.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+        std::ranges::stable_sort(order, [&](size_t a, size_t b) { return best.firedPerAction[a] > best.firedPerAction[b]; });
+        std::printf("fired actions:\n");
+        for (size_t i = 0; i < std::min<size_t>(order.size(), 20) && best.firedPerAction[order[i]] != 0; ++i)
+        {
+            std::printf("  %10llu  %s\n", static_cast<unsigned long long>(best.firedPerAction[order[i]]), ids[order[i]].c_str());
+        }
+
+        double const meanNs = MeanProcessNs(best);
+        char digest[24];
+        std::snprintf(digest, sizeof(digest), "%016llx", static_cast<unsigned long long>(best.digest));
+        bool failed = false;
+        if (options.baselinePath)
+        {
+            std::map<std::string, std::string> const baseline = ReadBaseline(options.baselinePath);
+            if (auto it = baseline.find("digest"); it != baseline.end() && it->second != digest)
+            {
+                std::fprintf(stderr, "fired actions differ from the baseline (digest %s, baseline %s)\n", digest, it->second.c_str());
+                failed = true;
+            }
+            if (auto it = baseline.find("fired"); it != baseline.end() && it->second != std::to_string(best.fired))
+            {
+                std::fprintf(stderr, "%llu actions fired, baseline %s\n", static_cast<unsigned long long>(best.fired), it->second.c_str());
+                failed = true;
+            }
+            if (auto it = baseline.find("processNs"); it != baseline.end() && std::atof(it->second.c_str()) > 0)
+            {
+                double const percent = (meanNs / std::atof(it->second.c_str()) - 1.0) * 100.0;
+                std::printf("process mean %.1f ns, %+.1f%% vs baseline\n", meanNs, percent);
+                failed |= percent > options.thresholdPercent;
+            }
+        }
+        if (options.writeBaselinePath)
+        {
+            std::ofstream file(options.writeBaselinePath);
+            file << "digest " << digest << "\nfired " << best.fired << "\nprocessNs " << meanNs << '\n';
+        }
+        return failed ? 1 : 0;
+    }
+    catch (ConfigurationError const& e)
+    {
+        std::fprintf(stderr, "%s: %s\n", options.config.string().c_str(), e.what());
+        return 1;
+    }
+    catch (winrt::hresult_error const& e)
+    {
+        std::fprintf(stderr, "%ls\n", e.message().c_str());
+        return 1;
+    }
+    catch (std::exception const& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}